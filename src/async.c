@@ -0,0 +1,253 @@
+/*
+ * async.c - Asynchronous injection queue and job handles
+ *
+ * Async variants of the long-running key and cursor functions hand their
+ * work to a single injector thread through a FIFO queue and return an
+ * input_job_t handle. Jobs run one at a time in submission order, so
+ * sequences never interleave. The thread is started on first use and
+ * stays parked on a condition variable while the queue is empty.
+ */
+
+#include <stdlib.h>
+#include "backend.h"
+#include "timing.h"
+#include "async.h"
+
+/*
+ * input_job_t - One queued job
+ *
+ * Referenced by the caller until input_jobclose and by the queue until it
+ * finishes; freed when both references are gone.
+ */
+struct input_job_t {
+	AsyncRun run;           /* Job body */
+	void* arg;              /* Body argument, freed with the job */
+	int state;              /* INPUT_JOB_* */
+	int cancel;             /* Set to request cancellation */
+	int refs;               /* Outstanding references */
+	input_job_t* next;      /* Next job in the queue */
+};
+
+static CRITICAL_SECTION g_async_cs;
+static CONDITION_VARIABLE g_async_work;   /* Signalled when a job is queued */
+static CONDITION_VARIABLE g_async_done;   /* Broadcast when a job finishes */
+static int g_async_initialized = 0;
+static HANDLE g_async_thread = NULL;
+static input_job_t* g_async_head = NULL;
+static input_job_t* g_async_tail = NULL;
+
+/*
+ * async_init - Lazily set up the queue lock and condition variables
+ */
+static void async_init(void) {
+	/* Submissions may race from several threads; one of them initializes */
+	if(__atomic_load_n(&g_async_initialized, __ATOMIC_ACQUIRE)) return;
+	static int claimed = 0;
+	if(__atomic_exchange_n(&claimed, 1, __ATOMIC_ACQ_REL)) {
+		while(!__atomic_load_n(&g_async_initialized, __ATOMIC_ACQUIRE)) {}
+		return;
+	}
+	InitializeCriticalSection(&g_async_cs);
+	InitializeConditionVariable(&g_async_work);
+	InitializeConditionVariable(&g_async_done);
+	__atomic_store_n(&g_async_initialized, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * async_release - Drop one reference, freeing the job on the last one
+ *
+ * Caller must hold g_async_cs.
+ */
+static void async_release(input_job_t* job) {
+	if(--job->refs > 0) return;
+	free(job->arg);
+	free(job);
+}
+
+/*
+ * async_finish - Publish the final state of a job and wake waiters
+ *
+ * Caller must hold g_async_cs.
+ */
+static void async_finish(input_job_t* job, int state) {
+	job->state = state;
+	WakeAllConditionVariable(&g_async_done);
+	async_release(job);
+}
+
+/*
+ * async_thread_proc - Injector thread
+ *
+ * Pops jobs in FIFO order and runs them outside the lock, so callers can
+ * submit, poll and cancel while a job is in progress.
+ */
+static DWORD WINAPI async_thread_proc(void* param) {
+	(void)param;
+	EnterCriticalSection(&g_async_cs);
+	for(;;) {
+		while(!g_async_head) SleepConditionVariableCS(&g_async_work, &g_async_cs, INFINITE);
+		input_job_t* job = g_async_head;
+		g_async_head = job->next;
+		if(!g_async_head) g_async_tail = NULL;
+		job->next = NULL;
+		job->state = INPUT_JOB_RUNNING;
+		LeaveCriticalSection(&g_async_cs);
+		
+		int rc = job->run(job->arg, &job->cancel);
+		
+		EnterCriticalSection(&g_async_cs);
+		async_finish(job, rc == ASYNC_RUN_DONE ? INPUT_JOB_DONE
+		               : rc == ASYNC_RUN_CANCELLED ? INPUT_JOB_CANCELLED : INPUT_JOB_FAILED);
+	}
+	return 0;
+}
+
+/*
+ * async_submit - Queue a job for the injector thread
+ *
+ * @run: Job body
+ * @arg: Heap-allocated argument, owned by the job from here on
+ *
+ * Starts the injector thread on first use. arg is freed on failure.
+ *
+ * Returns: Job handle, or NULL on failure
+ */
+input_job_t* async_submit(AsyncRun run, void* arg) {
+	async_init();
+	input_job_t* job = (input_job_t*)calloc(1, sizeof(input_job_t));
+	if(!job) {
+		free(arg);
+		SetLastError(ERROR_OUTOFMEMORY);
+		return NULL;
+	}
+	job->run = run;
+	job->arg = arg;
+	job->state = INPUT_JOB_PENDING;
+	job->refs = 2;  /* Caller and queue */
+	
+	EnterCriticalSection(&g_async_cs);
+	if(!g_async_thread) {
+		g_async_thread = CreateThread(NULL, 0, async_thread_proc, NULL, 0, NULL);
+		if(!g_async_thread) {
+			LeaveCriticalSection(&g_async_cs);
+			free(arg);
+			free(job);
+			return NULL;
+		}
+	}
+	if(g_async_tail) g_async_tail->next = job;
+	else g_async_head = job;
+	g_async_tail = job;
+	WakeConditionVariable(&g_async_work);
+	LeaveCriticalSection(&g_async_cs);
+	return job;
+}
+
+/*
+ * input_jobpoll - Get the state of an asynchronous job
+ * 
+ * @job: Handle returned by an *_async function
+ * 
+ * Returns: INPUT_JOB_* state, or -1 if job is NULL
+ */
+int INPUTLIB_CALL input_jobpoll(input_job_t* job) {
+	if(!job) { SetLastError(ERROR_INVALID_PARAMETER); return -1; }
+	EnterCriticalSection(&g_async_cs);
+	int state = job->state;
+	LeaveCriticalSection(&g_async_cs);
+	return state;
+}
+
+/*
+ * input_jobwait - Wait for an asynchronous job to finish
+ * 
+ * @job: Handle returned by an *_async function
+ * @timeout_ms: Maximum time to wait in milliseconds, -1 to wait forever
+ * 
+ * The timeout is measured on the real clock, also on the simulated backend.
+ * A job has finished once it is done, cancelled or failed; use input_jobpoll
+ * to tell which.
+ * 
+ * Returns: 0 if the job finished, 1 on timeout (ERROR_TIMEOUT) or invalid
+ * parameters
+ */
+int INPUTLIB_CALL input_jobwait(input_job_t* job, int timeout_ms) {
+	if(!job) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+	unsigned long long deadline = timing_now_ns() + (unsigned long long)(timeout_ms > 0 ? timeout_ms : 0) * 1000000ULL;
+	
+	EnterCriticalSection(&g_async_cs);
+	while(job->state == INPUT_JOB_PENDING || job->state == INPUT_JOB_RUNNING) {
+		DWORD wait = INFINITE;
+		if(timeout_ms >= 0) {
+			unsigned long long now = timing_now_ns();
+			if(now >= deadline) {
+				LeaveCriticalSection(&g_async_cs);
+				SetLastError(ERROR_TIMEOUT);
+				return 1;
+			}
+			wait = (DWORD)((deadline - now + 999999ULL) / 1000000ULL);
+		}
+		SleepConditionVariableCS(&g_async_done, &g_async_cs, wait);
+	}
+	LeaveCriticalSection(&g_async_cs);
+	return 0;
+}
+
+/*
+ * input_jobcancel - Cancel an asynchronous job
+ * 
+ * @job: Handle returned by an *_async function
+ * 
+ * A job still in the queue is removed and never runs. A running job stops
+ * at its next wait and cleans up after itself, e.g. a held key is released.
+ * Cancellation is asynchronous; use input_jobwait to wait for it.
+ * 
+ * Returns: 0 on success, 1 if job is NULL or has already finished
+ */
+int INPUTLIB_CALL input_jobcancel(input_job_t* job) {
+	if(!job) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+	EnterCriticalSection(&g_async_cs);
+	if(job->state == INPUT_JOB_RUNNING) {
+		__atomic_store_n(&job->cancel, 1, __ATOMIC_RELEASE);
+		LeaveCriticalSection(&g_async_cs);
+		return 0;
+	}
+	if(job->state != INPUT_JOB_PENDING) {
+		LeaveCriticalSection(&g_async_cs);
+		SetLastError(ERROR_INVALID_OPERATION);
+		return 1;
+	}
+	
+	/* Unlink from the queue */
+	input_job_t* prev = NULL;
+	for(input_job_t* it = g_async_head; it; prev = it, it = it->next) {
+		if(it != job) continue;
+		if(prev) prev->next = it->next;
+		else g_async_head = it->next;
+		if(g_async_tail == it) g_async_tail = prev;
+		break;
+	}
+	job->next = NULL;
+	async_finish(job, INPUT_JOB_CANCELLED);
+	LeaveCriticalSection(&g_async_cs);
+	return 0;
+}
+
+/*
+ * input_jobclose - Release an asynchronous job handle
+ * 
+ * @job: Handle returned by an *_async function
+ * 
+ * Does not cancel the job, which keeps running to completion. The handle
+ * must not be used afterwards. Closing right after submitting gives
+ * fire-and-forget behavior.
+ * 
+ * Returns: 0 on success, 1 if job is NULL
+ */
+int INPUTLIB_CALL input_jobclose(input_job_t* job) {
+	if(!job) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+	EnterCriticalSection(&g_async_cs);
+	async_release(job);
+	LeaveCriticalSection(&g_async_cs);
+	return 0;
+}
@@ -0,0 +1,23 @@
+/*
+ * async.h - Internal asynchronous injection queue
+ */
+
+#pragma once
+
+#include "platform.h"
+
+/* Outcome of a job run, mapped onto INPUT_JOB_* */
+#define ASYNC_RUN_DONE 0
+#define ASYNC_RUN_FAILED 1
+#define ASYNC_RUN_CANCELLED 2
+
+/*
+ * AsyncRun - Body of a job, executed on the injector thread
+ *
+ * Long-running bodies should poll *cancel (pacer_waitc does this for
+ * waits) and return ASYNC_RUN_CANCELLED when it is set.
+ */
+typedef int (*AsyncRun)(void* arg, const int* cancel);
+
+/* Queue a job; arg is passed to free() once the job is finished */
+input_job_t* async_submit(AsyncRun run, void* arg);
@@ -0,0 +1,114 @@
+/*
+ * backend.h - Internal platform backend interface
+ *
+ * Every public function reaches the operating system through the
+ * InputBackend vtable selected in g_backend. The native backend talks to
+ * Win32, the simulated backend keeps a virtual clock, key state, cursor and
+ * window table in memory so the library can be exercised off a desktop.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "platform.h"
+
+/*
+ * HookEvent - Raw keyboard or mouse event delivered by a backend hook
+ */
+typedef struct HookEvent {
+	int type;                 /* EVENT_* */
+	int vk;                   /* Virtual key code, VK_LBUTTON etc. for buttons, 0 for moves and wheels */
+	int scan;                 /* Hardware scan code */
+	int pressed;              /* 1 if pressed, 0 if released */
+	int injected;             /* 1 if input was injected, 0 otherwise */
+	int self;                 /* 1 if injected through this backend by this process */
+	int x, y;                 /* Cursor position for mouse events */
+	int data;                 /* Wheel delta for wheel events */
+	unsigned long long time;  /* Event time reported by the OS in milliseconds */
+	unsigned long long time_ns;  /* Backend monotonic clock when the hook ran */
+} HookEvent;
+
+/*
+ * KeyInput - One keyboard event in a batched submission
+ */
+typedef struct KeyInput {
+	WORD vk;                  /* Virtual key code */
+	WORD scan;                /* Scan code */
+	DWORD flags;              /* KEYEVENTF_* flags */
+} KeyInput;
+
+/* Hook procedure - returns 1 to swallow the event, 0 to pass it on */
+typedef int (*HookProc)(const HookEvent* he);
+
+/* Window enumeration callback - returns 0 to stop enumeration */
+typedef int (*WindowEnumProc)(HWND hwnd, void* ctx);
+
+/* Foreground change notification, hwnd is the new foreground window or NULL */
+typedef void (*FocusProc)(HWND hwnd);
+
+/*
+ * InputBackend - Table of platform operations
+ *
+ * Functions returning int follow the library convention of 0 on success
+ * and 1 on failure unless noted otherwise.
+ */
+typedef struct InputBackend {
+	const char* name;
+
+	/* One-time setup when the library is initialized */
+	void (*init)(void);
+
+	/* Keyboard and mouse injection */
+	void (*key_event)(BYTE vk, DWORD flags);
+	void (*mouse_event)(DWORD flags, int dx, int dy, int data);
+	int (*send_keys)(const KeyInput* in, int count);  /* Returns events injected */
+	int (*key_state)(int vk);                 /* 1 if down, 0 if up */
+	int (*cursor_get)(int* x, int* y);
+	int (*cursor_set)(int x, int y);
+
+	/* Keyboard layout */
+	uintptr_t (*layout_current)(void);        /* Identifier of the foreground layout */
+	SHORT (*char_scan)(WORD ch, uintptr_t layout);  /* VkKeyScanEx result, -1 if unmapped */
+
+	/* Timing */
+	unsigned long long (*tick_ms)(void);
+	unsigned long long (*now_ns)(void);       /* Monotonic nanoseconds */
+	void (*sleep_until_ns)(unsigned long long deadline);
+
+	/* Windows - enumeration is over visible top-level windows in Z-order */
+	int (*window_enum)(WindowEnumProc proc, void* ctx);
+	HWND (*window_foreground)(void);
+	int (*window_title)(HWND hwnd, char* out, size_t len);  /* Returns title length */
+	int (*window_activate)(HWND hwnd);
+	int (*window_rect)(HWND hwnd, int* x, int* y, int* w, int* h);
+	int (*window_move)(HWND hwnd, int x, int y, int w, int h);
+	int (*window_show)(HWND hwnd, int cmd);
+	int (*window_close)(HWND hwnd);
+	int (*window_query)(HWND hwnd, window_info_t* out);
+	int (*window_ident)(HWND hwnd, window_info_t* out);  /* window_query without the process fields, never opens the process */
+
+	/* Foreground changes, including title changes of the foreground window. 
+	   Set before hook_start, reported while the hook runs, NULL to stop */
+	void (*focus_watch)(FocusProc proc);
+
+	/* Keyboard hook, also hooks the mouse on the same thread if mouse is 1. 
+	   The hook proc and focus watcher are never entered concurrently, and 
+	   hook_stop returns only once no delivery is in progress */
+	int (*hook_start)(HookProc proc, int mouse);
+	void (*hook_stop)(void);
+} InputBackend;
+
+/* Available backends */
+#ifdef _WIN32
+extern const InputBackend backend_win32;
+#endif
+extern const InputBackend backend_sim;
+
+/* Currently selected backend */
+extern const InputBackend* g_backend;
+
+/* Re-base listener timestamps on the current backend clock */
+void listener_rebase(void);
+
+/* Check if the listener hook is installed */
+int listener_isrunning(void);
@@ -0,0 +1,819 @@
+/*
+ * backend_sim.c - Simulated in-memory platform backend
+ *
+ * Implements the InputBackend operations against a virtual desktop: a
+ * virtual clock that only advances when asked to, a 256-entry key state
+ * table, a virtual cursor and a small table of fake windows. Injected keys
+ * are delivered synchronously to the installed hook, so the full listener
+ * path can be driven and benchmarked without a physical desktop.
+ *
+ * Events are delivered on whichever thread injects them, but never two at
+ * once: a dedicated hook lock serializes hook and focus deliveries, as the
+ * single hook thread does on Windows. The lock is recursive, so input sent
+ * from inside the hook is delivered in place.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "backend.h"
+#include "keymap.h"
+#include "timing.h"
+
+/* Maximum number of simulated windows */
+#define SIM_WINDOW_CAPACITY 64
+
+/* Layout identifiers reported by layout_current, as HKLs would be */
+#define SIM_LAYOUT_ID_US 0x04090409
+#define SIM_LAYOUT_ID_DE 0x04070407
+
+/* Size of the simulated primary screen */
+#define SIM_SCREEN_W 1920
+#define SIM_SCREEN_H 1080
+
+/*
+ * SimWindow - Entry in the simulated window table
+ */
+typedef struct {
+	int used;              /* 1 if slot holds an open window */
+	int show;              /* Last ShowWindow command applied */
+	int x, y, w, h;        /* Window rectangle */
+	DWORD pid;             /* Fake owning process ID */
+	char title[260];
+	char classname[256];
+	char procname[260];
+} SimWindow;
+
+static CRITICAL_SECTION g_sim_cs;
+static CRITICAL_SECTION g_sim_hook_cs;    /* Held for every hook and focus delivery, taken before g_sim_cs */
+static int g_sim_inited = 0;
+
+static unsigned long long g_sim_now_ns = 0;
+static int g_sim_layout = SIM_LAYOUT_US;
+static int g_sim_realtime = 0;
+static unsigned long long g_sim_base_ns = 0;    /* Real clock at virtual zero */
+static BYTE g_sim_keys[256] = {0};
+static int g_sim_cursor_x = 0;
+static int g_sim_cursor_y = 0;
+
+static SimWindow g_sim_windows[SIM_WINDOW_CAPACITY];
+static int g_sim_foreground = -1;
+
+static unsigned long long g_sim_key_count = 0;
+static unsigned long long g_sim_mouse_count = 0;
+
+static HookProc g_sim_hook = NULL;
+static int g_sim_hook_mouse = 0;
+static FocusProc g_sim_focus = NULL;
+
+/* Window handles are slot index + 1 so that NULL stays invalid */
+#define SIM_HWND(i) ((HWND)(uintptr_t)((i) + 1))
+
+/*
+ * sim_slot - Resolve a window handle to its table slot
+ *
+ * Returns: Slot index, or -1 if the handle is not an open window
+ */
+static int sim_slot(HWND hwnd) {
+	uintptr_t i = (uintptr_t)hwnd;
+	if(i == 0 || i > SIM_WINDOW_CAPACITY) return -1;
+	if(!g_sim_windows[i - 1].used) return -1;
+	return (int)(i - 1);
+}
+
+/*
+ * sim_now_ns - Read the simulated clock
+ *
+ * In realtime mode the clock follows the real monotonic clock, otherwise it
+ * only moves when slept on or advanced.
+ */
+static unsigned long long sim_now_ns(void) {
+	EnterCriticalSection(&g_sim_cs);
+	unsigned long long now = g_sim_realtime ? timing_now_ns() - g_sim_base_ns : g_sim_now_ns;
+	LeaveCriticalSection(&g_sim_cs);
+	return now;
+}
+
+/*
+ * sim_focus_changed - Report a new foreground window to the focus watcher
+ *
+ * Called without the simulator lock held, like a WinEvent callback.
+ */
+static void sim_focus_changed(HWND hwnd) {
+	EnterCriticalSection(&g_sim_hook_cs);
+	EnterCriticalSection(&g_sim_cs);
+	FocusProc proc = g_sim_focus;
+	LeaveCriticalSection(&g_sim_cs);
+	if(proc) proc(hwnd);
+	LeaveCriticalSection(&g_sim_hook_cs);
+}
+
+static void sim_init(void) {
+	if(g_sim_inited) return;
+	InitializeCriticalSection(&g_sim_cs);
+	InitializeCriticalSection(&g_sim_hook_cs);
+	g_sim_inited = 1;
+}
+
+/*
+ * sim_deliver - Run a key event through the hook and apply it
+ *
+ * @vk: Virtual key code
+ * @scan: Scan code (UTF-16 code unit for VK_PACKET)
+ * @pressed: 1 if pressed, 0 if released
+ * @injected: 1 if the event was injected by the library
+ *
+ * Mirrors the native ordering: the hook sees the event first, and only
+ * events it passes on reach the key state table. The event is stamped 
+ * under the hook lock, so hook times never run backwards. Generic 
+ * modifiers arrive as their left-side code, as the low-level hook reports 
+ * them on Windows.
+ *
+ * Returns: 1 if the hook blocked the event, 0 otherwise
+ */
+static int sim_deliver(BYTE vk, int scan, int pressed, int injected) {
+	switch(vk) {
+		case VK_SHIFT: vk = VK_LSHIFT; break;
+		case VK_CONTROL: vk = VK_LCONTROL; break;
+		case VK_MENU: vk = VK_LMENU; break;
+		default: break;
+	}
+
+	HookEvent he;
+	he.type = EVENT_KEY;
+	he.vk = vk;
+	he.scan = scan;
+	he.pressed = pressed;
+	he.injected = injected;
+	he.self = injected;
+	he.x = 0;
+	he.y = 0;
+	he.data = 0;
+
+	EnterCriticalSection(&g_sim_hook_cs);
+	he.time_ns = sim_now_ns();
+	he.time = he.time_ns / 1000000ULL;
+	EnterCriticalSection(&g_sim_cs);
+	HookProc hook = g_sim_hook;
+	LeaveCriticalSection(&g_sim_cs);
+
+	int blocked = hook && hook(&he);
+	if(!blocked) {
+		EnterCriticalSection(&g_sim_cs);
+		g_sim_keys[vk] = pressed ? 1 : 0;
+		LeaveCriticalSection(&g_sim_cs);
+	}
+	LeaveCriticalSection(&g_sim_hook_cs);
+	return blocked;
+}
+
+/*
+ * sim_deliver_mouse - Run a mouse event through the hook and apply it
+ *
+ * @type: EVENT_MOUSE_* type
+ * @vk: Button code for button events, 0 otherwise
+ * @pressed: 1 if pressed, 0 if released
+ * @x: Cursor position after the event
+ * @y: Cursor position after the event
+ * @data: Wheel delta for wheel events
+ * @injected: 1 if the event was injected by the library
+ *
+ * The hook only sees mouse events when it was installed with the mouse. 
+ * Events it passes on move the virtual cursor and update button state.
+ *
+ * Returns: 1 if the hook blocked the event, 0 otherwise
+ */
+static int sim_deliver_mouse(int type, BYTE vk, int pressed, int x, int y, int data, int injected) {
+	if(x < 0) x = 0;
+	if(y < 0) y = 0;
+	if(x >= SIM_SCREEN_W) x = SIM_SCREEN_W - 1;
+	if(y >= SIM_SCREEN_H) y = SIM_SCREEN_H - 1;
+
+	HookEvent he;
+	he.type = type;
+	he.vk = vk;
+	he.scan = 0;
+	he.pressed = pressed;
+	he.injected = injected;
+	he.self = injected;
+	he.x = x;
+	he.y = y;
+	he.data = data;
+
+	EnterCriticalSection(&g_sim_hook_cs);
+	he.time_ns = sim_now_ns();
+	he.time = he.time_ns / 1000000ULL;
+	EnterCriticalSection(&g_sim_cs);
+	HookProc hook = g_sim_hook_mouse ? g_sim_hook : NULL;
+	LeaveCriticalSection(&g_sim_cs);
+
+	int blocked = hook && hook(&he);
+	if(!blocked) {
+		EnterCriticalSection(&g_sim_cs);
+		g_sim_cursor_x = x;
+		g_sim_cursor_y = y;
+		if(type == EVENT_MOUSE_BUTTON) g_sim_keys[vk] = pressed ? 1 : 0;
+		LeaveCriticalSection(&g_sim_cs);
+	}
+	LeaveCriticalSection(&g_sim_hook_cs);
+	return blocked;
+}
+
+static void sim_key_event(BYTE vk, DWORD flags) {
+	EnterCriticalSection(&g_sim_cs);
+	g_sim_key_count++;
+	LeaveCriticalSection(&g_sim_cs);
+	sim_deliver(vk, 0, (flags & KEYEVENTF_KEYUP) ? 0 : 1, 1);
+}
+
+/*
+ * sim_mouse_event - Inject a mouse_event style event
+ *
+ * Each flag becomes its own hook event, moves first, as Windows splits 
+ * them. Moves are relative to the virtual cursor.
+ */
+static void sim_mouse_event(DWORD flags, int dx, int dy, int data) {
+	EnterCriticalSection(&g_sim_cs);
+	g_sim_mouse_count++;
+	int x = g_sim_cursor_x;
+	int y = g_sim_cursor_y;
+	LeaveCriticalSection(&g_sim_cs);
+
+	if(flags & MOUSEEVENTF_MOVE) {
+		x += dx;
+		y += dy;
+		sim_deliver_mouse(EVENT_MOUSE_MOVE, 0, 0, x, y, 0, 1);
+		EnterCriticalSection(&g_sim_cs);
+		x = g_sim_cursor_x;
+		y = g_sim_cursor_y;
+		LeaveCriticalSection(&g_sim_cs);
+	}
+	if(flags & MOUSEEVENTF_LEFTDOWN) sim_deliver_mouse(EVENT_MOUSE_BUTTON, VK_LBUTTON, 1, x, y, 0, 1);
+	if(flags & MOUSEEVENTF_LEFTUP) sim_deliver_mouse(EVENT_MOUSE_BUTTON, VK_LBUTTON, 0, x, y, 0, 1);
+	if(flags & MOUSEEVENTF_RIGHTDOWN) sim_deliver_mouse(EVENT_MOUSE_BUTTON, VK_RBUTTON, 1, x, y, 0, 1);
+	if(flags & MOUSEEVENTF_RIGHTUP) sim_deliver_mouse(EVENT_MOUSE_BUTTON, VK_RBUTTON, 0, x, y, 0, 1);
+	if(flags & MOUSEEVENTF_MIDDLEDOWN) sim_deliver_mouse(EVENT_MOUSE_BUTTON, VK_MBUTTON, 1, x, y, 0, 1);
+	if(flags & MOUSEEVENTF_MIDDLEUP) sim_deliver_mouse(EVENT_MOUSE_BUTTON, VK_MBUTTON, 0, x, y, 0, 1);
+	if(flags & (MOUSEEVENTF_XDOWN | MOUSEEVENTF_XUP)) {
+		BYTE vk = data == XBUTTON2 ? VK_XBUTTON2 : VK_XBUTTON1;
+		sim_deliver_mouse(EVENT_MOUSE_BUTTON, vk, (flags & MOUSEEVENTF_XDOWN) ? 1 : 0, x, y, 0, 1);
+	}
+	if(flags & MOUSEEVENTF_WHEEL) sim_deliver_mouse(EVENT_MOUSE_WHEEL, 0, 0, x, y, data, 1);
+	if(flags & MOUSEEVENTF_HWHEEL) sim_deliver_mouse(EVENT_MOUSE_HWHEEL, 0, 0, x, y, data, 1);
+}
+
+/*
+ * sim_send_keys - Deliver a batch of key events
+ *
+ * Events are delivered in order, each through the hook. Unicode events
+ * arrive as VK_PACKET with the code unit in the scan code, as on Windows.
+ */
+static int sim_send_keys(const KeyInput* in, int count) {
+	if(count <= 0) return 0;
+	EnterCriticalSection(&g_sim_cs);
+	g_sim_key_count += (unsigned long long)count;
+	LeaveCriticalSection(&g_sim_cs);
+	for(int i = 0; i < count; ++i) {
+		int pressed = (in[i].flags & KEYEVENTF_KEYUP) ? 0 : 1;
+		if(in[i].flags & KEYEVENTF_UNICODE) sim_deliver(VK_PACKET, in[i].scan, pressed, 1);
+		else sim_deliver((BYTE)in[i].vk, in[i].scan, pressed, 1);
+	}
+	return count;
+}
+
+/*
+ * sim_key_state - Read the virtual key state table
+ *
+ * Generic modifiers are down while either side is, as GetAsyncKeyState
+ * reports them.
+ */
+static int sim_key_state(int vk) {
+	EnterCriticalSection(&g_sim_cs);
+	int down;
+	switch(vk & 0xFF) {
+		case VK_SHIFT: down = g_sim_keys[VK_LSHIFT] | g_sim_keys[VK_RSHIFT]; break;
+		case VK_CONTROL: down = g_sim_keys[VK_LCONTROL] | g_sim_keys[VK_RCONTROL]; break;
+		case VK_MENU: down = g_sim_keys[VK_LMENU] | g_sim_keys[VK_RMENU]; break;
+		default: down = g_sim_keys[vk & 0xFF]; break;
+	}
+	LeaveCriticalSection(&g_sim_cs);
+	return down;
+}
+
+static int sim_cursor_get(int* x, int* y) {
+	EnterCriticalSection(&g_sim_cs);
+	*x = g_sim_cursor_x;
+	*y = g_sim_cursor_y;
+	LeaveCriticalSection(&g_sim_cs);
+	return 0;
+}
+
+/*
+ * sim_cursor_set - Move the virtual cursor
+ *
+ * Clamps to the simulated primary screen, like SetCursorPos does.
+ */
+static int sim_cursor_set(int x, int y) {
+	if(x < 0) x = 0;
+	if(y < 0) y = 0;
+	if(x >= SIM_SCREEN_W) x = SIM_SCREEN_W - 1;
+	if(y >= SIM_SCREEN_H) y = SIM_SCREEN_H - 1;
+	EnterCriticalSection(&g_sim_cs);
+	g_sim_cursor_x = x;
+	g_sim_cursor_y = y;
+	LeaveCriticalSection(&g_sim_cs);
+	return 0;
+}
+
+static uintptr_t sim_layout_current(void) {
+	EnterCriticalSection(&g_sim_cs);
+	int layout = g_sim_layout;
+	LeaveCriticalSection(&g_sim_cs);
+	return layout == SIM_LAYOUT_DE ? SIM_LAYOUT_ID_DE : SIM_LAYOUT_ID_US;
+}
+
+/*
+ * sim_char_de - Translate a character on the simulated German layout
+ *
+ * @ch: UTF-16 code unit
+ *
+ * Covers letters and digits, the umlauts and ß, and a few shifted and 
+ * AltGr (Ctrl+Alt) characters. Y and Z keep their virtual keys, as the 
+ * QWERTZ swap happens at the scan code. Anything else is not on the 
+ * layout.
+ *
+ * Returns: VkKeyScanEx style result, or -1 if unmapped
+ */
+static SHORT sim_char_de(WORD ch) {
+	static const struct { WORD ch; SHORT scan; } de[] = {
+		{ 0x00FC, 0x0BA }, { 0x00DC, 0x1BA },    /* ü Ü on VK_OEM_1 */
+		{ 0x00F6, 0x0C0 }, { 0x00D6, 0x1C0 },    /* ö Ö on VK_OEM_3 */
+		{ 0x00E4, 0x0DE }, { 0x00C4, 0x1DE },    /* ä Ä on VK_OEM_7 */
+		{ 0x00DF, 0x0DB }, { '?', 0x1DB },       /* ß ? on VK_OEM_4 */
+		{ '!', 0x131 }, { '"', 0x132 }, { '/', 0x137 },
+		{ '+', 0x0BB }, { '*', 0x1BB },          /* On VK_OEM_PLUS */
+		{ '#', 0x0BF }, { '\'', 0x1BF },         /* On VK_OEM_2 */
+		{ '@', 0x651 }, { 0x20AC, 0x645 },       /* AltGr+Q, AltGr+E */
+		{ '{', 0x637 }, { '}', 0x630 }           /* AltGr+7, AltGr+0 */
+	};
+	for(size_t i = 0; i < sizeof(de) / sizeof(de[0]); ++i) {
+		if(de[i].ch == ch) return de[i].scan;
+	}
+	if(ch == ' ' || ch == '\t' || (ch >= '0' && ch <= '9') || 
+	   (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z')) return keymap_char_us(ch);
+	return -1;
+}
+
+static SHORT sim_char_scan(WORD ch, uintptr_t layout) {
+	return layout == SIM_LAYOUT_ID_DE ? sim_char_de(ch) : keymap_char_us(ch);
+}
+
+static unsigned long long sim_tick_ms(void) {
+	return sim_now_ns() / 1000000ULL;
+}
+
+/*
+ * sim_sleep_until_ns - Wait for a simulated deadline
+ *
+ * In virtual mode sleeping jumps the clock to the deadline instead of
+ * blocking. In realtime mode it really sleeps, using clock_nanosleep on
+ * POSIX systems.
+ */
+static void sim_sleep_until_ns(unsigned long long deadline) {
+	EnterCriticalSection(&g_sim_cs);
+	if(g_sim_realtime) {
+		unsigned long long real = deadline + g_sim_base_ns;
+		LeaveCriticalSection(&g_sim_cs);
+		timing_sleep_until_ns(real);
+		return;
+	}
+	if(deadline > g_sim_now_ns) g_sim_now_ns = deadline;
+	LeaveCriticalSection(&g_sim_cs);
+}
+
+/*
+ * sim_window_enum - Enumerate simulated windows
+ *
+ * The foreground window comes first, the rest follow in creation order.
+ */
+static int sim_window_enum(WindowEnumProc proc, void* ctx) {
+	HWND order[SIM_WINDOW_CAPACITY];
+	int n = 0;
+
+	EnterCriticalSection(&g_sim_cs);
+	if(g_sim_foreground >= 0) order[n++] = SIM_HWND(g_sim_foreground);
+	for(int i = 0; i < SIM_WINDOW_CAPACITY; ++i) {
+		if(g_sim_windows[i].used && i != g_sim_foreground) order[n++] = SIM_HWND(i);
+	}
+	LeaveCriticalSection(&g_sim_cs);
+
+	for(int i = 0; i < n; ++i) {
+		if(!proc(order[i], ctx)) return 1;
+	}
+	return 0;
+}
+
+static HWND sim_window_foreground(void) {
+	EnterCriticalSection(&g_sim_cs);
+	HWND hwnd = g_sim_foreground >= 0 ? SIM_HWND(g_sim_foreground) : NULL;
+	LeaveCriticalSection(&g_sim_cs);
+	return hwnd;
+}
+
+static int sim_window_title(HWND hwnd, char* out, size_t len) {
+	if(!out || len == 0) return 0;
+	EnterCriticalSection(&g_sim_cs);
+	int i = sim_slot(hwnd);
+	if(i < 0) {
+		LeaveCriticalSection(&g_sim_cs);
+		out[0] = '\0';
+		return 0;
+	}
+	int n = snprintf(out, len, "%s", g_sim_windows[i].title);
+	LeaveCriticalSection(&g_sim_cs);
+	if(n < 0) return 0;
+	return (size_t)n >= len ? (int)len - 1 : n;
+}
+
+static int sim_window_activate(HWND hwnd) {
+	EnterCriticalSection(&g_sim_cs);
+	int i = sim_slot(hwnd);
+	int changed = i >= 0 && g_sim_foreground != i;
+	if(i >= 0) g_sim_foreground = i;
+	LeaveCriticalSection(&g_sim_cs);
+	if(changed) sim_focus_changed(hwnd);
+	return i < 0 ? 1 : 0;
+}
+
+static int sim_window_rect(HWND hwnd, int* x, int* y, int* w, int* h) {
+	EnterCriticalSection(&g_sim_cs);
+	int i = sim_slot(hwnd);
+	if(i >= 0) {
+		*x = g_sim_windows[i].x;
+		*y = g_sim_windows[i].y;
+		*w = g_sim_windows[i].w;
+		*h = g_sim_windows[i].h;
+	}
+	LeaveCriticalSection(&g_sim_cs);
+	return i < 0 ? 1 : 0;
+}
+
+static int sim_window_move(HWND hwnd, int x, int y, int w, int h) {
+	EnterCriticalSection(&g_sim_cs);
+	int i = sim_slot(hwnd);
+	if(i >= 0) {
+		g_sim_windows[i].x = x;
+		g_sim_windows[i].y = y;
+		g_sim_windows[i].w = w;
+		g_sim_windows[i].h = h;
+	}
+	LeaveCriticalSection(&g_sim_cs);
+	return i < 0 ? 1 : 0;
+}
+
+static int sim_window_show(HWND hwnd, int cmd) {
+	EnterCriticalSection(&g_sim_cs);
+	int i = sim_slot(hwnd);
+	if(i >= 0) g_sim_windows[i].show = cmd;
+	LeaveCriticalSection(&g_sim_cs);
+	return i < 0 ? 1 : 0;
+}
+
+/* Simulated windows always accept WM_CLOSE */
+static int sim_window_close(HWND hwnd) {
+	EnterCriticalSection(&g_sim_cs);
+	int i = sim_slot(hwnd);
+	int changed = i >= 0 && g_sim_foreground == i;
+	if(i >= 0) {
+		g_sim_windows[i].used = 0;
+		if(changed) g_sim_foreground = -1;
+	}
+	LeaveCriticalSection(&g_sim_cs);
+	if(changed) sim_focus_changed(NULL);
+	return i < 0 ? 1 : 0;
+}
+
+/*
+ * sim_window_fill - Fill window information, with the process fields if proc
+ */
+static int sim_window_fill(HWND hwnd, window_info_t* out, int proc) {
+	EnterCriticalSection(&g_sim_cs);
+	int i = sim_slot(hwnd);
+	if(i < 0) {
+		LeaveCriticalSection(&g_sim_cs);
+		return 1;
+	}
+	SimWindow* w = &g_sim_windows[i];
+	out->pid = w->pid;
+	out->tid = w->pid + 1;
+	snprintf(out->title, sizeof(out->title), "%s", w->title);
+	snprintf(out->classname, sizeof(out->classname), "%s", w->classname);
+	if(proc) {
+		snprintf(out->procname, sizeof(out->procname), "%s", w->procname);
+		snprintf(out->procpath, sizeof(out->procpath), "C:\\sim\\%s", w->procname);
+	}
+	LeaveCriticalSection(&g_sim_cs);
+	return 0;
+}
+
+static int sim_window_query(HWND hwnd, window_info_t* out) {
+	return sim_window_fill(hwnd, out, 1);
+}
+
+static int sim_window_ident(HWND hwnd, window_info_t* out) {
+	return sim_window_fill(hwnd, out, 0);
+}
+
+static int sim_hook_start(HookProc proc, int mouse) {
+	EnterCriticalSection(&g_sim_hook_cs);
+	EnterCriticalSection(&g_sim_cs);
+	g_sim_hook = proc;
+	g_sim_hook_mouse = mouse;
+	LeaveCriticalSection(&g_sim_cs);
+	LeaveCriticalSection(&g_sim_hook_cs);
+	return 0;
+}
+
+/*
+ * sim_hook_stop - Remove the hook
+ *
+ * Waits for a delivery in progress on another thread, like unhooking 
+ * waits for the Windows hook thread to exit.
+ */
+static void sim_hook_stop(void) {
+	EnterCriticalSection(&g_sim_hook_cs);
+	EnterCriticalSection(&g_sim_cs);
+	g_sim_hook = NULL;
+	g_sim_hook_mouse = 0;
+	LeaveCriticalSection(&g_sim_cs);
+	LeaveCriticalSection(&g_sim_hook_cs);
+}
+
+static void sim_focus_watch(FocusProc proc) {
+	EnterCriticalSection(&g_sim_hook_cs);
+	EnterCriticalSection(&g_sim_cs);
+	g_sim_focus = proc;
+	LeaveCriticalSection(&g_sim_cs);
+	LeaveCriticalSection(&g_sim_hook_cs);
+}
+
+const InputBackend backend_sim = {
+	.name = "sim",
+	.init = sim_init,
+	.key_event = sim_key_event,
+	.mouse_event = sim_mouse_event,
+	.send_keys = sim_send_keys,
+	.key_state = sim_key_state,
+	.cursor_get = sim_cursor_get,
+	.cursor_set = sim_cursor_set,
+	.layout_current = sim_layout_current,
+	.char_scan = sim_char_scan,
+	.tick_ms = sim_tick_ms,
+	.now_ns = sim_now_ns,
+	.sleep_until_ns = sim_sleep_until_ns,
+	.window_enum = sim_window_enum,
+	.window_foreground = sim_window_foreground,
+	.window_title = sim_window_title,
+	.window_activate = sim_window_activate,
+	.window_rect = sim_window_rect,
+	.window_move = sim_window_move,
+	.window_show = sim_window_show,
+	.window_close = sim_window_close,
+	.window_query = sim_window_query,
+	.window_ident = sim_window_ident,
+	.focus_watch = sim_focus_watch,
+	.hook_start = sim_hook_start,
+	.hook_stop = sim_hook_stop
+};
+
+
+/*
+ * sim_reset - Reset the simulated desktop
+ *
+ * Rewinds the virtual clock to zero, releases every key, places the cursor
+ * at the origin, closes all simulated windows and zeroes the injection
+ * counters. An installed hook stays installed.
+ *
+ * Returns: 0 (always succeeds)
+ */
+int INPUTLIB_CALL sim_reset(void) {
+	sim_init();
+	EnterCriticalSection(&g_sim_cs);
+	g_sim_now_ns = 0;
+	g_sim_base_ns = timing_now_ns();
+	g_sim_layout = SIM_LAYOUT_US;
+	memset(g_sim_keys, 0, sizeof(g_sim_keys));
+	g_sim_cursor_x = 0;
+	g_sim_cursor_y = 0;
+	memset(g_sim_windows, 0, sizeof(g_sim_windows));
+	int changed = g_sim_foreground >= 0;
+	g_sim_foreground = -1;
+	g_sim_key_count = 0;
+	g_sim_mouse_count = 0;
+	LeaveCriticalSection(&g_sim_cs);
+	if(changed) sim_focus_changed(NULL);
+	/* The listener's timing state belongs to the hook */
+	EnterCriticalSection(&g_sim_hook_cs);
+	listener_rebase();
+	LeaveCriticalSection(&g_sim_hook_cs);
+	return 0;
+}
+
+/*
+ * sim_keyevent - Simulate a physical key event
+ *
+ * @vk: Virtual key code
+ * @pressed: 1 for key down, 0 for key up
+ *
+ * Feeds a non-injected key event through the simulated hook, exactly as a
+ * keystroke from a physical keyboard would arrive.
+ *
+ * Returns: 1 if the event was blocked, 0 if it passed, -1 on invalid vk
+ */
+int INPUTLIB_CALL sim_keyevent(int vk, int pressed) {
+	if(vk <= 0 || vk > 0xFF) { SetLastError(ERROR_INVALID_PARAMETER); return -1; }
+	sim_init();
+	return sim_deliver((BYTE)vk, 0, pressed ? 1 : 0, 0);
+}
+
+/*
+ * sim_mousemove - Simulate a physical mouse move
+ *
+ * @x: Absolute x coordinate
+ * @y: Absolute y coordinate
+ *
+ * Feeds a non-injected move through the simulated mouse hook. The 
+ * position is clamped to the simulated screen.
+ *
+ * Returns: 1 if the event was blocked, 0 if it passed
+ */
+int INPUTLIB_CALL sim_mousemove(int x, int y) {
+	sim_init();
+	return sim_deliver_mouse(EVENT_MOUSE_MOVE, 0, 0, x, y, 0, 0);
+}
+
+/*
+ * sim_mousebutton - Simulate a physical mouse button event
+ *
+ * @vk: VK_LBUTTON, VK_RBUTTON, VK_MBUTTON, VK_XBUTTON1 or VK_XBUTTON2
+ * @pressed: 1 for button down, 0 for button up
+ *
+ * Returns: 1 if the event was blocked, 0 if it passed, -1 on invalid vk
+ */
+int INPUTLIB_CALL sim_mousebutton(int vk, int pressed) {
+	if(vk < VK_LBUTTON || vk > VK_XBUTTON2 || vk == 0x03) { SetLastError(ERROR_INVALID_PARAMETER); return -1; }
+	sim_init();
+	int x, y;
+	sim_cursor_get(&x, &y);
+	return sim_deliver_mouse(EVENT_MOUSE_BUTTON, (BYTE)vk, pressed ? 1 : 0, x, y, 0, 0);
+}
+
+/*
+ * sim_mousewheel - Simulate a physical mouse wheel turn
+ *
+ * @delta: Wheel delta, WHEEL_DELTA (120) per notch
+ * @hwheel: 1 for the horizontal wheel, 0 for the vertical one
+ *
+ * Returns: 1 if the event was blocked, 0 if it passed
+ */
+int INPUTLIB_CALL sim_mousewheel(int delta, int hwheel) {
+	sim_init();
+	int x, y;
+	sim_cursor_get(&x, &y);
+	return sim_deliver_mouse(hwheel ? EVENT_MOUSE_HWHEEL : EVENT_MOUSE_WHEEL, 0, 0, x, y, delta, 0);
+}
+
+/*
+ * sim_clock - Get the virtual clock
+ *
+ * Returns: Simulated milliseconds since the last sim_reset
+ */
+unsigned long long INPUTLIB_CALL sim_clock(void) {
+	sim_init();
+	return sim_tick_ms();
+}
+
+/*
+ * sim_advance - Advance the virtual clock
+ *
+ * @ms: Number of milliseconds to advance
+ *
+ * Not available in realtime mode, where the clock follows real time.
+ * 
+ * Returns: 0 on success, 1 if ms is negative or realtime mode is enabled
+ */
+int INPUTLIB_CALL sim_advance(int ms) {
+	if(ms < 0) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+	sim_init();
+	EnterCriticalSection(&g_sim_cs);
+	if(g_sim_realtime) {
+		LeaveCriticalSection(&g_sim_cs);
+		SetLastError(ERROR_INVALID_OPERATION);
+		return 1;
+	}
+	g_sim_now_ns += (unsigned long long)ms * 1000000ULL;
+	LeaveCriticalSection(&g_sim_cs);
+	return 0;
+}
+
+/*
+ * sim_realtime - Select real or virtual simulated time
+ * 
+ * @enabled: 1 to follow the real monotonic clock, 0 for virtual time
+ * 
+ * Virtual time runs everything at full speed. Realtime mode makes sleeps 
+ * real, which is useful for measuring pacing jitter off a desktop. The 
+ * simulated clock continues from its current value when switching.
+ * 
+ * Returns: 0 (always succeeds)
+ */
+int INPUTLIB_CALL sim_realtime(int enabled) {
+	sim_init();
+	EnterCriticalSection(&g_sim_cs);
+	enabled = enabled ? 1 : 0;
+	if(enabled != g_sim_realtime) {
+		unsigned long long real = timing_now_ns();
+		if(enabled) g_sim_base_ns = real - g_sim_now_ns;  /* Continue from virtual time */
+		else g_sim_now_ns = real - g_sim_base_ns;        /* Freeze at current real offset */
+		g_sim_realtime = enabled;
+	}
+	LeaveCriticalSection(&g_sim_cs);
+	return 0;
+}
+
+/*
+ * sim_layout - Select the simulated keyboard layout
+ * 
+ * @layout: SIM_LAYOUT_US or SIM_LAYOUT_DE
+ * 
+ * The German layout is a QWERTZ subset with umlauts, ß and AltGr 
+ * characters, enough to drive layout-dependent typing off a desktop. 
+ * Typing picks the change up on its next call, as it would after a 
+ * foreground layout switch.
+ * 
+ * Returns: 0 on success, 1 on an unknown layout
+ */
+int INPUTLIB_CALL sim_layout(int layout) {
+	if(layout != SIM_LAYOUT_US && layout != SIM_LAYOUT_DE) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+	sim_init();
+	EnterCriticalSection(&g_sim_cs);
+	g_sim_layout = layout;
+	LeaveCriticalSection(&g_sim_cs);
+	return 0;
+}
+
+/*
+ * sim_addwindow - Add a window to the simulated window table
+ *
+ * @title: Window title
+ * @classname: Window class name (may be NULL)
+ * @procname: Owning process executable name (may be NULL)
+ * @x, @y, @w, @h: Window rectangle
+ *
+ * The new window becomes the foreground window.
+ *
+ * Returns: Window handle, or NULL if the table is full or title is NULL
+ */
+HWND INPUTLIB_CALL sim_addwindow(const char* title, const char* classname, const char* procname, int x, int y, int w, int h) {
+	if(!title) { SetLastError(ERROR_INVALID_PARAMETER); return NULL; }
+	sim_init();
+	EnterCriticalSection(&g_sim_cs);
+	for(int i = 0; i < SIM_WINDOW_CAPACITY; ++i) {
+		SimWindow* sw = &g_sim_windows[i];
+		if(sw->used) continue;
+		memset(sw, 0, sizeof(*sw));
+		sw->used = 1;
+		sw->x = x;
+		sw->y = y;
+		sw->w = w;
+		sw->h = h;
+		sw->pid = (DWORD)(1000 + i * 4);
+		snprintf(sw->title, sizeof(sw->title), "%s", title);
+		snprintf(sw->classname, sizeof(sw->classname), "%s", classname ? classname : "");
+		snprintf(sw->procname, sizeof(sw->procname), "%s", procname ? procname : "");
+		g_sim_foreground = i;
+		LeaveCriticalSection(&g_sim_cs);
+		sim_focus_changed(SIM_HWND(i));
+		return SIM_HWND(i);
+	}
+	LeaveCriticalSection(&g_sim_cs);
+	SetLastError(ERROR_OUTOFMEMORY);
+	return NULL;
+}
+
+/*
+ * sim_counts - Get injection counters
+ *
+ * @keys: Receives the number of injected key events (may be NULL)
+ * @mouse: Receives the number of injected mouse events (may be NULL)
+ *
+ * Returns: 0 (always succeeds)
+ */
+int INPUTLIB_CALL sim_counts(unsigned long long* keys, unsigned long long* mouse) {
+	sim_init();
+	EnterCriticalSection(&g_sim_cs);
+	if(keys) *keys = g_sim_key_count;
+	if(mouse) *mouse = g_sim_mouse_count;
+	LeaveCriticalSection(&g_sim_cs);
+	return 0;
+}
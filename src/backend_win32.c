@@ -0,0 +1,535 @@
+/*
+ * backend_win32.c - Native Win32 platform backend
+ *
+ * Implements the InputBackend operations on top of the Windows API:
+ * keybd_event/mouse_event for injection, the cursor and window functions
+ * from user32, and WH_KEYBOARD_LL and WH_MOUSE_LL hooks sharing one thread.
+ * Foreground changes are watched with WinEvent hooks on the same thread.
+ */
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "Psapi.lib")
+#include <stdlib.h>
+#include <string.h>
+#include "backend.h"
+#include "timing.h"
+
+/* Batches up to this size are converted on the stack */
+#define WIN32_SEND_STACK 64
+
+static HHOOK g_hook = NULL;
+static HHOOK g_mouse_hook = NULL;
+static int g_want_mouse = 0;
+static HANDLE g_thread = NULL;
+static DWORD g_thread_id = 0;
+static HANDLE g_init_event = NULL;
+static HookProc g_hook_proc = NULL;
+static ULONG_PTR g_tag = 0;   /* Extra info stamped on every injected event */
+static FocusProc g_focus_proc = NULL;
+static HWINEVENTHOOK g_fg_hook = NULL;
+static HWINEVENTHOOK g_name_hook = NULL;   /* Title changes in the foreground process */
+static DWORD g_name_pid = 0;
+
+/*
+ * win32_init - Set up DPI awareness and the injection tag
+ *
+ * Set DPI awareness to per-monitor V2 mode. This ensures cursor coordinates
+ * and window rectangles are correct on systems with multiple monitors at
+ * different DPI settings.
+ *
+ * The tag mixes a fixed signature with the process id, so the hooks can
+ * tell this process's injections from other automation tools, including
+ * other processes using the library.
+ */
+static void win32_init(void) {
+	SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
+	g_tag = (ULONG_PTR)(0x494E5054UL ^ (GetCurrentProcessId() * 0x9E3779B1UL));
+}
+
+static void win32_key_event(BYTE vk, DWORD flags) {
+	keybd_event(vk, 0, flags, g_tag);
+}
+
+static void win32_mouse_event(DWORD flags, int dx, int dy, int data) {
+	mouse_event(flags, (DWORD)dx, (DWORD)dy, (DWORD)data, g_tag);
+}
+
+/*
+ * win32_send_keys - Inject a batch of key events
+ *
+ * Converts the batch into one contiguous INPUT array and submits it with a
+ * single SendInput call, so the events are inserted into the input stream
+ * without interleaving.
+ *
+ * Returns: Number of events injected
+ */
+static int win32_send_keys(const KeyInput* in, int count) {
+	if(count <= 0) return 0;
+	INPUT stack_inputs[WIN32_SEND_STACK];
+	INPUT* inputs = stack_inputs;
+	if(count > WIN32_SEND_STACK) {
+		inputs = (INPUT*)malloc((size_t)count * sizeof(INPUT));
+		if(!inputs) { SetLastError(ERROR_OUTOFMEMORY); return 0; }
+	}
+	memset(inputs, 0, (size_t)count * sizeof(INPUT));
+	for(int i = 0; i < count; ++i) {
+		inputs[i].type = INPUT_KEYBOARD;
+		inputs[i].ki.wVk = in[i].vk;
+		inputs[i].ki.wScan = in[i].scan;
+		inputs[i].ki.dwFlags = in[i].flags;
+		inputs[i].ki.dwExtraInfo = g_tag;
+	}
+	UINT sent = SendInput((UINT)count, inputs, sizeof(INPUT));
+	if(inputs != stack_inputs) free(inputs);
+	return (int)sent;
+}
+
+/*
+ * win32_key_state - Query asynchronous key state
+ *
+ * Uses GetAsyncKeyState to check the high-order bit which indicates if the
+ * key is currently pressed.
+ */
+static int win32_key_state(int vk) {
+	SHORT state = GetAsyncKeyState(vk);
+	return (state & 0x8000) ? 1 : 0;
+}
+
+static int win32_cursor_get(int* x, int* y) {
+	POINT p;
+	if(!GetCursorPos(&p)) return 1;
+	*x = p.x;
+	*y = p.y;
+	return 0;
+}
+
+static int win32_cursor_set(int x, int y) {
+	return SetCursorPos(x, y) ? 0 : 1;
+}
+
+/*
+ * win32_layout_current - Get the foreground keyboard layout
+ *
+ * The layout belongs to the thread that owns the foreground window, which is
+ * the one that will receive injected input.
+ */
+static uintptr_t win32_layout_current(void) {
+	HWND fg = GetForegroundWindow();
+	DWORD tid = fg ? GetWindowThreadProcessId(fg, NULL) : 0;
+	return (uintptr_t)GetKeyboardLayout(tid);
+}
+
+static SHORT win32_char_scan(WORD ch, uintptr_t layout) {
+	return VkKeyScanExW((WCHAR)ch, (HKL)layout);
+}
+
+static unsigned long long win32_tick_ms(void) {
+	return GetTickCount64();
+}
+
+/* Precise waits use the QPC-based timing engine */
+static unsigned long long win32_now_ns(void) {
+	return timing_now_ns();
+}
+
+static void win32_sleep_until_ns(unsigned long long deadline) {
+	timing_sleep_until_ns(deadline);
+}
+
+/*
+ * win32_window_enum - Enumerate visible top-level windows
+ *
+ * Walks the top-level windows in Z-order starting from GetTopWindow, skipping
+ * invisible ones, until the callback asks to stop.
+ */
+static int win32_window_enum(WindowEnumProc proc, void* ctx) {
+	HWND hwnd = GetTopWindow(NULL);
+	while(hwnd) {
+		if(IsWindowVisible(hwnd)) {
+			if(!proc(hwnd, ctx)) return 1;
+		}
+		hwnd = GetNextWindow(hwnd, GW_HWNDNEXT);
+	}
+	return 0;
+}
+
+static HWND win32_window_foreground(void) {
+	return GetForegroundWindow();
+}
+
+static int win32_window_title(HWND hwnd, char* out, size_t len) {
+	return GetWindowTextA(hwnd, out, (int)len);
+}
+
+static int win32_window_activate(HWND hwnd) {
+	return SetForegroundWindow(hwnd) ? 0 : 1;
+}
+
+static int win32_window_rect(HWND hwnd, int* x, int* y, int* w, int* h) {
+	RECT r;
+	if(!GetWindowRect(hwnd, &r)) return 1;
+	*x = r.left;
+	*y = r.top;
+	*w = r.right - r.left;
+	*h = r.bottom - r.top;
+	return 0;
+}
+
+static int win32_window_move(HWND hwnd, int x, int y, int w, int h) {
+	return MoveWindow(hwnd, x, y, w, h, TRUE) ? 0 : 1;
+}
+
+static int win32_window_show(HWND hwnd, int cmd) {
+	return ShowWindow(hwnd, cmd) ? 0 : 1;
+}
+
+static int win32_window_close(HWND hwnd) {
+	return PostMessageA(hwnd, WM_CLOSE, 0, 0) ? 0 : 1;  /* Request close */
+}
+
+/*
+ * win32_window_ident - Fill window information without the owning process
+ *
+ * Cheap enough for the hook thread, the process is never opened.
+ */
+static int win32_window_ident(HWND hwnd, window_info_t* out) {
+	if(!hwnd || !IsWindow(hwnd)) return 1;
+
+	/* Get process and thread IDs */
+	DWORD pid = 0;
+	DWORD tid = GetWindowThreadProcessId(hwnd, &pid);
+	out->pid = pid;
+	out->tid = tid;
+
+	/* Get window title and class name */
+	if(!GetWindowTextA(hwnd, out->title, sizeof(out->title))) out->title[0] = '\0';
+	if(!GetClassNameA(hwnd, out->classname, sizeof(out->classname))) out->classname[0] = '\0';
+	return 0;
+}
+
+/*
+ * win32_window_query - Fill window and owning process information
+ *
+ * Requires PROCESS_QUERY_INFORMATION permission to resolve the executable;
+ * the process fields are left empty when the process cannot be opened.
+ */
+static int win32_window_query(HWND hwnd, window_info_t* out) {
+	if(win32_window_ident(hwnd, out)) return 1;
+
+	/* Open process to get executable information */
+	HANDLE hProc = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, out->pid);
+	if(hProc) {
+		/* Get full path to executable */
+		if(!GetModuleFileNameExA(hProc, NULL, out->procpath, sizeof(out->procpath))) out->procpath[0] = '\0';
+
+		/* Extract just the filename from the full path */
+		if(out->procpath[0]) {
+			const char* p = strrchr(out->procpath, '\\');  /* Find last backslash */
+			if(p) {
+				strncpy(out->procname, p + 1, sizeof(out->procname));  /* Copy filename */
+			} else {
+				strncpy(out->procname, out->procpath, sizeof(out->procname));  /* No path separator */
+			}
+		} else out->procname[0] = '\0';
+
+		CloseHandle(hProc);
+	} else {
+		/* Unable to open process - may lack permissions */
+		out->procpath[0] = '\0';
+		out->procname[0] = '\0';
+	}
+	return 0;
+}
+
+/*
+ * win32_lowlevel_proc - Low level keyboard hook proc
+ *
+ * @nCode: Hook code
+ * @wParam: Keyboard event identifier
+ * @lParam: Pointer to a KBDLLHOOKSTRUCT
+ *
+ * Registered with SetWindowsHookEx(WH_KEYBOARD_LL), and is invoked by the
+ * system on every keyboard event (press/release). Translates the event into
+ * a HookEvent and hands it to the registered hook procedure.
+ *
+ * Returns: 1 if event is blocked, passes input and calls CallNextHookEx otherwise
+ */
+static LRESULT CALLBACK win32_lowlevel_proc(int nCode, WPARAM wParam, LPARAM lParam) {
+	if(nCode < 0) return CallNextHookEx(g_hook, nCode, wParam, lParam); /* Negative hook code */
+
+	/* Retrieve KBDLLHOOKSTRUCT */
+	KBDLLHOOKSTRUCT* k = (KBDLLHOOKSTRUCT*)lParam;
+	if(!k) return CallNextHookEx(g_hook, nCode, wParam, lParam);
+
+	HookEvent he;
+	he.type = EVENT_KEY;
+	he.vk = (BYTE)k->vkCode;
+	he.scan = (int)k->scanCode;
+	he.pressed = (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN) ? 1 : 0;
+	he.injected = ((k->flags & LLKHF_INJECTED) != 0) ? 1 : 0;
+	he.self = he.injected && g_tag && k->dwExtraInfo == g_tag;
+	he.x = 0;
+	he.y = 0;
+	he.data = 0;
+	he.time = k->time;
+	he.time_ns = timing_now_ns();
+
+	if(g_hook_proc && g_hook_proc(&he)) return 1;
+	return CallNextHookEx(g_hook, nCode, wParam, lParam);
+}
+
+/*
+ * win32_mouse_proc - Low level mouse hook proc
+ *
+ * @nCode: Hook code
+ * @wParam: Mouse message identifier
+ * @lParam: Pointer to a MSLLHOOKSTRUCT
+ *
+ * Registered with SetWindowsHookEx(WH_MOUSE_LL) on the keyboard hook's 
+ * thread. Buttons are reported with their VK_*BUTTON codes, moves and 
+ * wheels with vk 0.
+ *
+ * Returns: 1 if event is blocked, passes input and calls CallNextHookEx otherwise
+ */
+static LRESULT CALLBACK win32_mouse_proc(int nCode, WPARAM wParam, LPARAM lParam) {
+	if(nCode < 0) return CallNextHookEx(g_mouse_hook, nCode, wParam, lParam);
+
+	MSLLHOOKSTRUCT* m = (MSLLHOOKSTRUCT*)lParam;
+	if(!m) return CallNextHookEx(g_mouse_hook, nCode, wParam, lParam);
+
+	HookEvent he;
+	he.type = EVENT_MOUSE_BUTTON;
+	he.vk = 0;
+	he.scan = 0;
+	he.pressed = 0;
+	he.data = 0;
+	switch(wParam) {
+		case WM_MOUSEMOVE: he.type = EVENT_MOUSE_MOVE; break;
+		case WM_LBUTTONDOWN: he.vk = VK_LBUTTON; he.pressed = 1; break;
+		case WM_LBUTTONUP: he.vk = VK_LBUTTON; break;
+		case WM_RBUTTONDOWN: he.vk = VK_RBUTTON; he.pressed = 1; break;
+		case WM_RBUTTONUP: he.vk = VK_RBUTTON; break;
+		case WM_MBUTTONDOWN: he.vk = VK_MBUTTON; he.pressed = 1; break;
+		case WM_MBUTTONUP: he.vk = VK_MBUTTON; break;
+		case WM_XBUTTONDOWN: case WM_XBUTTONUP:
+			he.vk = HIWORD(m->mouseData) == XBUTTON2 ? VK_XBUTTON2 : VK_XBUTTON1;
+			he.pressed = wParam == WM_XBUTTONDOWN ? 1 : 0;
+			break;
+		case WM_MOUSEWHEEL: he.type = EVENT_MOUSE_WHEEL; he.data = (SHORT)HIWORD(m->mouseData); break;
+		case WM_MOUSEHWHEEL: he.type = EVENT_MOUSE_HWHEEL; he.data = (SHORT)HIWORD(m->mouseData); break;
+		default: return CallNextHookEx(g_mouse_hook, nCode, wParam, lParam);
+	}
+	he.injected = ((m->flags & LLMHF_INJECTED) != 0) ? 1 : 0;
+	he.self = he.injected && g_tag && m->dwExtraInfo == g_tag;
+	he.x = m->pt.x;
+	he.y = m->pt.y;
+	he.time = m->time;
+	he.time_ns = timing_now_ns();
+
+	if(g_hook_proc && g_hook_proc(&he)) return 1;
+	return CallNextHookEx(g_mouse_hook, nCode, wParam, lParam);
+}
+
+static void CALLBACK win32_focus_proc(HWINEVENTHOOK hook, DWORD event, HWND hwnd, LONG obj, LONG child, DWORD thread, DWORD time);
+
+/*
+ * win32_focus_follow - Watch title changes in the foreground window's process
+ *
+ * @hwnd: New foreground window
+ *
+ * EVENT_OBJECT_NAMECHANGE fires for every control of every process, so it
+ * is only hooked for the process that owns the foreground window and is
+ * moved along as the foreground changes.
+ */
+static void win32_focus_follow(HWND hwnd) {
+	DWORD pid = 0;
+	if(hwnd) GetWindowThreadProcessId(hwnd, &pid);
+	if(pid == g_name_pid) return;
+	if(g_name_hook) UnhookWinEvent(g_name_hook);
+	g_name_hook = pid ? SetWinEventHook(EVENT_OBJECT_NAMECHANGE, EVENT_OBJECT_NAMECHANGE, NULL, win32_focus_proc, pid, 0, WINEVENT_OUTOFCONTEXT) : NULL;
+	g_name_pid = pid;
+}
+
+/*
+ * win32_focus_proc - WinEvent callback for foreground and title changes
+ *
+ * Out of context, so it runs from the hook thread's message loop. Only
+ * the foreground window itself is reported, not its controls.
+ */
+static void CALLBACK win32_focus_proc(HWINEVENTHOOK hook, DWORD event, HWND hwnd, LONG obj, LONG child, DWORD thread, DWORD time) {
+	(void)hook;
+	(void)thread;
+	(void)time;
+	if(!g_focus_proc || obj != OBJID_WINDOW || child != CHILDID_SELF) return;
+	if(event == EVENT_SYSTEM_FOREGROUND) win32_focus_follow(hwnd);
+	else if(hwnd != GetForegroundWindow()) return;
+	g_focus_proc(hwnd);
+}
+
+/*
+ * win32_hook_thread_proc - Install and run keyboard hook
+ *
+ * \@param: Unused
+ *
+ * Sets up low-level keyboard hook using SetWindowsHookExA with WH_KEYBOARD_LL,
+ * plus WH_MOUSE_LL if requested, and the WinEvent hooks of a focus watcher if
+ * one is set, then enters a Windows message loop to keep the hooks alive.
+ *
+ * Returns: 0 on normal termination, 1 if hook could not be installed
+ */
+static DWORD WINAPI win32_hook_thread_proc(LPVOID param) {
+	(void)param;
+	HINSTANCE hinst = GetModuleHandle(NULL);
+	g_hook = SetWindowsHookExA(WH_KEYBOARD_LL, win32_lowlevel_proc, hinst, 0);
+	if(g_hook && g_want_mouse) {
+		g_mouse_hook = SetWindowsHookExA(WH_MOUSE_LL, win32_mouse_proc, hinst, 0);
+		if(!g_mouse_hook) {
+			UnhookWindowsHookEx(g_hook);
+			g_hook = NULL;
+		}
+	}
+	if(!g_hook) {
+		SetLastError(ERROR_INVALID_FUNCTION);
+		if(g_init_event) SetEvent(g_init_event);
+		return 1;
+	}
+
+	if(g_focus_proc) {
+		g_fg_hook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, NULL, win32_focus_proc, 0, 0, WINEVENT_OUTOFCONTEXT);
+		win32_focus_follow(GetForegroundWindow());
+	}
+
+	if(g_init_event) SetEvent(g_init_event);
+
+	MSG msg;
+	while(GetMessageA(&msg, NULL, 0, 0) > 0) {
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+
+	if(g_name_hook) {
+		UnhookWinEvent(g_name_hook);
+		g_name_hook = NULL;
+		g_name_pid = 0;
+	}
+	if(g_fg_hook) {
+		UnhookWinEvent(g_fg_hook);
+		g_fg_hook = NULL;
+	}
+	if(g_mouse_hook) {
+		UnhookWindowsHookEx(g_mouse_hook);
+		g_mouse_hook = NULL;
+	}
+	if(g_hook) {
+		UnhookWindowsHookEx(g_hook);
+		g_hook = NULL;
+	}
+	return 0;
+}
+
+/*
+ * win32_hook_start - Start the hook thread
+ *
+ * Creates the hook thread and waits up to 3 seconds for the hook install.
+ * The mouse hook, when requested, is installed on the same thread.
+ *
+ * Returns: 0 if successful, 1 otherwise
+ */
+static int win32_hook_start(HookProc proc, int mouse) {
+	g_hook_proc = proc;
+	g_want_mouse = mouse;
+
+	/* Prepare init event for sync */
+	g_init_event = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if(!g_init_event) {
+		SetLastError(ERROR_OUTOFMEMORY);
+		return 1;
+	}
+
+	/* Create thread */
+	g_thread = CreateThread(NULL, 0, win32_hook_thread_proc, NULL, 0, &g_thread_id);
+	if(!g_thread) {
+		CloseHandle(g_init_event);
+		g_init_event = NULL;
+		SetLastError(ERROR_OUTOFMEMORY);
+		return 1;
+	}
+
+	/* Wait up to 3 seconds for hook install */
+	DWORD wait = WaitForSingleObject(g_init_event, 3000);
+	CloseHandle(g_init_event);
+	g_init_event = NULL;
+
+	if(wait != WAIT_OBJECT_0 || !g_hook) {
+		/* Thread didn't initalize properly in time */
+		PostThreadMessageA(g_thread_id, WM_QUIT, 0, 0);
+		WaitForSingleObject(g_thread, 2000);
+		CloseHandle(g_thread);
+		g_thread = NULL;
+		g_thread_id = 0;
+		SetLastError(ERROR_TIMEOUT);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * win32_hook_stop - Stop the hook thread
+ *
+ * Posts WM_QUIT to the hook thread and waits for it to unhook and exit.
+ */
+static void win32_hook_stop(void) {
+	if(g_thread) {
+		PostThreadMessageA(g_thread_id, WM_QUIT, 0, 0);
+		WaitForSingleObject(g_thread, 3000);
+		CloseHandle(g_thread);
+		g_thread = NULL;
+		g_thread_id = 0;
+	}
+	g_hook_proc = NULL;
+}
+
+/*
+ * win32_focus_watch - Set the foreground change callback
+ *
+ * Takes effect on the next hook_start, the WinEvent hooks live on the hook 
+ * thread. Clearing it stops reports at once.
+ */
+static void win32_focus_watch(FocusProc proc) {
+	g_focus_proc = proc;
+}
+
+const InputBackend backend_win32 = {
+	.name = "win32",
+	.init = win32_init,
+	.key_event = win32_key_event,
+	.mouse_event = win32_mouse_event,
+	.send_keys = win32_send_keys,
+	.key_state = win32_key_state,
+	.cursor_get = win32_cursor_get,
+	.cursor_set = win32_cursor_set,
+	.layout_current = win32_layout_current,
+	.char_scan = win32_char_scan,
+	.tick_ms = win32_tick_ms,
+	.now_ns = win32_now_ns,
+	.sleep_until_ns = win32_sleep_until_ns,
+	.window_enum = win32_window_enum,
+	.window_foreground = win32_window_foreground,
+	.window_title = win32_window_title,
+	.window_activate = win32_window_activate,
+	.window_rect = win32_window_rect,
+	.window_move = win32_window_move,
+	.window_show = win32_window_show,
+	.window_close = win32_window_close,
+	.window_query = win32_window_query,
+	.window_ident = win32_window_ident,
+	.focus_watch = win32_focus_watch,
+	.hook_start = win32_hook_start,
+	.hook_stop = win32_hook_stop
+};
+
+#endif /* _WIN32 */
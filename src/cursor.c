@@ -2,24 +2,27 @@
  * cursor.c - Mouse cursor control and click operations
  * 
  * Implements cursor movement and mouse button click functionality
- * using the Windows API mouse_event and cursor positioning functions.
+ * through the platform backend (mouse_event and the cursor positioning
+ * functions on Windows).
  */
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#include "inputlib.h"
+#include <stdlib.h>
+#include "backend.h"
+#include "timing.h"
+#include "async.h"
 
 /*
  * cursor_lclick - Perform a left mouse button click
  * 
  * Simulates pressing and releasing the left mouse button at the current
- * cursor position. Uses deprecated mouse_event API for compatibility.
+ * cursor position. Uses deprecated mouse_event API for compatibility on the
+ * native backend.
  * 
  * Returns: 0 on success
  */
 int INPUTLIB_CALL cursor_lclick(void) {
-	mouse_event(MOUSEEVENTF_LEFTDOWN, 0, 0, 0, 0);
-	mouse_event(MOUSEEVENTF_LEFTUP, 0, 0, 0, 0);
+	g_backend->mouse_event(MOUSEEVENTF_LEFTDOWN, 0, 0, 0);
+	g_backend->mouse_event(MOUSEEVENTF_LEFTUP, 0, 0, 0);
 	return 0;
 }
 
@@ -32,8 +35,8 @@ int INPUTLIB_CALL cursor_lclick(void) {
  * Returns: 0 on success
  */
 int INPUTLIB_CALL cursor_rclick(void) {
-	mouse_event(MOUSEEVENTF_RIGHTDOWN, 0, 0, 0, 0);
-	mouse_event(MOUSEEVENTF_RIGHTUP, 0, 0, 0, 0);
+	g_backend->mouse_event(MOUSEEVENTF_RIGHTDOWN, 0, 0, 0);
+	g_backend->mouse_event(MOUSEEVENTF_RIGHTUP, 0, 0, 0);
 	return 0;
 }
 
@@ -46,8 +49,8 @@ int INPUTLIB_CALL cursor_rclick(void) {
  * Returns: 0 on success
  */
 int INPUTLIB_CALL cursor_mclick(void) {
-	mouse_event(MOUSEEVENTF_MIDDLEDOWN, 0, 0, 0, 0);
-	mouse_event(MOUSEEVENTF_MIDDLEUP, 0, 0, 0, 0);
+	g_backend->mouse_event(MOUSEEVENTF_MIDDLEDOWN, 0, 0, 0);
+	g_backend->mouse_event(MOUSEEVENTF_MIDDLEUP, 0, 0, 0);
 	return 0;
 }
 
@@ -63,7 +66,7 @@ int INPUTLIB_CALL cursor_mclick(void) {
  * Returns: 0 on success, 1 on failure
  */
 int INPUTLIB_CALL cursor_moveto(int x, int y) {
-	if(!SetCursorPos(x, y)) return 1;
+	if(g_backend->cursor_set(x, y)) return 1;
 	return 0;
 }
 
@@ -78,52 +81,101 @@ int INPUTLIB_CALL cursor_moveto(int x, int y) {
  * Returns: 0 on success
  */
 int INPUTLIB_CALL cursor_scroll(int amount) {
-	mouse_event(MOUSEEVENTF_WHEEL, 0, 0, amount * WHEEL_DELTA, 0);
+	g_backend->mouse_event(MOUSEEVENTF_WHEEL, 0, 0, amount * WHEEL_DELTA);
 	return 0;
 }
 
 /*
- * cursor_movetos - Move cursor smoothly to absolute coordinates
+ * movetos_run - Move the cursor smoothly, optionally cancellable
  * 
  * @x: Target X coordinate in screen pixels
  * @y: Target Y coordinate in screen pixels
  * @duration_ms: Time in milliseconds to complete the movement
+ * @cancel: Cancellation flag checked between steps, or NULL
  * 
- * Moves the cursor from its current position to the target position in a smooth,
- * linear motion over the specified duration. The movement is broken into steps
- * with approximately 10ms intervals between updates.
+ * The start position is read when the movement begins.
  * 
- * Returns: 0 on success, 1 if unable to get current cursor position
+ * Returns: ASYNC_RUN_DONE, ASYNC_RUN_FAILED or ASYNC_RUN_CANCELLED
  */
-int INPUTLIB_CALL cursor_movetos(int x, int y, int duration_ms) {
-	POINT p;
-	if(!GetCursorPos(&p)) return 1;  /* Get current cursor position */
-	
-	int sx = p.x;  /* Starting X coordinate */
-	int sy = p.y;  /* Starting Y coordinate */
+static int movetos_run(int x, int y, int duration_ms, const int* cancel) {
+	int sx, sy;  /* Starting coordinates */
+	if(g_backend->cursor_get(&sx, &sy)) return ASYNC_RUN_FAILED;  /* Get current cursor position */
 	
 	/* Already at target position, no movement needed */
-	if(sx == x && sy == y) return 0;
+	if(sx == x && sy == y) return ASYNC_RUN_DONE;
 	
 	/* Calculate number of steps (aim for ~10ms per step) */
 	int steps = duration_ms / 10;
 	if(steps <= 0) steps = 1;
 	
-	int delay = duration_ms / steps;  /* Actual delay per step */
+	/* Per-step delay in microseconds, so the steps add up to the duration */
+	long long delay = (long long)duration_ms * 1000 / steps;
 	
 	/* Calculate total distance to travel */
 	double dx = (double)(x - sx);
 	double dy = (double)(y - sy);
 	
 	/* Perform linear interpolation for smooth movement */
+	Pacer p;
+	pacer_start(&p);
 	for(int i = 1; i <= steps; i++) {
 		double t = (double)i / (double)steps;  /* Progress ratio (0.0 to 1.0) */
 		int nx = (int)(sx + dx * t);  /* Interpolated X position */
 		int ny = (int)(sy + dy * t);  /* Interpolated Y position */
-		SetCursorPos(nx, ny);
-		if(delay > 0) input_sleep(delay);
+		g_backend->cursor_set(nx, ny);
+		if(pacer_waitc(&p, delay, cancel)) return ASYNC_RUN_CANCELLED;
 	}
-	return 0;
+	return ASYNC_RUN_DONE;
+}
+
+/*
+ * cursor_movetos - Move cursor smoothly to absolute coordinates
+ * 
+ * @x: Target X coordinate in screen pixels
+ * @y: Target Y coordinate in screen pixels
+ * @duration_ms: Time in milliseconds to complete the movement
+ * 
+ * Moves the cursor from its current position to the target position in a smooth,
+ * linear motion over the specified duration. The movement is broken into steps
+ * with approximately 10ms intervals between updates.
+ * 
+ * Returns: 0 on success, 1 if unable to get current cursor position
+ */
+int INPUTLIB_CALL cursor_movetos(int x, int y, int duration_ms) {
+	return movetos_run(x, y, duration_ms, NULL) == ASYNC_RUN_DONE ? 0 : 1;
+}
+
+/* Arguments of a cursor_movetos_async job */
+typedef struct MoveJob {
+	int x, y;
+	int duration_ms;
+} MoveJob;
+
+static int move_job_run(void* arg, const int* cancel) {
+	MoveJob* job = (MoveJob*)arg;
+	return movetos_run(job->x, job->y, job->duration_ms, cancel);
+}
+
+/*
+ * cursor_movetos_async - Move cursor smoothly on the injector thread
+ * 
+ * @x: Target X coordinate in screen pixels
+ * @y: Target Y coordinate in screen pixels
+ * @duration_ms: Time in milliseconds to complete the movement
+ * 
+ * Queues the same movement as cursor_movetos and returns immediately. The
+ * movement starts from wherever the cursor is when the job begins running.
+ * Cancelling leaves the cursor where it is.
+ * 
+ * Returns: Job handle to wait on, poll, cancel and close, or NULL on failure
+ */
+input_job_t* INPUTLIB_CALL cursor_movetos_async(int x, int y, int duration_ms) {
+	MoveJob* job = (MoveJob*)malloc(sizeof(MoveJob));
+	if(!job) { SetLastError(ERROR_OUTOFMEMORY); return NULL; }
+	job->x = x;
+	job->y = y;
+	job->duration_ms = duration_ms;
+	return async_submit(move_job_run, job);
 }
 
 /*
@@ -138,8 +190,8 @@ int INPUTLIB_CALL cursor_movetos(int x, int y, int duration_ms) {
  * Returns: 0 on success, 1 if unable to get current cursor position
  */
 int INPUTLIB_CALL cursor_movetor(int x, int y) {
-	POINT p;
-	if(!GetCursorPos(&p)) return 1;  /* Get current position */
+	int px, py;
+	if(g_backend->cursor_get(&px, &py)) return 1;  /* Get current position */
 	/* Move to current position + offset */
-	return cursor_moveto(p.x + x, p.y + y);
+	return cursor_moveto(px + x, py + y);
 }
\ No newline at end of file
@@ -0,0 +1,394 @@
+/*
+ * eventq.c - Lock-free event queue
+ *
+ * Events travel from the hook to their consumers through a bounded ring
+ * in the style of Vyukov's MPMC queue. Each slot carries a sequence number:
+ * pos while free for the producer claiming position pos, pos + 1 once that
+ * event is published. Producers and consumers only contend on their own
+ * index, which live on separate cache lines, so the hook never waits on a
+ * polling consumer.
+ *
+ * Capacity is a power of two chosen at runtime. When the ring is full the
+ * overflow policy either drops the oldest event, drops the new one, or
+ * grows: a ring twice the size is linked behind the full one, producers
+ * move on to it and the old ring is closed, and consumers follow once
+ * they have drained the old ring. Drained rings are only freed on the next
+ * eventq_configure, so a consumer still looking at one stays safe.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "backend.h"
+#include "eventq.h"
+
+/* Set in a ring's tail once it has been superseded by a larger ring */
+#define RING_CLOSED ((size_t)1 << (sizeof(size_t) * 8 - 1))
+
+/*
+ * ring_setup - Reset a ring's indexes and slot sequence numbers
+ */
+static void ring_setup(EventRing* r, QueueSlot* slots, size_t cap, int owned) {
+	memset(r, 0, sizeof(*r));
+	r->mask = cap - 1;
+	r->slots = slots;
+	r->owned = owned;
+	for(size_t i = 0; i < cap; ++i) r->slots[i].seq = i;
+}
+
+/*
+ * ring_alloc - Allocate a ring
+ *
+ * @cap: Capacity, a power of two
+ *
+ * Returns: New ring, or NULL if out of memory
+ */
+static EventRing* ring_alloc(size_t cap) {
+	EventRing* r = (EventRing*)malloc(sizeof(EventRing));
+	QueueSlot* slots = (QueueSlot*)malloc(cap * sizeof(QueueSlot));
+	if(!r || !slots) {
+		free(r);
+		free(slots);
+		return NULL;
+	}
+	ring_setup(r, slots, cap, 1);
+	return r;
+}
+
+static void ring_free(EventRing* r) {
+	if(!r || !r->owned) return;
+	free(r->slots);
+	free(r);
+}
+
+/*
+ * ring_trypush - Try to push an event into one ring
+ *
+ * Returns: 1 on success, 0 if the ring is full, -1 if it has been closed
+ */
+static int ring_trypush(EventQueue* q, EventRing* r, const EventEx* ev) {
+	size_t pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+	for(;;) {
+		if(pos & RING_CLOSED) return -1;
+		QueueSlot* slot = &r->slots[pos & r->mask];
+		size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+		if(dif == 0) {
+			/* Slot is free, claim the position (fails if closed meanwhile) */
+			if(__atomic_compare_exchange_n(&r->tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				slot->ev = *ev;
+				
+				/* Count before publishing so consumers never see a negative length */
+				unsigned long long len = (unsigned long long)__atomic_add_fetch(&q->len, 1, __ATOMIC_RELAXED);
+				unsigned long long high = __atomic_load_n(&q->high, __ATOMIC_RELAXED);
+				while(len > high && !__atomic_compare_exchange_n(&q->high, &high, len, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+				
+				__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+				return 1;
+			}
+		} else if(dif < 0) {
+			return 0; /* Slot still holds an unconsumed event */
+		} else {
+			pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+/*
+ * ring_popn - Pop up to max oldest events from one ring
+ *
+ * Claims a whole run of published events with a single compare-and-swap
+ * on the consumer index, then copies them out.
+ *
+ * Returns: Number of events popped
+ */
+static int ring_popn(EventQueue* q, EventRing* r, EventEx* out, int max) {
+	size_t pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+	for(;;) {
+		/* Count published events starting at pos */
+		int n = 0;
+		while(n < max) {
+			QueueSlot* slot = &r->slots[(pos + n) & r->mask];
+			if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + n + 1) break;
+			n++;
+		}
+		if(n == 0) {
+			size_t now = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+			if(now == pos) return 0;
+			pos = now; /* Another consumer moved on, retry from there */
+			continue;
+		}
+		if(!__atomic_compare_exchange_n(&r->head, &pos, pos + n, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) continue;
+		
+		/* Copy out and hand the slots back to producers */
+		for(int i = 0; i < n; ++i) {
+			QueueSlot* slot = &r->slots[(pos + i) & r->mask];
+			out[i] = slot->ev;
+			__atomic_store_n(&slot->seq, pos + i + r->mask + 1, __ATOMIC_RELEASE);
+		}
+		__atomic_sub_fetch(&q->len, n, __ATOMIC_RELAXED);
+		return n;
+	}
+}
+
+/*
+ * eventq_grow - Supersede a full ring with one twice its size
+ *
+ * @q: Queue being grown
+ * @r: The full producer ring
+ *
+ * Safe to race: the first successor linked wins. The successor is made
+ * the producer ring before r is closed, so a producer that finds r closed
+ * always finds somewhere to go.
+ *
+ * Returns: 1 if producers should retry, 0 if the maximum capacity is reached
+ */
+static int eventq_grow(EventQueue* q, EventRing* r) {
+	size_t cap = r->mask + 1;
+	if(cap >= q->max) return 0;
+	
+	EventRing* next = __atomic_load_n(&r->next, __ATOMIC_ACQUIRE);
+	if(!next) {
+		EventRing* fresh = ring_alloc(cap * 2);
+		if(!fresh) return 0;
+		EventRing* expected = NULL;
+		if(__atomic_compare_exchange_n(&r->next, &expected, fresh, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			next = fresh;
+			__atomic_fetch_add(&q->grown, 1, __ATOMIC_RELAXED);
+		} else {
+			ring_free(fresh);
+			next = expected;
+		}
+	}
+	EventRing* expected = r;
+	__atomic_compare_exchange_n(&q->prod, &expected, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	__atomic_fetch_or(&r->tail, RING_CLOSED, __ATOMIC_ACQ_REL);
+	return 1;
+}
+
+/*
+ * eventq_init - Set up a queue
+ *
+ * @q: Queue to set up
+ *
+ * Uses the built-in storage with the default capacity and drop-oldest
+ * policy, matching the original fixed queue.
+ */
+void eventq_init(EventQueue* q) {
+	memset(q, 0, sizeof(*q));
+	ring_setup(&q->base, q->base_slots, EVENTQ_DEFAULT_CAPACITY, 0);
+	q->prod = q->cons = &q->base;
+	q->policy = LISTENER_QUEUE_DROP_OLDEST;
+	q->max = EVENTQ_DEFAULT_CAPACITY;
+}
+
+/*
+ * pow2_at_least - Round up to a power of two
+ */
+static size_t pow2_at_least(size_t v) {
+	size_t p = 2;
+	while(p < v) p <<= 1;
+	return p;
+}
+
+/*
+ * eventq_configure - Replace the queue with an empty one
+ *
+ * @q: Queue to configure
+ * @capacity: Initial capacity, rounded up to a power of two
+ * @policy: LISTENER_QUEUE_* overflow policy
+ * @max_capacity: Growth limit for LISTENER_QUEUE_GROW, ignored otherwise
+ *
+ * Queued events are discarded. Caller must make sure no other thread is
+ * pushing or popping, i.e. the hook is stopped and nobody is polling.
+ *
+ * Returns: 0 on success, 1 on invalid parameters or out of memory
+ */
+int eventq_configure(EventQueue* q, int capacity, int policy, int max_capacity) {
+	if(capacity <= 0 || capacity > EVENTQ_MAX_CAPACITY ||
+	   policy < LISTENER_QUEUE_DROP_OLDEST || policy > LISTENER_QUEUE_GROW) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return 1;
+	}
+	size_t cap = pow2_at_least((size_t)capacity);
+	size_t max = cap;
+	if(policy == LISTENER_QUEUE_GROW) {
+		if(max_capacity < capacity || max_capacity > EVENTQ_MAX_CAPACITY) {
+			SetLastError(ERROR_INVALID_PARAMETER);
+			return 1;
+		}
+		max = pow2_at_least((size_t)max_capacity);
+	}
+	
+	EventRing* fresh;
+	if(cap <= EVENTQ_DEFAULT_CAPACITY) {
+		/* Small rings fit in the built-in storage */
+		fresh = &q->base;
+	} else {
+		fresh = ring_alloc(cap);
+		if(!fresh) { SetLastError(ERROR_OUTOFMEMORY); return 1; }
+	}
+	
+	/* Release the current chain and everything retired */
+	for(EventRing* r = q->cons; r; ) {
+		EventRing* next = r->next;
+		ring_free(r);
+		r = next;
+	}
+	for(EventRing* r = q->retired; r; ) {
+		EventRing* next = r->retired;
+		ring_free(r);
+		r = next;
+	}
+	
+	if(fresh == &q->base) ring_setup(&q->base, q->base_slots, cap, 0);
+	q->prod = q->cons = fresh;
+	q->retired = NULL;
+	q->policy = policy;
+	q->max = max;
+	q->len = 0;
+	q->high = 0;
+	q->dropped = 0;
+	q->grown = 0;
+	return 0;
+}
+
+/*
+ * eventq_push - Push an event into the queue
+ *
+ * @q: Queue to push to
+ * @ev: Event to push
+ *
+ * Lock-free. When the queue is full the event is handled by the overflow
+ * policy, and every lost event is counted.
+ *
+ * Returns: 1 if the event was queued, 0 if it was dropped
+ */
+int eventq_push(EventQueue* q, const EventEx* ev) {
+	for(;;) {
+		/* Rings not yet drained still count, so bound growth by length too */
+		if(q->policy == LISTENER_QUEUE_GROW && eventq_length(q) >= q->max) {
+			__atomic_fetch_add(&q->dropped, 1, __ATOMIC_RELAXED);
+			return 0;
+		}
+		EventRing* r = __atomic_load_n(&q->prod, __ATOMIC_ACQUIRE);
+		int rc = ring_trypush(q, r, ev);
+		if(rc > 0) return 1;
+		if(rc < 0) continue; /* Superseded by a larger ring, reload */
+		
+		/* Full */
+		if(q->policy == LISTENER_QUEUE_GROW && eventq_grow(q, r)) continue;
+		if(q->policy == LISTENER_QUEUE_DROP_OLDEST) {
+			EventEx dropped;
+			if(eventq_popn(q, &dropped, 1)) __atomic_fetch_add(&q->dropped, 1, __ATOMIC_RELAXED);
+			continue;
+		}
+		__atomic_fetch_add(&q->dropped, 1, __ATOMIC_RELAXED); /* Drop the new event */
+		return 0;
+	}
+}
+
+/*
+ * eventq_popn - Pop up to max oldest events
+ *
+ * @q: Queue to pop from
+ * @out: Array of at least max EventEx structs
+ * @max: Maximum number of events to pop
+ *
+ * Lock-free. Moves consumers on to the successor ring once a closed ring
+ * has been fully drained, so one call can drain several rings.
+ *
+ * Returns: Number of events popped, 0 if the queue is empty
+ */
+int eventq_popn(EventQueue* q, EventEx* out, int max) {
+	int total = 0;
+	for(;;) {
+		EventRing* r = __atomic_load_n(&q->cons, __ATOMIC_ACQUIRE);
+		total += ring_popn(q, r, out + total, max - total);
+		if(total == max) return total;
+		
+		/* Drained - move on only once a closed ring has nothing left in flight */
+		size_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+		if(!(tail & RING_CLOSED)) return total;
+		if(__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) != (tail & ~RING_CLOSED)) return total;
+		EventRing* next = __atomic_load_n(&r->next, __ATOMIC_ACQUIRE);
+		EventRing* expected = r;
+		if(__atomic_compare_exchange_n(&q->cons, &expected, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			/* Retire the drained ring, freed on the next eventq_configure */
+			EventRing* head = __atomic_load_n(&q->retired, __ATOMIC_RELAXED);
+			do {
+				r->retired = head;
+			} while(!__atomic_compare_exchange_n(&q->retired, &head, r, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+		}
+	}
+}
+
+/*
+ * eventq_length - Number of events currently queued
+ *
+ * @q: Queue to read
+ *
+ * Counts events from the moment a producer has claimed their slot, so a 
+ * nonzero length may briefly precede the event becoming poppable.
+ */
+size_t eventq_length(EventQueue* q) {
+	long long len = __atomic_load_n(&q->len, __ATOMIC_ACQUIRE);
+	return len > 0 ? (size_t)len : 0;
+}
+
+/*
+ * eventq_clear - Discard all queued events
+ */
+void eventq_clear(EventQueue* q) {
+	EventEx scratch[32];
+	while(eventq_popn(q, scratch, 32) > 0) {}
+}
+
+/*
+ * eventq_foreach - Visit queued events without consuming them
+ *
+ * @q: Queue to visit
+ * @fn: Visitor, returns 0 to stop
+ * @ctx: Passed through to fn
+ *
+ * Each slot is copied and then re-checked, so events popped or overwritten
+ * concurrently are skipped rather than reported torn.
+ */
+void eventq_foreach(EventQueue* q, int (*fn)(const EventEx* ev, void* ctx), void* ctx) {
+	for(EventRing* r = __atomic_load_n(&q->cons, __ATOMIC_ACQUIRE); r; r = __atomic_load_n(&r->next, __ATOMIC_ACQUIRE)) {
+		size_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		size_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) & ~RING_CLOSED;
+		for(size_t i = head; i != tail; ++i) {
+			QueueSlot* slot = &r->slots[i & r->mask];
+			if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != i + 1) continue;
+			EventEx copy = slot->ev;
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if(__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != i + 1) continue;
+			if(!fn(&copy, ctx)) return;
+		}
+	}
+}
+
+/*
+ * eventq_stats - Read the queue counters
+ *
+ * @q: Queue to read
+ * @out: Stats to populate
+ * @reset: If nonzero, dropped and grown are cleared and the high-water
+ *         mark restarts from the current length
+ */
+void eventq_stats(EventQueue* q, ListenerQueueStats* out, int reset) {
+	EventRing* r = __atomic_load_n(&q->prod, __ATOMIC_ACQUIRE);
+	long long len = __atomic_load_n(&q->len, __ATOMIC_RELAXED);
+	out->capacity = (unsigned long long)(r->mask + 1);
+	out->max_capacity = (unsigned long long)q->max;
+	out->length = len > 0 ? (unsigned long long)len : 0;
+	if(reset) {
+		out->high_water = __atomic_exchange_n(&q->high, out->length, __ATOMIC_RELAXED);
+		out->dropped = __atomic_exchange_n(&q->dropped, 0, __ATOMIC_RELAXED);
+		out->grown = __atomic_exchange_n(&q->grown, 0, __ATOMIC_RELAXED);
+	} else {
+		out->high_water = __atomic_load_n(&q->high, __ATOMIC_RELAXED);
+		out->dropped = __atomic_load_n(&q->dropped, __ATOMIC_RELAXED);
+		out->grown = __atomic_load_n(&q->grown, __ATOMIC_RELAXED);
+	}
+}
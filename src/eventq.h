@@ -0,0 +1,74 @@
+/*
+ * eventq.h - Internal lock-free event queue
+ */
+
+#pragma once
+
+#include "platform.h"
+
+/* Default capacity, matching the original fixed queue */
+#define EVENTQ_DEFAULT_CAPACITY 512
+
+/* Largest capacity accepted by eventq_configure */
+#define EVENTQ_MAX_CAPACITY (1 << 20)
+
+typedef struct QueueSlot {
+	size_t seq;
+	EventEx ev;
+} QueueSlot;
+
+typedef struct EventRing {
+	size_t head;                        /* Next position to consume */
+	char pad0[64 - sizeof(size_t)];
+	size_t tail;                        /* Next position to produce, RING_CLOSED once retired */
+	char pad1[64 - sizeof(size_t)];
+	size_t mask;                        /* Capacity - 1 */
+	QueueSlot* slots;
+	struct EventRing* next;             /* Larger successor once grown */
+	struct EventRing* retired;          /* Link in the retired list */
+	int owned;                          /* 1 if allocated, 0 for the built-in ring */
+} EventRing;
+
+/*
+ * EventQueue - Multi-producer multi-consumer event queue
+ *
+ * Starts on built-in storage of EVENTQ_DEFAULT_CAPACITY slots, so setting
+ * one up cannot fail. Fields are private to eventq.c.
+ */
+typedef struct EventQueue {
+	EventRing* prod;                    /* Ring producers push to */
+	EventRing* cons;                    /* Ring consumers pop from */
+	EventRing* retired;                 /* Drained rings awaiting release */
+	int policy;                         /* LISTENER_QUEUE_* */
+	size_t max;                         /* Capacity limit */
+	long long len;
+	unsigned long long high;
+	unsigned long long dropped;
+	unsigned long long grown;
+	EventRing base;
+	QueueSlot base_slots[EVENTQ_DEFAULT_CAPACITY];
+} EventQueue;
+
+/* Set up a queue with the default capacity and drop-oldest policy */
+void eventq_init(EventQueue* q);
+
+/* Replace the queue with an empty one using new settings */
+int eventq_configure(EventQueue* q, int capacity, int policy, int max_capacity);
+
+/* Push an event, applying the overflow policy when full; returns 0 if it was dropped */
+int eventq_push(EventQueue* q, const EventEx* ev);
+
+/* Pop up to max oldest events, returns number popped */
+int eventq_popn(EventQueue* q, EventEx* out, int max);
+
+/* Number of events currently queued */
+size_t eventq_length(EventQueue* q);
+
+/* Discard all queued events */
+void eventq_clear(EventQueue* q);
+
+/* Visit queued events oldest first without consuming them; fn returns 0 to stop */
+void eventq_foreach(EventQueue* q, int (*fn)(const EventEx* ev, void* ctx), void* ctx);
+
+/* Read the queue counters */
+void eventq_stats(EventQueue* q, ListenerQueueStats* out, int reset);
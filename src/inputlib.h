@@ -25,7 +25,18 @@
 #endif
 
 #include <stddef.h>
-#include <windows.h>
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	/* Stand-ins for the Win32 types that appear in the public API */
+	#include <stdint.h>
+	typedef void* HWND;
+	typedef uint32_t DWORD;
+#endif
+
+/* Platform backends selectable with input_setbackend */
+#define INPUT_BACKEND_NATIVE 0  /* Real OS input (Win32) */
+#define INPUT_BACKEND_SIM 1     /* In-memory simulated desktop */
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +56,179 @@ typedef struct Event {
  unsigned long held;       /* Milliseconds key was held, valid on release */
 } Event;
 
+/* Current EventEx layout version */
+#define EVENTEX_VERSION 4
+
+/* EventEx types */
+#define EVENT_KEY 0                    /* Keyboard key press or release */
+#define EVENT_MOUSE_BUTTON 1           /* Mouse button press or release, vk is VK_LBUTTON etc. */
+#define EVENT_MOUSE_MOVE 2             /* Cursor moved to x, y */
+#define EVENT_MOUSE_WHEEL 3            /* Vertical wheel turned by wheel */
+#define EVENT_MOUSE_HWHEEL 4           /* Horizontal wheel turned by wheel */
+
+/*
+ * Extended keyboard event with nanosecond timestamps
+ *
+ * Set size to sizeof(EventEx) before passing one to the library. Fields 
+ * are only ever appended, version tells which ones were filled in.
+ */
+typedef struct EventEx {
+ unsigned int size;              /* Size of the struct as known to the caller */
+ unsigned int version;           /* EVENTEX_VERSION of the library that filled it */
+ int vk;                         /* Virtual key code */
+ int scan;                       /* Raw hardware scan code */
+ int pressed;                    /* 1 if pressed, 0 if released */
+ int injected;                   /* 1 if input was injected, 0 otherwise */
+ int modifiers;                  /* Bitmask of active modifiers */
+ unsigned long long time_ns;     /* Nanoseconds since library init */
+ unsigned long long delta_ns;    /* Nanoseconds since last event */
+ unsigned long long held_ns;     /* Nanoseconds key was held, valid on release */
+ unsigned long long clock_ns;    /* Monotonic clock when the hook saw the event */
+ unsigned long long os_time;     /* Event time reported by the OS in milliseconds */
+ /* Version 2 */
+ int type;                       /* EVENT_* */
+ int x;                          /* Cursor position for mouse events */
+ int y;
+ int wheel;                      /* Wheel delta, multiples of 120 per notch */
+ /* Version 3 */
+ int repeat;                     /* Press: 1 if auto-repeat. Release: repeats folded into the hold */
+ /* Version 4 */
+ int self;                       /* 1 if injected by this library in this process */
+} EventEx;
+
+/* Polling queue overflow policies for listener_cbqueue */
+#define LISTENER_QUEUE_DROP_OLDEST 0   /* Overwrite the oldest event (default) */
+#define LISTENER_QUEUE_DROP_NEWEST 1   /* Discard the incoming event */
+#define LISTENER_QUEUE_GROW 2          /* Double the capacity up to a limit */
+
+/* Mouse move coalescing for listener_mousemoves */
+#define LISTENER_MOVES_ALL 0           /* Deliver every move (default) */
+#define LISTENER_MOVES_LATEST -1       /* Keep only the latest move until the consumer drains */
+
+/* Handling of the library's own injected input for listener_selfinput */
+#define LISTENER_SELF_DELIVER 0        /* Process like any other event (default) */
+#define LISTENER_SELF_SKIP 1           /* Pass on without rules, hotkeys, recording or delivery */
+#define LISTENER_SELF_BLOCK 2          /* Block it */
+
+/* Most replacement steps for listener_remap */
+#define LISTENER_REMAP_MAX 16
+
+/* Foreground window scopes for listener_blockscope, matched case-insensitively */
+#define LISTENER_SCOPE_PROCESS 0       /* Executable name, such as "notepad.exe" */
+#define LISTENER_SCOPE_CLASS 1         /* Window class name */
+#define LISTENER_SCOPE_TITLE 2         /* Text contained in the window title */
+
+/* Simulated keyboard layouts for sim_layout */
+#define SIM_LAYOUT_US 0                /* US QWERTY (default) */
+#define SIM_LAYOUT_DE 1                /* German QWERTZ subset with AltGr characters */
+
+/*
+ * Structure containing polling queue statistics
+ */
+typedef struct ListenerQueueStats {
+ unsigned long long capacity;      /* Current capacity in events */
+ unsigned long long max_capacity;  /* Capacity limit */
+ unsigned long long length;        /* Events currently queued */
+ unsigned long long high_water;    /* Most events queued at once */
+ unsigned long long dropped;       /* Events lost to the overflow policy */
+ unsigned long long grown;         /* Times the queue grew */
+} ListenerQueueStats;
+
+/*
+ * Structure containing event recorder statistics
+ */
+typedef struct ListenerRecordStats {
+ unsigned long long events;        /* Events recorded */
+ unsigned long long bytes;         /* Bytes written, segment headers included */
+ unsigned long long dropped;       /* Events lost because no segment was ready */
+ unsigned long long segments;      /* Segments started */
+} ListenerRecordStats;
+
+/*
+ * Latency histogram buckets in ListenerStats. Bucket b < 4 counts b ns.
+ * Above that, with e = b / 4 + 1, bucket b counts 
+ * [(4 + b % 4) << (e - 2), (5 + b % 4) << (e - 2)) ns, four buckets per 
+ * power of two. The last bucket also counts everything longer.
+ */
+#define LISTENER_HIST_BUCKETS 128
+
+/*
+ * Structure containing listener hook instrumentation
+ */
+typedef struct ListenerStats {
+ unsigned long long events;             /* Hook invocations */
+ unsigned long long hook_total_ns;      /* Time from hook entry to return */
+ unsigned long long hook_mean_ns;
+ unsigned long long hook_max_ns;
+ unsigned long long hook_p50_ns;        /* Percentiles, upper bound of the histogram bucket */
+ unsigned long long hook_p99_ns;
+ unsigned long long hook_p999_ns;
+ unsigned long long callbacks;          /* Callback invocations, inline or dispatched */
+ unsigned long long callback_total_ns;
+ unsigned long long callback_mean_ns;
+ unsigned long long callback_max_ns;
+ unsigned long long callback_p99_ns;
+ unsigned long long lock_waits;         /* Locks taken while delivering, to wake the dispatcher or on a contended move slot */
+ unsigned long long lock_wait_ns;       /* Time spent acquiring them */
+ unsigned long long remaps;             /* Remap replacements seen back at the hook */
+ unsigned long long remap_total_ns;     /* Time from the remapped key to its replacement at the hook */
+ unsigned long long remap_mean_ns;
+ unsigned long long remap_max_ns;
+ unsigned long long remap_p99_ns;
+ unsigned long long queue_length;       /* Events waiting in the poll and dispatch queues */
+ unsigned long long queue_high_water;   /* Most events queued at once in either */
+ unsigned long long dropped;            /* Events lost by either queue */
+ unsigned long long blocked_all;        /* Events blocked by listener_blockall */
+ unsigned long long blocked_sim;        /* ... by listener_blocksim */
+ unsigned long long blocked_phys;       /* ... by listener_blockphys */
+ unsigned long long blocked_key;        /* ... by a blocked key */
+ unsigned long long blocked_group;      /* ... by a blocked key group */
+ unsigned long long blocked_combo;      /* ... by a blocked combo */
+ unsigned long long blocked_debounce;   /* ... by a debounce window */
+ unsigned long long blocked_hotkey;     /* ... by a swallowing hotkey or sequence */
+ unsigned long long blocked_self;       /* ... by LISTENER_SELF_BLOCK */
+ unsigned long long blocked_remap;      /* Remapped events swallowed */
+ unsigned long long blocked_scope;      /* Events blocked by a foreground scoped rule */
+ unsigned long long hook_hist[LISTENER_HIST_BUCKETS];
+ unsigned long long callback_hist[LISTENER_HIST_BUCKETS];
+ unsigned long long remap_hist[LISTENER_HIST_BUCKETS];
+} ListenerStats;
+
+/*
+ * Structure containing pacing jitter statistics
+ */
+typedef struct InputTimingStats {
+ unsigned long long waits;          /* Number of timed waits */
+ unsigned long long missed;         /* Waits whose deadline had already passed */
+ unsigned long long total_late_ns;  /* Sum of wake-up lateness in nanoseconds */
+ unsigned long long mean_late_ns;   /* Mean wake-up lateness in nanoseconds */
+ unsigned long long max_late_ns;    /* Worst wake-up lateness in nanoseconds */
+} InputTimingStats;
+
+/*
+ * Opaque handle to an asynchronous input job
+ */
+typedef struct input_job_t input_job_t;
+
+/* Asynchronous job states returned by input_jobpoll */
+#define INPUT_JOB_PENDING 0    /* Queued, not started */
+#define INPUT_JOB_RUNNING 1    /* Running on the injector thread */
+#define INPUT_JOB_DONE 2       /* Finished successfully */
+#define INPUT_JOB_CANCELLED 3  /* Cancelled before finishing */
+#define INPUT_JOB_FAILED 4     /* Finished with an error */
+
+/* Replay flags for input_replay */
+#define INPUT_REPLAY_PHYSICAL 0x1  /* Skip events that were injected when recorded */
+#define INPUT_REPLAY_KEYS 0x2      /* Skip mouse events */
+
+/* Hotkey flags */
+#define HOTKEY_SWALLOW 0x1         /* Block the trigger key's press, repeats and release */
+#define HOTKEY_REPEAT 0x2          /* Also fire on auto-repeats */
+#define HOTKEY_PHYSICAL 0x4        /* Ignore injected presses */
+
+/* Most steps in a key sequence */
+#define SEQUENCE_MAX_STEPS 32
+
 /*
  * Structure containing detailed information about a window
  */
@@ -69,9 +253,39 @@ INPUTLIB_API int INPUTLIB_CALL input_init(void);
 /* Sleep for the specified number of milliseconds */
 INPUTLIB_API void INPUTLIB_CALL input_sleep(int ms);
 
+/* Sleep for the specified number of microseconds with sub-millisecond precision */
+INPUTLIB_API void INPUTLIB_CALL input_sleep_us(long long us);
+
+/* Get pacing jitter statistics, optionally resetting them */
+INPUTLIB_API int INPUTLIB_CALL input_timingstats(InputTimingStats* out, int reset);
+
 /* Get the last Windows error as a formatted string */
 INPUTLIB_API void INPUTLIB_CALL input_gle(char* buffer, size_t len);
 
+/* Select the platform backend all functions route through (INPUT_BACKEND_*) */
+INPUTLIB_API int INPUTLIB_CALL input_setbackend(int backend);
+
+/* Query the currently selected platform backend */
+INPUTLIB_API int INPUTLIB_CALL input_getbackend(void);
+
+/* Get the state of an asynchronous job (INPUT_JOB_*) */
+INPUTLIB_API int INPUTLIB_CALL input_jobpoll(input_job_t* job);
+
+/* Wait for an asynchronous job to finish, -1 to wait forever */
+INPUTLIB_API int INPUTLIB_CALL input_jobwait(input_job_t* job, int timeout_ms);
+
+/* Cancel an asynchronous job */
+INPUTLIB_API int INPUTLIB_CALL input_jobcancel(input_job_t* job);
+
+/* Release an asynchronous job handle */
+INPUTLIB_API int INPUTLIB_CALL input_jobclose(input_job_t* job);
+
+/* Replay a listener_record recording at speed times real time, shortening pauses to max_gap_ms (0 = keep) */
+INPUTLIB_API int INPUTLIB_CALL input_replay(const char* path, double speed, int max_gap_ms, int flags);
+
+/* Replay a recording on the injector thread without blocking */
+INPUTLIB_API input_job_t* INPUTLIB_CALL input_replay_async(const char* path, double speed, int max_gap_ms, int flags);
+
 /* ========== Keyboard Functions ========== */
 
 /* Press and release a key by name (e.g., "A", "ENTER", "F1") */
@@ -92,12 +306,27 @@ INPUTLIB_API int INPUTLIB_CALL key_pressmt(const char* mod1, const char* mod2, c
 /* Hold a key down for a specified duration in milliseconds */
 INPUTLIB_API int INPUTLIB_CALL key_hold(const char* key, int duration_ms);
 
+/* Hold a key on the injector thread without blocking */
+INPUTLIB_API input_job_t* INPUTLIB_CALL key_hold_async(const char* key, int duration_ms);
+
 /* Type a text string, handling uppercase and special characters automatically */
 INPUTLIB_API int INPUTLIB_CALL key_type(const char* text);
 
+/* Type a UTF-8 string as layout-independent Unicode input in a single submission */
+INPUTLIB_API int INPUTLIB_CALL key_type_utf8(const char* text);
+
+/* Type a text string in batched submissions of chunk characters (0 = all) with delay_ms between them */
+INPUTLIB_API int INPUTLIB_CALL key_typeb(const char* text, int chunk, int delay_ms);
+
+/* Type a text string on the injector thread without blocking */
+INPUTLIB_API input_job_t* INPUTLIB_CALL key_type_async(const char* text);
+
 /* Check if a key is currently pressed down - returns 1 if down, 0 if up, -1 on error */
 INPUTLIB_API int INPUTLIB_CALL key_isdown(const char* key);
 
+/* Get the canonical name of a virtual key code - returns NULL if unnamed */
+INPUTLIB_API const char* INPUTLIB_CALL key_name(int vk);
+
 /* ========== Cursor Functions ========== */
 
 /* Perform a left mouse button click at the current cursor position */
@@ -118,6 +347,9 @@ INPUTLIB_API int INPUTLIB_CALL cursor_moveto(int x, int y);
 /* Move cursor smoothly to absolute coordinates over the specified duration */
 INPUTLIB_API int INPUTLIB_CALL cursor_movetos(int x, int y, int duration_ms);
 
+/* Move cursor smoothly on the injector thread without blocking */
+INPUTLIB_API input_job_t* INPUTLIB_CALL cursor_movetos_async(int x, int y, int duration_ms);
+
 /* Move cursor relative to current position by (x, y) pixels */
 INPUTLIB_API int INPUTLIB_CALL cursor_movetor(int x, int y);
 
@@ -131,12 +363,21 @@ INPUTLIB_API int INPUTLIB_CALL listener_start(void);
 /* Stop listener */
 INPUTLIB_API int INPUTLIB_CALL listener_stop(void);
 
+/* Capture mouse events along with the keyboard, set before listener_start */
+INPUTLIB_API int INPUTLIB_CALL listener_mouse(int enabled);
+
+/* Coalesce mouse moves - LISTENER_MOVES_* or a maximum number of moves per second */
+INPUTLIB_API int INPUTLIB_CALL listener_mousemoves(int mode);
+
 /* Flush listener-related variables */
 INPUTLIB_API int INPUTLIB_CALL listener_flush(void);
 
 /* Subscribe to keyboard event callbacks */
 INPUTLIB_API int INPUTLIB_CALL listener_cbsub(void (*cb)(Event* ev));
 
+/* Subscribe to extended keyboard event callbacks */
+INPUTLIB_API int INPUTLIB_CALL listener_cbsubex(void (*cb)(EventEx* ev));
+
 /* Unsubscribe from keyboard event callbacks */
 INPUTLIB_API int INPUTLIB_CALL listener_ucbsub(void);
 
@@ -146,12 +387,48 @@ INPUTLIB_API int INPUTLIB_CALL listener_cbpollmode(int enabled);
 /* Poll next event in queue */
 INPUTLIB_API int INPUTLIB_CALL listener_cbpoll(Event* out);
 
+/* Poll next event in queue as an EventEx */
+INPUTLIB_API int INPUTLIB_CALL listener_cbpollex(EventEx* out);
+
+/* Poll up to max queued events in a single call */
+INPUTLIB_API int INPUTLIB_CALL listener_cbpolln(Event* out, int max);
+
+/* Wait up to timeout_ms (-1 = forever) for events and poll up to max of them */
+INPUTLIB_API int INPUTLIB_CALL listener_cbwait(Event* out, int max, int timeout_ms);
+
+/* Get an event HANDLE (Windows) or file descriptor (elsewhere) signalled while poll events are waiting */
+INPUTLIB_API intptr_t INPUTLIB_CALL listener_cbwaitobj(void);
+
 /* Dump poll queue to buffer */
 INPUTLIB_API int INPUTLIB_CALL listener_cbdumppoll(char* buffer, size_t len);
 
 /* Flush callback-related variables */
 INPUTLIB_API int INPUTLIB_CALL listener_cbflush(void);
 
+/* Set polling queue capacity and overflow policy (LISTENER_QUEUE_*) */
+INPUTLIB_API int INPUTLIB_CALL listener_cbqueue(int capacity, int policy, int max_capacity);
+
+/* Get polling queue statistics, optionally resetting them */
+INPUTLIB_API int INPUTLIB_CALL listener_cbqueuestats(ListenerQueueStats* out, int reset);
+
+/* Run callbacks on a dispatcher thread instead of the hook thread */
+INPUTLIB_API int INPUTLIB_CALL listener_cbdispatch(int enabled, int max_inflight);
+
+/* Get dispatcher queue statistics, optionally resetting them */
+INPUTLIB_API int INPUTLIB_CALL listener_cbdispatchstats(ListenerQueueStats* out, int reset);
+
+/* Get hook latency, callback, queue and block counters, optionally resetting them */
+INPUTLIB_API int INPUTLIB_CALL listener_stats(ListenerStats* out, int reset);
+
+/* Record every listener event to memory-mapped segment files <path>.000000, ... */
+INPUTLIB_API int INPUTLIB_CALL listener_record(const char* path, size_t segment_bytes, int max_segments);
+
+/* Stop recording and finish the current segment */
+INPUTLIB_API int INPUTLIB_CALL listener_recordstop(void);
+
+/* Get event recorder statistics */
+INPUTLIB_API int INPUTLIB_CALL listener_recordstats(ListenerRecordStats* out);
+
 /* Block a key by name */
 INPUTLIB_API int INPUTLIB_CALL listener_block(const char* key);
 
@@ -209,6 +486,47 @@ INPUTLIB_API int INPUTLIB_CALL listener_isblocksim(void);
 /* Query the state of the block_phys toggle */
 INPUTLIB_API int INPUTLIB_CALL listener_isblockphys(void);
 
+/* Debounce physical presses of a key (0 for all keys) within ms of its release */
+INPUTLIB_API int INPUTLIB_CALL listener_debounce(int vk, int ms);
+
+/* Fold key auto-repeats into a count on the release */
+INPUTLIB_API int INPUTLIB_CALL listener_repeatfold(int enabled);
+
+/* Choose how the library's own injected input is handled, LISTENER_SELF_* */
+INPUTLIB_API int INPUTLIB_CALL listener_selfinput(int mode);
+
+/* Remap a key to a held chord, or to a sequence of chords typed on press, inside the hook */
+INPUTLIB_API int INPUTLIB_CALL listener_remap(const char* key, const char** to, int count);
+
+/* Remove a key remap */
+INPUTLIB_API int INPUTLIB_CALL listener_unremap(const char* key);
+
+/* Block a key only while the foreground window matches, LISTENER_SCOPE_* */
+INPUTLIB_API int INPUTLIB_CALL listener_blockscope(const char* key, int scope, const char* match);
+
+/* Remove a foreground scoped block */
+INPUTLIB_API int INPUTLIB_CALL listener_ublockscope(const char* key, int scope, const char* match);
+
+/* Begin a batch of block rule changes, published together on commit */
+INPUTLIB_API int INPUTLIB_CALL listener_blockbegin(void);
+
+/* Publish the block rule changes made since listener_blockbegin */
+INPUTLIB_API int INPUTLIB_CALL listener_blockcommit(void);
+
+/* ========== Hotkey Functions ========== */
+
+/* Register a callback for a chord, the last key triggers it. Returns an id, 0 on failure */
+INPUTLIB_API int INPUTLIB_CALL hotkey_register(const char** keys, int count, void (*callback)(int id, EventEx* ev), int flags);
+
+/* Remove a registered hotkey */
+INPUTLIB_API int INPUTLIB_CALL hotkey_unregister(int id);
+
+/* Register a callback for a sequence of presses such as "CONTROL+K", "CONTROL+C". Returns an id, 0 on failure */
+INPUTLIB_API int INPUTLIB_CALL sequence_register(const char** steps, int count, void (*callback)(int id, EventEx* ev), int timeout_ms, int flags);
+
+/* Remove a registered sequence */
+INPUTLIB_API int INPUTLIB_CALL sequence_unregister(int id);
+
 /* ========== Window Management Functions ========== */
 
 /* Get the title of the currently active (foreground) window */
@@ -238,6 +556,41 @@ INPUTLIB_API int INPUTLIB_CALL window_info(HWND hwnd, window_info_t* out);
 /* Get a list of all visible window titles - caller must free the returned array */
 INPUTLIB_API int INPUTLIB_CALL window_list(char*** titles_out, int* count_out);
 
+/* ========== Simulation Functions ========== */
+
+/* Reset the simulated desktop (clock, key state, cursor, windows, counters) */
+INPUTLIB_API int INPUTLIB_CALL sim_reset(void);
+
+/* Feed a physical key event through the simulated hook - returns 1 if blocked */
+INPUTLIB_API int INPUTLIB_CALL sim_keyevent(int vk, int pressed);
+
+/* Get the virtual clock in milliseconds */
+INPUTLIB_API unsigned long long INPUTLIB_CALL sim_clock(void);
+
+/* Advance the virtual clock by the specified number of milliseconds */
+INPUTLIB_API int INPUTLIB_CALL sim_advance(int ms);
+
+/* Make the simulated clock follow real time (1) or virtual time (0) */
+INPUTLIB_API int INPUTLIB_CALL sim_realtime(int enabled);
+
+/* Select the simulated keyboard layout */
+INPUTLIB_API int INPUTLIB_CALL sim_layout(int layout);
+
+/* Add a window to the simulated window table - returns its handle */
+INPUTLIB_API HWND INPUTLIB_CALL sim_addwindow(const char* title, const char* classname, const char* procname, int x, int y, int w, int h);
+
+/* Simulate a physical mouse move to an absolute position */
+INPUTLIB_API int INPUTLIB_CALL sim_mousemove(int x, int y);
+
+/* Simulate a physical mouse button press (1) or release (0) */
+INPUTLIB_API int INPUTLIB_CALL sim_mousebutton(int vk, int pressed);
+
+/* Simulate a physical mouse wheel turn, horizontal if hwheel is 1 */
+INPUTLIB_API int INPUTLIB_CALL sim_mousewheel(int delta, int hwheel);
+
+/* Get the number of key and mouse events injected into the simulated desktop */
+INPUTLIB_API int INPUTLIB_CALL sim_counts(unsigned long long* keys, unsigned long long* mouse);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,81 +1,93 @@
 /*
  * keyboard.c - Keyboard input simulation and key state detection
  * 
- * Implements keyboard input functionality using the Windows keybd_event API.
- * Provides key name to virtual key code mapping and various key press patterns.
+ * Implements keyboard input functionality through the platform backend's
+ * key injection (keybd_event on Windows). Provides various key press patterns
+ * on top of the shared key name mapping in keymap.c.
  */
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+#include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-#include "inputlib.h"
+#include "backend.h"
+#include "keymap.h"
+#include "layout.h"
+#include "timing.h"
+#include "async.h"
 
-/*
- * vKey - Structure mapping key names to virtual key codes
- */
-typedef struct {
-	const char* name;
-	BYTE code;          /* Windows virtual key code */
-} vKey;
+/* Delay after each character for key_type */
+#define KEY_TYPE_DELAY 25
+
+/* Modifier keys in press order, matching the LAYOUT_MOD_* bits */
+static const struct { BYTE mod; BYTE vk; } type_mods[] = {
+	{ LAYOUT_MOD_CTRL, VK_CONTROL },
+	{ LAYOUT_MOD_ALT, VK_MENU },
+	{ LAYOUT_MOD_SHIFT, VK_SHIFT }
+};
 
 /*
- * keymap - Maps human-readable key names to Windows virtual key codes
+ * type_mods_set - Emit the key events that move between modifier sets
  * 
- * This lookup table allows users to specify keys by name (e.g., "A", "ENTER")
- * instead of using numeric virtual key codes directly.
+ * @cur: Currently held LAYOUT_MOD_* set
+ * @need: Desired LAYOUT_MOD_* set
+ * @out: Event buffer to append to
+ * 
+ * Releases in reverse press order, then presses in press order.
+ * 
+ * Returns: Number of events written to out
  */
-static const vKey keymap[] = {
-	/* Alphabetic keys A-Z (0x41-0x5A) */
-	{"A", 0x41}, {"B", 0x42}, {"C", 0x43}, {"D", 0x44}, {"E", 0x45}, {"F", 0x46}, {"G", 0x47},
-	{"H", 0x48}, {"I", 0x49}, {"J", 0x4A}, {"K", 0x4B}, {"L", 0x4C}, {"M", 0x4D}, {"N", 0x4E},
-	{"O", 0x4F}, {"P", 0x50}, {"Q", 0x51}, {"R", 0x52}, {"S", 0x53}, {"T", 0x54}, {"U", 0x55},
-	{"V", 0x56}, {"W", 0x57}, {"X", 0x58}, {"Y", 0x59}, {"Z", 0x5A},
-
-	/* Number keys 0-9 (0x30-0x39) and their shifted symbols */
-	{"0", 0x30}, {"1", 0x31}, {"2", 0x32}, {"3", 0x33}, {"4", 0x34}, {"5", 0x35}, {"6", 0x36}, 
-	{"7", 0x37}, {"8", 0x38}, {"9", 0x39}, {"!", 0x31}, {"@", 0x32}, {"#", 0x33}, {"$", 0x34}, 
-	{"%", 0x35}, {"^", 0x36}, {"&", 0x37}, {"*", 0x38}, {"(", 0x39}, {")", 0x30},
-
-	/* Punctuation and symbol keys */
-	{"`", 0xC0}, {"~", 0xC0}, {"-", 0xBD}, {"_", 0xBD}, {"=", 0xBB}, {"+", 0xBB}, {"[", 0xDB}, 
-	{"{", 0xDB}, {"]", 0xDD}, {"}", 0xDD}, {"\\", 0xDC}, {"|", 0xDC}, {";", 0xBA}, {":", 0xBA}, 
-	{"'", 0xDE}, {"\"", 0xDE}, {",", 0xBC}, {"<", 0xBC}, {".", 0xBE}, {">", 0xBE}, {"/", 0xBF}, 
-	{"?", 0xBF},
-
-	/* Special and navigation keys */
-	{" ", 0x20}, {"SPACE", 0x20}, {"BACKSPACE", 0x08}, {"DELETE", 0x2E}, {"TAB", 0x09}, 
-	{"ENTER", 0x0D}, {"ESCAPE", 0x1B}, {"HOME", 0x24}, {"END", 0x23}, {"INSERT", 0x2D}, 
-	{"PAGEUP", 0x21}, {"PAGEDOWN", 0x22}, {"LEFT", 0x25}, {"UP", 0x26}, {"RIGHT", 0x27}, 
-	{"DOWN", 0x28}, {"SHIFT", 0x10}, {"CONTROL", 0x11}, {"ALT", 0x12}, {"WIN", 0x5B},
-
-	/* Function keys F1-F12 (0x70-0x7B) */
-	{"F1", 0x70}, {"F2", 0x71}, {"F3", 0x72}, {"F4", 0x73}, {"F5", 0x74}, {"F6", 0x75},
-	{"F7", 0x76}, {"F8", 0x77}, {"F9", 0x78}, {"F10", 0x79}, {"F11", 0x7A}, {"F12", 0x7B}
-};
-
-/* Characters that require the Shift key to be held down */
-static const char* shift_req = "~!@#$%^&*()_+{}|:\"<>?";
+static int type_mods_set(int cur, int need, KeyInput* out) {
+	int n = 0;
+	for(int i = 2; i >= 0; --i) {
+		if((cur & type_mods[i].mod) && !(need & type_mods[i].mod)) {
+			KeyInput k = { type_mods[i].vk, 0, KEYEVENTF_KEYUP };
+			out[n++] = k;
+		}
+	}
+	for(int i = 0; i < 3; ++i) {
+		if(!(cur & type_mods[i].mod) && (need & type_mods[i].mod)) {
+			KeyInput k = { type_mods[i].vk, 0, 0 };
+			out[n++] = k;
+		}
+	}
+	return n;
+}
 
 /*
- * find_vk - Look up virtual key code by key name
+ * type_chunk - Build the key events for a run of characters
  * 
- * @key: Key name to search for (case-insensitive)
+ * @keys: Translation cache entries for the characters
+ * @len: Number of entries
+ * @out: Buffer with room for at least len * 5 + 3 events
  * 
- * Searches the keymap for a matching key name and returns its virtual key code.
- * The search is case-insensitive ("a" and "A" both work).
+ * Modifiers are pressed only when the required set changes between 
+ * characters, so a run of shifted characters shares a single Shift press.
+ * All modifiers are released at the end of the run. Characters the layout
+ * cannot produce are skipped.
  * 
- * Returns: Virtual key code (BYTE), or 0 if key not found
+ * Returns: Number of events written to out
  */
-static BYTE find_vk(const char* key) {
-	if(!key) return 0;  /* Null key name */
-	
-	/* Linear search through keymap for matching name */
-	for(size_t i = 0; i < sizeof(keymap)/sizeof(keymap[0]); ++i) {
-		if(_stricmp(keymap[i].name, key) == 0)  /* Case-insensitive comparison */
-			return keymap[i].code;
+static int type_chunk(const WORD* keys, size_t len, KeyInput* out) {
+	int n = 0;
+	int mods = 0;
+	for(size_t i = 0; i < len; ++i) {
+		if(keys[i] == LAYOUT_NONE) continue;  /* Skip unsupported characters */
+		BYTE vk = (BYTE)(keys[i] & 0xFF);
+		int need = (keys[i] >> 8) & (LAYOUT_MOD_SHIFT | LAYOUT_MOD_CTRL | LAYOUT_MOD_ALT);
+		
+		/* Switch modifiers if this character needs a different set */
+		if(need != mods) {
+			n += type_mods_set(mods, need, out + n);
+			mods = need;
+		}
+		
+		/* Press and release the key */
+		KeyInput down = { vk, 0, 0 };
+		KeyInput up = { vk, 0, KEYEVENTF_KEYUP };
+		out[n++] = down;
+		out[n++] = up;
 	}
-	return 0;  /* Key not found */
+	n += type_mods_set(mods, 0, out + n);
+	return n;
 }
 
 /*
@@ -89,10 +101,10 @@ static BYTE find_vk(const char* key) {
  * Returns: 0 on success, 1 if key name not found
  */
 int INPUTLIB_CALL key_press(const char* key) {
-	BYTE vk = find_vk(key);
+	BYTE vk = layout_find(key);
 	if(!vk) return 1;
-	keybd_event(vk, 0, 0, 0);
-	keybd_event(vk, 0, KEYEVENTF_KEYUP, 0);
+	g_backend->key_event(vk, 0);
+	g_backend->key_event(vk, KEYEVENTF_KEYUP);
 	return 0;
 }
 
@@ -108,8 +120,8 @@ int INPUTLIB_CALL key_press(const char* key) {
  */
 int INPUTLIB_CALL key_pressa(int vk) {
 	if(!vk) return 1;
-	keybd_event((BYTE)vk, 0, 0, 0);
-	keybd_event((BYTE)vk, 0, KEYEVENTF_KEYUP, 0);
+	g_backend->key_event((BYTE)vk, 0);
+	g_backend->key_event((BYTE)vk, KEYEVENTF_KEYUP);
 	return 0;
 }
 
@@ -126,14 +138,16 @@ int INPUTLIB_CALL key_pressa(int vk) {
  */
 int INPUTLIB_CALL key_pressn(const char* key, int amount) {
 	if(!key || amount <= 0) return 1;
-	BYTE vk = find_vk(key);
+	BYTE vk = layout_find(key);
 	if(!vk) return 1;
 	
-	/* Press the key multiple times with delays */
+	/* Press the key multiple times on a fixed 10ms cadence */
+	Pacer p;
+	pacer_start(&p);
 	for(int i = 0; i < amount; ++i) {
-		keybd_event(vk, 0, 0, 0);                 /* Key down */
-		keybd_event(vk, 0, KEYEVENTF_KEYUP, 0);   /* Key up */
-		input_sleep(10);  /* Small delay between presses */
+		g_backend->key_event(vk, 0);                /* Key down */
+		g_backend->key_event(vk, KEYEVENTF_KEYUP);  /* Key up */
+		pacer_wait(&p, 10000);  /* Small delay between presses */
 	}
 	return 0;
 }
@@ -152,16 +166,18 @@ int INPUTLIB_CALL key_pressn(const char* key, int amount) {
  */
 int INPUTLIB_CALL key_pressm(const char* mod, const char* key) {
 	if(!mod || !key) return 1;
-	BYTE vk = find_vk(key);
-	BYTE vm = find_vk(mod);
+	BYTE vk = layout_find(key);
+	BYTE vm = layout_find(mod);
 	if(!vk || !vm) return 1;
 	
-	keybd_event(vm, 0, 0, 0);                 /* Press modifier */
-	input_sleep(5);                           /* Brief delay for system to register */
-	keybd_event(vk, 0, 0, 0);                 /* Press main key */
-	keybd_event(vk, 0, KEYEVENTF_KEYUP, 0);   /* Release main key */
-	input_sleep(5);
-	keybd_event(vm, 0, KEYEVENTF_KEYUP, 0);   /* Release modifier */
+	Pacer p;
+	pacer_start(&p);
+	g_backend->key_event(vm, 0);                    /* Press modifier */
+	pacer_wait(&p, 5000);                           /* Brief delay for system to register */
+	g_backend->key_event(vk, 0);                    /* Press main key */
+	g_backend->key_event(vk, KEYEVENTF_KEYUP);      /* Release main key */
+	pacer_wait(&p, 5000);
+	g_backend->key_event(vm, KEYEVENTF_KEYUP);      /* Release modifier */
 	return 0;
 }
 
@@ -180,24 +196,46 @@ int INPUTLIB_CALL key_pressm(const char* mod, const char* key) {
  */
 int INPUTLIB_CALL key_pressmt(const char* mod1, const char* mod2, const char* key) {
 	if(!mod1 || !mod2 || !key) return 1;
-	BYTE vk = find_vk(key);
-	BYTE vm1 = find_vk(mod1);
-	BYTE vm2 = find_vk(mod2);
+	BYTE vk = layout_find(key);
+	BYTE vm1 = layout_find(mod1);
+	BYTE vm2 = layout_find(mod2);
 	if(!vk || !vm1 || !vm2) return 1;
 	
-	keybd_event(vm1, 0, 0, 0);                /* Press first modifier */
-	input_sleep(5);
-	keybd_event(vm2, 0, 0, 0);                /* Press second modifier */
-	input_sleep(5);
-	keybd_event(vk, 0, 0, 0);                 /* Press main key */
-	keybd_event(vk, 0, KEYEVENTF_KEYUP, 0);   /* Release main key */
-	input_sleep(5);
-	keybd_event(vm2, 0, KEYEVENTF_KEYUP, 0);  /* Release second modifier */
-	input_sleep(5);
-	keybd_event(vm1, 0, KEYEVENTF_KEYUP, 0);  /* Release first modifier */
+	Pacer p;
+	pacer_start(&p);
+	g_backend->key_event(vm1, 0);                   /* Press first modifier */
+	pacer_wait(&p, 5000);
+	g_backend->key_event(vm2, 0);                   /* Press second modifier */
+	pacer_wait(&p, 5000);
+	g_backend->key_event(vk, 0);                    /* Press main key */
+	g_backend->key_event(vk, KEYEVENTF_KEYUP);      /* Release main key */
+	pacer_wait(&p, 5000);
+	g_backend->key_event(vm2, KEYEVENTF_KEYUP);     /* Release second modifier */
+	pacer_wait(&p, 5000);
+	g_backend->key_event(vm1, KEYEVENTF_KEYUP);     /* Release first modifier */
 	return 0;
 }
 
+/*
+ * hold_run - Hold a resolved key for a duration
+ * 
+ * @vk: Virtual key code
+ * @duration_ms: How long to hold the key in milliseconds
+ * @cancel: Cancellation flag, or NULL
+ * 
+ * The key is always released, also when the hold is cancelled early.
+ * 
+ * Returns: ASYNC_RUN_DONE, or ASYNC_RUN_CANCELLED if cancelled
+ */
+static int hold_run(BYTE vk, int duration_ms, const int* cancel) {
+	Pacer p;
+	pacer_start(&p);
+	g_backend->key_event(vk, 0);                    /* Press key down */
+	int cancelled = pacer_waitc(&p, (long long)duration_ms * 1000, cancel);  /* Hold for duration */
+	g_backend->key_event(vk, KEYEVENTF_KEYUP);      /* Release key */
+	return cancelled ? ASYNC_RUN_CANCELLED : ASYNC_RUN_DONE;
+}
+
 /*
  * key_hold - Hold a key down for a specified duration
  * 
@@ -211,13 +249,131 @@ int INPUTLIB_CALL key_pressmt(const char* mod1, const char* mod2, const char* ke
  */
 int INPUTLIB_CALL key_hold(const char* key, int duration_ms) {
 	if(!key || duration_ms < 0) return 1;
-	BYTE vk = find_vk(key);
+	BYTE vk = layout_find(key);
 	if(!vk) return 1;
+	return hold_run(vk, duration_ms, NULL) == ASYNC_RUN_DONE ? 0 : 1;
+}
+
+/*
+ * utf8_to_utf16 - Decode UTF-8 into UTF-16 code units
+ * 
+ * @text: NUL-terminated UTF-8 string
+ * @out: Buffer with room for at least strlen(text) code units
+ * @lenient: 1 to skip invalid bytes one at a time, 0 to reject them
+ * 
+ * Code points above U+FFFF are encoded as surrogate pairs. Overlong forms,
+ * encoded surrogates and truncated sequences are invalid.
+ * 
+ * Returns: Number of code units written, or -1 on invalid UTF-8
+ */
+static int utf8_to_utf16(const char* text, WORD* out, int lenient) {
+	const unsigned char* p = (const unsigned char*)text;
+	int n = 0;
+	while(*p) {
+		unsigned int cp = 0;
+		int extra = 0;
+		int valid = 1;
+		if(p[0] < 0x80) { cp = p[0]; extra = 0; }
+		else if((p[0] & 0xE0) == 0xC0) { cp = p[0] & 0x1F; extra = 1; }
+		else if((p[0] & 0xF0) == 0xE0) { cp = p[0] & 0x0F; extra = 2; }
+		else if((p[0] & 0xF8) == 0xF0) { cp = p[0] & 0x07; extra = 3; }
+		else valid = 0;
+		
+		for(int i = 1; valid && i <= extra; ++i) {
+			if((p[i] & 0xC0) != 0x80) valid = 0;  /* Also catches the terminator */
+			else cp = (cp << 6) | (p[i] & 0x3F);
+		}
+		
+		/* Reject overlong forms, surrogates and out of range code points */
+		static const unsigned int min_cp[4] = { 0, 0x80, 0x800, 0x10000 };
+		if(valid && (cp < min_cp[extra] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))) valid = 0;
+		if(!valid) {
+			if(!lenient) return -1;
+			p++;
+			continue;
+		}
+		p += extra + 1;
+		
+		if(cp >= 0x10000) {
+			cp -= 0x10000;
+			out[n++] = (WORD)(0xD800 | (cp >> 10));    /* High surrogate */
+			out[n++] = (WORD)(0xDC00 | (cp & 0x3FF));  /* Low surrogate */
+		} else {
+			out[n++] = (WORD)cp;
+		}
+	}
+	return n;
+}
+
+/*
+ * type_run - Type a string in paced batches
+ * 
+ * @text: UTF-8 string to type
+ * @chunk: Maximum characters per submission, 0 for the whole string at once
+ * @delay_ms: Delay after each submission in milliseconds
+ * @cancel: Cancellation flag checked between submissions, or NULL
+ * 
+ * Shared by key_typeb and key_type_async. The string is decoded into 
+ * UTF-16 code units, so characters such as é on AZERTY or ß on QWERTZ 
+ * resolve through the layout like ASCII does. Invalid bytes are skipped. 
+ * Modifiers are released at the end of every chunk, so stopping between 
+ * chunks leaves nothing held.
+ * 
+ * Returns: ASYNC_RUN_DONE, ASYNC_RUN_FAILED or ASYNC_RUN_CANCELLED
+ */
+static int type_run(const char* text, int chunk, int delay_ms, const int* cancel) {
+	size_t len = strlen(text);
+	if(len == 0) return ASYNC_RUN_DONE;
 	
-	keybd_event(vk, 0, 0, 0);                 /* Press key down */
-	if(duration_ms > 0) input_sleep(duration_ms);  /* Hold for duration */
-	keybd_event(vk, 0, KEYEVENTF_KEYUP, 0);   /* Release key */
-	return 0;
+	/* UTF-16 never needs more code units than UTF-8 has bytes */
+	WORD* keys = (WORD*)malloc(len * sizeof(WORD));
+	if(!keys) {
+		SetLastError(ERROR_OUTOFMEMORY);
+		return ASYNC_RUN_FAILED;
+	}
+	len = (size_t)utf8_to_utf16(text, keys, 1);
+	if(len == 0) {
+		free(keys);
+		return ASYNC_RUN_DONE;
+	}
+	
+	size_t per = (chunk == 0 || (size_t)chunk > len) ? len : (size_t)chunk;
+	
+	/* Worst case per character is three modifier changes plus key down and up */
+	KeyInput* buf = (KeyInput*)malloc((per * 5 + 3) * sizeof(KeyInput));
+	if(!buf) {
+		free(keys);
+		SetLastError(ERROR_OUTOFMEMORY);
+		return ASYNC_RUN_FAILED;
+	}
+	
+	/* Translate the whole string on the active layout up front, in place */
+	layout_lock();
+	for(size_t i = 0; i < len; ++i) keys[i] = layout_char(keys[i]);
+	layout_unlock();
+	
+	/* Chunks go out on a fixed cadence so delays do not drift */
+	Pacer p;
+	pacer_start(&p);
+	int rc = ASYNC_RUN_DONE;
+	for(size_t i = 0; i < len; i += per) {
+		size_t n_chars = (len - i < per) ? len - i : per;
+		int n = type_chunk(keys + i, n_chars, buf);
+		if(n == 0) continue;  /* Nothing typeable in this chunk */
+		
+		/* One submission per chunk */
+		if(g_backend->send_keys(buf, n) != n) {
+			rc = ASYNC_RUN_FAILED;
+			break;
+		}
+		if(pacer_waitc(&p, (long long)delay_ms * 1000, cancel)) {
+			rc = ASYNC_RUN_CANCELLED;
+			break;
+		}
+	}
+	free(keys);
+	free(buf);
+	return rc;
 }
 
 /*
@@ -225,43 +381,165 @@ int INPUTLIB_CALL key_hold(const char* key, int duration_ms) {
  * 
  * @text: String to type
  * 
- * Types each character in the string by automatically handling uppercase
- * letters and special characters that require the Shift key. Unsupported
- * characters are silently skipped. Each character has a 25ms delay after it.
+ * Types each character of the UTF-8 string by automatically handling 
+ * uppercase letters and special characters that require the Shift key, on 
+ * the active keyboard layout. Unsupported
+ * characters are silently skipped. Each character is submitted on its own
+ * and has a 25ms delay after it. See key_typeb for fast batched typing.
  * 
- * Returns: 0 on success, 1 if text is null
+ * Returns: 0 on success, 1 if text is null or injection failed
  */
 int INPUTLIB_CALL key_type(const char* text) {
-	if(!text) return 1;
+	return key_typeb(text, 1, KEY_TYPE_DELAY);
+}
+
+/*
+ * key_typeb - Type a text string in batches
+ * 
+ * @text: UTF-8 string to type
+ * @chunk: Maximum characters per submission, 0 for the whole string at once
+ * @delay_ms: Delay after each submission in milliseconds, 0 for none
+ * 
+ * Builds one contiguous array of key events per chunk and injects it with a
+ * single backend submission (SendInput on Windows). Characters are resolved
+ * on the active keyboard layout through the translation cache, and Shift
+ * (or AltGr) is reused across runs of characters that need it instead of
+ * being toggled per character. Unsupported characters are silently skipped.
+ * 
+ * Returns: 0 on success, 1 on invalid parameters or if injection failed
+ */
+int INPUTLIB_CALL key_typeb(const char* text, int chunk, int delay_ms) {
+	if(!text || chunk < 0 || delay_ms < 0) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+	return type_run(text, chunk, delay_ms, NULL) == ASYNC_RUN_DONE ? 0 : 1;
+}
+
+/* Arguments of a key_type_async job, with the text stored inline */
+typedef struct TypeJob {
+	int chunk;
+	int delay_ms;
+	char text[1];
+} TypeJob;
+
+static int type_job_run(void* arg, const int* cancel) {
+	TypeJob* job = (TypeJob*)arg;
+	return type_run(job->text, job->chunk, job->delay_ms, cancel);
+}
+
+/*
+ * key_type_async - Type a text string on the injector thread
+ * 
+ * @text: String to type, copied before returning
+ * 
+ * Queues the same sequence as key_type and returns immediately. Cancelling
+ * stops typing after the current character.
+ * 
+ * Returns: Job handle to wait on, poll, cancel and close, or NULL on failure
+ */
+input_job_t* INPUTLIB_CALL key_type_async(const char* text) {
+	if(!text) { SetLastError(ERROR_INVALID_PARAMETER); return NULL; }
+	size_t len = strlen(text);
+	TypeJob* job = (TypeJob*)malloc(sizeof(TypeJob) + len);
+	if(!job) { SetLastError(ERROR_OUTOFMEMORY); return NULL; }
+	job->chunk = 1;
+	job->delay_ms = KEY_TYPE_DELAY;
+	memcpy(job->text, text, len + 1);
+	return async_submit(type_job_run, job);
+}
+
+/* Arguments of a key_hold_async job */
+typedef struct HoldJob {
+	BYTE vk;
+	int duration_ms;
+} HoldJob;
+
+static int hold_job_run(void* arg, const int* cancel) {
+	HoldJob* job = (HoldJob*)arg;
+	return hold_run(job->vk, job->duration_ms, cancel);
+}
+
+/*
+ * key_hold_async - Hold a key on the injector thread
+ * 
+ * @key: Name of the key to hold
+ * @duration_ms: How long to hold the key in milliseconds
+ * 
+ * Queues the same sequence as key_hold and returns immediately. The key
+ * name is resolved before returning. Cancelling releases the key early.
+ * 
+ * Returns: Job handle to wait on, poll, cancel and close, or NULL on 
+ * invalid parameters or key not found
+ */
+input_job_t* INPUTLIB_CALL key_hold_async(const char* key, int duration_ms) {
+	if(!key || duration_ms < 0) { SetLastError(ERROR_INVALID_PARAMETER); return NULL; }
+	BYTE vk = layout_find(key);
+	if(!vk) { SetLastError(ERROR_INVALID_PARAMETER); return NULL; }
+	HoldJob* job = (HoldJob*)malloc(sizeof(HoldJob));
+	if(!job) { SetLastError(ERROR_OUTOFMEMORY); return NULL; }
+	job->vk = vk;
+	job->duration_ms = duration_ms;
+	return async_submit(hold_job_run, job);
+}
+
+/*
+ * key_type_utf8 - Type a UTF-8 string as Unicode input
+ * 
+ * @text: UTF-8 string to type
+ * 
+ * Decodes the string once into UTF-16 code units and injects them in a single
+ * backend submission as Unicode events (KEYEVENTF_UNICODE), independent of
+ * the active keyboard layout and without any Shift handling. Surrogate pairs
+ * are sent as two consecutive code units. Line feeds and tabs are sent as
+ * ENTER and TAB key presses, and carriage returns are dropped, since most
+ * applications ignore them as Unicode input.
+ * 
+ * Returns: 0 on success, 1 on invalid parameters, invalid UTF-8 or if injection failed
+ */
+int INPUTLIB_CALL key_type_utf8(const char* text) {
+	if(!text) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
 	size_t len = strlen(text);
+	if(len == 0) return 0;
 	
-	/* Process each character in the string */
-	for(size_t i = 0; i < len; ++i) {
-		char c = text[i];
-		
-		/* Convert to uppercase for keymap lookup */
-		char s[2] = {0};
-		s[0] = (char)toupper((unsigned char)c);
-		
-		BYTE vk = find_vk(s);
-		if(!vk) continue;  /* Skip unsupported characters */
-		
-		/* Determine if Shift is needed (uppercase or shifted symbols) */
-		BOOL need_shift = isupper((unsigned char)c) || strchr(shift_req, c) != NULL;
-		
-		/* Press Shift if needed for this character */
-		if(need_shift) keybd_event(VK_SHIFT, 0, 0, 0);
-		
-		/* Press and release the key */
-		keybd_event(vk, 0, 0, 0);
-		keybd_event(vk, 0, KEYEVENTF_KEYUP, 0);
-		
-		/* Release Shift if it was pressed */
-		if(need_shift) keybd_event(VK_SHIFT, 0, KEYEVENTF_KEYUP, 0);
-		
-		input_sleep(25);  /* Delay between characters for natural typing */
+	/* UTF-16 never needs more code units than UTF-8 has bytes */
+	WORD* units = (WORD*)malloc(len * sizeof(WORD));
+	KeyInput* buf = (KeyInput*)malloc(len * 2 * sizeof(KeyInput));
+	if(!units || !buf) {
+		free(units);
+		free(buf);
+		SetLastError(ERROR_OUTOFMEMORY);
+		return 1;
 	}
-	return 0;
+	
+	int count = utf8_to_utf16(text, units, 0);
+	if(count < 0) {
+		free(units);
+		free(buf);
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return 1;
+	}
+	
+	/* Each code unit becomes a down/up pair */
+	int n = 0;
+	for(int i = 0; i < count; ++i) {
+		WORD u = units[i];
+		if(u == '\r') continue;
+		if(u == '\n' || u == '\t') {
+			WORD vk = (u == '\n') ? VK_RETURN : VK_TAB;
+			KeyInput down = { vk, 0, 0 };
+			KeyInput up = { vk, 0, KEYEVENTF_KEYUP };
+			buf[n++] = down;
+			buf[n++] = up;
+			continue;
+		}
+		KeyInput down = { 0, u, KEYEVENTF_UNICODE };
+		KeyInput up = { 0, u, KEYEVENTF_UNICODE | KEYEVENTF_KEYUP };
+		buf[n++] = down;
+		buf[n++] = up;
+	}
+	free(units);
+	
+	int ok = (n == 0 || g_backend->send_keys(buf, n) == n);
+	free(buf);
+	return ok ? 0 : 1;
 }
 
 /*
@@ -270,18 +548,30 @@ int INPUTLIB_CALL key_type(const char* text) {
  * @key: Name of the key to check
  * 
  * Queries the current state of a key to determine if it is being held down.
- * Uses GetAsyncKeyState to check the high-order bit which indicates if the
- * key is currently pressed.
+ * On the native backend this uses GetAsyncKeyState.
  * 
  * Returns: 1 if key is down, 0 if key is up, -1 on error or key not found
  */
 int INPUTLIB_CALL key_isdown(const char* key) {
 	if(!key) return -1;
-	BYTE vk = find_vk(key);
+	BYTE vk = layout_find(key);
 	if(!vk) return -1;
 	
-	/* Get asynchronous key state - high-order bit indicates if pressed */
-	SHORT state = GetAsyncKeyState(vk);
-	if(state & 0x8000) return 1;  /* Key is currently down */
-	return 0;  /* Key is up */
+	/* Get asynchronous key state from the backend */
+	return g_backend->key_state(vk);
+}
+
+/*
+ * key_name - Get the canonical name of a key
+ * 
+ * @vk: Windows virtual key code
+ * 
+ * Performs the reverse of the name lookup used by the other key functions,
+ * returning the canonical name (e.g., 0x0D gives "ENTER").
+ * 
+ * Returns: Key name, or NULL if vk has no name
+ */
+const char* INPUTLIB_CALL key_name(int vk) {
+	if(vk <= 0 || vk > 0xFF) return NULL;
+	return keymap_name((BYTE)vk);
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+/*
+ * keymap.c - Key name to virtual key code lookup
+ *
+ * Maps human-readable key names (e.g., "A", "ENTER") to Windows virtual key
+ * codes and back. The tables are generated at build time by
+ * tools/gen_keymap.py: single-character names index a 256-entry table
+ * directly, and multi-character names go through a collision-free hash, so
+ * every lookup is O(1) with at most one string compare to confirm a hit.
+ */
+
+#include <string.h>
+#include "keymap.h"
+#include "keymap_table.h"
+
+/* FNV-1a multiplier used by the generator */
+#define KEYMAP_FNV_PRIME 0x01000193U
+
+/* Characters that require the Shift key on the US layout */
+static const char* shift_req = "~!@#$%^&*()_+{}|:\"<>?";
+
+/* Fold ASCII lowercase to uppercase, leaving every other byte alone */
+#define KEYMAP_FOLD(c) ((c) >= 'a' && (c) <= 'z' ? (c) - ('a' - 'A') : (c))
+
+/*
+ * keymap_find - Look up virtual key code by key name
+ * 
+ * @key: Key name to search for (case-insensitive)
+ * 
+ * Single characters are resolved by indexing keymap_chars with the folded
+ * character. Longer names are hashed with the generator's seed, and the
+ * resulting slot is confirmed with one case-insensitive compare.
+ * 
+ * Returns: Virtual key code (BYTE), or 0 if key not found
+ */
+BYTE keymap_find(const char* key) {
+	if(!key || !key[0]) return 0;  /* Null or empty key name */
+	
+	/* Single character - direct table index */
+	if(!key[1]) {
+		unsigned char c = (unsigned char)key[0];
+		return keymap_chars[KEYMAP_FOLD(c)];
+	}
+	
+	/* Multi-character - perfect hash over the folded name */
+	unsigned int h = KEYMAP_HASH_SEED;
+	for(const unsigned char* p = (const unsigned char*)key; *p; ++p) {
+		h ^= (unsigned int)KEYMAP_FOLD(*p);
+		h *= KEYMAP_FNV_PRIME;
+	}
+	const KeymapSlot* slot = &keymap_slots[h & ((1U << KEYMAP_HASH_BITS) - 1)];
+	if(!slot->name || _stricmp(slot->name, key) != 0) return 0;
+	return slot->code;
+}
+
+/*
+ * keymap_char_us - Translate a character on the US layout
+ * 
+ * @ch: UTF-16 code unit
+ * 
+ * Resolves printable ASCII and tab through the single-character names, with
+ * Shift required for uppercase letters and shifted symbols.
+ * 
+ * Returns: vk in the low byte and 1 (Shift) in the high byte when needed, 
+ * or -1 if the character is not on the US layout
+ */
+SHORT keymap_char_us(WORD ch) {
+	if(ch == '\t') return VK_TAB;
+	if(ch < 0x20 || ch >= 0x7F) return -1;
+	BYTE vk = keymap_chars[KEYMAP_FOLD(ch)];
+	if(!vk) return -1;
+	int shift = (ch >= 'A' && ch <= 'Z') || strchr(shift_req, (int)ch) != NULL;
+	return (SHORT)(vk | (shift ? 0x100 : 0));
+}
+
+/*
+ * keymap_name - Look up canonical key name by virtual key code
+ * 
+ * @vk: Virtual key code
+ * 
+ * Returns: Canonical key name, or NULL if the code has no name
+ */
+const char* keymap_name(BYTE vk) {
+	return keymap_names[vk];
+}
@@ -0,0 +1,24 @@
+/*
+ * keymap.h - Internal key name lookup shared by keyboard and listener
+ */
+
+#pragma once
+
+#include "platform.h"
+
+/*
+ * KeymapSlot - Perfect hash slot mapping a key name to a virtual key code
+ */
+typedef struct {
+	const char* name;   /* Canonical key name, NULL for empty slots */
+	BYTE code;          /* Windows virtual key code */
+} KeymapSlot;
+
+/* Look up a virtual key code by case-insensitive key name - 0 if not found */
+BYTE keymap_find(const char* key);
+
+/* Translate a character on the US layout, in VkKeyScan format - -1 if unmapped */
+SHORT keymap_char_us(WORD ch);
+
+/* Look up the canonical name of a virtual key code - NULL if unnamed */
+const char* keymap_name(BYTE vk);
@@ -0,0 +1,201 @@
+/*
+ * keymap_table.h - Generated key name tables
+ *
+ * Generated by tools/gen_keymap.py - do not edit by hand.
+ */
+
+#pragma once
+
+/* Perfect hash parameters for multi-character names */
+#define KEYMAP_HASH_SEED 0x811C9DD4U
+#define KEYMAP_HASH_BITS 7
+
+/* Single-character names, indexed by case-folded character */
+static const BYTE keymap_chars[256] = {
+	[0x20] = 0x20,  /* " " */
+	[0x21] = 0x31,  /* "!" */
+	[0x22] = 0xDE,  /* "\"" */
+	[0x23] = 0x33,  /* "#" */
+	[0x24] = 0x34,  /* "$" */
+	[0x25] = 0x35,  /* "%" */
+	[0x26] = 0x37,  /* "&" */
+	[0x27] = 0xDE,  /* "'" */
+	[0x28] = 0x39,  /* "(" */
+	[0x29] = 0x30,  /* ")" */
+	[0x2A] = 0x38,  /* "*" */
+	[0x2B] = 0xBB,  /* "+" */
+	[0x2C] = 0xBC,  /* "," */
+	[0x2D] = 0xBD,  /* "-" */
+	[0x2E] = 0xBE,  /* "." */
+	[0x2F] = 0xBF,  /* "/" */
+	[0x30] = 0x30,  /* "0" */
+	[0x31] = 0x31,  /* "1" */
+	[0x32] = 0x32,  /* "2" */
+	[0x33] = 0x33,  /* "3" */
+	[0x34] = 0x34,  /* "4" */
+	[0x35] = 0x35,  /* "5" */
+	[0x36] = 0x36,  /* "6" */
+	[0x37] = 0x37,  /* "7" */
+	[0x38] = 0x38,  /* "8" */
+	[0x39] = 0x39,  /* "9" */
+	[0x3A] = 0xBA,  /* ":" */
+	[0x3B] = 0xBA,  /* ";" */
+	[0x3C] = 0xBC,  /* "<" */
+	[0x3D] = 0xBB,  /* "=" */
+	[0x3E] = 0xBE,  /* ">" */
+	[0x3F] = 0xBF,  /* "?" */
+	[0x40] = 0x32,  /* "@" */
+	[0x41] = 0x41,  /* "A" */
+	[0x42] = 0x42,  /* "B" */
+	[0x43] = 0x43,  /* "C" */
+	[0x44] = 0x44,  /* "D" */
+	[0x45] = 0x45,  /* "E" */
+	[0x46] = 0x46,  /* "F" */
+	[0x47] = 0x47,  /* "G" */
+	[0x48] = 0x48,  /* "H" */
+	[0x49] = 0x49,  /* "I" */
+	[0x4A] = 0x4A,  /* "J" */
+	[0x4B] = 0x4B,  /* "K" */
+	[0x4C] = 0x4C,  /* "L" */
+	[0x4D] = 0x4D,  /* "M" */
+	[0x4E] = 0x4E,  /* "N" */
+	[0x4F] = 0x4F,  /* "O" */
+	[0x50] = 0x50,  /* "P" */
+	[0x51] = 0x51,  /* "Q" */
+	[0x52] = 0x52,  /* "R" */
+	[0x53] = 0x53,  /* "S" */
+	[0x54] = 0x54,  /* "T" */
+	[0x55] = 0x55,  /* "U" */
+	[0x56] = 0x56,  /* "V" */
+	[0x57] = 0x57,  /* "W" */
+	[0x58] = 0x58,  /* "X" */
+	[0x59] = 0x59,  /* "Y" */
+	[0x5A] = 0x5A,  /* "Z" */
+	[0x5B] = 0xDB,  /* "[" */
+	[0x5C] = 0xDC,  /* "\\" */
+	[0x5D] = 0xDD,  /* "]" */
+	[0x5E] = 0x36,  /* "^" */
+	[0x5F] = 0xBD,  /* "_" */
+	[0x60] = 0xC0,  /* "`" */
+	[0x7B] = 0xDB,  /* "{" */
+	[0x7C] = 0xDC,  /* "|" */
+	[0x7D] = 0xDD,  /* "}" */
+	[0x7E] = 0xC0,  /* "~" */
+};
+
+/* Multi-character names, indexed by perfect hash */
+static const KeymapSlot keymap_slots[1 << KEYMAP_HASH_BITS] = {
+	[0] = { "DOWN", 0x28 },
+	[9] = { "CONTROL", 0x11 },
+	[15] = { "F10", 0x79 },
+	[26] = { "PAGEUP", 0x21 },
+	[27] = { "PAGEDOWN", 0x22 },
+	[32] = { "F6", 0x75 },
+	[37] = { "F1", 0x70 },
+	[42] = { "F8", 0x77 },
+	[43] = { "BACKSPACE", 0x08 },
+	[51] = { "F7", 0x76 },
+	[53] = { "F12", 0x7B },
+	[58] = { "WIN", 0x5B },
+	[61] = { "F9", 0x78 },
+	[64] = { "SHIFT", 0x10 },
+	[67] = { "TAB", 0x09 },
+	[70] = { "F4", 0x73 },
+	[73] = { "END", 0x23 },
+	[78] = { "RIGHT", 0x27 },
+	[85] = { "LEFT", 0x25 },
+	[87] = { "ALT", 0x12 },
+	[89] = { "F5", 0x74 },
+	[95] = { "DELETE", 0x2E },
+	[103] = { "ESCAPE", 0x1B },
+	[106] = { "SPACE", 0x20 },
+	[108] = { "F2", 0x71 },
+	[113] = { "INSERT", 0x2D },
+	[114] = { "ENTER", 0x0D },
+	[115] = { "HOME", 0x24 },
+	[121] = { "UP", 0x26 },
+	[124] = { "F11", 0x7A },
+	[127] = { "F3", 0x72 },
+};
+
+/* Canonical name for each virtual key code */
+static const char* const keymap_names[256] = {
+	[0x08] = "BACKSPACE",
+	[0x09] = "TAB",
+	[0x0D] = "ENTER",
+	[0x10] = "SHIFT",
+	[0x11] = "CONTROL",
+	[0x12] = "ALT",
+	[0x1B] = "ESCAPE",
+	[0x20] = "SPACE",
+	[0x21] = "PAGEUP",
+	[0x22] = "PAGEDOWN",
+	[0x23] = "END",
+	[0x24] = "HOME",
+	[0x25] = "LEFT",
+	[0x26] = "UP",
+	[0x27] = "RIGHT",
+	[0x28] = "DOWN",
+	[0x2D] = "INSERT",
+	[0x2E] = "DELETE",
+	[0x30] = "0",
+	[0x31] = "1",
+	[0x32] = "2",
+	[0x33] = "3",
+	[0x34] = "4",
+	[0x35] = "5",
+	[0x36] = "6",
+	[0x37] = "7",
+	[0x38] = "8",
+	[0x39] = "9",
+	[0x41] = "A",
+	[0x42] = "B",
+	[0x43] = "C",
+	[0x44] = "D",
+	[0x45] = "E",
+	[0x46] = "F",
+	[0x47] = "G",
+	[0x48] = "H",
+	[0x49] = "I",
+	[0x4A] = "J",
+	[0x4B] = "K",
+	[0x4C] = "L",
+	[0x4D] = "M",
+	[0x4E] = "N",
+	[0x4F] = "O",
+	[0x50] = "P",
+	[0x51] = "Q",
+	[0x52] = "R",
+	[0x53] = "S",
+	[0x54] = "T",
+	[0x55] = "U",
+	[0x56] = "V",
+	[0x57] = "W",
+	[0x58] = "X",
+	[0x59] = "Y",
+	[0x5A] = "Z",
+	[0x5B] = "WIN",
+	[0x70] = "F1",
+	[0x71] = "F2",
+	[0x72] = "F3",
+	[0x73] = "F4",
+	[0x74] = "F5",
+	[0x75] = "F6",
+	[0x76] = "F7",
+	[0x77] = "F8",
+	[0x78] = "F9",
+	[0x79] = "F10",
+	[0x7A] = "F11",
+	[0x7B] = "F12",
+	[0xBA] = ";",
+	[0xBB] = "=",
+	[0xBC] = ",",
+	[0xBD] = "-",
+	[0xBE] = ".",
+	[0xBF] = "/",
+	[0xC0] = "`",
+	[0xDB] = "[",
+	[0xDC] = "\\",
+	[0xDD] = "]",
+	[0xDE] = "'",
+};
@@ -0,0 +1,153 @@
+/*
+ * layout.c - Per-layout character translation cache
+ *
+ * Maps characters to the virtual key and modifier set that produce them on
+ * the active keyboard layout. The cache is a two-level table over the Basic
+ * Multilingual Plane: 256 pages of 256 entries, each page filled on first use
+ * with one backend query (VkKeyScanEx on Windows) per character. The whole
+ * cache is dropped only when the foreground keyboard layout changes, so
+ * repeated typing resolves characters in O(1) without further API calls.
+ */
+
+#include <stdlib.h>
+#include "backend.h"
+#include "keymap.h"
+#include "layout.h"
+
+#define LAYOUT_PAGE_SIZE 256
+
+static CRITICAL_SECTION g_layout_cs;
+static int g_layout_inited = 0;
+
+static uintptr_t g_layout_id = 0;                  /* Layout the pages belong to */
+static WORD* g_layout_pages[LAYOUT_PAGE_SIZE] = {0};
+
+/*
+ * layout_clear - Free every cached page
+ * 
+ * Caller must hold the cache lock.
+ */
+static void layout_clear(void) {
+	for(int i = 0; i < LAYOUT_PAGE_SIZE; ++i) {
+		free(g_layout_pages[i]);
+		g_layout_pages[i] = NULL;
+	}
+}
+
+/*
+ * layout_build_page - Fill one page of the cache
+ * 
+ * @page: Page index (high byte of the code unit)
+ * 
+ * Control characters other than tab are never mapped, since the layout
+ * reports them as Ctrl combinations rather than typeable keys.
+ * 
+ * Returns: The new page, or NULL on allocation failure
+ */
+static WORD* layout_build_page(int page) {
+	WORD* p = (WORD*)malloc(LAYOUT_PAGE_SIZE * sizeof(WORD));
+	if(!p) return NULL;
+	for(int i = 0; i < LAYOUT_PAGE_SIZE; ++i) {
+		WORD ch = (WORD)((page << 8) | i);
+		if(ch < 0x20 && ch != '\t') { p[i] = LAYOUT_NONE; continue; }
+		SHORT s = g_backend->char_scan(ch, g_layout_id);
+		if(s == -1 || (s & 0xFF) == 0xFF) p[i] = LAYOUT_NONE;
+		else p[i] = (WORD)s;
+	}
+	g_layout_pages[page] = p;
+	return p;
+}
+
+/*
+ * layout_init - Initialize the translation cache
+ * 
+ * Any subsequent calls after the initial call will do nothing.
+ */
+void layout_init(void) {
+	if(g_layout_inited) return;
+	InitializeCriticalSection(&g_layout_cs);
+	g_layout_inited = 1;
+}
+
+/*
+ * layout_invalidate - Drop the translation cache
+ */
+void layout_invalidate(void) {
+	EnterCriticalSection(&g_layout_cs);
+	layout_clear();
+	g_layout_id = 0;
+	LeaveCriticalSection(&g_layout_cs);
+}
+
+/*
+ * layout_lock - Lock and revalidate the translation cache
+ * 
+ * Queries the foreground keyboard layout once and drops the cached pages if
+ * it differs from the layout they were built for.
+ */
+void layout_lock(void) {
+	EnterCriticalSection(&g_layout_cs);
+	uintptr_t id = g_backend->layout_current();
+	if(id != g_layout_id) {
+		layout_clear();
+		g_layout_id = id;
+	}
+}
+
+/*
+ * layout_char - Translate a character
+ * 
+ * @ch: UTF-16 code unit
+ * 
+ * Caller must hold the cache lock.
+ * 
+ * Returns: vk in the low byte and LAYOUT_MOD_* in the high byte, or 
+ * LAYOUT_NONE if the layout cannot produce the character
+ */
+WORD layout_char(WORD ch) {
+	WORD* p = g_layout_pages[ch >> 8];
+	if(!p) p = layout_build_page(ch >> 8);
+	if(!p) return LAYOUT_NONE;
+	return p[ch & 0xFF];
+}
+
+/*
+ * layout_unlock - Unlock the translation cache
+ */
+void layout_unlock(void) {
+	LeaveCriticalSection(&g_layout_cs);
+}
+
+/*
+ * layout_find - Look up the virtual key code for a key name
+ * 
+ * @key: Key name (case-insensitive), or a single UTF-8 character
+ * 
+ * Single characters are resolved on the active keyboard layout through the
+ * translation cache, so symbols land on the right key on non-US layouts.
+ * Everything else, and characters the layout cannot produce, fall back to
+ * the shared keymap.
+ * 
+ * Returns: Virtual key code (BYTE), or 0 if key not found
+ */
+BYTE layout_find(const char* key) {
+	if(!key || !key[0]) return 0;
+	const unsigned char* p = (const unsigned char*)key;
+	WORD ch = 0;
+	if(p[0] < 0x80 && !p[1]) {
+		ch = p[0];
+	} else if((p[0] & 0xE0) == 0xC0 && (p[1] & 0xC0) == 0x80 && !p[2]) {
+		ch = (WORD)(((p[0] & 0x1F) << 6) | (p[1] & 0x3F));
+		if(ch < 0x80) ch = 0;
+	} else if((p[0] & 0xF0) == 0xE0 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80 && !p[3]) {
+		ch = (WORD)(((p[0] & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F));
+		if(ch < 0x800 || (ch >= 0xD800 && ch <= 0xDFFF)) ch = 0;
+	}
+	if(ch) {
+		layout_lock();
+		WORD e = layout_char(ch);
+		layout_unlock();
+		if(e != LAYOUT_NONE) return (BYTE)(e & 0xFF);
+	}
+	return keymap_find(key);
+}
@@ -0,0 +1,33 @@
+/*
+ * layout.h - Internal per-layout character translation cache
+ */
+
+#pragma once
+
+#include "platform.h"
+
+/* Cache entry: low byte is the vk, high byte the LAYOUT_MOD_* set */
+#define LAYOUT_NONE 0xFFFF
+
+/* Modifier bits in the high byte of an entry (VkKeyScanEx shift state) */
+#define LAYOUT_MOD_SHIFT 0x01
+#define LAYOUT_MOD_CTRL 0x02
+#define LAYOUT_MOD_ALT 0x04
+
+/* Initialize the cache - safe to call more than once */
+void layout_init(void);
+
+/* Drop every cached page, e.g. after switching backends */
+void layout_invalidate(void);
+
+/* Lock the cache and revalidate it against the foreground layout */
+void layout_lock(void);
+
+/* Translate one UTF-16 code unit - caller must hold the cache lock */
+WORD layout_char(WORD ch);
+
+/* Unlock the cache */
+void layout_unlock(void);
+
+/* Look up a key name, single characters on the active layout - 0 if not found */
+BYTE layout_find(const char* key);
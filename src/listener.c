@@ -5,16 +5,19 @@
  * 
  */
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include "inputlib.h"
-
-/* Define event poll queue length */
-#define EVENT_QUEUE_CAPACITY 512
+#include "backend.h"
+#include "keymap.h"
+#include "layout.h"
+#include "eventq.h"
+#include "recorder.h"
+#include "timing.h"
+#include "waitobj.h"
+#include "seqauto.h"
 
 /* Define modifier bit shifts */
 #define L_MOD_SHIFT (1 << 0)
@@ -22,79 +25,6 @@
 #define L_MOD_ALT (1 << 2)
 #define L_MOD_WIN (1 << 3)
 
-/* 
- * vKey -  Structure mapping key names to virtual key codes
- */
-typedef struct {
-    const char* name;
-    BYTE code; /* Windows vitrual key code */
-} vKey;
-
-/*
- * keymap - Maps human-readable key names to Windows virtual key codes
- *
- * This lookup table allows users to specify keys by name (e.g., "A", "ENTER")
- * instead of using numeric vitrual key codes directly. 
- */
-static const vKey keymap[] = {
-    /* Alphabetic keys A-Z (0x41-0x5A) */
-    {"A", 0x41}, {"B", 0x42}, {"C", 0x43}, {"D", 0x44}, {"E", 0x45}, {"F", 0x46}, {"G", 0x47},
-    {"H", 0x48}, {"I", 0x49}, {"J", 0x4A}, {"K", 0x4B}, {"L", 0x4C}, {"M", 0x4D}, {"N", 0x4E},
-    {"O", 0x4F}, {"P", 0x50}, {"Q", 0x51}, {"R", 0x52}, {"S", 0x53}, {"T", 0x54}, {"U", 0x55},
-    {"V", 0x56}, {"W", 0x57}, {"X", 0x58}, {"Y", 0x59}, {"Z", 0x5A},
-
-    /* Number keys 0-9 (0x30-0x39) and their shifted symbols */
-    {"0", 0x30}, {"1", 0x31}, {"2", 0x32}, {"3", 0x33}, {"4", 0x34}, {"5", 0x35}, {"6", 0x36},
-    {"7", 0x37}, {"8", 0x38}, {"9", 0x39}, {"!", 0x31}, {"@", 0x32}, {"#", 0x33}, {"$", 0x34},
-    {"%", 0x35}, {"^", 0x36}, {"&", 0x37}, {"*", 0x38}, {"(", 0x39}, {")", 0x30}, 
-
-    /* Punctuation and symbol keys */
-    {"`", 0xC0}, {"~", 0xC0}, {"-", 0xBD}, {"_", 0xBD}, {"=", 0xBB}, {"+", 0xBB}, {"[", 0xDB}, {"{", 0xDB}, {"]", 0xDD}, {"}", 0xDD}, {"\\", 0xDC},
-    {"|", 0xDC}, {";", 0xBA}, {":", 0xBA}, {"'", 0xDE}, {"\"", 0xDE}, {",", 0xBC}, {"<", 0xBC}, {".", 0xBE}, {">", 0xBE}, {"/", 0xBF}, {"?", 0xBF},
-
-    /* Special and navigation keys */
-    {" ", 0x20}, {"SPACE", 0x20}, {"BACKSPACE", 0x08}, {"DELETE", 0x2E}, {"TAB", 0x09},
-    {"ENTER", 0x0D}, {"ESCAPE", 0x1B}, {"HOME", 0x24}, {"END", 0x23}, {"INSERT", 0x2D},
-    {"PAGEUP", 0x21}, {"PAGEDOWN", 0x22}, {"LEFT", 0x25}, {"UP", 0x26}, {"RIGHT", 0x27},
-    {"DOWN", 0x28}, {"SHIFT", 0x10}, {"CONTROL", 0x11}, {"ALT", 0x12}, {"WIN", 0x5B},
-
-    /* Function keys F1-F12 (0x70-0x7B) */
-    {"F1", 0x70}, {"F2", 0x71}, {"F3", 0x72}, {"F4", 0x73}, {"F5", 0x74}, {"F6", 0x75},
-    {"F7", 0x76}, {"F8", 0x77}, {"F9", 0x78}, {"F10", 0x79}, {"F11", 0x7A}, {"F12", 0x7B}
-};
-
-/* Precalculate array length as a constant */
-static const size_t keymap_count = sizeof(keymap) / sizeof(keymap[0]);
-
-
-/*
- * find_vk - Look up virtual key code by key name
- * 
- * @key: Key name to search for (case-insensitive)
- * 
- * Searches the keymap for the matching key name and returns its virtual key code.
- * The search is case-insensitive ("a" and "A" both work).
- * 
- * Returns: Virtual key code (BYTE), or 0 if key not found
- */
-static BYTE find_vk(const char* key) {
-    if(!key) return 0; /* Null key name */
-
-    /* Linear search through keymap for matching name */
-    for(size_t i = 0; i < keymap_count; ++i) {
-        if(_stricmp(keymap[i].name, key) == 0) return keymap[i].code;
-    }
-
-    /* Fallback if search is for single character in lowercase */
-    if(strlen(key) == 1) {
-        char s[2] = { (char)toupper((unsigned char)key[0]), 0 };
-        for(size_t i = 0; i < keymap_count; ++i) {
-            if(_stricmp(keymap[i].name, s) == 0) return keymap[i].code;
-        }
-    }
-    return 0; /* Key not found */
-}
-
 typedef enum {
     GROUP_LETTERS = 0,
     GROUP_NUMBERS,
@@ -138,510 +68,2191 @@ static int find_group_id(const char* name) {
     return -1;
 }
 
+/* 256-bit set of virtual key codes */
+typedef struct KeySet {
+    uint64_t w[4];
+} KeySet;
+
 /*
  * Structure containing key information of a combo
  */
 typedef struct ComboNode {
-    BYTE* mods;                /* Array of modifier key codes */
-    int mod_count;             /* Number of modifers in the array */
-    BYTE key;                  /* Primary key code for combo */
-    struct ComboNode* next;    /* Next combo in linked list */
+    KeySet mods;                  /* Set of modifier key codes */
+    BYTE key;                     /* Primary key code for combo */
+    struct ComboNode* next_hash;  /* Next combo in the same (key, mods) bucket */
+    struct ComboNode* next_key;   /* Next combo with the same primary key */
 } ComboNode;
 
+/* Combo index size and node pool growth */
+#define COMBO_HASH_BITS 8
+#define COMBO_HASH_SIZE (1 << COMBO_HASH_BITS)
+#define COMBO_POOL_CHUNK 64
 
-static HHOOK g_hook = NULL;
-static HANDLE g_thread = NULL;
-static DWORD g_thread_id = 0;
+
+/* State without a lock or atomics below is hook-owned. Backends never 
+   enter the hook on two threads at once (one hook thread on Windows, a 
+   hook lock in the simulator), so only the hook may touch it while the 
+   listener runs */
+static const InputBackend* g_hook_backend = NULL;
 static volatile int g_running = 0;
-static unsigned long long g_start_time = 0;
-static unsigned long long g_last_event_time = 0;
-static unsigned long long g_key_down_time[256] = {0};
+static unsigned long long g_start_ns = 0;
+static unsigned long long g_last_event_ns = 0;
+static unsigned long long g_key_down_ns[256] = {0};
+static unsigned long long g_key_change_ns[256] = {0};  /* Last accepted press or release */
+static unsigned char g_bounced[256] = {0};             /* Press swallowed by debounce, release pending */
+static unsigned g_repeat_count[256] = {0};             /* Repeats folded since the press */
+static unsigned char g_hotkey_swallowed[256] = {0};    /* Press swallowed by a hotkey or sequence, release pending */
+static int g_repeat_fold = 0;
+static int g_self_mode = LISTENER_SELF_DELIVER;
+
+/* Sequence matching, the last SEQUENCE_MAX_STEPS step presses are kept 
+   to check timeouts and injection on a match */
+static int g_seq_state = 0;
+static unsigned long long g_seq_gen = 0;               /* Snapshot g_seq_state belongs to */
+static unsigned g_seq_pos = 0;
+static unsigned long long g_seq_times[SEQUENCE_MAX_STEPS];
+static unsigned char g_seq_injected[SEQUENCE_MAX_STEPS];
 
 static CRITICAL_SECTION g_cs;
 
 static void (*g_callback)(Event* ev) = NULL;
+static void (*g_callback_ex)(EventEx* ev) = NULL;  /* Set instead of g_callback by listener_cbsubex */
+
+/*
+ * Latest coalesced mouse move waiting for a consumer
+ * 
+ * Written by the hook under a sequence lock, taken whole by whichever 
+ * consumer drains next.
+ */
+typedef struct MoveSlot {
+    unsigned seq;                  /* Odd while a writer is updating */
+    int pending;                   /* 1 if a move is waiting */
+    unsigned long long pos;        /* x in the high half, y in the low half */
+    unsigned long long clock_ns;
+    unsigned long long os_time;
+    int injected;
+    int self;
+    int modifiers;
+    unsigned long long last_ns;    /* Last move delivered to this consumer under a rate limit */
+} MoveSlot;
+
+static int g_mouse = 0;                      /* Hook the mouse on listener_start */
+static int g_move_mode = LISTENER_MOVES_ALL;
+static unsigned long long g_move_inline_ns = 0;  /* Last move delivered inline under a rate limit */
+static MoveSlot g_poll_move;
+static MoveSlot g_dispatch_move;
 static int g_poll_mode = 0;
-static Event g_event_queue[EVENT_QUEUE_CAPACITY];
-static int g_q_head = 0;
-static int g_q_tail = 0;
-static int g_q_count = 0;
+static EventQueue g_poll_q;
+
+/* Poll consumers' wait signal, created on first use and set while events are waiting */
+static WaitObj g_wait;
+static int g_wait_ready = 0;
+static int g_wait_signaled = 0;
+
+/* Sets the wait signal once a poll move held back by a rate limit is due, 
+   runs while the listener does once the signal exists */
+static HANDLE g_wait_timer = NULL;
+static CRITICAL_SECTION g_wait_timer_cs;
+static CONDITION_VARIABLE g_wait_timer_cv;
+static int g_wait_timer_idle = 0;   /* Timer is parked or about to park */
+static int g_wait_timer_stop = 0;
+
+/* Callback dispatcher, runs callbacks off the hook thread when enabled */
+static int g_dispatch = 0;
+static EventQueue g_dispatch_q;
+static HANDLE g_dispatch_thread = NULL;
+static CRITICAL_SECTION g_dispatch_cs;
+static CONDITION_VARIABLE g_dispatch_cv;
+static int g_dispatch_idle = 0;   /* Dispatcher is parked or about to park */
+static int g_dispatch_stop = 0;
+static __thread int t_on_dispatcher = 0;
+
+/* Callback picked by a hotkey or sequence match, run after the rules are released */
+typedef struct HotkeyFire {
+    void (*cb)(int id, EventEx* ev);
+    int id;
+} HotkeyFire;
+
+/* Matches waiting for the dispatcher, in a single-producer ring since the 
+   hook is never entered concurrently */
+#define FIRE_QUEUE_SIZE 256
+
+typedef struct FireRecord {
+    HotkeyFire fire;
+    EventEx ev;
+} FireRecord;
+
+static FireRecord g_fire_q[FIRE_QUEUE_SIZE];
+static unsigned g_fire_head = 0;                /* Next record to run, dispatcher-owned */
+static unsigned g_fire_tail = 0;                /* Next record to fill, hook-owned */
+static unsigned long long g_fire_dropped = 0;
+
+/* Block reasons counted in StatBlock.blocked */
+enum {
+    STAT_BLOCK_ALL,
+    STAT_BLOCK_SIM,
+    STAT_BLOCK_PHYS,
+    STAT_BLOCK_KEY,
+    STAT_BLOCK_GROUP,
+    STAT_BLOCK_COMBO,
+    STAT_BLOCK_DEBOUNCE,
+    STAT_BLOCK_HOTKEY,
+    STAT_BLOCK_SELF,
+    STAT_BLOCK_REMAP,
+    STAT_BLOCK_SCOPE,
+    STAT_BLOCK_REASONS
+};
+
+/*
+ * Per-thread listener counters
+ * 
+ * Each thread that runs the hook or a callback claims a block and is its 
+ * only writer, so counting is a plain load and store. Threads beyond 
+ * STAT_SLOTS share the last block and count with atomic adds. 
+ * listener_stats sums the blocks and subtracts the totals of the last reset.
+ */
+typedef struct StatBlock {
+    int shared;                    /* Written by several threads */
+    unsigned epoch;                /* g_stats_epoch the maxima belong to */
+    unsigned long long events;
+    unsigned long long hook_ns;
+    unsigned long long hook_max_ns;
+    unsigned long long callbacks;
+    unsigned long long callback_ns;
+    unsigned long long callback_max_ns;
+    unsigned long long lock_waits;
+    unsigned long long lock_wait_ns;
+    unsigned long long remaps;
+    unsigned long long remap_ns;
+    unsigned long long remap_max_ns;
+    unsigned long long blocked[STAT_BLOCK_REASONS];
+    unsigned long long hook_hist[LISTENER_HIST_BUCKETS];
+    unsigned long long callback_hist[LISTENER_HIST_BUCKETS];
+    unsigned long long remap_hist[LISTENER_HIST_BUCKETS];
+} StatBlock;
+
+#define STAT_SLOTS 16
+
+static StatBlock g_stats[STAT_SLOTS];
+static int g_stats_claimed = 0;        /* Blocks handed out, the last one is never exclusive */
+static unsigned g_stats_epoch = 0;     /* Bumped by a reset to drop the maxima */
+static StatBlock g_stats_base;         /* Sums at the last reset */
+static CRITICAL_SECTION g_stats_cs;
+static __thread StatBlock* t_stats = NULL;
+
+/* EventEx size up to the end of each version's fields, version 1 is the 
+   smallest accepted from callers */
+#define EVENTEX_V1_SIZE offsetof(EventEx, type)
+#define EVENTEX_V2_SIZE offsetof(EventEx, repeat)
+#define EVENTEX_V3_SIZE offsetof(EventEx, self)
+#define EVENTEX_V4_SIZE (offsetof(EventEx, self) + sizeof(int))
+
+/* Block decision bits, one table entry per vk */
+#define BLOCK_INJECTED (1 << 0)   /* Block injected events */
+#define BLOCK_PHYSICAL (1 << 1)   /* Block physical events */
+#define BLOCK_COMBO (1 << 2)      /* Some combo ends in this key, check modifiers */
+#define BLOCK_BY_ALL (1 << 3)     /* Reasons, only read to attribute a block */
+#define BLOCK_BY_KEY (1 << 4)
+#define BLOCK_BY_GROUP (1 << 5)
+#define BLOCK_HOTKEY (1 << 6)     /* Some hotkey is triggered by this key */
+#define BLOCK_SEQUENCE (1 << 7)   /* Some sequence has a step on this key */
+#define BLOCK_REMAP (1 << 8)      /* This key is remapped */
+#define BLOCK_BY_SCOPE (1 << 9)   /* Only set in the hook's scoped table */
 
+/*
+ * Structure containing a registered hotkey
+ */
+typedef struct Hotkey {
+    KeySet extra;                     /* Non-modifier keys that must also be held */
+    int id;
+    int flags;                        /* HOTKEY_* */
+    int mods;                         /* L_MOD_* mask, must match exactly */
+    BYTE key;                         /* Trigger key */
+    void (*cb)(int id, EventEx* ev);
+} Hotkey;
+
+/* Hotkey index bucket in a rule snapshot, one per distinct (key, mods) */
+typedef struct HotkeySlot {
+    unsigned key;                     /* HOTKEY_SLOT_KEY, 0 if empty */
+    int first;                        /* Hotkeys are hotkeys[first .. first + count) */
+    int count;
+} HotkeySlot;
+
+#define HOTKEY_SLOT_KEY(vk, mods) ((unsigned)(vk) | ((unsigned)(mods) << 8))
+
+/* Most hotkeys fired by one event */
+#define HOTKEY_FIRE_MAX 8
+
+/*
+ * Structure containing a key remap
+ */
+typedef struct Remap {
+    int count;                              /* 1 holds the target in place of the key, more are typed on press */
+    unsigned steps[LISTENER_REMAP_MAX];     /* SEQ_SYMBOL per step */
+} Remap;
+
+/* Most key events sent for one remapped event, a step is at most 4 modifiers and a key, down and up */
+#define REMAP_BATCH_MAX (LISTENER_REMAP_MAX * 10)
+
+/* Most key events sent on the release of a held remap */
+#define REMAP_RELEASE_MAX 5
+
+/* Remaps in effect, the release of a held original sends the stored events */
+static unsigned char g_remap_held[256] = {0};
+static unsigned char g_remap_release_n[256] = {0};
+static KeyInput g_remap_release[256][REMAP_RELEASE_MAX];
+static unsigned char g_remap_timing[256] = {0};          /* A replacement starting with vk is on its way */
+static unsigned long long g_remap_origin_ns[256] = {0};  /* Hook time of its original */
+static unsigned char g_remap_expect[256] = {0};          /* Replacement events with vk still to come */
+
+/*
+ * Structure containing a block scoped to the foreground window
+ */
+typedef struct ScopedRule {
+    BYTE vk;
+    int scope;                        /* LISTENER_SCOPE_* */
+    char match[260];                  /* Lowercased */
+} ScopedRule;
+
+/*
+ * Identity of the foreground window, lowercased for matching
+ */
+typedef struct Foreground {
+    HWND hwnd;
+    DWORD pid;
+    char procname[260];
+    char classname[256];
+    char title[260];
+} Foreground;
+
+/* Foreground identity, resolved on focus change notifications, never per event */
+static CRITICAL_SECTION g_fg_cs;
+static Foreground g_fg;
+static unsigned g_fg_serial = 0;       /* Bumped on every change of g_fg */
+
+/* Hook-owned scoped block bits, valid for one snapshot and foreground */
+static unsigned short g_scope_table[256];
+static unsigned long long g_scope_gen = 0;
+static unsigned g_scope_serial = 0;
+
+/*
+ * Immutable snapshot of the block rules
+ * 
+ * Compiled from the working rules below on every change and published 
+ * through g_rules. Readers never lock, writers build a new snapshot, swap 
+ * the pointer and free the old one after a grace period.
+ */
+typedef struct RuleSet {
+    unsigned short table[256];             /* Block decision per vk */
+    unsigned char keys[256];               /* Blocked keys */
+    unsigned char groups[GROUP_COUNT];     /* Blocked groups */
+    int block_all;
+    int block_sim;
+    int block_phys;
+    unsigned short debounce_ms[256];       /* Debounce window per vk, 0 if off */
+    int combo_first[257];                  /* Combos ending in vk are combos[first[vk] .. first[vk + 1]) */
+    HotkeySlot* hk_slots;                  /* Open-addressed by (key, mods), NULL if no hotkeys */
+    unsigned hk_mask;                      /* Slot count - 1 */
+    Hotkey* hotkeys;                       /* Grouped by (key, mods), same allocation as hk_slots */
+    SeqAutomaton* seq;                     /* Sequence automaton, NULL if no sequences */
+    unsigned char remap_of[256];           /* Index + 1 into remaps, 0 if vk is not remapped */
+    Remap* remaps;                         /* NULL if no remaps */
+    ScopedRule* scoped;                    /* NULL if no scoped blocks */
+    int scoped_count;
+    unsigned long long gen;                /* Publish count, 0 for the empty snapshot */
+    KeySet combos[];                       /* Modifier sets grouped by primary key */
+} RuleSet;
+
+/* Working rules, only touched by writers holding g_rules_cs */
+static CRITICAL_SECTION g_rules_cs;
+static int g_rules_batch = 0;          /* Open listener_blockbegin depth */
 static unsigned char g_blocked_keys[256] = {0};
 static unsigned char g_blocked_groups[GROUP_COUNT] = {0};
-static ComboNode* g_combo_head = NULL;
-
+static ComboNode* g_combo_hash[COMBO_HASH_SIZE] = {0};  /* Indexed by (key, mods) */
+static ComboNode* g_combo_by_key[256] = {0};             /* Candidates per primary key */
+static ComboNode* g_combo_free = NULL;                   /* Pool free list */
+static int g_combo_count = 0;
 static int g_block_all = 0;
 static int g_block_sim = 0;
 static int g_block_phys = 0;
+static unsigned short g_debounce_ms[256] = {0};
+static Hotkey* g_hotkeys = NULL;
+static int g_hotkey_count = 0;
+static int g_hotkey_cap = 0;
+static int g_hotkey_next_id = 1;       /* Shared by hotkeys and sequences */
+static SeqDef* g_seqs = NULL;
+static int g_seq_count = 0;
+static int g_seq_cap = 0;
+static unsigned long long g_rules_gen = 0;
+static Remap g_remaps[256];            /* count 0 if not remapped */
+static int g_remap_count = 0;
+static ScopedRule* g_scoped = NULL;
+static int g_scoped_count = 0;
+static int g_scoped_cap = 0;
+
+/* Published snapshot, the empty rule set is never freed */
+static RuleSet g_rules_empty;
+static RuleSet* g_rules = &g_rules_empty;
+
+/* Epoch-based reclamation, readers count themselves in the current epoch */
+static int g_rules_epoch = 0;
+static int g_rules_readers[2] = {0};
+
+/* Keys the listener has seen go down and not yet come up */
+static KeySet g_keys_down;
 
-static int g_ignore_injected_for_listener = 0;
 static int g_mod_state = 0;
-static HANDLE g_init_event = NULL;
 
 
 /*
- * q_push - Push input event into polling queue 
- * 
- * @ev: Pointer to Event struct
+ * combo_hash - Hash a combo's primary key and modifier set
  * 
- * Pushes the information from the specified Event struct
- * into the polling queue.
+ * Returns: Bucket index into g_combo_hash
  */
-static void q_push(const Event* ev) {
-    if(g_q_count >= EVENT_QUEUE_CAPACITY) {
-        g_q_head = (g_q_head + 1) % EVENT_QUEUE_CAPACITY;
-        g_q_count--;
+static unsigned combo_hash(const KeySet* mods, BYTE key) {
+    uint64_t h = 0x9E3779B97F4A7C15ULL * (uint64_t)(key + 1);
+    for(int i = 0; i < 4; ++i) {
+        h ^= mods->w[i];
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
     }
-    g_event_queue[g_q_tail] = *ev;
-    g_q_tail = (g_q_tail + 1) % EVENT_QUEUE_CAPACITY;
-    g_q_count++;
+    return (unsigned)(h >> (64 - COMBO_HASH_BITS));
 }
 
 /*
- * q_pop - Pop oldest input event from polling queue
- * 
- * @out: Pointer to output Event struct
+ * combo_modset - Build a modifier set from an array of key codes
+ */
+static KeySet combo_modset(const BYTE* mods, int mod_count) {
+    KeySet set = {{0}};
+    for(int i = 0; i < mod_count; ++i) set.w[mods[i] >> 6] |= 1ULL << (mods[i] & 63);
+    return set;
+}
+
+/*
+ * combo_find - Look up a combo by primary key and modifier set
  * 
- * Pops the oldest event from the polling queue into a provided Event struct.
+ * Caller must hold the rules CS.
  * 
- * Returns: 1 on success, 0 if queue is empty
+ * Returns: Pointer to the link that holds the node, or to the terminating 
+ * NULL link of its bucket if not found
  */
-static int q_pop(Event* out) {
-    if(g_q_count == 0) return 0;
-    *out = g_event_queue[g_q_head];
-    g_q_head = (g_q_head + 1) % EVENT_QUEUE_CAPACITY;
-    g_q_count--;
-    return 1;
+static ComboNode** combo_find(const KeySet* mods, BYTE key) {
+    ComboNode** link = &g_combo_hash[combo_hash(mods, key)];
+    while(*link) {
+        if((*link)->key == key && memcmp(&(*link)->mods, mods, sizeof(KeySet)) == 0) break;
+        link = &(*link)->next_hash;
+    }
+    return link;
 }
 
 /*
- * q_clear - Clears all entries from polling queue
+ * combo_alloc - Take a node from the pool
+ * 
+ * Refills the free list a chunk at a time. Chunks are kept for the life of 
+ * the process and recycled through combo_remove and combo_clear. 
+ * Caller must hold the rules CS.
  * 
- * Clears all of the entries that are currently in the polling queue.
+ * Returns: Node, or NULL if out of memory
  */
-static void q_clear(void) {
-    g_q_head = g_q_tail = g_q_count = 0;
+static ComboNode* combo_alloc(void) {
+    if(!g_combo_free) {
+        ComboNode* chunk = (ComboNode*)malloc(COMBO_POOL_CHUNK * sizeof(ComboNode));
+        if(!chunk) return NULL;
+        for(int i = 0; i < COMBO_POOL_CHUNK; ++i) {
+            chunk[i].next_hash = g_combo_free;
+            g_combo_free = &chunk[i];
+        }
+    }
+    ComboNode* node = g_combo_free;
+    g_combo_free = node->next_hash;
+    return node;
 }
 
-
 /*
- * combo_add - Add combo to list
+ * combo_add - Add combo to the index
  * 
  * @mods: Array of modifier key codes
  * @mod_count: Number of modifiers in the array
  * @key: Primary key code of the combo
  * 
- * Create and populate a new ComboNode, then add it to the linked list of combos. 
- * Caller must hold CS.
+ * Adds the combo to both the (key, mods) hash and the per-key candidate 
+ * list. Adding a combo that already exists succeeds without a duplicate.
+ * The order of modifiers does not matter. Caller must hold the rules CS.
  * 
- * Returns: 1 on success, 0 if node is invalid
+ * Returns: 1 on success, 0 if out of memory
  */
 static int combo_add(const BYTE* mods, int mod_count, BYTE key) { 
-    ComboNode* node = (ComboNode*)malloc(sizeof(ComboNode));
+    KeySet set = combo_modset(mods, mod_count);
+    ComboNode** link = combo_find(&set, key);
+    if(*link) return 1;
+    ComboNode* node = combo_alloc();
     if(!node) return 0;
-    node->mods = (BYTE*)malloc((size_t)mod_count);
-    if(!node->mods) { free(node); return 0; }
-    for(int i = 0; i < mod_count; ++i) node->mods[i] = mods[i];
-    node->mod_count = mod_count;
+    node->mods = set;
     node->key = key;
-    node->next = g_combo_head;
-    g_combo_head = node;
+    node->next_hash = NULL;
+    *link = node;
+    node->next_key = g_combo_by_key[key];
+    g_combo_by_key[key] = node;
+    g_combo_count++;
     return 1;
 }
 
 /*
- * combo_remove - Remove combo from list
+ * combo_remove - Remove combo from the index
  * 
  * @mods: Array of modifier key codes
  * @mod_count: Number of modifers in the array
  * @key: Primary key code of the combo
  * 
- * Remove combo entry from list if it matches the one provided exactly. 
- * Matches are unlinked from list and have thier memory freed. 
- * Caller must hold CS.
+ * Unlinks the combo with exactly this key and modifier set and returns its 
+ * node to the pool. Caller must hold the rules CS.
  * 
  * Returns: Number of combos removed
  */
 static int combo_remove(const BYTE* mods, int mod_count, BYTE key) {
-    ComboNode* prev = NULL;
-    ComboNode* cur = g_combo_head;
-    int removed = 0;
-    while(cur) {
-        int same = 0;
-        if(cur->key == key && cur->mod_count == mod_count) {
-            same = 1;
-            for(int i = 0; i < mod_count && same; ++i)
-                if(cur->mods[i] != mods[i]) same = 0;
-        }
-        if(same) {
-            ComboNode* next = cur->next;
-            if(prev) prev->next = next; else g_combo_head = next;
-            free(cur->mods);
-            free(cur);
-            removed++;
-            cur = next;
-            continue;
-        }
-        prev = cur;
-        cur = cur->next;
+    KeySet set = combo_modset(mods, mod_count);
+    ComboNode** link = combo_find(&set, key);
+    ComboNode* node = *link;
+    if(!node) return 0;
+    *link = node->next_hash;
+    for(ComboNode** k = &g_combo_by_key[key]; *k; k = &(*k)->next_key) {
+        if(*k == node) { *k = node->next_key; break; }
     }
-    return removed;
+    node->next_hash = g_combo_free;
+    g_combo_free = node;
+    g_combo_count--;
+    return 1;
 }
 
 /*
- * combo_clear - Clear all combos from list
+ * combo_clear - Clear all combos
  * 
- * Frees every node's modifier array, followed by the node itself. After all 
- * nodes are freed, the list head is set to NULL. Caller must hold CS.
+ * Returns every node to the pool and empties both indexes. 
+ * Caller must hold the rules CS.
  * 
  * Returns: nothing
  */
 static void combo_clear(void) {
-    ComboNode* cur = g_combo_head;
-    while(cur) {
-        ComboNode* n = cur->next;
-        free(cur->mods);
-        free(cur);
-        cur = n;
+    for(int vk = 0; vk < 256; ++vk) {
+        ComboNode* cur = g_combo_by_key[vk];
+        while(cur) {
+            ComboNode* n = cur->next_key;
+            cur->next_hash = g_combo_free;
+            g_combo_free = cur;
+            cur = n;
+        }
     }
-    g_combo_head = NULL;
+    memset(g_combo_by_key, 0, sizeof(g_combo_by_key));
+    memset(g_combo_hash, 0, sizeof(g_combo_hash));
+    g_combo_count = 0;
 }
 
 /*
- * mods_down_match - Check if specified modifiers are pressed
+ * keys_down_update - Track a key in the down-key set
  * 
- * @mods: Array of modifier key codes to check
- * @mod_count: Number of modifiers in the array
+ * @vk: Virtual key code of the event
+ * @pressed: 1 if pressed, 0 if released
  * 
- * Uses GetAsyncKeyState to test each modifer in the array. If any modifier is 
- * not currently down, returns 0.
+ * Maintained from the events the hook sees. Left and right modifier keys 
+ * also drive their generic code (VK_SHIFT, VK_CONTROL, VK_MENU), which is 
+ * down while either side is, matching how combos name modifiers.
+ */
+static void keys_down_update(BYTE vk, int pressed) {
+    uint64_t bit = 1ULL << (vk & 63);
+    if(pressed) __atomic_fetch_or(&g_keys_down.w[vk >> 6], bit, __ATOMIC_RELAXED);
+    else __atomic_fetch_and(&g_keys_down.w[vk >> 6], ~bit, __ATOMIC_RELAXED);
+
+    BYTE left, right, generic;
+    switch(vk) {
+        case VK_LSHIFT: case VK_RSHIFT: left = VK_LSHIFT; right = VK_RSHIFT; generic = VK_SHIFT; break;
+        case VK_LCONTROL: case VK_RCONTROL: left = VK_LCONTROL; right = VK_RCONTROL; generic = VK_CONTROL; break;
+        case VK_LMENU: case VK_RMENU: left = VK_LMENU; right = VK_RMENU; generic = VK_MENU; break;
+        default: return;
+    }
+    uint64_t w = __atomic_load_n(&g_keys_down.w[left >> 6], __ATOMIC_RELAXED);
+    int any = ((w >> (left & 63)) & 1) || ((w >> (right & 63)) & 1);
+    bit = 1ULL << (generic & 63);
+    if(any) __atomic_fetch_or(&g_keys_down.w[generic >> 6], bit, __ATOMIC_RELAXED);
+    else __atomic_fetch_and(&g_keys_down.w[generic >> 6], ~bit, __ATOMIC_RELAXED);
+}
+
+/*
+ * keys_down_seed - Initialize the down-key set from the backend
  * 
- * Returns: 1 if all modifiers are pressed, 0 otherwise
+ * Keys already held when the listener starts would otherwise be missed. 
+ * Called once per listener_start, off the hook's hot path.
  */
-static int mods_down_match(const BYTE* mods, int mod_count) {
-    for(int i = 0; i < mod_count; ++i) {
-        SHORT s = GetAsyncKeyState((int)mods[i]);
-        if((s & 0x8000) == 0) return 0;
+static void keys_down_seed(void) {
+    KeySet set = {{0}};
+    for(int vk = 1; vk < 256; ++vk) {
+        if(g_backend->key_state(vk)) set.w[vk >> 6] |= 1ULL << (vk & 63);
     }
-    return 1;
+    for(int i = 0; i < 4; ++i) __atomic_store_n(&g_keys_down.w[i], set.w[i], __ATOMIC_RELAXED);
 }
 
-// check if any combo matches
 /*
- * combo_matches_event - Check if a kehy event matches registered combo
+ * combo_matches_event - Check if a key event matches registered combo
  * 
+ * @rs: Rule snapshot held by the caller
  * @vk: Virtual key code of event to test
  * 
- * Searches combo linked list to check if any combo node matches the given key.
- * A Match occurs if: 
- * - The node's primary key equals vk, AND
- * - The node has no modifiers OR all required modifiers are currently pressed.
+ * Walks only the combos whose primary key is vk. A combo matches when all 
+ * of its modifiers are in the listener's down-key set, which takes four 
+ * word compares and no system calls.
  * 
  * Returns: 1 if a match is found, 0 otherwise
  */
-static int combo_matches_event(BYTE vk) {
-    ComboNode* cur = g_combo_head;
-    while(cur) {
-        if(cur->key == vk) {
-            if(cur->mod_count == 0) return 1;
-            if(mods_down_match(cur->mods, cur->mod_count)) return 1;
-        }
-        cur = cur->next;
+static int combo_matches_event(const RuleSet* rs, BYTE vk) {
+    KeySet down;
+    for(int i = 0; i < 4; ++i) down.w[i] = __atomic_load_n(&g_keys_down.w[i], __ATOMIC_RELAXED);
+    for(int c = rs->combo_first[vk]; c < rs->combo_first[vk + 1]; ++c) {
+        const KeySet* m = &rs->combos[c];
+        if(!(m->w[0] & ~down.w[0]) && !(m->w[1] & ~down.w[1]) &&
+           !(m->w[2] & ~down.w[2]) && !(m->w[3] & ~down.w[3])) return 1;
     }
     return 0;
 }
 
 /*
- * lowlevel_proc - Low level keyboard hook proc
+ * rules_read_lock - Enter a rule snapshot read section
  * 
- * @nCode: Hook code
- * @wParam: Keyboard event identifier
- * @lParam: Pointer to a KBDLLHOOKSTRUCT
+ * @rs: Receives the current snapshot, valid until rules_read_unlock
  * 
- * Registered with SetWindowsHookEx(WH_KEYBOARD_LL), and is invoked by the 
- * system on every keyboard event (press/release). Populates an 
- * Event struct and dispatches it to either the callback or the internal queue.
+ * Wait-free, two atomic adds on a counter and no lock. Read sections must 
+ * stay short and must not call back into the library.
  * 
- * Returns: 1 if event is blocked, passes input and calls CallNextHookEx otherwise
+ * Returns: Epoch slot to pass to rules_read_unlock
  */
-static LRESULT CALLBACK lowlevel_proc(int nCode, WPARAM wParam, LPARAM lParam) {
-    if(nCode < 0) return CallNextHookEx(g_hook, nCode, wParam, lParam); /* Negative hook code */
+static int rules_read_lock(const RuleSet** rs) {
+    int slot = __atomic_load_n(&g_rules_epoch, __ATOMIC_RELAXED) & 1;
+    /* Counted before the pointer load, so a writer that swapped after it waits for us */
+    __atomic_fetch_add(&g_rules_readers[slot], 1, __ATOMIC_SEQ_CST);
+    *rs = __atomic_load_n(&g_rules, __ATOMIC_SEQ_CST);
+    return slot;
+}
 
-    /* Retrieve KBDLLHOOKSTRUCT */
-    KBDLLHOOKSTRUCT* k = (KBDLLHOOKSTRUCT*)lParam;
-    if(!k) return CallNextHookEx(g_hook, nCode, wParam, lParam);
+/*
+ * rules_read_unlock - Leave a rule snapshot read section
+ * 
+ * @slot: Value returned by rules_read_lock
+ */
+static void rules_read_unlock(int slot) {
+    __atomic_fetch_sub(&g_rules_readers[slot], 1, __ATOMIC_RELEASE);
+}
 
-    int pressed = (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN) ? 1 : 0;
-    BYTE vk = (BYTE)k->vkCode;
-    int injected = ((k->flags & LLKHF_INJECTED) != 0) ? 1 : 0;
-    unsigned long long now = GetTickCount64();
+/*
+ * rules_synchronize - Wait until no reader can still see a retired snapshot
+ * 
+ * Flips the epoch and drains the old slot, then does the same for the 
+ * other one. Readers that arrive meanwhile count in the new slot, so the 
+ * wait is bounded by the read sections already in progress. 
+ * Caller must hold the rules CS.
+ */
+static void rules_synchronize(void) {
+    for(int pass = 0; pass < 2; ++pass) {
+        int old = __atomic_fetch_xor(&g_rules_epoch, 1, __ATOMIC_SEQ_CST) & 1;
+        while(__atomic_load_n(&g_rules_readers[old], __ATOMIC_ACQUIRE) != 0) SwitchToThread();
+    }
+}
 
-    /* Populate Event struct */
-    Event ev;
-    ev.vk = vk;
-    ev.scan = (int)k->scanCode;
-    ev.pressed = pressed;
-    ev.injected = injected;
-    ev.time = (unsigned long)(now - g_start_time);
-    ev.delta = (unsigned long)(now - g_last_event_time);
-    g_last_event_time = now;
-    if(pressed) {
-        g_key_down_time[vk] = now;
-        ev.held = 0;
-    } else {
-        if(g_key_down_time[vk] != 0) {
-            ev.held = (unsigned long)(now - g_key_down_time[vk]);
-        } else {
-            ev.held = 0;
-        }
-        g_key_down_time[vk] = 0;
+/*
+ * hotkey_modbit - Modifier bit of a key
+ * 
+ * Returns: L_MOD_* bit, 0 if vk is not a modifier
+ */
+static int hotkey_modbit(BYTE vk) {
+    switch(vk) {
+        case VK_SHIFT: case VK_LSHIFT: case VK_RSHIFT: return L_MOD_SHIFT;
+        case VK_CONTROL: case VK_LCONTROL: case VK_RCONTROL: return L_MOD_CTRL;
+        case VK_MENU: case VK_LMENU: case VK_RMENU: return L_MOD_ALT;
+        case VK_LWIN: case VK_RWIN: return L_MOD_WIN;
+        default: return 0;
     }
+}
 
-    /* Retrieve modifier bitmask */
+/*
+ * hotkey_variants - Key codes a hotkey trigger stands for
+ * 
+ * The hook reports modifiers by side, so a generic modifier trigger is 
+ * indexed under both sides as well.
+ * 
+ * Returns: Number of codes written to out (at most 3)
+ */
+static int hotkey_variants(BYTE vk, BYTE* out) {
     switch(vk) {
-        case VK_LSHIFT: case VK_RSHIFT:
-            if(pressed) g_mod_state |= L_MOD_SHIFT;
-            else g_mod_state &= ~L_MOD_SHIFT;
-            break;
-        case VK_LCONTROL: case VK_RCONTROL:
-            if(pressed) g_mod_state |= L_MOD_CTRL;
-            else g_mod_state &= ~L_MOD_CTRL;
-            break;
-        case VK_LMENU: case VK_RMENU:
-            if(pressed) g_mod_state |= L_MOD_ALT;
-            else g_mod_state &= ~L_MOD_ALT;
-            break;
-        case VK_LWIN: case VK_RWIN:
-            if(pressed) g_mod_state |= L_MOD_WIN;
-            else g_mod_state &= ~L_MOD_WIN;
-            break;
+        case VK_SHIFT: out[0] = VK_SHIFT; out[1] = VK_LSHIFT; out[2] = VK_RSHIFT; return 3;
+        case VK_CONTROL: out[0] = VK_CONTROL; out[1] = VK_LCONTROL; out[2] = VK_RCONTROL; return 3;
+        case VK_MENU: out[0] = VK_MENU; out[1] = VK_LMENU; out[2] = VK_RMENU; return 3;
+        case VK_LWIN: case VK_RWIN: out[0] = VK_LWIN; out[1] = VK_RWIN; return 2;
+        default: out[0] = vk; return 1;
     }
-    ev.modifiers = g_mod_state;
+}
 
-    int should_block = 0;
+static unsigned hotkey_hash(unsigned key) {
+    return (key * 0x9E3779B1U) >> 7;
+}
 
-    EnterCriticalSection(&g_cs);
+static int hotkey_cmp(const void* a, const void* b) {
+    const Hotkey* x = (const Hotkey*)a;
+    const Hotkey* y = (const Hotkey*)b;
+    unsigned kx = HOTKEY_SLOT_KEY(x->key, x->mods), ky = HOTKEY_SLOT_KEY(y->key, y->mods);
+    if(kx != ky) return kx < ky ? -1 : 1;
+    return x->id < y->id ? -1 : (x->id > y->id);
+}
 
-    /* Blocking logic */
-    if(g_block_all) {
-        should_block = 1;
-    } else {
-        if(g_block_sim && injected) should_block = 1;
-        if(g_block_phys && !injected) should_block = 1;
-        if(!should_block && g_blocked_keys[vk]) should_block = 1;
-        if(!should_block) {
-            for(int gi = 0; gi < GROUP_COUNT; ++gi) {
-                if(g_blocked_groups[gi]) {
-                    if(vk_in_group(vk, (GroupId)gi)) { should_block = 1; break; }
-                }
-            }
+/*
+ * hotkeys_compile - Build the hotkey index of a snapshot
+ * 
+ * @rs: Snapshot being built
+ * 
+ * Groups the hotkeys by (trigger, modifier mask) and hashes each group 
+ * into an open-addressed table at most half full, so the hook finds the 
+ * candidates for an event with one probe on average. Caller must hold the 
+ * rules CS.
+ * 
+ * Returns: 0 on success, 1 if out of memory
+ */
+static int hotkeys_compile(RuleSet* rs) {
+    rs->hk_slots = NULL;
+    rs->hk_mask = 0;
+    rs->hotkeys = NULL;
+    if(g_hotkey_count == 0) return 0;
+
+    BYTE variants[3];
+    int total = 0;
+    for(int i = 0; i < g_hotkey_count; ++i) total += hotkey_variants(g_hotkeys[i].key, variants);
+    size_t slots = 8;
+    while(slots < (size_t)total * 2) slots <<= 1;
+    HotkeySlot* mem = (HotkeySlot*)calloc(1, slots * sizeof(HotkeySlot) + (size_t)total * sizeof(Hotkey));
+    if(!mem) return 1;
+    Hotkey* hk = (Hotkey*)(mem + slots);
+
+    int n = 0;
+    for(int i = 0; i < g_hotkey_count; ++i) {
+        int nv = hotkey_variants(g_hotkeys[i].key, variants);
+        for(int v = 0; v < nv; ++v) {
+            hk[n] = g_hotkeys[i];
+            hk[n++].key = variants[v];
         }
-        if(!should_block && combo_matches_event(vk)) should_block = 1;
     }
-
-    /* Block input */
-    if(should_block) {
-        LeaveCriticalSection(&g_cs);
-        return 1;
+    qsort(hk, (size_t)n, sizeof(Hotkey), hotkey_cmp);
+
+    unsigned mask = (unsigned)slots - 1;
+    HotkeySlot* cur = NULL;
+    for(int i = 0; i < n; ++i) {
+        unsigned key = HOTKEY_SLOT_KEY(hk[i].key, hk[i].mods);
+        if(cur && cur->key == key) {
+            cur->count++;
+            continue;
+        }
+        unsigned at = hotkey_hash(key) & mask;
+        while(mem[at].key) at = (at + 1) & mask;
+        cur = &mem[at];
+        cur->key = key;
+        cur->first = i;
+        cur->count = 1;
+        rs->table[hk[i].key] |= BLOCK_HOTKEY;
     }
+    rs->hk_slots = mem;
+    rs->hk_mask = mask;
+    rs->hotkeys = hk;
+    return 0;
+}
 
-    if(g_poll_mode) {
-        q_push(&ev); /* Push event into queue */
-        LeaveCriticalSection(&g_cs);
-    } else {
-        void (*cb)(Event*) = g_callback;
-        LeaveCriticalSection(&g_cs);
-        if(cb) {
-            cb(&ev);
-        } else {
-            EnterCriticalSection(&g_cs);
-            q_push(&ev);
-            LeaveCriticalSection(&g_cs);
-        }
+/*
+ * hotkey_generic - Side-independent code of a modifier key
+ * 
+ * Returns: VK_SHIFT, VK_CONTROL, VK_MENU or VK_LWIN for a modifier, vk 
+ * otherwise
+ */
+static BYTE hotkey_generic(BYTE vk) {
+    switch(vk) {
+        case VK_LSHIFT: case VK_RSHIFT: return VK_SHIFT;
+        case VK_LCONTROL: case VK_RCONTROL: return VK_CONTROL;
+        case VK_LMENU: case VK_RMENU: return VK_MENU;
+        case VK_RWIN: return VK_LWIN;
+        default: return vk;
     }
-    return CallNextHookEx(g_hook, nCode, wParam, lParam);
 }
 
 /*
- * listener_thread_proc - Install and run keyboard hook 
+ * sequences_compile - Build the sequence automaton of a snapshot
  * 
- * \@param: Unused
+ * @rs: Snapshot being built
  * 
- * Sets up low-level keyboard hook using SetWindowsHookExA with WH_KEYBOARD_LL, 
- * then enters a Windows message loop to keep hook alive.
+ * Marks every key a step is made of, both sides for modifiers, so the 
+ * hook only steps the automaton for those. Caller must hold the rules CS.
  * 
- * Returns: 0 on normal termination, 1 if hook could not be installed
+ * Returns: 0 on success, 1 if out of memory
  */
-static DWORD WINAPI listener_thread_proc(LPVOID param) {
-    (void)param;
-    HINSTANCE hinst = GetModuleHandle(NULL);
-    g_hook = SetWindowsHookExA(WH_KEYBOARD_LL, lowlevel_proc, hinst, 0);
-    if(!g_hook) {
-        SetLastError(ERROR_INVALID_FUNCTION);
-        if(g_init_event) SetEvent(g_init_event);
-        return 1;
-    }
-    
-    if(g_init_event) SetEvent(g_init_event);
-    
-    MSG msg;
-    while(GetMessageA(&msg, NULL, 0, 0) > 0) {
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
+static int sequences_compile(RuleSet* rs) {
+    rs->seq = NULL;
+    if(g_seq_count == 0) return 0;
+    rs->seq = seqauto_build(g_seqs, g_seq_count);
+    if(!rs->seq) return 1;
+    BYTE variants[3];
+    for(int i = 0; i < g_seq_count; ++i) {
+        for(int k = 0; k < g_seqs[i].out.count; ++k) {
+            int nv = hotkey_variants((BYTE)(g_seqs[i].steps[k] & 0xFF), variants);
+            for(int v = 0; v < nv; ++v) rs->table[variants[v]] |= BLOCK_SEQUENCE;
+        }
     }
+    return 0;
+}
 
-    if(g_hook) {
-        UnhookWindowsHookEx(g_hook);
-        g_hook = NULL;
+/*
+ * remaps_compile - Copy the remaps into a snapshot
+ * 
+ * @rs: Snapshot being built
+ * 
+ * Caller must hold the rules CS.
+ * 
+ * Returns: 0 on success, 1 if out of memory
+ */
+static int remaps_compile(RuleSet* rs) {
+    memset(rs->remap_of, 0, sizeof(rs->remap_of));
+    rs->remaps = NULL;
+    if(g_remap_count == 0) return 0;
+    rs->remaps = (Remap*)malloc((size_t)g_remap_count * sizeof(Remap));
+    if(!rs->remaps) return 1;
+    int n = 0;
+    for(int vk = 1; vk < 256; ++vk) {
+        if(!g_remaps[vk].count) continue;
+        rs->remaps[n++] = g_remaps[vk];
+        rs->remap_of[vk] = (unsigned char)n;
+        rs->table[vk] |= BLOCK_REMAP;
     }
     return 0;
 }
 
-
 /*
- * listener_start - Enable listener functions
+ * scoped_compile - Copy the foreground scoped blocks into a snapshot
  * 
- * Triggers the init event and begins the listener thread.
+ * @rs: Snapshot being built
  * 
- * Returns: 0 if successful, 1 otherwise
+ * They stay out of the table, which does not depend on the foreground; 
+ * the hook folds them in through scope_decision. Caller must hold the 
+ * rules CS.
+ * 
+ * Returns: 0 on success, 1 if out of memory
  */
-int INPUTLIB_CALL listener_start(void) {
-    EnterCriticalSection(&g_cs);
+static int scoped_compile(RuleSet* rs) {
+    rs->scoped = NULL;
+    rs->scoped_count = g_scoped_count;
+    if(g_scoped_count == 0) return 0;
+    rs->scoped = (ScopedRule*)malloc((size_t)g_scoped_count * sizeof(ScopedRule));
+    if(!rs->scoped) return 1;
+    memcpy(rs->scoped, g_scoped, (size_t)g_scoped_count * sizeof(ScopedRule));
+    return 0;
+}
 
-    if(g_running) {
-        LeaveCriticalSection(&g_cs);
-        SetLastError(ERROR_ALREADY_EXISTS);
+/*
+ * rules_publish - Compile the working rules into a new snapshot
+ * 
+ * Folds the global toggles, blocked keys, blocked groups, combo keys, 
+ * hotkey triggers, sequence steps and remaps into one word per vk, lays 
+ * out combos contiguously by primary key and builds the hotkey index and 
+ * sequence automaton, so the hook makes a single table load per event 
+ * however many rules are configured. Foreground scoped blocks are copied 
+ * as they are. Swaps the snapshot in and frees the previous one once no 
+ * reader holds it. Deferred while a listener_blockbegin batch is open. 
+ * Caller must hold the rules CS.
+ * 
+ * Returns: 0 on success, 1 if out of memory (the previous snapshot stays)
+ */
+static int rules_publish(void) {
+    if(g_rules_batch > 0) return 0;
+
+    RuleSet* rs = (RuleSet*)malloc(sizeof(RuleSet) + (size_t)g_combo_count * sizeof(KeySet));
+    if(!rs) return 1;
+    memcpy(rs->keys, g_blocked_keys, sizeof(rs->keys));
+    memcpy(rs->groups, g_blocked_groups, sizeof(rs->groups));
+    rs->block_all = g_block_all;
+    rs->block_sim = g_block_sim;
+    rs->block_phys = g_block_phys;
+    memcpy(rs->debounce_ms, g_debounce_ms, sizeof(rs->debounce_ms));
+
+    int c = 0;
+    for(int vk = 0; vk < 256; ++vk) {
+        unsigned short d = 0;
+        if(g_block_all) d |= BLOCK_INJECTED | BLOCK_PHYSICAL | BLOCK_BY_ALL;
+        if(g_blocked_keys[vk]) d |= BLOCK_INJECTED | BLOCK_PHYSICAL | BLOCK_BY_KEY;
+        if(g_block_sim) d |= BLOCK_INJECTED;
+        if(g_block_phys) d |= BLOCK_PHYSICAL;
+        for(int gi = 0; gi < GROUP_COUNT; ++gi) {
+            if(g_blocked_groups[gi] && vk_in_group((BYTE)vk, (GroupId)gi)) d |= BLOCK_INJECTED | BLOCK_PHYSICAL | BLOCK_BY_GROUP;
+        }
+        rs->combo_first[vk] = c;
+        for(ComboNode* cur = g_combo_by_key[vk]; cur; cur = cur->next_key) rs->combos[c++] = cur->mods;
+        if(c > rs->combo_first[vk]) d |= BLOCK_COMBO;
+        rs->table[vk] = d;
+    }
+    rs->combo_first[256] = c;
+    if(hotkeys_compile(rs)) {
+        free(rs);
         return 1;
     }
-
-    /* Prepare init event for sync */
-    g_init_event = CreateEventA(NULL, TRUE, FALSE, NULL);
-    if(!g_init_event) {
-        LeaveCriticalSection(&g_cs);
-        SetLastError(ERROR_OUTOFMEMORY);
+    if(sequences_compile(rs)) {
+        free(rs->hk_slots);
+        free(rs);
         return 1;
     }
-
-    /* Create thread */
-    g_thread = CreateThread(NULL, 0, listener_thread_proc, NULL, 0, &g_thread_id);
-    if(!g_thread) {
-        CloseHandle(g_init_event);
-        g_init_event = NULL;
-        LeaveCriticalSection(&g_cs);
-        SetLastError(ERROR_OUTOFMEMORY);
+    if(remaps_compile(rs)) {
+        free(rs->seq);
+        free(rs->hk_slots);
+        free(rs);
         return 1;
     }
-    LeaveCriticalSection(&g_cs);
-
-    /* Wait up to 3 seconds for hook install */
-    DWORD wait = WaitForSingleObject(g_init_event, 3000);
-    CloseHandle(g_init_event);
-    g_init_event = NULL;
-
-    if(wait != WAIT_OBJECT_0) {
-        /* Thread didn't initalize properly in time */
-        PostThreadMessageA(g_thread_id, WM_QUIT, 0, 0);
-        WaitForSingleObject(g_thread, 2000);
-        CloseHandle(g_thread);
-        g_thread = NULL;
-        SetLastError(ERROR_TIMEOUT);
+    if(scoped_compile(rs)) {
+        free(rs->remaps);
+        free(rs->seq);
+        free(rs->hk_slots);
+        free(rs);
         return 1;
     }
+    rs->gen = ++g_rules_gen;
+
+    RuleSet* old = __atomic_exchange_n(&g_rules, rs, __ATOMIC_SEQ_CST);
+    rules_synchronize();
+    if(old != &g_rules_empty) {
+        free(old->hk_slots);
+        free(old->seq);
+        free(old->remaps);
+        free(old->scoped);
+        free(old);
+    }
+    return 0;
+}
 
-    EnterCriticalSection(&g_cs);
-    g_running = 1;
-    LeaveCriticalSection(&g_cs);
+/*
+ * rules_changed - Publish after a change to the working rules
+ * 
+ * Common tail of the rule setters. Caller holds the rules CS, which this 
+ * releases.
+ * 
+ * Returns: 0 on success, 1 if the snapshot could not be built
+ */
+static int rules_changed(void) {
+    int err = rules_publish();
+    LeaveCriticalSection(&g_rules_cs);
+    if(err) { SetLastError(ERROR_OUTOFMEMORY); return 1; }
     return 0;
 }
 
 /*
- * listener_stop - Disable listener functions
+ * event_from_ex - Narrow an EventEx to the original Event layout
  * 
- * Kills listener thread.
+ * @ex: Extended event
+ * @out: Event to fill in
  * 
- * Returns: 0 if successful, 1 if already stopped
+ * Times are truncated to milliseconds, as the Event fields always were.
  */
-int INPUTLIB_CALL listener_stop(void) {
-    EnterCriticalSection(&g_cs);
+static void event_from_ex(const EventEx* ex, Event* out) {
+    out->vk = ex->vk;
+    out->scan = ex->scan;
+    out->pressed = ex->pressed;
+    out->injected = ex->injected;
+    out->modifiers = ex->modifiers;
+    out->time = (unsigned long)(ex->time_ns / 1000000ULL);
+    out->delta = (unsigned long)(ex->delta_ns / 1000000ULL);
+    out->held = (unsigned long)(ex->held_ns / 1000000ULL);
+}
 
-    if(!g_running) {
-        LeaveCriticalSection(&g_cs);
-        SetLastError(ERROR_INVALID_OPERATION);
-        return 1;
-    }
-    g_running = 0;
+/*
+ * stats_block - Get the calling thread's counter block
+ * 
+ * Returns: Block claimed on the thread's first use, or the shared one
+ */
+static StatBlock* stats_block(void) {
+    StatBlock* b = t_stats;
+    if(b) return b;
+    int i = __atomic_fetch_add(&g_stats_claimed, 1, __ATOMIC_RELAXED);
+    b = &g_stats[i < STAT_SLOTS - 1 ? i : STAT_SLOTS - 1];
+    t_stats = b;
+    return b;
+}
 
-    LeaveCriticalSection(&g_cs);
+/* Add to a counter of a block, only the shared block needs an atomic add */
+static void stat_add(const StatBlock* b, unsigned long long* c, unsigned long long v) {
+    if(b->shared) __atomic_fetch_add(c, v, __ATOMIC_RELAXED);
+    else __atomic_store_n(c, __atomic_load_n(c, __ATOMIC_RELAXED) + v, __ATOMIC_RELAXED);
+}
 
-    if(g_thread) {
-        PostThreadMessageA(g_thread_id, WM_QUIT, 0, 0);
-        WaitForSingleObject(g_thread, 3000);
-        CloseHandle(g_thread);
-        g_thread = NULL;
-        g_thread_id = 0;
-    }
-    return 0;
+static void stat_max(unsigned long long* c, unsigned long long v) {
+    unsigned long long m = __atomic_load_n(c, __ATOMIC_RELAXED);
+    while(v > m && !__atomic_compare_exchange_n(c, &m, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
 }
 
 /*
- * listener_flush - Clears all toggles and blocks
+ * stats_bucket - Log-linear histogram bucket of a duration
  * 
- * Flushes everything, including the callback pointer, queue, blocked key lists, 
- * and global block toggles.
+ * Four buckets per power of two, see LISTENER_HIST_BUCKETS.
  */
-int INPUTLIB_CALL listener_flush(void) {
-    EnterCriticalSection(&g_cs);
+static int stats_bucket(unsigned long long ns) {
+    if(ns < 4) return (int)ns;
+    int e = 63 - __builtin_clzll(ns);
+    int b = (e - 1) * 4 + (int)((ns >> (e - 2)) & 3);
+    return b < LISTENER_HIST_BUCKETS ? b : LISTENER_HIST_BUCKETS - 1;
+}
+
+/*
+ * stats_epoch - Drop a block's maxima if a reset happened since they were set
+ */
+static void stats_epoch(StatBlock* b) {
+    unsigned e = __atomic_load_n(&g_stats_epoch, __ATOMIC_RELAXED);
+    if(__atomic_load_n(&b->epoch, __ATOMIC_RELAXED) == e) return;
+    __atomic_store_n(&b->hook_max_ns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->callback_max_ns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->remap_max_ns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->epoch, e, __ATOMIC_RELEASE);
+}
 
-    g_callback = NULL;
-    q_clear();
+/* Count one hook invocation that took ns */
+static void stats_hook(StatBlock* b, unsigned long long ns) {
+    stats_epoch(b);
+    stat_add(b, &b->events, 1);
+    stat_add(b, &b->hook_ns, ns);
+    stat_add(b, &b->hook_hist[stats_bucket(ns)], 1);
+    stat_max(&b->hook_max_ns, ns);
+}
 
-    memset(g_blocked_keys, 0, sizeof(g_blocked_keys));
-    memset(g_blocked_groups, 0, sizeof(g_blocked_groups));
-    combo_clear();
+/* Count one callback invocation that took ns */
+static void stats_callback(StatBlock* b, unsigned long long ns) {
+    stats_epoch(b);
+    stat_add(b, &b->callbacks, 1);
+    stat_add(b, &b->callback_ns, ns);
+    stat_add(b, &b->callback_hist[stats_bucket(ns)], 1);
+    stat_max(&b->callback_max_ns, ns);
+}
 
-    g_block_all = 0;
-    g_block_sim = 0;
-    g_block_phys = 0;
+/* Count one remap whose replacement reached the hook ns after the original */
+static void stats_remap(StatBlock* b, unsigned long long ns) {
+    stats_epoch(b);
+    stat_add(b, &b->remaps, 1);
+    stat_add(b, &b->remap_ns, ns);
+    stat_add(b, &b->remap_hist[stats_bucket(ns)], 1);
+    stat_max(&b->remap_max_ns, ns);
+}
 
-    LeaveCriticalSection(&g_cs);
-    return 0;
+/* Count one lock acquisition on the delivery path that took ns */
+static void stats_lockwait(unsigned long long ns) {
+    StatBlock* b = stats_block();
+    stat_add(b, &b->lock_waits, 1);
+    stat_add(b, &b->lock_wait_ns, ns);
 }
 
 /*
- * listener_cbsub - Subscribe to callbacks
- * 
- * @cb: Callback function to receive populated Event structs
+ * event_deliver - Invoke whichever callback is subscribed
  * 
- * Subscribes to keyboard event callbacks with a function.
+ * Mouse events only reach EventEx callbacks.
  * 
- * Returns: 0 if successful, 1 if polling is enabled
+ * @ex: Event to deliver
+ * @cb: Event callback, or NULL
+ * @cb_ex: EventEx callback, or NULL
  */
-int INPUTLIB_CALL listener_cbsub(void (*cb)(Event* ev)) {
-    if(!cb) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-
-    EnterCriticalSection(&g_cs);
-
-    if(g_poll_mode) {
-        LeaveCriticalSection(&g_cs);
-        SetLastError(ERROR_INVALID_OPERATION); /* Can't use callback while polling */
-        return 1;
+static void event_deliver(EventEx* ex, void (*cb)(Event*), void (*cb_ex)(EventEx*)) {
+    unsigned long long t0 = timing_now_ns();
+    if(cb_ex) {
+        cb_ex(ex);
+    } else if(cb && ex->type == EVENT_KEY) {
+        Event ev;
+        event_from_ex(ex, &ev);
+        cb(&ev);
+    } else {
+        return;
     }
-
-    g_callback = cb;
-    LeaveCriticalSection(&g_cs);
-    return 0;
+    stats_callback(stats_block(), timing_now_ns() - t0);
 }
 
 /*
- * listener_ucbsub - Unsubscribe from callbacks
+ * move_stash - Park a mouse move as the latest one for a consumer
  * 
- * Unsubscribes from callback events.
+ * @ms: Slot of the consumer the move is routed to
+ * @ev: Move event, replaces whatever move was waiting
+ */
+static void move_stash(MoveSlot* ms, const EventEx* ev) {
+    unsigned seq = __atomic_load_n(&ms->seq, __ATOMIC_RELAXED);
+    if((seq & 1) || !__atomic_compare_exchange_n(&ms->seq, &seq, seq + 1, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        /* Another hook thread holds the slot, only the contended path is timed */
+        unsigned long long t0 = timing_now_ns();
+        do {
+            seq = __atomic_load_n(&ms->seq, __ATOMIC_RELAXED);
+        } while((seq & 1) || !__atomic_compare_exchange_n(&ms->seq, &seq, seq + 1, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+        stats_lockwait(timing_now_ns() - t0);
+    }
+    unsigned long long pos = ((unsigned long long)(unsigned)ev->x << 32) | (unsigned)ev->y;
+    __atomic_store_n(&ms->pos, pos, __ATOMIC_RELAXED);
+    __atomic_store_n(&ms->clock_ns, ev->clock_ns, __ATOMIC_RELAXED);
+    __atomic_store_n(&ms->os_time, ev->os_time, __ATOMIC_RELAXED);
+    __atomic_store_n(&ms->injected, ev->injected, __ATOMIC_RELAXED);
+    __atomic_store_n(&ms->self, ev->self, __ATOMIC_RELAXED);
+    __atomic_store_n(&ms->modifiers, ev->modifiers, __ATOMIC_RELAXED);
+    __atomic_store_n(&ms->seq, seq + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&ms->pending, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * move_due - Check if a rate-limited move may be delivered now
+ * 
+ * @mode: Current move mode
+ * @last: Time of the consumer's last delivered move
+ * @now: Backend clock in nanoseconds
+ * 
+ * Returns: 1 if a move may go out, 0 if the rate limit holds it back
+ */
+static int move_due(int mode, unsigned long long last, unsigned long long now) {
+    if(mode <= 0) return 1;
+    return now - last >= 1000000000ULL / (unsigned)mode;
+}
+
+/*
+ * move_take - Take the waiting mouse move, if any
+ * 
+ * @ms: Consumer's slot
+ * @out: Receives the move
+ * 
+ * Under a rate limit the move is only handed out once the interval since 
+ * the last move delivered to this consumer has passed, so the final 
+ * resting position is never lost but the rate still holds. Only the 
+ * consumer that wins the move restarts the interval.
+ * 
+ * Returns: 1 if a move was taken, 0 otherwise
+ */
+static int move_take(MoveSlot* ms, EventEx* out) {
+    if(!__atomic_load_n(&ms->pending, __ATOMIC_ACQUIRE)) return 0;
+    int mode = __atomic_load_n(&g_move_mode, __ATOMIC_RELAXED);
+    unsigned long long now = 0;
+    if(mode > 0) {
+        now = g_backend->now_ns();
+        if(!move_due(mode, __atomic_load_n(&ms->last_ns, __ATOMIC_RELAXED), now)) return 0;
+    }
+    if(!__atomic_exchange_n(&ms->pending, 0, __ATOMIC_ACQ_REL)) return 0;
+    if(mode > 0) __atomic_store_n(&ms->last_ns, now, __ATOMIC_RELAXED);
+
+    unsigned seq;
+    unsigned long long pos;
+    for(;;) {
+        seq = __atomic_load_n(&ms->seq, __ATOMIC_ACQUIRE);
+        if(seq & 1) continue;
+        pos = __atomic_load_n(&ms->pos, __ATOMIC_RELAXED);
+        out->clock_ns = __atomic_load_n(&ms->clock_ns, __ATOMIC_RELAXED);
+        out->os_time = __atomic_load_n(&ms->os_time, __ATOMIC_RELAXED);
+        out->injected = __atomic_load_n(&ms->injected, __ATOMIC_RELAXED);
+        out->self = __atomic_load_n(&ms->self, __ATOMIC_RELAXED);
+        out->modifiers = __atomic_load_n(&ms->modifiers, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&ms->seq, __ATOMIC_RELAXED) == seq) break;
+    }
+    out->size = sizeof(EventEx);
+    out->version = EVENTEX_VERSION;
+    out->type = EVENT_MOUSE_MOVE;
+    out->vk = 0;
+    out->scan = 0;
+    out->pressed = 0;
+    out->time_ns = out->clock_ns - g_start_ns;
+    out->delta_ns = 0;
+    out->held_ns = 0;
+    out->x = (int)(unsigned)(pos >> 32);
+    out->y = (int)(unsigned)pos;
+    out->wheel = 0;
+    out->repeat = 0;
+    return 1;
+}
+
+/*
+ * dispatch_wake - Wake the dispatcher thread if it is parked
+ */
+static void dispatch_wake(void) {
+    /* Pairs with the fence in dispatch_thread_proc, one side sees the other */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&g_dispatch_idle, __ATOMIC_RELAXED)) {
+        unsigned long long t0 = timing_now_ns();
+        EnterCriticalSection(&g_dispatch_cs);
+        stats_lockwait(timing_now_ns() - t0);
+        WakeConditionVariable(&g_dispatch_cv);
+        LeaveCriticalSection(&g_dispatch_cs);
+    }
+}
+
+/*
+ * dispatch_post - Hand an event to the dispatcher thread
+ * 
+ * @ev: Event to deliver
+ * 
+ * Never blocks on the dispatcher. The dispatcher lock is only taken to 
+ * wake it when it has announced it is parking. Events beyond the in-flight 
+ * limit are dropped and counted.
+ */
+static void dispatch_post(const EventEx* ev) {
+    if(!eventq_push(&g_dispatch_q, ev)) return;
+    dispatch_wake();
+}
+
+/*
+ * dispatch_fire - Hand a hotkey or sequence match to the dispatcher thread
+ * 
+ * @f: Matched callback and id
+ * @ev: Event that triggered it
+ * 
+ * Never blocks. A match that finds the ring full is dropped and counted 
+ * with the dispatcher's drops. The caller wakes the dispatcher.
+ */
+static void dispatch_fire(const HotkeyFire* f, const EventEx* ev) {
+    unsigned tail = __atomic_load_n(&g_fire_tail, __ATOMIC_RELAXED);
+    if(tail - __atomic_load_n(&g_fire_head, __ATOMIC_ACQUIRE) >= FIRE_QUEUE_SIZE) {
+        __atomic_fetch_add(&g_fire_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    FireRecord* r = &g_fire_q[tail & (FIRE_QUEUE_SIZE - 1)];
+    r->fire = *f;
+    r->ev = *ev;
+    __atomic_store_n(&g_fire_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * dispatch_fires - Run the matches waiting for the dispatcher
+ * 
+ * Returns: Number of callbacks run
+ */
+static int dispatch_fires(void) {
+    unsigned head = g_fire_head;
+    unsigned tail = __atomic_load_n(&g_fire_tail, __ATOMIC_ACQUIRE);
+    for(unsigned i = head; i != tail; ++i) {
+        FireRecord r = g_fire_q[i & (FIRE_QUEUE_SIZE - 1)];
+        __atomic_store_n(&g_fire_head, i + 1, __ATOMIC_RELEASE);
+        unsigned long long t0 = timing_now_ns();
+        r.fire.cb(r.fire.id, &r.ev);
+        stats_callback(stats_block(), timing_now_ns() - t0);
+    }
+    return (int)(tail - head);
+}
+
+/*
+ * dispatch_thread_proc - Callback dispatcher thread
+ * 
+ * Drains the dispatch queue in batches and invokes the subscribed callback 
+ * in event order. Hotkey and sequence matches run ahead of queued events, 
+ * since they are handed over before their event. Parks on a condition 
+ * variable while both are empty, and delivers whatever is left before 
+ * exiting.
+ */
+static DWORD WINAPI dispatch_thread_proc(void* param) {
+    (void)param;
+    t_on_dispatcher = 1;
+    EventEx batch[32];
+    for(;;) {
+        int fired = dispatch_fires();
+        int n = eventq_popn(&g_dispatch_q, batch, 31);
+        n += move_take(&g_dispatch_move, &batch[n]);
+        if(n > 0) {
+            EnterCriticalSection(&g_cs);
+            void (*cb)(Event*) = g_callback;
+            void (*cb_ex)(EventEx*) = g_callback_ex;
+            LeaveCriticalSection(&g_cs);
+            for(int i = 0; i < n; ++i) event_deliver(&batch[i], cb, cb_ex);
+            continue;
+        }
+        if(fired) continue;
+
+        EnterCriticalSection(&g_dispatch_cs);
+        if(g_dispatch_stop) {
+            LeaveCriticalSection(&g_dispatch_cs);
+            break;
+        }
+        __atomic_store_n(&g_dispatch_idle, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        /* Timeout is only a safety net, posts wake the dispatcher directly. 
+           A move held back by the rate limit is retried shortly. */
+        DWORD wait = __atomic_load_n(&g_dispatch_move.pending, __ATOMIC_RELAXED) ? 1 : 100;
+        int empty = eventq_length(&g_dispatch_q) == 0 && 
+                    __atomic_load_n(&g_fire_tail, __ATOMIC_RELAXED) == g_fire_head;
+        if(empty) SleepConditionVariableCS(&g_dispatch_cv, &g_dispatch_cs, wait);
+        __atomic_store_n(&g_dispatch_idle, 0, __ATOMIC_RELAXED);
+        LeaveCriticalSection(&g_dispatch_cs);
+    }
+    return 0;
+}
+
+/*
+ * poll_pending - Check for anything a poll consumer could take now
+ * 
+ * @moves: 1 if the consumer takes coalesced moves, 0 for key-only ones
+ * 
+ * A move held back by a rate limit does not count until it is due, the 
+ * wait timer sets the signal then.
+ */
+static int poll_pending(int moves) {
+    if(eventq_length(&g_poll_q) > 0) return 1;
+    if(!moves || !__atomic_load_n(&g_poll_move.pending, __ATOMIC_ACQUIRE)) return 0;
+    return move_due(__atomic_load_n(&g_move_mode, __ATOMIC_RELAXED), __atomic_load_n(&g_poll_move.last_ns, __ATOMIC_RELAXED), g_backend->now_ns());
+}
+
+/*
+ * wait_notify - Wake poll consumers after the hook queued an event
+ * 
+ * Only the empty to non-empty transition touches the wait signal, so a 
+ * burst of events costs one wake-up.
+ */
+static void wait_notify(void) {
+    if(!__atomic_load_n(&g_wait_ready, __ATOMIC_ACQUIRE)) return;
+    /* Pairs with the fence in wait_drained, one side sees the other */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&g_wait_signaled, __ATOMIC_RELAXED)) return;
+    if(__atomic_exchange_n(&g_wait_signaled, 1, __ATOMIC_ACQ_REL)) return;
+    waitobj_signal(&g_wait);
+}
+
+/*
+ * wait_drained - Clear the wait signal after a poll found nothing
+ * 
+ * @moves: 1 if the consumer takes coalesced moves, 0 for key-only ones
+ * 
+ * Re-checks after clearing, so an event queued meanwhile sets it again. A 
+ * key-only consumer never takes the coalesced move, so a waiting one does 
+ * not keep the signal set for it; it is left for listener_cbpollex.
+ */
+static void wait_drained(int moves) {
+    if(!__atomic_load_n(&g_wait_signaled, __ATOMIC_RELAXED)) return;
+    waitobj_reset(&g_wait);
+    __atomic_store_n(&g_wait_signaled, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(poll_pending(moves) && !__atomic_exchange_n(&g_wait_signaled, 1, __ATOMIC_ACQ_REL)) waitobj_signal(&g_wait);
+}
+
+/*
+ * wait_timer_wake - Have the wait timer watch a held-back poll move
+ */
+static void wait_timer_wake(void) {
+    if(!__atomic_load_n(&g_wait_ready, __ATOMIC_ACQUIRE)) return;
+    /* Pairs with the fence in wait_timer_proc, one side sees the other */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&g_wait_timer_idle, __ATOMIC_RELAXED)) {
+        unsigned long long t0 = timing_now_ns();
+        EnterCriticalSection(&g_wait_timer_cs);
+        stats_lockwait(timing_now_ns() - t0);
+        WakeConditionVariable(&g_wait_timer_cv);
+        LeaveCriticalSection(&g_wait_timer_cs);
+    }
+}
+
+/*
+ * wait_timer_proc - Wait timer thread
+ * 
+ * Poll consumers have no thread of their own to retry a move held back by 
+ * the rate limit, so this one does it for them, as the dispatcher does for 
+ * itself: it re-checks every millisecond while such a move is waiting and 
+ * sets the wait signal once it is due, then parks until the hook holds 
+ * back another. Runs from listener_start, or the first wait, to 
+ * listener_stop.
+ */
+static DWORD WINAPI wait_timer_proc(void* param) {
+    (void)param;
+    unsigned notified = 1;  /* Slot sequence the signal was last set for, odd never matches */
+    for(;;) {
+        EnterCriticalSection(&g_wait_timer_cs);
+        if(g_wait_timer_stop) {
+            LeaveCriticalSection(&g_wait_timer_cs);
+            break;
+        }
+        __atomic_store_n(&g_wait_timer_idle, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        int held = __atomic_load_n(&g_poll_move.pending, __ATOMIC_RELAXED) && 
+                   __atomic_load_n(&g_poll_move.seq, __ATOMIC_RELAXED) != notified;
+        SleepConditionVariableCS(&g_wait_timer_cv, &g_wait_timer_cs, held ? 1 : INFINITE);
+        __atomic_store_n(&g_wait_timer_idle, 0, __ATOMIC_RELAXED);
+        LeaveCriticalSection(&g_wait_timer_cs);
+
+        if(!__atomic_load_n(&g_poll_move.pending, __ATOMIC_ACQUIRE)) continue;
+        unsigned seq = __atomic_load_n(&g_poll_move.seq, __ATOMIC_ACQUIRE);
+        int mode = __atomic_load_n(&g_move_mode, __ATOMIC_RELAXED);
+        if(move_due(mode, __atomic_load_n(&g_poll_move.last_ns, __ATOMIC_RELAXED), g_backend->now_ns())) {
+            wait_notify();
+            notified = seq;
+        }
+    }
+    return 0;
+}
+
+/*
+ * wait_timer_start - Start the wait timer if it is not running
+ * 
+ * Called with g_cs held.
+ * 
+ * Returns: 0 on success, 1 if the thread could not be created
+ */
+static int wait_timer_start(void) {
+    if(g_wait_timer) return 0;
+    g_wait_timer_stop = 0;
+    g_wait_timer = CreateThread(NULL, 0, wait_timer_proc, NULL, 0, NULL);
+    return g_wait_timer ? 0 : 1;
+}
+
+/*
+ * wait_timer_stop - Stop the wait timer and wait for it to exit
+ * 
+ * Called with g_cs held, which the timer never takes. A move still held 
+ * back is left for the next poll.
+ */
+static void wait_timer_stop(void) {
+    if(!g_wait_timer) return;
+    EnterCriticalSection(&g_wait_timer_cs);
+    g_wait_timer_stop = 1;
+    WakeConditionVariable(&g_wait_timer_cv);
+    LeaveCriticalSection(&g_wait_timer_cs);
+    WaitForSingleObject(g_wait_timer, INFINITE);
+    CloseHandle(g_wait_timer);
+    g_wait_timer = NULL;
+}
+
+/*
+ * wait_setup - Create the wait signal on first use
+ * 
+ * Starts the wait timer along with it while the listener is running.
+ * 
+ * Returns: 0 on success, 1 if it could not be created
+ */
+static int wait_setup(void) {
+    if(__atomic_load_n(&g_wait_ready, __ATOMIC_ACQUIRE)) return 0;
+    EnterCriticalSection(&g_cs);
+    int err = 0;
+    if(!g_wait_ready) {
+        err = waitobj_create(&g_wait);
+        if(!err && g_running) err = wait_timer_start();
+        if(!err) {
+            __atomic_store_n(&g_wait_ready, 1, __ATOMIC_RELEASE);
+            /* Events queued before anyone waited */
+            if(poll_pending(1)) wait_notify();
+        }
+    }
+    LeaveCriticalSection(&g_cs);
+    if(err) SetLastError(ERROR_NOT_SUPPORTED);
+    return err;
+}
+
+/*
+ * hotkeys_match - Collect the hotkeys a key press triggers
+ * 
+ * @rs: Current snapshot
+ * @ev: Key press
+ * @fire: Matches are appended here
+ * @fired: Number already in fire
+ * @swallow: Set to 1 if a match swallows the key
+ * 
+ * Returns: New number of matches in fire
+ */
+static int hotkeys_match(const RuleSet* rs, const EventEx* ev, HotkeyFire* fire, int fired, int* swallow) {
+    if(!rs->hk_slots) return fired;
+    BYTE vk = (BYTE)ev->vk;
+    unsigned key = HOTKEY_SLOT_KEY(vk, ev->modifiers | hotkey_modbit(vk));
+    unsigned at = hotkey_hash(key) & rs->hk_mask;
+    while(rs->hk_slots[at].key && rs->hk_slots[at].key != key) at = (at + 1) & rs->hk_mask;
+    const HotkeySlot* hs = &rs->hk_slots[at];
+    if(!hs->key) return fired;
+
+    KeySet down;
+    for(int i = 0; i < 4; ++i) down.w[i] = __atomic_load_n(&g_keys_down.w[i], __ATOMIC_RELAXED);
+    for(int i = 0; i < hs->count && fired < HOTKEY_FIRE_MAX; ++i) {
+        const Hotkey* h = &rs->hotkeys[hs->first + i];
+        if((h->flags & HOTKEY_PHYSICAL) && ev->injected) continue;
+        if(ev->repeat && !(h->flags & HOTKEY_REPEAT)) continue;
+        int held = 1;
+        for(int w = 0; w < 4; ++w) held &= (h->extra.w[w] & ~down.w[w]) == 0;
+        if(!held) continue;
+        if(h->flags & HOTKEY_SWALLOW) *swallow = 1;
+        fire[fired].cb = h->cb;
+        fire[fired++].id = h->id;
+    }
+    return fired;
+}
+
+/*
+ * sequence_accept - Check a matched sequence against the recent steps
+ * 
+ * The automaton only knows the keys, so the gaps between the last count 
+ * step presses and their injected flags are checked here.
+ * 
+ * Returns: 1 if the sequence fires, 0 otherwise
+ */
+static int sequence_accept(const SeqOutput* o) {
+    unsigned long long limit = (unsigned long long)o->timeout_ms * 1000000ULL;
+    for(int i = 1; i <= o->count; ++i) {
+        unsigned at = (g_seq_pos - (unsigned)i) & (SEQUENCE_MAX_STEPS - 1);
+        if((o->flags & HOTKEY_PHYSICAL) && g_seq_injected[at]) return 0;
+        if(limit && i < o->count) {
+            unsigned prev = (at - 1) & (SEQUENCE_MAX_STEPS - 1);
+            if(g_seq_times[at] - g_seq_times[prev] > limit) return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * sequences_step - Advance the sequence automaton by a key press
+ * 
+ * @rs: Current snapshot
+ * @ev: Key press, not a repeat
+ * @fire: Matches are appended here
+ * @fired: Number already in fire
+ * @swallow: Set to 1 if a match swallows the key
+ * 
+ * Takes one transition on (vk, modifiers). Every sequence ending at the 
+ * new state fires if its timeout and flags allow, and any match restarts 
+ * the automaton so matches do not overlap.
+ * 
+ * Returns: New number of matches in fire
+ */
+static int sequences_step(const RuleSet* rs, const EventEx* ev, HotkeyFire* fire, int fired, int* swallow) {
+    const SeqAutomaton* a = rs->seq;
+    if(!a) return fired;
+    if(g_seq_gen != rs->gen) {
+        g_seq_gen = rs->gen;
+        g_seq_state = 0;
+    }
+    BYTE vk = (BYTE)ev->vk;
+    unsigned at = g_seq_pos++ & (SEQUENCE_MAX_STEPS - 1);
+    g_seq_times[at] = ev->clock_ns;
+    g_seq_injected[at] = (unsigned char)ev->injected;
+
+    int s = seqauto_next(a, g_seq_state, SEQ_SYMBOL(hotkey_generic(vk), ev->modifiers | hotkey_modbit(vk)));
+    int matched = 0;
+    for(int n = a->nodes[s].out_count ? s : a->nodes[s].dict; n >= 0; n = a->nodes[n].dict) {
+        const SeqNode* node = &a->nodes[n];
+        for(int i = node->out_first; i < node->out_first + node->out_count; ++i) {
+            const SeqOutput* o = &a->out[i];
+            if(!sequence_accept(o)) continue;
+            matched = 1;
+            if(o->flags & HOTKEY_SWALLOW) *swallow = 1;
+            if(fired < HOTKEY_FIRE_MAX) {
+                fire[fired].cb = o->cb;
+                fire[fired++].id = o->id;
+            }
+        }
+    }
+    g_seq_state = matched ? 0 : s;
+    return fired;
+}
+
+/*
+ * remap_sided - Left-side code of a generic modifier
+ * 
+ * Replacements use sided codes, which is what the hook reports and tracks.
+ */
+static BYTE remap_sided(BYTE vk) {
+    switch(vk) {
+        case VK_SHIFT: return VK_LSHIFT;
+        case VK_CONTROL: return VK_LCONTROL;
+        case VK_MENU: return VK_LMENU;
+        default: return vk;
+    }
+}
+
+/*
+ * remap_chord - Append the presses or releases of one remap step
+ * 
+ * @out: Batch being built
+ * @n: Events already in out
+ * @step: SEQ_SYMBOL of the step
+ * @up: 0 for modifiers then key down, 1 for key then modifiers up
+ * 
+ * Returns: New number of events in out
+ */
+static int remap_chord(KeyInput* out, int n, unsigned step, int up) {
+    static const BYTE mod_vk[4] = { VK_LSHIFT, VK_LCONTROL, VK_LMENU, VK_LWIN };  /* By L_MOD_* bit */
+    BYTE vk = remap_sided((BYTE)(step & 0xFF));
+    int mods = (int)(step >> 8) & ~hotkey_modbit(vk);
+    if(up) {
+        out[n].vk = vk;
+        out[n].scan = 0;
+        out[n++].flags = KEYEVENTF_KEYUP;
+    }
+    for(int i = 0; i < 4; ++i) {
+        int m = up ? 3 - i : i;
+        if(!(mods & (1 << m))) continue;
+        out[n].vk = mod_vk[m];
+        out[n].scan = 0;
+        out[n++].flags = up ? KEYEVENTF_KEYUP : 0;
+    }
+    if(!up) {
+        out[n].vk = vk;
+        out[n].scan = 0;
+        out[n++].flags = 0;
+    }
+    return n;
+}
+
+/*
+ * remap_event - Build the replacement of a key event
+ * 
+ * @rs: Current snapshot
+ * @vk: Key of the event, not injected by the library
+ * @pressed: 1 if pressed, 0 if released
+ * @repeat: 1 if an auto-repeat
+ * @out: Receives the replacement, room for REMAP_BATCH_MAX events
+ * 
+ * A single-step remap holds its target down for as long as the key is, 
+ * repeats included. A longer one types every step on the press, and its 
+ * repeats and release are swallowed. The release is decided by what the 
+ * press sent, so changing the remap while the key is held cannot leave 
+ * the target stuck down.
+ * 
+ * Returns: Number of events in out (0 to swallow with no replacement), or 
+ * -1 if the event is not remapped
+ */
+static int remap_event(const RuleSet* rs, BYTE vk, int pressed, int repeat, KeyInput* out) {
+    if(!pressed || repeat) {
+        if(!g_remap_held[vk]) return -1;
+        int n = g_remap_release_n[vk];
+        if(!pressed) {
+            memcpy(out, g_remap_release[vk], (size_t)n * sizeof(KeyInput));
+            g_remap_held[vk] = 0;
+            g_remap_release_n[vk] = 0;
+            return n;
+        }
+        if(n == 0) return 0;
+        out[0] = g_remap_release[vk][0];  /* The target's own release, repeated as a press */
+        out[0].flags &= ~KEYEVENTF_KEYUP;
+        return 1;
+    }
+
+    int i = rs->remap_of[vk];
+    if(!i) return -1;
+    const Remap* r = &rs->remaps[i - 1];
+    int n = 0;
+    if(r->count == 1) {
+        n = remap_chord(out, 0, r->steps[0], 0);
+        g_remap_release_n[vk] = (unsigned char)remap_chord(g_remap_release[vk], 0, r->steps[0], 1);
+    } else {
+        for(int k = 0; k < r->count; ++k) {
+            n = remap_chord(out, n, r->steps[k], 0);
+            n = remap_chord(out, n, r->steps[k], 1);
+        }
+        g_remap_release_n[vk] = 0;
+    }
+    g_remap_held[vk] = 1;
+    return n;
+}
+
+/*
+ * mod_state_update - Track the modifier bitmask
+ * 
+ * Only sided codes change the state, as the hook reports modifiers by side.
+ */
+static void mod_state_update(BYTE vk, int pressed) {
+    switch(vk) {
+        case VK_LSHIFT: case VK_RSHIFT:
+            if(pressed) g_mod_state |= L_MOD_SHIFT;
+            else g_mod_state &= ~L_MOD_SHIFT;
+            break;
+        case VK_LCONTROL: case VK_RCONTROL:
+            if(pressed) g_mod_state |= L_MOD_CTRL;
+            else g_mod_state &= ~L_MOD_CTRL;
+            break;
+        case VK_LMENU: case VK_RMENU:
+            if(pressed) g_mod_state |= L_MOD_ALT;
+            else g_mod_state &= ~L_MOD_ALT;
+            break;
+        case VK_LWIN: case VK_RWIN:
+            if(pressed) g_mod_state |= L_MOD_WIN;
+            else g_mod_state &= ~L_MOD_WIN;
+            break;
+    }
+}
+
+/*
+ * scope_lower - Copy a string in lower case
+ */
+static void scope_lower(char* out, size_t len, const char* in) {
+    size_t i = 0;
+    for(; in[i] && i + 1 < len; ++i) out[i] = (char)tolower((unsigned char)in[i]);
+    out[i] = '\0';
+}
+
+/*
+ * scope_matches - Check a scoped block against the foreground window
+ */
+static int scope_matches(const ScopedRule* r, const Foreground* fg) {
+    if(!fg->hwnd) return 0;
+    switch(r->scope) {
+        case LISTENER_SCOPE_PROCESS: return strcmp(fg->procname, r->match) == 0;
+        case LISTENER_SCOPE_CLASS: return strcmp(fg->classname, r->match) == 0;
+        case LISTENER_SCOPE_TITLE: return strstr(fg->title, r->match) != NULL;
+        default: return 0;
+    }
+}
+
+/*
+ * scope_decision - Block bits of the scoped blocks for a key
+ * 
+ * @rs: Current snapshot
+ * @vk: Virtual key code
+ * 
+ * The rules are matched against the cached foreground identity only when 
+ * the snapshot or the foreground changed since the last event; otherwise 
+ * this is a table load. Called from the hook inside a read section.
+ * 
+ * Returns: BLOCK_* bits to merge into the table entry
+ */
+static unsigned short scope_decision(const RuleSet* rs, BYTE vk) {
+    unsigned serial = __atomic_load_n(&g_fg_serial, __ATOMIC_ACQUIRE);
+    if(g_scope_gen != rs->gen || g_scope_serial != serial) {
+        static Foreground fg;   /* Hook-owned, too large for the hook's stack */
+        EnterCriticalSection(&g_fg_cs);
+        fg = g_fg;
+        serial = g_fg_serial;
+        LeaveCriticalSection(&g_fg_cs);
+        memset(g_scope_table, 0, sizeof(g_scope_table));
+        for(int i = 0; i < rs->scoped_count; ++i) {
+            if(scope_matches(&rs->scoped[i], &fg)) g_scope_table[rs->scoped[i].vk] = BLOCK_INJECTED | BLOCK_PHYSICAL | BLOCK_BY_SCOPE;
+        }
+        g_scope_gen = rs->gen;
+        g_scope_serial = serial;
+    }
+    return g_scope_table[vk];
+}
+
+/*
+ * listener_focus - Resolve a new foreground window
+ * 
+ * @hwnd: Foreground window, NULL if there is none
+ * 
+ * Registered as the backend's focus watcher while the listener runs, and 
+ * so called on the hook thread. Title changes and windows of the same 
+ * process keep the cached process name; the process is only opened when 
+ * the foreground moves to another one. The hook picks the new identity up 
+ * on its next event.
+ */
+static void listener_focus(HWND hwnd) {
+    window_info_t info;
+    memset(&info, 0, sizeof(info));
+    if(hwnd && g_backend->window_ident(hwnd, &info)) hwnd = NULL;
+
+    EnterCriticalSection(&g_fg_cs);
+    int same = hwnd && g_fg.hwnd && g_fg.pid == info.pid;
+    LeaveCriticalSection(&g_fg_cs);
+    if(hwnd && !same && g_backend->window_query(hwnd, &info)) hwnd = NULL;
+
+    EnterCriticalSection(&g_fg_cs);
+    g_fg.hwnd = hwnd;
+    g_fg.pid = hwnd ? info.pid : 0;
+    if(!same) scope_lower(g_fg.procname, sizeof(g_fg.procname), hwnd ? info.procname : "");
+    scope_lower(g_fg.classname, sizeof(g_fg.classname), hwnd ? info.classname : "");
+    scope_lower(g_fg.title, sizeof(g_fg.title), hwnd ? info.title : "");
+    __atomic_add_fetch(&g_fg_serial, 1, __ATOMIC_RELEASE);
+    LeaveCriticalSection(&g_fg_cs);
+}
+
+/*
+ * lowlevel_event - Decide on and deliver one hook event
+ * 
+ * @he: Event from the backend hook
+ * @sb: Counter block of the hook thread
+ * 
+ * Returns: 1 if event is blocked, 0 to pass input on
+ */
+static int lowlevel_event(const HookEvent* he, StatBlock* sb) {
+    int pressed = he->pressed;
+    BYTE vk = (BYTE)he->vk;
+    int injected = he->injected;
+    unsigned long long now = he->time_ns;
+
+    /* A press of a key that is already down is an auto-repeat */
+    int repeat = 0;
+    if(vk && pressed) {
+        uint64_t w = __atomic_load_n(&g_keys_down.w[vk >> 6], __ATOMIC_RELAXED);
+        repeat = (int)((w >> (vk & 63)) & 1);
+    }
+
+    /* Rules stay readable for the rest of the decision */
+    const RuleSet* rs;
+    int slot = rules_read_lock(&rs);
+
+    /* Debounce - swallow a physical press that follows its own release too 
+       closely, along with the release that goes with it */
+    unsigned debounce = vk ? rs->debounce_ms[vk] : 0;
+    if(debounce && !injected && !repeat) {
+        if(pressed) {
+            if(g_bounced[vk]) {
+                g_bounced[vk] = 0;  /* Pressed again, it is real */
+            } else if(now - g_key_change_ns[vk] < (unsigned long long)debounce * 1000000ULL) {
+                g_bounced[vk] = 1;
+                rules_read_unlock(slot);
+                stat_add(sb, &sb->blocked[STAT_BLOCK_DEBOUNCE], 1);
+                return 1;
+            }
+        } else if(g_bounced[vk]) {
+            g_bounced[vk] = 0;
+            rules_read_unlock(slot);
+            stat_add(sb, &sb->blocked[STAT_BLOCK_DEBOUNCE], 1);
+            return 1;
+        }
+    }
+    if(vk && !repeat) g_key_change_ns[vk] = now;
+
+    /* Populate EventEx struct */
+    EventEx ev;
+    ev.size = sizeof(EventEx);
+    ev.version = EVENTEX_VERSION;
+    ev.type = he->type;
+    ev.x = he->x;
+    ev.y = he->y;
+    ev.wheel = he->data;
+    ev.vk = vk;
+    ev.scan = he->scan;
+    ev.pressed = pressed;
+    ev.injected = injected;
+    ev.self = he->self;
+    ev.clock_ns = now;
+    ev.os_time = he->time;
+    ev.time_ns = now - g_start_ns;
+    ev.delta_ns = now - g_last_event_ns;
+    g_last_event_ns = now;
+    ev.repeat = repeat;
+    if(vk == 0) {
+        ev.held_ns = 0;
+    } else if(pressed) {
+        if(!repeat) {
+            g_key_down_ns[vk] = now;
+            g_repeat_count[vk] = 0;
+        }
+        ev.held_ns = 0;
+    } else {
+        ev.repeat = g_repeat_count[vk];
+        g_repeat_count[vk] = 0;
+        if(g_key_down_ns[vk] != 0) {
+            ev.held_ns = now - g_key_down_ns[vk];
+        } else {
+            ev.held_ns = 0;
+        }
+        g_key_down_ns[vk] = 0;
+    }
+
+    /* Retrieve modifier bitmask */
+    mod_state_update(vk, pressed);
+    ev.modifiers = g_mod_state;
+
+    /* Track held keys for combo matching, blocked or not */
+    if(vk) keys_down_update(vk, pressed);
+
+    /* Blocking logic - one table load, combos only checked for their keys */
+    unsigned short d = rs->table[vk];
+    if(rs->scoped_count) d |= scope_decision(rs, vk);
+    int block = (d & (injected ? BLOCK_INJECTED : BLOCK_PHYSICAL)) != 0;
+    if(!block && (d & BLOCK_COMBO)) block = combo_matches_event(rs, vk);
+    rules_read_unlock(slot);
+    if(block) {
+        int reason;
+        if(d & BLOCK_BY_ALL) reason = STAT_BLOCK_ALL;
+        else if(d & BLOCK_BY_KEY) reason = STAT_BLOCK_KEY;
+        else if(d & BLOCK_BY_GROUP) reason = STAT_BLOCK_GROUP;
+        else if(d & BLOCK_BY_SCOPE) reason = STAT_BLOCK_SCOPE;
+        else if(d & (injected ? BLOCK_INJECTED : BLOCK_PHYSICAL)) reason = injected ? STAT_BLOCK_SIM : STAT_BLOCK_PHYS;
+        else reason = STAT_BLOCK_COMBO;
+        stat_add(sb, &sb->blocked[reason], 1);
+        return 1;
+    }
+
+    /* Remapping - the original is swallowed and its replacement sent in one 
+       submission straight from the hook. The library's own input is never 
+       remapped, so a replacement cannot loop */
+    if(vk && !he->self && ((d & BLOCK_REMAP) || g_remap_held[vk])) {
+        KeyInput out[REMAP_BATCH_MAX];
+        slot = rules_read_lock(&rs);
+        int n = remap_event(rs, vk, pressed, repeat, out);
+        rules_read_unlock(slot);
+        if(n >= 0) {
+            stat_add(sb, &sb->blocked[STAT_BLOCK_REMAP], 1);
+            if(n) {
+                g_remap_timing[out[0].vk] = 1;
+                g_remap_origin_ns[out[0].vk] = now;
+                for(int i = 0; i < n; ++i) {
+                    if(g_remap_expect[out[i].vk] < 0xFF) g_remap_expect[out[i].vk]++;
+                }
+                g_backend->send_keys(out, n);
+            }
+            return 1;
+        }
+    }
+
+    /* Hotkeys and sequences - one hash probe each on (vk, modifiers) */
+    if(vk && pressed && !repeat && !(d & BLOCK_SEQUENCE) && !hotkey_modbit(vk)) g_seq_state = 0;
+    if(vk && ((d & (BLOCK_HOTKEY | BLOCK_SEQUENCE)) || g_hotkey_swallowed[vk])) {
+        HotkeyFire fire[HOTKEY_FIRE_MAX];
+        int fired = 0, swallow = 0;
+        if(pressed) {
+            slot = rules_read_lock(&rs);
+            if(d & BLOCK_HOTKEY) fired = hotkeys_match(rs, &ev, fire, fired, &swallow);
+            if((d & BLOCK_SEQUENCE) && !repeat) fired = sequences_step(rs, &ev, fire, fired, &swallow);
+            rules_read_unlock(slot);
+        }
+
+        /* A swallowed press takes its repeats and release with it */
+        if(!pressed) {
+            swallow = g_hotkey_swallowed[vk];
+            g_hotkey_swallowed[vk] = 0;
+        } else if(!repeat) {
+            g_hotkey_swallowed[vk] = (unsigned char)swallow;
+        } else if(g_hotkey_swallowed[vk]) {
+            swallow = 1;
+        }
+
+        /* Only the swallow decision stays in the hook when dispatching */
+        int posted = 0;
+        for(int i = 0; i < fired; ++i) {
+            if(__atomic_load_n(&g_dispatch, __ATOMIC_RELAXED)) {
+                dispatch_fire(&fire[i], &ev);
+                posted = 1;
+                continue;
+            }
+            unsigned long long t0 = timing_now_ns();
+            fire[i].cb(fire[i].id, &ev);
+            stats_callback(sb, timing_now_ns() - t0);
+        }
+        if(posted) dispatch_wake();
+        if(swallow) {
+            stat_add(sb, &sb->blocked[STAT_BLOCK_HOTKEY], 1);
+            return 1;
+        }
+    }
+
+    /* Fold auto-repeats into the release, which reports how many there were */
+    if(repeat && __atomic_load_n(&g_repeat_fold, __ATOMIC_RELAXED)) {
+        g_repeat_count[vk]++;
+        return 0;
+    }
+
+    recorder_append(&ev);
+
+    int poll = __atomic_load_n(&g_poll_mode, __ATOMIC_RELAXED);
+    int dispatch = __atomic_load_n(&g_dispatch, __ATOMIC_RELAXED);
+    void (*cb)(Event*) = __atomic_load_n(&g_callback, __ATOMIC_ACQUIRE);
+    void (*cb_ex)(EventEx*) = __atomic_load_n(&g_callback_ex, __ATOMIC_ACQUIRE);
+
+    /* Coalesce moves - queued consumers get the latest one when they drain, 
+       inline callbacks simply see fewer moves under a rate limit */
+    int queued = poll || (!cb && !cb_ex) || dispatch;
+    int move_mode = __atomic_load_n(&g_move_mode, __ATOMIC_RELAXED);
+    if(ev.type == EVENT_MOUSE_MOVE && move_mode != LISTENER_MOVES_ALL) {
+        MoveSlot* ms = (poll || (!cb && !cb_ex)) ? &g_poll_move : &g_dispatch_move;
+        if(move_mode == LISTENER_MOVES_LATEST && queued) {
+            move_stash(ms, &ev);
+            if(ms == &g_dispatch_move) dispatch_wake();
+            else wait_notify();
+            return 0;
+        }
+        if(move_mode > 0) {
+            unsigned long long last = queued ? __atomic_load_n(&ms->last_ns, __ATOMIC_RELAXED) : g_move_inline_ns;
+            if(!move_due(move_mode, last, now)) {
+                if(queued) {
+                    move_stash(ms, &ev);
+                    if(ms == &g_dispatch_move) dispatch_wake();
+                    else wait_timer_wake();
+                }
+                return 0;
+            }
+            if(queued) {
+                __atomic_store_n(&ms->last_ns, now, __ATOMIC_RELAXED);
+                __atomic_store_n(&ms->pending, 0, __ATOMIC_RELAXED);  /* Superseded */
+            } else {
+                g_move_inline_ns = now;
+            }
+        }
+    }
+
+    /* The queues are lock-free, so pushing never waits on a consumer */
+    if(poll || (!cb && !cb_ex)) {
+        eventq_push(&g_poll_q, &ev);
+        wait_notify();
+    } else if(dispatch) {
+        dispatch_post(&ev);
+    } else {
+        event_deliver(&ev, cb, cb_ex);
+    }
+    return 0;
+}
+
+/*
+ * lowlevel_proc - Low level keyboard and mouse hook proc
+ * 
+ * @he: Pointer to the HookEvent delivered by the backend
+ * 
+ * Registered with the backend's keyboard hook (WH_KEYBOARD_LL on Windows), 
+ * and is invoked on every keyboard event (press/release), and every mouse 
+ * event when the mouse is hooked. Populates an EventEx struct and 
+ * dispatches it to either the callback or the internal queue. Mouse moves 
+ * and wheels use the vk 0 entry of the block table, so only the global 
+ * block toggles apply to them.
+ * 
+ * Times every invocation from entry to return for listener_stats, except 
+ * the library's own events when listener_selfinput bypasses them.
+ * 
+ * Returns: 1 if event is blocked, 0 to pass input on
+ */
+static int lowlevel_proc(const HookEvent* he) {
+    /* First event of a remap's replacement, timed from the original */
+    if(he->self && he->vk && g_remap_timing[he->vk]) {
+        unsigned long long origin = g_remap_origin_ns[he->vk];
+        g_remap_timing[he->vk] = 0;
+        stats_remap(stats_block(), he->time_ns > origin ? he->time_ns - origin : 0);
+    }
+
+    /* A remap's replacement stands in for the user's key, so it is exempt 
+       from listener_selfinput even though it carries the library's tag */
+    int replacement = 0;
+    if(he->self && he->vk && g_remap_expect[he->vk]) {
+        g_remap_expect[he->vk]--;
+        replacement = 1;
+    }
+
+    /* Own injections can bypass everything but key and modifier tracking, 
+       so high-rate typing does not feed back through the decision path */
+    if(he->self && !replacement) {
+        int mode = __atomic_load_n(&g_self_mode, __ATOMIC_RELAXED);
+        if(mode != LISTENER_SELF_DELIVER) {
+            if(he->vk) {
+                keys_down_update((BYTE)he->vk, he->pressed);
+                mod_state_update((BYTE)he->vk, he->pressed);
+            }
+            if(mode == LISTENER_SELF_SKIP) return 0;
+            StatBlock* sb = stats_block();
+            stat_add(sb, &sb->blocked[STAT_BLOCK_SELF], 1);
+            return 1;
+        }
+    }
+
+    StatBlock* sb = stats_block();
+    unsigned long long t0 = timing_now_ns();
+    int r = lowlevel_event(he, sb);
+    stats_hook(sb, timing_now_ns() - t0);
+    return r;
+}
+
+/*
+ * listener_start - Enable listener functions
+ * 
+ * Installs the keyboard hook, and the mouse hook if enabled with 
+ * listener_mouse, through the current backend. On Windows this starts the 
+ * hook thread and waits for the hook install. The foreground window is 
+ * resolved now and again on every foreground change, for scoped blocks.
+ * 
+ * Returns: 0 if successful, 1 otherwise
+ */
+int INPUTLIB_CALL listener_start(void) {
+    EnterCriticalSection(&g_cs);
+
+    if(g_running) {
+        LeaveCriticalSection(&g_cs);
+        SetLastError(ERROR_ALREADY_EXISTS);
+        return 1;
+    }
+    if(g_wait_ready && wait_timer_start()) {
+        LeaveCriticalSection(&g_cs);
+        SetLastError(ERROR_NOT_SUPPORTED);
+        return 1;
+    }
+    g_running = 1;
+    g_hook_backend = g_backend;
+    keys_down_seed();
+
+    LeaveCriticalSection(&g_cs);
+
+    g_hook_backend->focus_watch(listener_focus);
+    listener_focus(g_hook_backend->window_foreground());
+    if(g_hook_backend->hook_start(lowlevel_proc, g_mouse)) {
+        /* Hook didn't initalize properly */
+        g_hook_backend->focus_watch(NULL);
+        EnterCriticalSection(&g_cs);
+        g_running = 0;
+        g_hook_backend = NULL;
+        wait_timer_stop();
+        LeaveCriticalSection(&g_cs);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * listener_mouse - Capture mouse events
+ * 
+ * @enabled: 1 to hook the mouse along with the keyboard, 0 for keyboard only
+ * 
+ * Mouse events share the keyboard hook's thread, queue, dispatcher and 
+ * block rules. Buttons arrive as EVENT_MOUSE_BUTTON with their VK_*BUTTON 
+ * code, so they can be blocked like keys. Mouse events are only delivered 
+ * as EventEx, through listener_cbsubex and listener_cbpollex. Only allowed 
+ * while the listener is stopped.
+ * 
+ * Returns: 0 if successful, 1 if the listener is running
+ */
+int INPUTLIB_CALL listener_mouse(int enabled) {
+    EnterCriticalSection(&g_cs);
+    if(g_running) {
+        LeaveCriticalSection(&g_cs);
+        SetLastError(ERROR_INVALID_OPERATION);
+        return 1;
+    }
+    g_mouse = enabled ? 1 : 0;
+    LeaveCriticalSection(&g_cs);
+    return 0;
+}
+
+/*
+ * listener_mousemoves - Coalesce mouse moves
+ * 
+ * @mode: LISTENER_MOVES_ALL, LISTENER_MOVES_LATEST, or a maximum number 
+ *        of moves per second
+ * 
+ * LISTENER_MOVES_LATEST keeps moves out of the queue and hands polling or 
+ * dispatched consumers only the latest position each time they drain. A 
+ * rate limit delivers moves no more often than the given rate, and the 
+ * last position held back is still delivered once the interval passes. 
+ * Callbacks invoked inline on the hook thread get every move under 
+ * LISTENER_MOVES_LATEST.
+ * 
+ * Returns: 0 if successful, 1 if mode is invalid
+ */
+int INPUTLIB_CALL listener_mousemoves(int mode) {
+    if(mode < LISTENER_MOVES_LATEST) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+    __atomic_store_n(&g_move_mode, mode, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/*
+ * listener_stop - Disable listener functions
+ * 
+ * Removes the keyboard hook from the backend it was installed with, and 
+ * stops the wait timer once the hook can no longer hold back moves.
+ * 
+ * Returns: 0 if successful, 1 if already stopped
+ */
+int INPUTLIB_CALL listener_stop(void) {
+    EnterCriticalSection(&g_cs);
+
+    if(!g_running) {
+        LeaveCriticalSection(&g_cs);
+        SetLastError(ERROR_INVALID_OPERATION);
+        return 1;
+    }
+    g_running = 0;
+    const InputBackend* b = g_hook_backend;
+    g_hook_backend = NULL;
+
+    LeaveCriticalSection(&g_cs);
+
+    if(b) {
+        b->hook_stop();
+        b->focus_watch(NULL);
+    }
+    EnterCriticalSection(&g_cs);
+    if(!g_running) wait_timer_stop();
+    LeaveCriticalSection(&g_cs);
+
+    /* Let go of remap targets whose keys were still held */
+    for(int vk = 1; vk < 256; ++vk) {
+        if(!g_remap_held[vk]) continue;
+        if(b && g_remap_release_n[vk]) b->send_keys(g_remap_release[vk], g_remap_release_n[vk]);
+        g_remap_held[vk] = 0;
+        g_remap_release_n[vk] = 0;
+    }
+    memset(g_remap_expect, 0, sizeof(g_remap_expect));
+    return 0;
+}
+
+/*
+ * listener_flush - Clears all toggles and blocks
+ * 
+ * Flushes everything, including the callback pointer, queue, blocked key lists, 
+ * global block toggles, debounce windows, repeat folding, remaps and scoped blocks.
+ */
+int INPUTLIB_CALL listener_flush(void) {
+    EnterCriticalSection(&g_cs);
+
+    __atomic_store_n(&g_callback, NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_callback_ex, NULL, __ATOMIC_RELEASE);
+    eventq_clear(&g_poll_q);
+    __atomic_store_n(&g_poll_move.pending, 0, __ATOMIC_RELAXED);
+    LeaveCriticalSection(&g_cs);
+
+    EnterCriticalSection(&g_rules_cs);
+    memset(g_blocked_keys, 0, sizeof(g_blocked_keys));
+    memset(g_blocked_groups, 0, sizeof(g_blocked_groups));
+    combo_clear();
+
+    g_block_all = 0;
+    g_block_sim = 0;
+    g_block_phys = 0;
+    memset(g_debounce_ms, 0, sizeof(g_debounce_ms));
+    memset(g_remaps, 0, sizeof(g_remaps));
+    g_remap_count = 0;
+    g_scoped_count = 0;
+    __atomic_store_n(&g_repeat_fold, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_self_mode, LISTENER_SELF_DELIVER, __ATOMIC_RELAXED);
+    return rules_changed();
+}
+
+/*
+ * listener_cbsub - Subscribe to callbacks
+ * 
+ * @cb: Callback function to receive populated Event structs
+ * 
+ * Subscribes to keyboard event callbacks with a function.
+ * 
+ * Returns: 0 if successful, 1 if polling is enabled
+ */
+int INPUTLIB_CALL listener_cbsub(void (*cb)(Event* ev)) {
+    if(!cb) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+
+    EnterCriticalSection(&g_cs);
+
+    if(g_poll_mode) {
+        LeaveCriticalSection(&g_cs);
+        SetLastError(ERROR_INVALID_OPERATION); /* Can't use callback while polling */
+        return 1;
+    }
+
+    __atomic_store_n(&g_callback_ex, NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_callback, cb, __ATOMIC_RELEASE);
+    LeaveCriticalSection(&g_cs);
+    return 0;
+}
+
+/*
+ * listener_cbsubex - Subscribe to extended callbacks
+ * 
+ * @cb: Callback function to receive populated EventEx structs
+ * 
+ * Like listener_cbsub, with nanosecond timestamps. Replaces a callback set 
+ * by listener_cbsub, and vice versa.
+ * 
+ * Returns: 0 if successful, 1 if polling is enabled
+ */
+int INPUTLIB_CALL listener_cbsubex(void (*cb)(EventEx* ev)) {
+    if(!cb) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+
+    EnterCriticalSection(&g_cs);
+
+    if(g_poll_mode) {
+        LeaveCriticalSection(&g_cs);
+        SetLastError(ERROR_INVALID_OPERATION); /* Can't use callback while polling */
+        return 1;
+    }
+
+    __atomic_store_n(&g_callback, NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_callback_ex, cb, __ATOMIC_RELEASE);
+    LeaveCriticalSection(&g_cs);
+    return 0;
+}
+
+/*
+ * listener_ucbsub - Unsubscribe from callbacks
+ * 
+ * Unsubscribes from callback events.
  * 
  * Returns: 0 (always succeeds)
  */
 int INPUTLIB_CALL listener_ucbsub(void) {
     EnterCriticalSection(&g_cs);
-    g_callback = NULL;
+    __atomic_store_n(&g_callback, NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_callback_ex, NULL, __ATOMIC_RELEASE);
     LeaveCriticalSection(&g_cs);
     return 0;
 }
@@ -657,14 +2268,14 @@ int INPUTLIB_CALL listener_ucbsub(void) {
 int INPUTLIB_CALL listener_cbpollmode(int enabled) {
     EnterCriticalSection(&g_cs);
     if(enabled) {
-        if(g_callback) {
+        if(g_callback || g_callback_ex) {
             LeaveCriticalSection(&g_cs);
             SetLastError(ERROR_INVALID_OPERATION);
             return 1; /* Callback mode cannot be active at the same time as polling */
         }
-    g_poll_mode = 1;
+    __atomic_store_n(&g_poll_mode, 1, __ATOMIC_RELAXED);
     } else {
-        g_poll_mode = 0;
+        __atomic_store_n(&g_poll_mode, 0, __ATOMIC_RELAXED);
     }
     LeaveCriticalSection(&g_cs);
     return 0;
@@ -681,55 +2292,462 @@ int INPUTLIB_CALL listener_cbpollmode(int enabled) {
  */
 int INPUTLIB_CALL listener_cbpoll(Event* out) {
     if(!out) { SetLastError(ERROR_INVALID_PARAMETER); return -1; }
+    EventEx ex;
+    do {
+        if(!eventq_popn(&g_poll_q, &ex, 1)) {
+            wait_drained(0);
+            return 0;
+        }
+    } while(ex.type != EVENT_KEY);  /* Mouse events are only polled as EventEx */
+    event_from_ex(&ex, out);
+    return 1;
+}
+
+/*
+ * listener_cbpollex - Poll next event with nanosecond timestamps
+ * 
+ * @out: Pointer to EventEx struct to populate, with size set
+ * 
+ * Pops the next queued event. Only the first out->size bytes are written, 
+ * so callers built against an older, smaller EventEx keep working. The 
+ * caller's size is left as is and version reports the newest layout 
+ * whose fields all fit in it. 
+ * Once the queue is empty, a coalesced mouse move is returned if one is 
+ * waiting.
+ * 
+ * Returns: 1 if an event was popped, 0 if the queue is empty, -1 if out is 
+ * invalid or its size is too small
+ */
+int INPUTLIB_CALL listener_cbpollex(EventEx* out) {
+    if(!out || out->size < EVENTEX_V1_SIZE) { SetLastError(ERROR_INVALID_PARAMETER); return -1; }
+    EventEx ex;
+    if(!eventq_popn(&g_poll_q, &ex, 1) && !move_take(&g_poll_move, &ex)) {
+        wait_drained(1);
+        return 0;
+    }
+    unsigned int size = out->size;
+    memcpy(out, &ex, size < sizeof(EventEx) ? size : sizeof(EventEx));
+    out->size = size;
+    if(size < EVENTEX_V2_SIZE) out->version = 1;
+    else if(size < EVENTEX_V3_SIZE) out->version = 2;
+    else if(size < EVENTEX_V4_SIZE) out->version = 3;
+    return 1;
+}
+
+/*
+ * listener_cbpolln - Poll multiple events
+ * 
+ * @out: Array of Event structs to populate
+ * @max: Capacity of out
+ * 
+ * Pops up to max queued keyboard input events, oldest first, in a single 
+ * call. Does not take the listener lock, so draining never delays the hook.
+ * 
+ * Returns: Number of events popped, -1 if out or max is invalid
+ */
+int INPUTLIB_CALL listener_cbpolln(Event* out, int max) {
+    if(!out || max <= 0) { SetLastError(ERROR_INVALID_PARAMETER); return -1; }
+    EventEx batch[32];
+    int total = 0;
+    while(total < max) {
+        int want = max - total < 32 ? max - total : 32;
+        int n = eventq_popn(&g_poll_q, batch, want);
+        for(int i = 0; i < n; ++i) {
+            if(batch[i].type == EVENT_KEY) event_from_ex(&batch[i], &out[total++]);
+        }
+        if(n < want) {
+            wait_drained(0);
+            break;
+        }
+    }
+    return total;
+}
+
+/*
+ * listener_cbwait - Wait for events and poll them
+ * 
+ * @out: Array of Event structs to populate
+ * @max: Capacity of out
+ * @timeout_ms: Longest wait in milliseconds, 0 to poll, -1 to wait forever
+ * 
+ * Like listener_cbpolln, but parks the calling thread until at least one 
+ * keyboard event is queued. The hook only signals when the queue goes from 
+ * empty to non-empty, so a burst costs a single wake-up. Queued mouse 
+ * events are discarded as with listener_cbpolln, and a waiting coalesced 
+ * move neither wakes it nor is taken, it stays for listener_cbpollex.
+ * 
+ * Returns: Number of events popped, 0 on timeout, -1 on invalid parameters
+ */
+int INPUTLIB_CALL listener_cbwait(Event* out, int max, int timeout_ms) {
+    if(!out || max <= 0 || timeout_ms < -1) { SetLastError(ERROR_INVALID_PARAMETER); return -1; }
+    if(wait_setup()) return -1;
+    unsigned long long deadline = timing_now_ns() + (unsigned long long)(timeout_ms < 0 ? 0 : timeout_ms) * 1000000ULL;
+    for(;;) {
+        int n = listener_cbpolln(out, max);
+        if(n > 0) return n;
+
+        DWORD ms = INFINITE;
+        if(timeout_ms >= 0) {
+            unsigned long long now = timing_now_ns();
+            if(now >= deadline) return 0;
+            ms = (DWORD)((deadline - now + 999999ULL) / 1000000ULL);
+        }
+        waitobj_wait(&g_wait, ms);
+    }
+}
+
+/*
+ * listener_cbwaitobj - Get a waitable object for the polling queue
+ * 
+ * Returns a manual-reset event HANDLE on Windows and a readable file 
+ * descriptor elsewhere (an eventfd on Linux), so the listener can join an 
+ * existing WaitForMultipleObjects, poll or epoll loop. It is signalled 
+ * while events are waiting. Once woken, drain with the poll functions 
+ * until one comes back short or empty, which clears it. Owned by the 
+ * library, do not close it.
+ * 
+ * Returns: Handle or descriptor, or -1 if it could not be created
+ */
+intptr_t INPUTLIB_CALL listener_cbwaitobj(void) {
+    if(wait_setup()) return -1;
+    return waitobj_export(&g_wait);
+}
+
+/* Output cursor for listener_cbdumppoll */
+typedef struct DumpCtx {
+    char* buffer;
+    size_t len;
+    size_t pos;
+} DumpCtx;
+
+/*
+ * dump_event - Append one queued event to a dump buffer
+ * 
+ * Returns: 1 to continue, 0 once the buffer is full
+ */
+static int dump_event(const EventEx* ev, void* p) {
+    DumpCtx* ctx = (DumpCtx*)p;
+    char line[128];
+    int n;
+    unsigned long ms = (unsigned long)(ev->time_ns / 1000000ULL);
+    if(ev->type == EVENT_KEY || ev->type == EVENT_MOUSE_BUTTON) {
+        n = _snprintf(line, sizeof(line), "VK=0x%02X %s MOD=0x%02X INJ=%d TIME=%lu\n",
+         ev->vk, ev->pressed ? "DOWN" : "UP", ev->modifiers, ev->injected, ms);
+    } else {
+        n = _snprintf(line, sizeof(line), "%s X=%d Y=%d WHEEL=%d INJ=%d TIME=%lu\n",
+         ev->type == EVENT_MOUSE_MOVE ? "MOVE" : "WHEEL", ev->x, ev->y, ev->wheel, ev->injected, ms);
+    }
+    if(n <= 0) return 1;
+    if(ctx->pos + (size_t)n + 1 >= ctx->len) return 0;
+    memcpy(ctx->buffer + ctx->pos, line, (size_t)n);
+    ctx->pos += (size_t)n;
+    return 1;
+}
+
+/*
+ * listener_cbdumppoll - Dump polling queue to buffer
+ * 
+ * @buffer: Empty string to dump to
+ * @len: Length of buffer
+ * 
+ * Dumps the entirety of the polling queue to the buffer without consuming 
+ * it. Events popped concurrently may be left out.
+ * 
+ * Returns: 0 if successful, 1 otherwise
+ */
+int INPUTLIB_CALL listener_cbdumppoll(char* buffer, size_t len) {
+    if(!buffer || len == 0) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+    DumpCtx ctx = { buffer, len, 0 };
+    eventq_foreach(&g_poll_q, dump_event, &ctx);
+    buffer[ctx.pos] = '\0';
+    return 0;
+}
+
+/*
+ * listener_cbflush - Clear callback-related things
+ * 
+ * Flushes (clears) polling queue and callback pointer without clearing 
+ * blocklists or global block toggles.
+ * 
+ * Returns: 0 (always succeeds)
+ */
+int INPUTLIB_CALL listener_cbflush(void) {
+    EnterCriticalSection(&g_cs);
+    eventq_clear(&g_poll_q);
+    __atomic_store_n(&g_poll_move.pending, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_callback, NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_callback_ex, NULL, __ATOMIC_RELEASE);
+    LeaveCriticalSection(&g_cs);
+    return 0;
+}
+
+/*
+ * listener_cbqueue - Configure the polling queue
+ * 
+ * @capacity: Queue capacity in events, rounded up to a power of two
+ * @policy: What to do when the queue is full (LISTENER_QUEUE_*)
+ * @max_capacity: Growth limit for LISTENER_QUEUE_GROW, ignored otherwise
+ * 
+ * Replaces the queue with an empty one. LISTENER_QUEUE_DROP_OLDEST 
+ * overwrites the oldest event (the default, with a capacity of 512),
+ * LISTENER_QUEUE_DROP_NEWEST discards incoming events, and 
+ * LISTENER_QUEUE_GROW doubles the capacity up to max_capacity and then 
+ * discards incoming events. Only allowed while the listener is stopped 
+ * and no thread is polling.
+ * 
+ * Returns: 0 if successful, 1 on invalid parameters or if the listener is 
+ * running
+ */
+int INPUTLIB_CALL listener_cbqueue(int capacity, int policy, int max_capacity) {
+    EnterCriticalSection(&g_cs);
+    if(g_running) {
+        LeaveCriticalSection(&g_cs);
+        SetLastError(ERROR_INVALID_OPERATION);
+        return 1;
+    }
+    int rc = eventq_configure(&g_poll_q, capacity, policy, max_capacity);
+    __atomic_store_n(&g_poll_move.pending, 0, __ATOMIC_RELAXED);
+    LeaveCriticalSection(&g_cs);
+    return rc;
+}
+
+/*
+ * listener_cbqueuestats - Get polling queue statistics
+ * 
+ * @out: Pointer to ListenerQueueStats struct to populate
+ * @reset: If nonzero, the drop and growth counters are cleared and the 
+ *         high-water mark restarts from the current length
+ * 
+ * Returns: 0 if successful, 1 if out is NULL
+ */
+int INPUTLIB_CALL listener_cbqueuestats(ListenerQueueStats* out, int reset) {
+    if(!out) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+    eventq_stats(&g_poll_q, out, reset);
+    return 0;
+}
+
+/*
+ * listener_cbdispatch - Run callbacks on a dispatcher thread
+ * 
+ * @enabled: 1 to enable, 0 to disable
+ * @max_inflight: Most events waiting for the callback before new ones are 
+ *                dropped, ignored when disabling
+ * 
+ * With the dispatcher enabled, the hook only makes the block decision and 
+ * queues the event; a dedicated thread invokes the callback in order, 
+ * along with the callbacks of matched hotkeys and sequences. A slow 
+ * callback then no longer delays keyboard input system-wide or risks the 
+ * hook being removed. Blocking decisions are unaffected. Disabling 
+ * delivers the events still in flight before returning, and cannot be 
+ * done from inside the callback.
+ * 
+ * Returns: 0 if successful, 1 on invalid parameters, if already in the 
+ * requested state, or if the thread could not be started
+ */
+int INPUTLIB_CALL listener_cbdispatch(int enabled, int max_inflight) {
+    if(enabled) {
+        if(max_inflight <= 0) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+        EnterCriticalSection(&g_cs);
+        if(g_dispatch_thread) {
+            LeaveCriticalSection(&g_cs);
+            SetLastError(ERROR_ALREADY_EXISTS);
+            return 1;
+        }
+        if(eventq_configure(&g_dispatch_q, max_inflight, LISTENER_QUEUE_DROP_NEWEST, 0)) {
+            LeaveCriticalSection(&g_cs);
+            return 1;
+        }
+        g_dispatch_stop = 0;
+        g_dispatch_thread = CreateThread(NULL, 0, dispatch_thread_proc, NULL, 0, NULL);
+        if(!g_dispatch_thread) {
+            LeaveCriticalSection(&g_cs);
+            return 1;
+        }
+        __atomic_store_n(&g_dispatch, 1, __ATOMIC_RELAXED);
+        LeaveCriticalSection(&g_cs);
+        return 0;
+    }
+
+    if(t_on_dispatcher) { SetLastError(ERROR_INVALID_OPERATION); return 1; }
     EnterCriticalSection(&g_cs);
-    int ok = q_pop(out);
+    HANDLE thread = g_dispatch_thread;
+    if(!thread) {
+        LeaveCriticalSection(&g_cs);
+        SetLastError(ERROR_INVALID_OPERATION);
+        return 1;
+    }
+    __atomic_store_n(&g_dispatch, 0, __ATOMIC_RELAXED);
+    LeaveCriticalSection(&g_cs);
+
+    /* Let the dispatcher drain and exit */
+    EnterCriticalSection(&g_dispatch_cs);
+    g_dispatch_stop = 1;
+    WakeConditionVariable(&g_dispatch_cv);
+    LeaveCriticalSection(&g_dispatch_cs);
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+
+    EnterCriticalSection(&g_cs);
+    g_dispatch_thread = NULL;
     LeaveCriticalSection(&g_cs);
-    return ok;
+    return 0;
+}
+
+/*
+ * listener_cbdispatchstats - Get dispatcher queue statistics
+ * 
+ * @out: Pointer to ListenerQueueStats struct to populate
+ * @reset: If nonzero, the drop counter is cleared and the high-water mark 
+ *         restarts from the current length
+ * 
+ * dropped counts events the callback never saw because max_inflight 
+ * events were already waiting, and hotkey or sequence matches lost 
+ * because 256 of them were.
+ * 
+ * Returns: 0 if successful, 1 if out is NULL
+ */
+int INPUTLIB_CALL listener_cbdispatchstats(ListenerQueueStats* out, int reset) {
+    if(!out) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+    eventq_stats(&g_dispatch_q, out, reset);
+    out->dropped += reset ? __atomic_exchange_n(&g_fire_dropped, 0, __ATOMIC_RELAXED) 
+                          : __atomic_load_n(&g_fire_dropped, __ATOMIC_RELAXED);
+    return 0;
 }
 
 /*
- * listener_cbdumppoll - Dump polling queue to buffer
- * 
- * @buffer: Empty string to dump to
- * @len: Length of buffer
+ * stats_percentile - Estimate a percentile from a latency histogram
  * 
- * Dumps the entirety of the polling queue to the buffer.
+ * @hist: LISTENER_HIST_BUCKETS counts
+ * @count: Total of hist
+ * @permille: Percentile in tenths of a percent
+ * @max: Largest value seen, caps the estimate
  * 
- * Returns: 0 if successful, 1 otherwise
+ * Returns: Upper bound of the bucket holding the percentile
  */
-int INPUTLIB_CALL listener_cbdumppoll(char* buffer, size_t len) {
-    if(!buffer || len == 0) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    EnterCriticalSection(&g_cs);
-    size_t pos = 0;
-    for(int i = 0; i < g_q_count; ++i) {
-        int idx = (g_q_head + i) % EVENT_QUEUE_CAPACITY;
-        Event* ev = &g_event_queue[idx];
-        char line[128];
-        int n = _snprintf(line, sizeof(line), "VK=0x%02X %s MOD=0x%02X INJ=%d TIME=%lu\n",
-         ev->vk, ev->pressed ? "DOWN" : "UP", ev->modifiers, ev->injected, ev->time);
-        if(n <= 0) continue;
-        if(pos + (size_t)n + 1 >= len) break;
-        memcpy(buffer + pos, line, (size_t)n);
-        pos += (size_t)n;
-    }
-    buffer[pos] = '\0';
-    LeaveCriticalSection(&g_cs);
-    return 0;
+static unsigned long long stats_percentile(const unsigned long long* hist, unsigned long long count, unsigned permille, unsigned long long max) {
+    if(count == 0) return 0;
+    unsigned long long rank = (count * permille + 999) / 1000;
+    unsigned long long seen = 0;
+    for(int b = 0; b < LISTENER_HIST_BUCKETS - 1; ++b) {
+        seen += hist[b];
+        if(seen < rank) continue;
+        if(b < 4) return (unsigned long long)b;
+        int e = b / 4 + 1;
+        unsigned long long hi = ((unsigned long long)(5 + b % 4) << (e - 2)) - 1;
+        return hi < max ? hi : max;
+    }
+    return max;
 }
 
 /*
- * listener_cbflush - Clear callback-related things
+ * listener_stats - Get listener hook instrumentation
  * 
- * Flushes (clears) polling queue and callback pointer without clearing 
- * blocklists or global block toggles.
+ * @out: Pointer to ListenerStats struct to populate
+ * @reset: If nonzero, counters, histograms and maxima restart from zero 
+ *         after being read, and the queue counters are reset as with 
+ *         listener_cbqueuestats
  * 
- * Returns: 0 (always succeeds)
+ * Hook time runs from entry to return of the hook procedure, and so 
+ * includes inline callbacks. Remap latency runs from the hook seeing a 
+ * remapped key to it seeing the first event of the replacement. Counters 
+ * are kept per thread and summed here, so reading never slows the hook 
+ * down.
+ * 
+ * Returns: 0 if successful, 1 if out is NULL
  */
-int INPUTLIB_CALL listener_cbflush(void) {
-    EnterCriticalSection(&g_cs);
-    q_clear();
-    g_callback = NULL;
-    LeaveCriticalSection(&g_cs);
+int INPUTLIB_CALL listener_stats(ListenerStats* out, int reset) {
+    if(!out) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+    EnterCriticalSection(&g_stats_cs);
+
+    StatBlock sum;
+    memset(&sum, 0, sizeof(sum));
+    unsigned epoch = __atomic_load_n(&g_stats_epoch, __ATOMIC_RELAXED);
+    int used = __atomic_load_n(&g_stats_claimed, __ATOMIC_RELAXED);
+    if(used > STAT_SLOTS) used = STAT_SLOTS;
+    for(int i = 0; i < used; ++i) {
+        StatBlock* b = &g_stats[i];
+        sum.events += __atomic_load_n(&b->events, __ATOMIC_RELAXED);
+        sum.hook_ns += __atomic_load_n(&b->hook_ns, __ATOMIC_RELAXED);
+        sum.callbacks += __atomic_load_n(&b->callbacks, __ATOMIC_RELAXED);
+        sum.callback_ns += __atomic_load_n(&b->callback_ns, __ATOMIC_RELAXED);
+        sum.lock_waits += __atomic_load_n(&b->lock_waits, __ATOMIC_RELAXED);
+        sum.lock_wait_ns += __atomic_load_n(&b->lock_wait_ns, __ATOMIC_RELAXED);
+        sum.remaps += __atomic_load_n(&b->remaps, __ATOMIC_RELAXED);
+        sum.remap_ns += __atomic_load_n(&b->remap_ns, __ATOMIC_RELAXED);
+        for(int r = 0; r < STAT_BLOCK_REASONS; ++r) sum.blocked[r] += __atomic_load_n(&b->blocked[r], __ATOMIC_RELAXED);
+        for(int h = 0; h < LISTENER_HIST_BUCKETS; ++h) {
+            sum.hook_hist[h] += __atomic_load_n(&b->hook_hist[h], __ATOMIC_RELAXED);
+            sum.callback_hist[h] += __atomic_load_n(&b->callback_hist[h], __ATOMIC_RELAXED);
+            sum.remap_hist[h] += __atomic_load_n(&b->remap_hist[h], __ATOMIC_RELAXED);
+        }
+        /* Maxima set before the last reset are stale */
+        if(__atomic_load_n(&b->epoch, __ATOMIC_ACQUIRE) == epoch) {
+            unsigned long long m = __atomic_load_n(&b->hook_max_ns, __ATOMIC_RELAXED);
+            if(m > sum.hook_max_ns) sum.hook_max_ns = m;
+            m = __atomic_load_n(&b->callback_max_ns, __ATOMIC_RELAXED);
+            if(m > sum.callback_max_ns) sum.callback_max_ns = m;
+            m = __atomic_load_n(&b->remap_max_ns, __ATOMIC_RELAXED);
+            if(m > sum.remap_max_ns) sum.remap_max_ns = m;
+        }
+    }
+
+    memset(out, 0, sizeof(*out));
+    StatBlock* base = &g_stats_base;
+    out->events = sum.events - base->events;
+    out->hook_total_ns = sum.hook_ns - base->hook_ns;
+    out->hook_max_ns = sum.hook_max_ns;
+    out->callbacks = sum.callbacks - base->callbacks;
+    out->callback_total_ns = sum.callback_ns - base->callback_ns;
+    out->callback_max_ns = sum.callback_max_ns;
+    out->lock_waits = sum.lock_waits - base->lock_waits;
+    out->lock_wait_ns = sum.lock_wait_ns - base->lock_wait_ns;
+    out->remaps = sum.remaps - base->remaps;
+    out->remap_total_ns = sum.remap_ns - base->remap_ns;
+    out->remap_max_ns = sum.remap_max_ns;
+    out->blocked_all = sum.blocked[STAT_BLOCK_ALL] - base->blocked[STAT_BLOCK_ALL];
+    out->blocked_sim = sum.blocked[STAT_BLOCK_SIM] - base->blocked[STAT_BLOCK_SIM];
+    out->blocked_phys = sum.blocked[STAT_BLOCK_PHYS] - base->blocked[STAT_BLOCK_PHYS];
+    out->blocked_key = sum.blocked[STAT_BLOCK_KEY] - base->blocked[STAT_BLOCK_KEY];
+    out->blocked_group = sum.blocked[STAT_BLOCK_GROUP] - base->blocked[STAT_BLOCK_GROUP];
+    out->blocked_combo = sum.blocked[STAT_BLOCK_COMBO] - base->blocked[STAT_BLOCK_COMBO];
+    out->blocked_debounce = sum.blocked[STAT_BLOCK_DEBOUNCE] - base->blocked[STAT_BLOCK_DEBOUNCE];
+    out->blocked_hotkey = sum.blocked[STAT_BLOCK_HOTKEY] - base->blocked[STAT_BLOCK_HOTKEY];
+    out->blocked_self = sum.blocked[STAT_BLOCK_SELF] - base->blocked[STAT_BLOCK_SELF];
+    out->blocked_remap = sum.blocked[STAT_BLOCK_REMAP] - base->blocked[STAT_BLOCK_REMAP];
+    out->blocked_scope = sum.blocked[STAT_BLOCK_SCOPE] - base->blocked[STAT_BLOCK_SCOPE];
+    for(int h = 0; h < LISTENER_HIST_BUCKETS; ++h) {
+        out->hook_hist[h] = sum.hook_hist[h] - base->hook_hist[h];
+        out->callback_hist[h] = sum.callback_hist[h] - base->callback_hist[h];
+        out->remap_hist[h] = sum.remap_hist[h] - base->remap_hist[h];
+    }
+    /* Histogram totals, a hook may be mid-update between its counters */
+    unsigned long long hooks = 0, calls = 0, remaps = 0;
+    for(int h = 0; h < LISTENER_HIST_BUCKETS; ++h) {
+        hooks += out->hook_hist[h];
+        calls += out->callback_hist[h];
+        remaps += out->remap_hist[h];
+    }
+    out->hook_mean_ns = out->events ? out->hook_total_ns / out->events : 0;
+    out->hook_p50_ns = stats_percentile(out->hook_hist, hooks, 500, out->hook_max_ns);
+    out->hook_p99_ns = stats_percentile(out->hook_hist, hooks, 990, out->hook_max_ns);
+    out->hook_p999_ns = stats_percentile(out->hook_hist, hooks, 999, out->hook_max_ns);
+    out->callback_mean_ns = out->callbacks ? out->callback_total_ns / out->callbacks : 0;
+    out->callback_p99_ns = stats_percentile(out->callback_hist, calls, 990, out->callback_max_ns);
+    out->remap_mean_ns = out->remaps ? out->remap_total_ns / out->remaps : 0;
+    out->remap_p99_ns = stats_percentile(out->remap_hist, remaps, 990, out->remap_max_ns);
+
+    ListenerQueueStats poll, disp;
+    eventq_stats(&g_poll_q, &poll, reset);
+    eventq_stats(&g_dispatch_q, &disp, reset);
+    out->queue_length = poll.length + disp.length;
+    out->queue_high_water = poll.high_water > disp.high_water ? poll.high_water : disp.high_water;
+    out->dropped = poll.dropped + disp.dropped;
+
+    if(reset) {
+        g_stats_base = sum;
+        __atomic_fetch_add(&g_stats_epoch, 1, __ATOMIC_RELAXED);
+    }
+    LeaveCriticalSection(&g_stats_cs);
     return 0;
 }
 
@@ -739,18 +2757,19 @@ int INPUTLIB_CALL listener_cbflush(void) {
  * @key: Name of the key to block
  * 
  * Blocks all input from the given key. Given the way that the blocking works, 
- * blocking a key will also disable all combos using that key.
+ * blocking a key will also disable all combos using that key. Like every 
+ * name taken by the listener, a single character is resolved on the 
+ * keyboard layout active when the rule is added.
  * 
  * Returns: 0 on success, 1 if key name not found
  */
 int INPUTLIB_CALL listener_block(const char* key) {
     if(!key) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    BYTE vk = find_vk(key);
+    BYTE vk = layout_find(key);
     if(!vk) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     g_blocked_keys[vk] = 1;
-    LeaveCriticalSection(&g_cs);
-    return 0;
+    return rules_changed();
 }
 
 /*
@@ -764,12 +2783,11 @@ int INPUTLIB_CALL listener_block(const char* key) {
  */
 int INPUTLIB_CALL listener_ublock(const char* key) {
     if(!key) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    BYTE vk = find_vk(key);
+    BYTE vk = layout_find(key);
     if(!vk) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     g_blocked_keys[vk] = 0;
-    LeaveCriticalSection(&g_cs);
-    return 0;
+    return rules_changed();
 }
 
 /*
@@ -783,10 +2801,9 @@ int INPUTLIB_CALL listener_ublock(const char* key) {
  */
 int INPUTLIB_CALL listener_blocka(int vk) {
     if(!vk) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     g_blocked_keys[vk] = 1;
-    LeaveCriticalSection(&g_cs);
-    return 0;
+    return rules_changed();
 }
 
 /*
@@ -800,10 +2817,9 @@ int INPUTLIB_CALL listener_blocka(int vk) {
  */
 int INPUTLIB_CALL listener_ublocka(int vk) {
     if(!vk) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     g_blocked_keys[vk] = 0;
-    LeaveCriticalSection(&g_cs);
-    return 0;
+    return rules_changed();
 }
 
 /*
@@ -818,15 +2834,14 @@ int INPUTLIB_CALL listener_ublocka(int vk) {
  */
 int INPUTLIB_CALL listener_blockc(const char* mod, const char* key) {
     if(!mod || !key) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    BYTE vm = find_vk(mod);
-    BYTE vk = find_vk(key);
+    BYTE vm = layout_find(mod);
+    BYTE vk = layout_find(key);
     if(!vm || !vk) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     BYTE mods[1] = { vm };
     int ok = combo_add(mods, 1, vk);
-    LeaveCriticalSection(&g_cs);
-    if(!ok) { SetLastError(ERROR_OUTOFMEMORY); return 1; }
-    return 0;
+    if(!ok) { LeaveCriticalSection(&g_rules_cs); SetLastError(ERROR_OUTOFMEMORY); return 1; }
+    return rules_changed();
 }
 
 /*
@@ -841,12 +2856,12 @@ int INPUTLIB_CALL listener_blockc(const char* mod, const char* key) {
  */
 int INPUTLIB_CALL listener_ublockc(const char* mod, const char* key) {
     if(!mod || !key) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    BYTE vm = find_vk(mod);
-    BYTE vk = find_vk(key);
+    BYTE vm = layout_find(mod);
+    BYTE vk = layout_find(key);
     if(!vm || !vk) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     int removed = combo_remove((BYTE*)&vm, 1, vk);
-    LeaveCriticalSection(&g_cs);
+    if(rules_changed()) return 1;
     return removed ? 0 : 1;
 }
 
@@ -863,16 +2878,15 @@ int INPUTLIB_CALL listener_ublockc(const char* mod, const char* key) {
  */
 int INPUTLIB_CALL listener_blockct(const char* mod1, const char* mod2, const char* key) {
     if(!mod1 || !mod2 || !key) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    BYTE m1 = find_vk(mod1);
-    BYTE m2 = find_vk(mod2);
-    BYTE vk = find_vk(key);
+    BYTE m1 = layout_find(mod1);
+    BYTE m2 = layout_find(mod2);
+    BYTE vk = layout_find(key);
     if(!m1 || !m2 || !vk) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
     BYTE mods[2] = { m1, m2 };
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     int ok = combo_add(mods, 2, vk);
-    LeaveCriticalSection(&g_cs);
-    if(!ok) { SetLastError(ERROR_OUTOFMEMORY); return 1; }
-    return 0;
+    if(!ok) { LeaveCriticalSection(&g_rules_cs); SetLastError(ERROR_OUTOFMEMORY); return 1; }
+    return rules_changed();
 }
 
 /*
@@ -888,14 +2902,14 @@ int INPUTLIB_CALL listener_blockct(const char* mod1, const char* mod2, const cha
  */
 int INPUTLIB_CALL listener_ublockct(const char* mod1, const char* mod2, const char* key) {
     if(!mod1 || !mod2 || !key) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    BYTE m1 = find_vk(mod1);
-    BYTE m2 = find_vk(mod2);
-    BYTE vk = find_vk(key);
+    BYTE m1 = layout_find(mod1);
+    BYTE m2 = layout_find(mod2);
+    BYTE vk = layout_find(key);
     if(!m1 || !m2 || !vk) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
     BYTE mods[2] = { m1, m2 };
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     int removed = combo_remove(mods, 2, vk);
-    LeaveCriticalSection(&g_cs);
+    if(rules_changed()) return 1;
     return removed ? 0 : 1;
 }
 
@@ -920,19 +2934,18 @@ int INPUTLIB_CALL listener_blockca(const char** keys, int count) {
     if(!mods) { SetLastError(ERROR_OUTOFMEMORY); return 1; }
 
     for(int i = 0; i < count - 1; ++i) {
-        BYTE v = find_vk(keys[i]);
+        BYTE v = layout_find(keys[i]);
         if(!v) { free(mods); SetLastError(ERROR_INVALID_PARAMETER); return 1; }
         mods[i] = v;
     }
 
-    BYTE vk = find_vk(keys[count - 1]);
+    BYTE vk = layout_find(keys[count - 1]);
     if(!vk) { free(mods); SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     int ok = combo_add(mods, count - 1, vk);
-    LeaveCriticalSection(&g_cs);
     free(mods);
-    if(!ok) { SetLastError(ERROR_OUTOFMEMORY); return 1; }
-    return 0;
+    if(!ok) { LeaveCriticalSection(&g_rules_cs); SetLastError(ERROR_OUTOFMEMORY); return 1; }
+    return rules_changed();
 }
 
 /*
@@ -956,17 +2969,17 @@ int INPUTLIB_CALL listener_ublockca(const char** keys, int count) {
     if(!mods) { SetLastError(ERROR_OUTOFMEMORY); return 1; }
 
     for(int i = 0; i < count - 1; ++i) {
-        BYTE v = find_vk(keys[i]);
+        BYTE v = layout_find(keys[i]);
         if(!v) { free(mods); SetLastError(ERROR_INVALID_PARAMETER); return 1; }
         mods[i] = v;
     }
 
-    BYTE vk = find_vk(keys[count - 1]);
+    BYTE vk = layout_find(keys[count - 1]);
     if(!vk) { free(mods); SetLastError(ERROR_INVALID_PARAMETER); return 1; }
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     int removed = combo_remove(mods, count - 1, vk);
-    LeaveCriticalSection(&g_cs);
     free(mods);
+    if(rules_changed()) return 1;
     return removed ? 0 : 1;
 }
 
@@ -983,15 +2996,16 @@ int INPUTLIB_CALL listener_ublockca(const char** keys, int count) {
  */
 int INPUTLIB_CALL listener_isblocked(const char* key) {
     if(!key) { SetLastError(ERROR_INVALID_PARAMETER); return -1; }
-    BYTE vk = find_vk(key);
+    BYTE vk = layout_find(key);
     if(!vk) { SetLastError(ERROR_INVALID_PARAMETER); return -1; }
-    EnterCriticalSection(&g_cs);
-    if(g_blocked_keys[vk]) { LeaveCriticalSection(&g_cs); return 1; }
-    for(int gi = 0; gi < GROUP_COUNT; ++gi) {
-        if(g_blocked_groups[gi] && vk_in_group(vk, (GroupId)gi)) { LeaveCriticalSection(&g_cs); return 1; }
+    const RuleSet* rs;
+    int slot = rules_read_lock(&rs);
+    int v = rs->keys[vk];
+    for(int gi = 0; gi < GROUP_COUNT && !v; ++gi) {
+        if(rs->groups[gi] && vk_in_group(vk, (GroupId)gi)) v = 1;
     }
-    LeaveCriticalSection(&g_cs);
-    return 0;
+    rules_read_unlock(slot);
+    return v;
 }
 
 /*
@@ -1000,17 +3014,16 @@ int INPUTLIB_CALL listener_isblocked(const char* key) {
  * @key: Name of the key to check
  * 
  * Queries the current state of a key to determine if it is being held down.
- * Uses GetAsyncKeyState to check the high-order bit which indicates if the 
- * key is currently pressed. Functionally identical to key_isdown.
+ * Uses the backend key state (GetAsyncKeyState on Windows). Functionally 
+ * identical to key_isdown.
  * 
  * Returns: 1 if key is down, 0 if key is up, -1 on error or key not found
  */
 int INPUTLIB_CALL listener_keystate(const char* key) {
     if(!key) { SetLastError(ERROR_INVALID_PARAMETER); return -1; }
-    BYTE vk = find_vk(key);
+    BYTE vk = layout_find(key);
     if(!vk) { SetLastError(ERROR_INVALID_PARAMETER); return -1; }
-    SHORT s = GetAsyncKeyState((int)vk);
-    return (s & 0x8000) ? 1 : 0;
+    return g_backend->key_state((int)vk);
 }
 
 /*
@@ -1036,10 +3049,9 @@ int INPUTLIB_CALL listener_modstate(int* out_mask) {
  * Returns: 0 (always succeeds)
  */
 int INPUTLIB_CALL listener_blockall(int enabled) {
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     g_block_all = enabled ? 1 : 0;
-    LeaveCriticalSection(&g_cs);
-    return 0;
+    return rules_changed();
 }
 
 /*
@@ -1054,10 +3066,9 @@ int INPUTLIB_CALL listener_blockall(int enabled) {
  * Returns: 0 (always succeeds)
  */
 int INPUTLIB_CALL listener_blocksim(int enabled) {
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     g_block_sim = enabled ? 1 : 0;
-    LeaveCriticalSection(&g_cs);
-    return 0;
+    return rules_changed();
 }
 
 /*
@@ -1070,10 +3081,9 @@ int INPUTLIB_CALL listener_blocksim(int enabled) {
  * 1 enables, 0 disables.
  */
 int INPUTLIB_CALL listener_blockphys(int enabled) {
-    EnterCriticalSection(&g_cs);
+    EnterCriticalSection(&g_rules_cs);
     g_block_phys = enabled ? 1 : 0;
-    LeaveCriticalSection(&g_cs);
-    return 0;
+    return rules_changed();
 }
 
 /*
@@ -1084,9 +3094,10 @@ int INPUTLIB_CALL listener_blockphys(int enabled) {
  * Returns: 1 if enabled, 0 if disabled
  */
 int INPUTLIB_CALL listener_isblockall(void) {
-    EnterCriticalSection(&g_cs);
-    int v = g_block_all;
-    LeaveCriticalSection(&g_cs);
+    const RuleSet* rs;
+    int slot = rules_read_lock(&rs);
+    int v = rs->block_all;
+    rules_read_unlock(slot);
     return v;
 }
 
@@ -1098,9 +3109,10 @@ int INPUTLIB_CALL listener_isblockall(void) {
  * Returns: 1 if enabled, 0 if disabled
  */
 int INPUTLIB_CALL listener_isblocksim(void) {
-    EnterCriticalSection(&g_cs);
-    int v = g_block_sim;
-    LeaveCriticalSection(&g_cs);
+    const RuleSet* rs;
+    int slot = rules_read_lock(&rs);
+    int v = rs->block_sim;
+    rules_read_unlock(slot);
     return v;
 }
 
@@ -1112,12 +3124,520 @@ int INPUTLIB_CALL listener_isblocksim(void) {
  * Returns: 1 if enabled, 0 if disabled
  */
 int INPUTLIB_CALL listener_isblockphys(void) {
-    EnterCriticalSection(&g_cs);
-    int v = g_block_phys;
-    LeaveCriticalSection(&g_cs);
+    const RuleSet* rs;
+    int slot = rules_read_lock(&rs);
+    int v = rs->block_phys;
+    rules_read_unlock(slot);
     return v;
 }
 
+/*
+ * listener_debounce - Debounce a key
+ * 
+ * @vk: Virtual key code, or 0 for every key
+ * @ms: Debounce window in milliseconds, 0 to turn debouncing off
+ * 
+ * A physical press arriving within ms of the same key's last release is 
+ * treated as switch chatter. It is swallowed together with its release, 
+ * so neither the system nor the consumers see the bounce. A key held 
+ * down through the window still registers, since its next press or 
+ * auto-repeat is let through. Injected input is never debounced.
+ * 
+ * Returns: 0 on success, 1 if vk or ms is out of range
+ */
+int INPUTLIB_CALL listener_debounce(int vk, int ms) {
+    if(vk < 0 || vk > 0xFF || ms < 0 || ms > 0xFFFF) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+    EnterCriticalSection(&g_rules_cs);
+    if(vk == 0) {
+        for(int i = 0; i < 256; ++i) g_debounce_ms[i] = (unsigned short)ms;
+    } else {
+        g_debounce_ms[vk] = (unsigned short)ms;
+    }
+    return rules_changed();
+}
+
+/*
+ * listener_repeatfold - Fold auto-repeats
+ * 
+ * @enabled: 1 to fold, 0 to deliver every repeat
+ * 
+ * Holding a key makes the system repeat its press. With folding, repeats 
+ * still pass through to the system but are not delivered to consumers, 
+ * and the release carries the number of repeats in EventEx.repeat. 
+ * Without it, each repeat is delivered with EventEx.repeat set to 1.
+ * 
+ * Returns: 0 (always succeeds)
+ */
+int INPUTLIB_CALL listener_repeatfold(int enabled) {
+    __atomic_store_n(&g_repeat_fold, enabled ? 1 : 0, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/*
+ * listener_selfinput - Choose how the library's own input is handled
+ * 
+ * @mode: LISTENER_SELF_DELIVER, LISTENER_SELF_SKIP or LISTENER_SELF_BLOCK
+ * 
+ * Every event the library injects carries a per-process signature in its 
+ * extra info, reported as EventEx.self, so it can be told apart from 
+ * other automation tools. LISTENER_SELF_SKIP passes those events on 
+ * without rules, hotkeys, sequences, recording, stats or delivery, only 
+ * keeping track of held keys and modifiers. LISTENER_SELF_BLOCK blocks 
+ * them. Other injected input is unaffected, and so are the replacements 
+ * of listener_remap, which always reach the system.
+ * 
+ * Returns: 0 on success, 1 on an invalid mode
+ */
+int INPUTLIB_CALL listener_selfinput(int mode) {
+    if(mode < LISTENER_SELF_DELIVER || mode > LISTENER_SELF_BLOCK) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 1;
+    }
+    __atomic_store_n(&g_self_mode, mode, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/*
+ * listener_blockbegin - Begin a batch of block rule changes
+ * 
+ * Block and unblock calls made until the matching listener_blockcommit 
+ * update the working rules only. The hook keeps using the previous rules 
+ * until the whole batch is published at once. No lock is held between 
+ * the calls, so callbacks may still change rules; changes made from any 
+ * thread while a batch is open join it. Batches may nest.
+ * 
+ * Returns: 0 (always succeeds)
+ */
+int INPUTLIB_CALL listener_blockbegin(void) {
+    EnterCriticalSection(&g_rules_cs);
+    g_rules_batch++;
+    LeaveCriticalSection(&g_rules_cs);
+    return 0;
+}
+
+/*
+ * listener_blockcommit - Publish a batch of block rule changes
+ * 
+ * Ends the batch opened by listener_blockbegin. The outermost commit 
+ * compiles all changes into one snapshot and swaps it in.
+ * 
+ * Returns: 0 on success, 1 if no batch is open or out of memory
+ */
+int INPUTLIB_CALL listener_blockcommit(void) {
+    EnterCriticalSection(&g_rules_cs);
+    if(g_rules_batch == 0) {
+        LeaveCriticalSection(&g_rules_cs);
+        SetLastError(ERROR_INVALID_OPERATION);
+        return 1;
+    }
+    g_rules_batch--;
+    return rules_changed();
+}
+
+/*
+ * hotkey_register - Register a callback for a key chord
+ * 
+ * @keys: Array of key names, modifiers and held keys first, trigger last
+ * @count: Number of items in the array
+ * @callback: Called with the hotkey id and the event, on the dispatcher 
+ *            thread if listener_cbdispatch is enabled, else on the hook 
+ *            thread
+ * @flags: HOTKEY_* flags
+ * 
+ * Fires when the trigger is pressed while exactly the given modifiers are 
+ * held, going by the listener's own modifier tracking, and every other 
+ * listed key is down. Generic modifier names match either side. Hotkeys 
+ * are indexed by (trigger, modifiers) in the rule snapshot, so matching 
+ * costs one hash probe per event however many are registered. With 
+ * HOTKEY_SWALLOW the trigger's press, repeats and release are blocked 
+ * from other applications and from the listener's consumers; that is 
+ * decided in the hook even when the callback is dispatched. Callbacks run 
+ * inside the hook without the dispatcher and should then return quickly. 
+ * Takes part in listener_blockbegin batches.
+ * 
+ * Returns: Hotkey id (1 or greater) on success, 0 on failure
+ */
+int INPUTLIB_CALL hotkey_register(const char** keys, int count, void (*callback)(int id, EventEx* ev), int flags) {
+    if(!keys || count <= 0 || !callback || (flags & ~(HOTKEY_SWALLOW | HOTKEY_REPEAT | HOTKEY_PHYSICAL))) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 0;
+    }
+
+    Hotkey hk;
+    memset(&hk, 0, sizeof(hk));
+    for(int i = 0; i < count; ++i) {
+        BYTE v = layout_find(keys[i]);
+        if(!v) { SetLastError(ERROR_INVALID_PARAMETER); return 0; }
+        if(i == count - 1) {
+            hk.key = v;
+            hk.mods |= hotkey_modbit(v);
+        } else if(hotkey_modbit(v)) {
+            hk.mods |= hotkey_modbit(v);
+        } else {
+            hk.extra.w[v >> 6] |= 1ULL << (v & 63);
+        }
+    }
+    hk.flags = flags;
+    hk.cb = callback;
+
+    EnterCriticalSection(&g_rules_cs);
+    if(g_hotkey_count == g_hotkey_cap) {
+        int cap = g_hotkey_cap ? g_hotkey_cap * 2 : 16;
+        Hotkey* grown = (Hotkey*)realloc(g_hotkeys, (size_t)cap * sizeof(Hotkey));
+        if(!grown) {
+            LeaveCriticalSection(&g_rules_cs);
+            SetLastError(ERROR_OUTOFMEMORY);
+            return 0;
+        }
+        g_hotkeys = grown;
+        g_hotkey_cap = cap;
+    }
+    hk.id = g_hotkey_next_id++;
+    g_hotkeys[g_hotkey_count++] = hk;
+    if(rules_publish()) {
+        g_hotkey_count--;
+        LeaveCriticalSection(&g_rules_cs);
+        SetLastError(ERROR_OUTOFMEMORY);
+        return 0;
+    }
+    LeaveCriticalSection(&g_rules_cs);
+    return hk.id;
+}
+
+/*
+ * hotkey_unregister - Remove a registered hotkey
+ * 
+ * @id: Id returned by hotkey_register
+ * 
+ * The callback is not called again once this returns, except by an 
+ * event the hook was already matching.
+ * 
+ * Returns: 0 on success, 1 if id not found or out of memory
+ */
+int INPUTLIB_CALL hotkey_unregister(int id) {
+    EnterCriticalSection(&g_rules_cs);
+    int i = 0;
+    while(i < g_hotkey_count && g_hotkeys[i].id != id) ++i;
+    if(i == g_hotkey_count) {
+        LeaveCriticalSection(&g_rules_cs);
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 1;
+    }
+    memmove(&g_hotkeys[i], &g_hotkeys[i + 1], (size_t)(g_hotkey_count - i - 1) * sizeof(Hotkey));
+    g_hotkey_count--;
+    return rules_changed();
+}
+
+/*
+ * sequence_parse_step - Parse one step of a key sequence
+ * 
+ * @step: Key name, optionally preceded by modifier names joined with '+', 
+ *        such as "CONTROL+SHIFT+K". "+" alone or last names the plus key.
+ * @out: Receives the SEQ_SYMBOL
+ * 
+ * Returns: 0 on success, 1 if a name is unknown or a non-modifier is not last
+ */
+static int sequence_parse_step(const char* step, unsigned* out) {
+    int mods = 0;
+    BYTE vk = 0;
+    const char* p = step;
+    while(*p) {
+        const char* e = p + 1;  /* A part has at least one character, so "+" can name a key */
+        while(*e && *e != '+') ++e;
+        if(*e && !e[1]) return 1;  /* Trailing '+' */
+        char name[32];
+        size_t len = (size_t)(e - p);
+        if(len >= sizeof(name)) return 1;
+        memcpy(name, p, len);
+        name[len] = '\0';
+        if(vk && !hotkey_modbit(vk)) return 1;  /* Only modifiers may come before the key */
+        vk = layout_find(name);
+        if(!vk) return 1;
+        mods |= hotkey_modbit(vk);
+        p = *e ? e + 1 : e;
+    }
+    if(!vk) return 1;
+    *out = SEQ_SYMBOL(hotkey_generic(vk), mods);
+    return 0;
+}
+
+/*
+ * sequence_register - Register a callback for a sequence of key presses
+ * 
+ * @steps: Array of steps, each a key name optionally preceded by modifiers 
+ *         joined with '+', such as { "CONTROL+K", "CONTROL+C" } or 
+ *         { "G", "G" }
+ * @count: Number of steps, at most SEQUENCE_MAX_STEPS
+ * @callback: Called with the sequence id and the event of the last step, 
+ *            on the dispatcher thread if listener_cbdispatch is enabled, 
+ *            else on the hook thread
+ * @timeout_ms: Longest gap allowed between two steps, 0 for no limit
+ * @flags: HOTKEY_SWALLOW to block the last step's press and release, 
+ *         HOTKEY_PHYSICAL to ignore injected presses
+ * 
+ * All sequences are compiled into one automaton in the rule snapshot that 
+ * takes a single transition per key press, so matching costs the same 
+ * however many are registered. Each step must be pressed with exactly its 
+ * modifiers held, and any other key pressed in between restarts matching. 
+ * Auto-repeats are ignored, and a modifier only counts as a step when some 
+ * sequence uses it as one. Modifiers match either side. When several 
+ * sequences end on the same press, such as "G" and "G G", all of them 
+ * fire, and matching then starts over. Takes part in listener_blockbegin 
+ * batches.
+ * 
+ * Returns: Sequence id (1 or greater) on success, 0 on failure
+ */
+int INPUTLIB_CALL sequence_register(const char** steps, int count, void (*callback)(int id, EventEx* ev), int timeout_ms, int flags) {
+    if(!steps || count <= 0 || count > SEQUENCE_MAX_STEPS || !callback || timeout_ms < 0 ||
+       (flags & ~(HOTKEY_SWALLOW | HOTKEY_PHYSICAL))) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 0;
+    }
+
+    SeqDef def;
+    memset(&def, 0, sizeof(def));
+    for(int i = 0; i < count; ++i) {
+        if(!steps[i] || sequence_parse_step(steps[i], &def.steps[i])) {
+            SetLastError(ERROR_INVALID_PARAMETER);
+            return 0;
+        }
+    }
+    def.out.flags = flags;
+    def.out.count = count;
+    def.out.timeout_ms = timeout_ms;
+    def.out.cb = callback;
+
+    EnterCriticalSection(&g_rules_cs);
+    if(g_seq_count == g_seq_cap) {
+        int cap = g_seq_cap ? g_seq_cap * 2 : 16;
+        SeqDef* grown = (SeqDef*)realloc(g_seqs, (size_t)cap * sizeof(SeqDef));
+        if(!grown) {
+            LeaveCriticalSection(&g_rules_cs);
+            SetLastError(ERROR_OUTOFMEMORY);
+            return 0;
+        }
+        g_seqs = grown;
+        g_seq_cap = cap;
+    }
+    def.out.id = g_hotkey_next_id++;
+    g_seqs[g_seq_count++] = def;
+    if(rules_publish()) {
+        g_seq_count--;
+        LeaveCriticalSection(&g_rules_cs);
+        SetLastError(ERROR_OUTOFMEMORY);
+        return 0;
+    }
+    LeaveCriticalSection(&g_rules_cs);
+    return def.out.id;
+}
+
+/*
+ * sequence_unregister - Remove a registered sequence
+ * 
+ * @id: Id returned by sequence_register
+ * 
+ * Sequences partly typed when this is called are forgotten.
+ * 
+ * Returns: 0 on success, 1 if id not found or out of memory
+ */
+int INPUTLIB_CALL sequence_unregister(int id) {
+    EnterCriticalSection(&g_rules_cs);
+    int i = 0;
+    while(i < g_seq_count && g_seqs[i].out.id != id) ++i;
+    if(i == g_seq_count) {
+        LeaveCriticalSection(&g_rules_cs);
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 1;
+    }
+    memmove(&g_seqs[i], &g_seqs[i + 1], (size_t)(g_seq_count - i - 1) * sizeof(SeqDef));
+    g_seq_count--;
+    return rules_changed();
+}
+
+/*
+ * listener_remap - Remap a key inside the hook
+ * 
+ * @key: Name of the key to remap
+ * @to: Replacement steps, each a key name optionally preceded by modifiers 
+ *      joined with '+', as for sequence_register
+ * @count: Number of steps, at most LISTENER_REMAP_MAX
+ * 
+ * With one step, the target (with its modifiers) is held down in place of 
+ * the key, so { "CONTROL" } turns the key into a control key. With more, 
+ * the steps are typed one after the other when the key is pressed. The 
+ * original event is swallowed and the replacement sent from the hook in 
+ * one submission. Replacements carry the library's injection tag and are 
+ * never remapped again, so remaps cannot chain or loop. Physical and 
+ * other tools' injected presses are remapped alike. Replaces any remap 
+ * of the same key.
+ * 
+ * Returns: 0 on success, 1 on invalid parameters or out of memory
+ */
+int INPUTLIB_CALL listener_remap(const char* key, const char** to, int count) {
+    if(!key || !to || count <= 0 || count > LISTENER_REMAP_MAX) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 1;
+    }
+    BYTE vk = layout_find(key);
+    if(!vk) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+    Remap r;
+    memset(&r, 0, sizeof(r));
+    for(int i = 0; i < count; ++i) {
+        if(!to[i] || sequence_parse_step(to[i], &r.steps[i])) {
+            SetLastError(ERROR_INVALID_PARAMETER);
+            return 1;
+        }
+    }
+    r.count = count;
+
+    EnterCriticalSection(&g_rules_cs);
+    Remap prev = g_remaps[vk];
+    if(!prev.count) g_remap_count++;
+    g_remaps[vk] = r;
+    if(rules_publish()) {
+        if(!prev.count) g_remap_count--;
+        g_remaps[vk] = prev;
+        LeaveCriticalSection(&g_rules_cs);
+        SetLastError(ERROR_OUTOFMEMORY);
+        return 1;
+    }
+    LeaveCriticalSection(&g_rules_cs);
+    return 0;
+}
+
+/*
+ * listener_unremap - Remove a key remap
+ * 
+ * @key: Name of the remapped key
+ * 
+ * A target held down by the remap is still released with the key.
+ * 
+ * Returns: 0 on success, 1 if key not found or not remapped
+ */
+int INPUTLIB_CALL listener_unremap(const char* key) {
+    if(!key) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+    BYTE vk = layout_find(key);
+    if(!vk) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+    EnterCriticalSection(&g_rules_cs);
+    if(!g_remaps[vk].count) {
+        LeaveCriticalSection(&g_rules_cs);
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 1;
+    }
+    Remap prev = g_remaps[vk];
+    g_remaps[vk].count = 0;
+    g_remap_count--;
+    if(rules_publish()) {
+        g_remap_count++;
+        g_remaps[vk] = prev;
+        LeaveCriticalSection(&g_rules_cs);
+        SetLastError(ERROR_OUTOFMEMORY);
+        return 1;
+    }
+    LeaveCriticalSection(&g_rules_cs);
+    return 0;
+}
+
+/*
+ * scoped_find - Find a scoped block in the working rules
+ * 
+ * Caller must hold the rules CS.
+ * 
+ * Returns: Index into g_scoped, or -1 if not found
+ */
+static int scoped_find(const ScopedRule* r) {
+    for(int i = 0; i < g_scoped_count; ++i) {
+        if(g_scoped[i].vk == r->vk && g_scoped[i].scope == r->scope && strcmp(g_scoped[i].match, r->match) == 0) return i;
+    }
+    return -1;
+}
+
+/*
+ * scoped_parse - Validate the arguments of a scoped block
+ * 
+ * Returns: 0 on success, 1 on invalid parameters
+ */
+static int scoped_parse(const char* key, int scope, const char* match, ScopedRule* out) {
+    if(!key || !match || !match[0] || scope < LISTENER_SCOPE_PROCESS || scope > LISTENER_SCOPE_TITLE) return 1;
+    memset(out, 0, sizeof(*out));
+    out->vk = layout_find(key);
+    if(!out->vk) return 1;
+    out->scope = scope;
+    scope_lower(out->match, sizeof(out->match), match);
+    return 0;
+}
+
+/*
+ * listener_blockscope - Block a key while a window is in the foreground
+ * 
+ * @key: Name of the key to block
+ * @scope: LISTENER_SCOPE_PROCESS, LISTENER_SCOPE_CLASS or LISTENER_SCOPE_TITLE
+ * @match: Executable name or class name to equal, or text the title must 
+ *         contain, ignoring case
+ * 
+ * Blocks the key like listener_block, but only while the foreground window 
+ * matches. The foreground is resolved when it changes, not per event, and 
+ * a title change of the foreground window counts as a change. Takes part 
+ * in listener_blockbegin batches. Adding a block that exists does nothing.
+ * 
+ * Returns: 0 on success, 1 on invalid parameters or out of memory
+ */
+int INPUTLIB_CALL listener_blockscope(const char* key, int scope, const char* match) {
+    ScopedRule r;
+    if(scoped_parse(key, scope, match, &r)) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+
+    EnterCriticalSection(&g_rules_cs);
+    if(scoped_find(&r) >= 0) {
+        LeaveCriticalSection(&g_rules_cs);
+        return 0;
+    }
+    if(g_scoped_count == g_scoped_cap) {
+        int cap = g_scoped_cap ? g_scoped_cap * 2 : 16;
+        ScopedRule* grown = (ScopedRule*)realloc(g_scoped, (size_t)cap * sizeof(ScopedRule));
+        if(!grown) {
+            LeaveCriticalSection(&g_rules_cs);
+            SetLastError(ERROR_OUTOFMEMORY);
+            return 1;
+        }
+        g_scoped = grown;
+        g_scoped_cap = cap;
+    }
+    g_scoped[g_scoped_count++] = r;
+    if(rules_publish()) {
+        g_scoped_count--;
+        LeaveCriticalSection(&g_rules_cs);
+        SetLastError(ERROR_OUTOFMEMORY);
+        return 1;
+    }
+    LeaveCriticalSection(&g_rules_cs);
+    return 0;
+}
+
+/*
+ * listener_ublockscope - Remove a foreground scoped block
+ * 
+ * @key: Name of the blocked key
+ * @scope: Scope given to listener_blockscope
+ * @match: Match given to listener_blockscope, case is ignored
+ * 
+ * Returns: 0 on success, 1 if the block was not found or out of memory
+ */
+int INPUTLIB_CALL listener_ublockscope(const char* key, int scope, const char* match) {
+    ScopedRule r;
+    if(scoped_parse(key, scope, match, &r)) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+
+    EnterCriticalSection(&g_rules_cs);
+    int i = scoped_find(&r);
+    if(i < 0) {
+        LeaveCriticalSection(&g_rules_cs);
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 1;
+    }
+    memmove(&g_scoped[i], &g_scoped[i + 1], (size_t)(g_scoped_count - i - 1) * sizeof(ScopedRule));
+    g_scoped_count--;
+    return rules_changed();
+}
+
 
 
 /*
@@ -1132,7 +3652,47 @@ void listener_init(void) {
     static int inited = 0;
     if(inited) return;
     InitializeCriticalSection(&g_cs);
-    g_start_time = GetTickCount64();
-    g_last_event_time = g_start_time;
+    InitializeCriticalSection(&g_rules_cs);
+    InitializeCriticalSection(&g_fg_cs);
+    eventq_init(&g_poll_q);
+    eventq_init(&g_dispatch_q);
+    InitializeCriticalSection(&g_dispatch_cs);
+    InitializeConditionVariable(&g_dispatch_cv);
+    InitializeCriticalSection(&g_wait_timer_cs);
+    InitializeConditionVariable(&g_wait_timer_cv);
+    recorder_init();
+    InitializeCriticalSection(&g_stats_cs);
+    g_stats[STAT_SLOTS - 1].shared = 1;
+    g_start_ns = g_backend->now_ns();
+    g_last_event_ns = g_start_ns;
     inited = 1;
+}
+
+/*
+ * listener_rebase - Re-base event timestamps
+ * 
+ * Resets the listener start time to the current backend clock, so event 
+ * times stay meaningful after switching backends or resetting the 
+ * simulated clock.
+ * 
+ * Returns: nothing
+ */
+void listener_rebase(void) {
+    EnterCriticalSection(&g_cs);
+    g_start_ns = g_backend->now_ns();
+    g_last_event_ns = g_start_ns;
+    memset(g_key_down_ns, 0, sizeof(g_key_down_ns));
+    LeaveCriticalSection(&g_cs);
+}
+
+/*
+ * listener_isrunning - Check if the listener hook is installed
+ * 
+ * Returns: 1 if running, 0 otherwise
+ */
+int listener_isrunning(void) {
+    EnterCriticalSection(&g_cs);
+    int v = g_running;
+    LeaveCriticalSection(&g_cs);
+    return v;
 }
\ No newline at end of file
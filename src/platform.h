@@ -0,0 +1,163 @@
+/*
+ * platform.h - Internal platform compatibility layer
+ *
+ * On Windows this simply pulls in <windows.h>. Everywhere else it provides
+ * the small subset of Win32 types, constants and primitives the library
+ * relies on, so that the portable modules and the simulated backend can be
+ * built and exercised without a Windows desktop.
+ */
+
+#pragma once
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+	#include "inputlib.h"
+#else
+	/* POSIX.1-2008 and XSI for recursive mutexes, monotonic condition 
+	   variables and ftruncate under -std=c11. They only take effect ahead of 
+	   the first system header, so the build also defines them */
+	#ifndef _POSIX_C_SOURCE
+		#define _POSIX_C_SOURCE 200809L
+	#endif
+	#ifndef _XOPEN_SOURCE
+		#define _XOPEN_SOURCE 700
+	#endif
+	#include <stdint.h>
+	#include <string.h>
+	#include <strings.h>
+	#include <stdio.h>
+	#include <pthread.h>
+	#include <sched.h>
+	#include <time.h>
+	#include "inputlib.h"
+
+	/* Win32 integer types (DWORD and HWND come from inputlib.h) */
+	typedef uint8_t BYTE;
+	typedef int16_t SHORT;
+	typedef uint16_t WORD;
+	typedef int BOOL;
+	typedef void* HANDLE;
+
+	#define TRUE 1
+	#define FALSE 0
+	#define WINAPI
+	#define INFINITE 0xFFFFFFFFUL
+	#define WAIT_OBJECT_0 0UL
+	#define WAIT_TIMEOUT 258UL
+
+	/* Error codes reported through SetLastError */
+	#define ERROR_INVALID_FUNCTION 1L
+	#define ERROR_FILE_NOT_FOUND 2L
+	#define ERROR_INVALID_DATA 13L
+	#define ERROR_OUTOFMEMORY 14L
+	#define ERROR_NOT_SUPPORTED 50L
+	#define ERROR_INVALID_PARAMETER 87L
+	#define ERROR_ALREADY_EXISTS 183L
+	#define ERROR_TIMEOUT 1460L
+	#define ERROR_INVALID_OPERATION 4317L
+
+	/* Virtual key codes referenced by name */
+	#define VK_LBUTTON 0x01
+	#define VK_RBUTTON 0x02
+	#define VK_MBUTTON 0x04
+	#define VK_XBUTTON1 0x05
+	#define VK_XBUTTON2 0x06
+	#define VK_BACK 0x08
+	#define VK_TAB 0x09
+	#define VK_RETURN 0x0D
+	#define VK_SHIFT 0x10
+	#define VK_CONTROL 0x11
+	#define VK_MENU 0x12
+	#define VK_ESCAPE 0x1B
+	#define VK_SPACE 0x20
+	#define VK_PRIOR 0x21
+	#define VK_NEXT 0x22
+	#define VK_END 0x23
+	#define VK_HOME 0x24
+	#define VK_LEFT 0x25
+	#define VK_UP 0x26
+	#define VK_RIGHT 0x27
+	#define VK_DOWN 0x28
+	#define VK_LWIN 0x5B
+	#define VK_RWIN 0x5C
+	#define VK_NUMPAD0 0x60
+	#define VK_DIVIDE 0x6F
+	#define VK_LSHIFT 0xA0
+	#define VK_RSHIFT 0xA1
+	#define VK_LCONTROL 0xA2
+	#define VK_RCONTROL 0xA3
+	#define VK_LMENU 0xA4
+	#define VK_RMENU 0xA5
+	#define VK_PACKET 0xE7
+
+	/* Input injection flags */
+	#define KEYEVENTF_KEYUP 0x0002
+	#define KEYEVENTF_UNICODE 0x0004
+	#define MOUSEEVENTF_MOVE 0x0001
+	#define MOUSEEVENTF_LEFTDOWN 0x0002
+	#define MOUSEEVENTF_LEFTUP 0x0004
+	#define MOUSEEVENTF_RIGHTDOWN 0x0008
+	#define MOUSEEVENTF_RIGHTUP 0x0010
+	#define MOUSEEVENTF_MIDDLEDOWN 0x0020
+	#define MOUSEEVENTF_MIDDLEUP 0x0040
+	#define MOUSEEVENTF_XDOWN 0x0080
+	#define MOUSEEVENTF_XUP 0x0100
+	#define MOUSEEVENTF_WHEEL 0x0800
+	#define MOUSEEVENTF_HWHEEL 0x1000
+	#define XBUTTON1 0x0001
+	#define XBUTTON2 0x0002
+	#define WHEEL_DELTA 120
+
+	/* ShowWindow commands */
+	#define SW_MAXIMIZE 3
+	#define SW_MINIMIZE 6
+
+	/* CRT name differences */
+	#define _stricmp strcasecmp
+	#define _strnicmp strncasecmp
+	#define _snprintf snprintf
+
+	/* Thread-local last error, mirrors GetLastError/SetLastError */
+	DWORD GetLastError(void);
+	void SetLastError(DWORD err);
+
+	/* Recursive mutex standing in for a Win32 CRITICAL_SECTION */
+	typedef pthread_mutex_t CRITICAL_SECTION;
+
+	static inline void InitializeCriticalSection(CRITICAL_SECTION* cs) {
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+		pthread_mutex_init(cs, &attr);
+		pthread_mutexattr_destroy(&attr);
+	}
+	static inline void DeleteCriticalSection(CRITICAL_SECTION* cs) { pthread_mutex_destroy(cs); }
+	static inline void EnterCriticalSection(CRITICAL_SECTION* cs) { pthread_mutex_lock(cs); }
+	static inline void LeaveCriticalSection(CRITICAL_SECTION* cs) { pthread_mutex_unlock(cs); }
+
+	/* Condition variable paired with a CRITICAL_SECTION entered exactly once */
+	typedef pthread_cond_t CONDITION_VARIABLE;
+
+	static inline void InitializeConditionVariable(CONDITION_VARIABLE* cv) {
+		pthread_condattr_t attr;
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(cv, &attr);
+		pthread_condattr_destroy(&attr);
+	}
+	static inline void WakeConditionVariable(CONDITION_VARIABLE* cv) { pthread_cond_signal(cv); }
+	static inline void WakeAllConditionVariable(CONDITION_VARIABLE* cv) { pthread_cond_broadcast(cv); }
+	BOOL SleepConditionVariableCS(CONDITION_VARIABLE* cv, CRITICAL_SECTION* cs, DWORD ms);
+
+	/* Threads, the only waitable handles outside Windows */
+	typedef DWORD (*LPTHREAD_START_ROUTINE)(void* param);
+	HANDLE CreateThread(void* attr, size_t stack, LPTHREAD_START_ROUTINE proc, void* param, DWORD flags, DWORD* id);
+	DWORD WaitForSingleObject(HANDLE thread, DWORD ms);
+	BOOL CloseHandle(HANDLE thread);
+
+	/* Give up the rest of the time slice */
+	static inline BOOL SwitchToThread(void) { sched_yield(); return TRUE; }
+#endif
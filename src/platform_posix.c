@@ -0,0 +1,117 @@
+/*
+ * platform_posix.c - Win32 compatibility shims for non-Windows builds
+ *
+ * Provides the handful of Win32 primitives declared in platform.h that
+ * cannot be expressed as inline wrappers.
+ */
+
+#ifndef _WIN32
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include "platform.h"
+
+/* Thread-local storage for the last error code */
+static __thread DWORD g_last_error = 0;
+
+DWORD GetLastError(void) {
+	return g_last_error;
+}
+
+void SetLastError(DWORD err) {
+	g_last_error = err;
+}
+
+/*
+ * deadline_after - Absolute CLOCK_MONOTONIC time ms milliseconds from now
+ */
+static struct timespec deadline_after(DWORD ms) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += ms / 1000;
+	ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+	if(ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+	return ts;
+}
+
+BOOL SleepConditionVariableCS(CONDITION_VARIABLE* cv, CRITICAL_SECTION* cs, DWORD ms) {
+	if(ms == INFINITE) return pthread_cond_wait(cv, cs) == 0;
+	struct timespec ts = deadline_after(ms);
+	if(pthread_cond_timedwait(cv, cs, &ts) == ETIMEDOUT) {
+		SetLastError(ERROR_TIMEOUT);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Thread handle - joined at most once, detached on close otherwise */
+typedef struct PosixThread {
+	pthread_t thread;
+	int joined;
+} PosixThread;
+
+/* Start parameters, owned by the new thread so closing early is safe */
+typedef struct PosixThreadStart {
+	LPTHREAD_START_ROUTINE proc;
+	void* param;
+} PosixThreadStart;
+
+static void* posix_thread_entry(void* arg) {
+	PosixThreadStart start = *(PosixThreadStart*)arg;
+	free(arg);
+	start.proc(start.param);
+	return NULL;
+}
+
+HANDLE CreateThread(void* attr, size_t stack, LPTHREAD_START_ROUTINE proc, void* param, DWORD flags, DWORD* id) {
+	(void)attr; (void)stack; (void)flags;
+	PosixThread* t = (PosixThread*)calloc(1, sizeof(PosixThread));
+	PosixThreadStart* start = (PosixThreadStart*)malloc(sizeof(PosixThreadStart));
+	if(!t || !start) {
+		free(t);
+		free(start);
+		SetLastError(ERROR_OUTOFMEMORY);
+		return NULL;
+	}
+	start->proc = proc;
+	start->param = param;
+	if(pthread_create(&t->thread, NULL, posix_thread_entry, start) != 0) {
+		free(t);
+		free(start);
+		SetLastError(ERROR_NOT_SUPPORTED);
+		return NULL;
+	}
+	if(id) *id = (DWORD)(uintptr_t)t;
+	return (HANDLE)t;
+}
+
+DWORD WaitForSingleObject(HANDLE thread, DWORD ms) {
+	PosixThread* t = (PosixThread*)thread;
+	if(t->joined) return WAIT_OBJECT_0;
+	if(ms == INFINITE) {
+		pthread_join(t->thread, NULL);
+	} else {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);  /* timedjoin uses the realtime clock */
+		ts.tv_sec += ms / 1000;
+		ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+		if(ts.tv_nsec >= 1000000000L) { ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+		if(pthread_timedjoin_np(t->thread, NULL, &ts) != 0) return WAIT_TIMEOUT;
+	}
+	t->joined = 1;
+	return WAIT_OBJECT_0;
+}
+
+BOOL CloseHandle(HANDLE thread) {
+	PosixThread* t = (PosixThread*)thread;
+	if(!t) return FALSE;
+	if(!t->joined) pthread_detach(t->thread);
+	free(t);
+	return TRUE;
+}
+
+#endif /* !_WIN32 */
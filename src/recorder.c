@@ -0,0 +1,617 @@
+/*
+ * recorder.c - Binary event recorder on memory-mapped segment files
+ *
+ * The hook thread encodes each listener event into a few bytes of
+ * delta/varint data and copies them into the current segment, which is a
+ * file mapped into memory. That is the only work on the hook thread: a
+ * writer thread keeps the next segment created and mapped ahead of time,
+ * and finishes full ones (unmap, trim to the used length, close, and
+ * delete the oldest when a segment limit is set). If the hook fills a
+ * segment before the writer has the next one ready, events are dropped
+ * and counted rather than waited for. The file format is described in
+ * recorder.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "backend.h"
+#include "recorder.h"
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+#endif
+
+/*
+ * RecSegment - One mapped segment file
+ */
+typedef struct RecSegment {
+	unsigned char* base;        /* Mapped view */
+	size_t size;                /* Mapped size */
+	size_t used;                /* Bytes written, owned by the hook while current */
+	unsigned index;             /* Segment number in the file name */
+	struct RecSegment* next;    /* Link in the finished list */
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+} RecSegment;
+
+static CRITICAL_SECTION g_rec_ctl_cs;   /* Serializes start and stop */
+static CRITICAL_SECTION g_rec_cs;       /* Writer wakeups, never held while waiting on the hook */
+static CONDITION_VARIABLE g_rec_cv;
+static HANDLE g_rec_thread = NULL;
+static int g_rec_stop = 0;
+
+/* Recording settings, fixed while recording */
+static char* g_rec_path = NULL;
+static size_t g_rec_size = 0;
+static int g_rec_max = 0;
+static unsigned g_rec_next_index = 0;
+
+/* Hook side - the current segment and its encoder state are hook-owned. 
+   Backends never run the hook on two threads at once, so they need no lock */
+static int g_rec_on = 0;
+static int g_rec_busy = 0;                /* Hook delivery inside recorder_append */
+static RecSegment* g_rec_cur = NULL;
+static RecState g_rec_enc;
+static RecSegment* g_rec_spare = NULL;    /* Next segment, handed from writer to hook */
+static RecSegment* g_rec_full = NULL;     /* Finished segments, handed from hook to writer */
+
+static unsigned long long g_rec_events = 0;
+static unsigned long long g_rec_bytes = 0;
+static unsigned long long g_rec_dropped = 0;
+static unsigned long long g_rec_segments = 0;
+
+/*
+ * rec_put_varint - Append an unsigned LEB128 value
+ *
+ * Returns: Position after the value
+ */
+static unsigned char* rec_put_varint(unsigned char* p, unsigned long long v) {
+	while(v >= 0x80) {
+		*p++ = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (unsigned char)v;
+	return p;
+}
+
+/*
+ * rec_get_varint - Read an unsigned LEB128 value
+ *
+ * Returns: Position after the value, or NULL if it runs past end
+ */
+static const unsigned char* rec_get_varint(const unsigned char* p, const unsigned char* end, unsigned long long* v) {
+	unsigned long long r = 0;
+	for(int shift = 0; p < end && shift < 64; shift += 7) {
+		unsigned char b = *p++;
+		r |= (unsigned long long)(b & 0x7F) << shift;
+		if(!(b & 0x80)) { *v = r; return p; }
+	}
+	return NULL;
+}
+
+static unsigned long long rec_zigzag(int n) {
+	return (unsigned long long)(((unsigned)n << 1) ^ (unsigned)(n >> 31));
+}
+
+static int rec_unzigzag(unsigned long long v) {
+	return (int)((unsigned)(v >> 1) ^ (0U - (unsigned)(v & 1)));
+}
+
+/*
+ * rec_encode - Encode one event against the delta state
+ *
+ * @st: Delta state, not modified
+ * @ev: Event to encode
+ * @out: Buffer of at least REC_MAX_RECORD bytes
+ *
+ * Returns: Encoded length
+ */
+static size_t rec_encode(const RecState* st, const EventEx* ev, unsigned char* out) {
+	unsigned char head = (unsigned char)((ev->type + 1) & REC_TYPE_MASK);
+	unsigned char* p = out + 1;
+	if(ev->pressed) head |= REC_PRESSED;
+	if(ev->injected) head |= REC_INJECTED;
+
+	BYTE vk = (BYTE)ev->vk;
+	if(ev->type == EVENT_KEY || ev->type == EVENT_MOUSE_BUTTON) *p++ = vk;
+	unsigned long long us = ev->clock_ns / 1000ULL;
+	p = rec_put_varint(p, us > st->last_us ? us - st->last_us : 0);
+	if(ev->modifiers != st->mods) {
+		head |= REC_MODS;
+		p = rec_put_varint(p, (unsigned)ev->modifiers);
+	}
+
+	if(ev->type == EVENT_KEY) {
+		if(ev->repeat) {
+			head |= REC_OPT;
+			p = rec_put_varint(p, (unsigned)ev->repeat);
+		}
+		if((unsigned short)ev->scan != st->scan[vk]) {
+			head |= REC_SCAN;
+			p = rec_put_varint(p, (unsigned short)ev->scan);
+		}
+	} else {
+		if(ev->x != st->x || ev->y != st->y) {
+			head |= REC_OPT;
+			p = rec_put_varint(p, rec_zigzag(ev->x - st->x));
+			p = rec_put_varint(p, rec_zigzag(ev->y - st->y));
+		}
+		if(ev->type == EVENT_MOUSE_WHEEL || ev->type == EVENT_MOUSE_HWHEEL) p = rec_put_varint(p, rec_zigzag(ev->wheel));
+	}
+	out[0] = head;
+	return (size_t)(p - out);
+}
+
+/*
+ * rec_commit - Advance the delta state past an encoded event
+ */
+static void rec_commit(RecState* st, const EventEx* ev) {
+	unsigned long long us = ev->clock_ns / 1000ULL;
+	if(us > st->last_us) st->last_us = us;
+	st->mods = ev->modifiers;
+	if(ev->type == EVENT_KEY) {
+		st->scan[(BYTE)ev->vk] = (unsigned short)ev->scan;
+	} else {
+		st->x = ev->x;
+		st->y = ev->y;
+	}
+}
+
+/*
+ * recorder_header - Check a segment header and start decoding from it
+ *
+ * @st: Delta state to reset to the segment base
+ * @p: Segment bytes
+ * @len: Segment length
+ *
+ * Returns: 0 if the header is valid, 1 otherwise
+ */
+int recorder_header(RecState* st, const unsigned char* p, size_t len) {
+	if(len < REC_HEADER_SIZE || memcmp(p, REC_MAGIC, 8) != 0) return 1;
+	unsigned version = 0;
+	unsigned long long base = 0;
+	for(int i = 0; i < 4; ++i) version |= (unsigned)p[8 + i] << (8 * i);
+	for(int i = 0; i < 8; ++i) base |= (unsigned long long)p[16 + i] << (8 * i);
+	if(version != REC_VERSION) return 1;
+	memset(st, 0, sizeof(RecState));
+	st->last_us = base;
+	return 0;
+}
+
+/*
+ * recorder_decode - Decode one record
+ *
+ * @st: Delta state, advanced past the record
+ * @p: Record bytes
+ * @len: Bytes left in the segment
+ * @out: Receives the event; time_ns, delta_ns and held_ns are left for the
+ *       caller, clock_ns is rebuilt from the segment base
+ *
+ * Returns: Bytes consumed, or 0 at the end of the segment or on a corrupt or
+ * truncated record
+ */
+size_t recorder_decode(RecState* st, const unsigned char* p, size_t len, EventEx* out) {
+	const unsigned char* end = p + len;
+	const unsigned char* q = p;
+	if(q >= end || *q == 0) return 0;
+	unsigned char head = *q++;
+	int type = (head & REC_TYPE_MASK) - 1;
+	if(type < 0 || type > EVENT_MOUSE_HWHEEL) return 0;
+
+	memset(out, 0, sizeof(EventEx));
+	out->size = sizeof(EventEx);
+	out->version = EVENTEX_VERSION;
+	out->type = type;
+	out->pressed = (head & REC_PRESSED) ? 1 : 0;
+	out->injected = (head & REC_INJECTED) ? 1 : 0;
+	if(type == EVENT_KEY || type == EVENT_MOUSE_BUTTON) {
+		if(q >= end) return 0;
+		out->vk = *q++;
+	}
+
+	unsigned long long v;
+	if(!(q = rec_get_varint(q, end, &v))) return 0;
+	unsigned long long us = st->last_us + v;
+	int mods = st->mods;
+	if(head & REC_MODS) {
+		if(!(q = rec_get_varint(q, end, &v))) return 0;
+		mods = (int)v;
+	}
+	out->modifiers = mods;
+
+	if(type == EVENT_KEY) {
+		out->scan = st->scan[out->vk];
+		if(head & REC_OPT) {
+			if(!(q = rec_get_varint(q, end, &v))) return 0;
+			out->repeat = (int)v;
+		}
+		if(head & REC_SCAN) {
+			if(!(q = rec_get_varint(q, end, &v))) return 0;
+			out->scan = (int)v;
+		}
+		st->scan[out->vk] = (unsigned short)out->scan;
+	} else {
+		out->x = st->x;
+		out->y = st->y;
+		if(head & REC_OPT) {
+			unsigned long long dx, dy;
+			if(!(q = rec_get_varint(q, end, &dx)) || !(q = rec_get_varint(q, end, &dy))) return 0;
+			out->x += rec_unzigzag(dx);
+			out->y += rec_unzigzag(dy);
+		}
+		if(type == EVENT_MOUSE_WHEEL || type == EVENT_MOUSE_HWHEEL) {
+			if(!(q = rec_get_varint(q, end, &v))) return 0;
+			out->wheel = rec_unzigzag(v);
+		}
+		st->x = out->x;
+		st->y = out->y;
+	}
+	st->last_us = us;
+	st->mods = mods;
+	out->clock_ns = us * 1000ULL;
+	return (size_t)(q - p);
+}
+
+/*
+ * recorder_segname - Build the file name of a segment
+ */
+void recorder_segname(char* out, size_t len, const char* path, unsigned index) {
+	_snprintf(out, len, "%s.%06u", path, index);
+}
+
+/*
+ * rec_segment_open - Create and map a new segment file
+ *
+ * Returns: Segment, or NULL if the file could not be created or mapped
+ */
+static RecSegment* rec_segment_open(const char* path, unsigned index, size_t size) {
+	char name[1024];
+	recorder_segname(name, sizeof(name), path, index);
+	RecSegment* seg = (RecSegment*)calloc(1, sizeof(RecSegment));
+	if(!seg) return NULL;
+	seg->size = size;
+	seg->index = index;
+#ifdef _WIN32
+	seg->file = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(seg->file == INVALID_HANDLE_VALUE) { free(seg); return NULL; }
+	seg->mapping = CreateFileMappingA(seg->file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)size, NULL);
+	if(seg->mapping) seg->base = (unsigned char*)MapViewOfFile(seg->mapping, FILE_MAP_WRITE, 0, 0, size);
+	if(!seg->base) {
+		if(seg->mapping) CloseHandle(seg->mapping);
+		CloseHandle(seg->file);
+		DeleteFileA(name);
+		free(seg);
+		return NULL;
+	}
+#else
+	seg->fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(seg->fd < 0) { free(seg); return NULL; }
+	void* base = MAP_FAILED;
+	if(ftruncate(seg->fd, (off_t)size) == 0) base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+	if(base == MAP_FAILED) {
+		close(seg->fd);
+		unlink(name);
+		free(seg);
+		return NULL;
+	}
+	seg->base = (unsigned char*)base;
+#endif
+	return seg;
+}
+
+/*
+ * rec_segment_close - Unmap a segment and trim its file to the used length
+ *
+ * @seg: Segment to close, freed
+ * @keep: 0 to delete the file instead, for a segment that was never used
+ */
+static void rec_segment_close(RecSegment* seg, int keep) {
+	char name[1024];
+	recorder_segname(name, sizeof(name), g_rec_path, seg->index);
+#ifdef _WIN32
+	FlushViewOfFile(seg->base, seg->used);
+	UnmapViewOfFile(seg->base);
+	CloseHandle(seg->mapping);
+	LARGE_INTEGER end;
+	end.QuadPart = (LONGLONG)seg->used;
+	if(SetFilePointerEx(seg->file, end, NULL, FILE_BEGIN)) SetEndOfFile(seg->file);
+	CloseHandle(seg->file);
+	if(!keep) DeleteFileA(name);
+#else
+	munmap(seg->base, seg->size);
+	if(ftruncate(seg->fd, (off_t)seg->used) != 0) { /* Left at full size, still readable */ }
+	close(seg->fd);
+	if(!keep) unlink(name);
+#endif
+	free(seg);
+}
+
+/*
+ * rec_segment_retire - Close a finished segment and enforce the segment limit
+ */
+static void rec_segment_retire(RecSegment* seg) {
+	unsigned index = seg->index;
+	rec_segment_close(seg, 1);
+	if(g_rec_max > 0 && index >= (unsigned)g_rec_max) {
+		char name[1024];
+		recorder_segname(name, sizeof(name), g_rec_path, index - (unsigned)g_rec_max);
+#ifdef _WIN32
+		DeleteFileA(name);
+#else
+		unlink(name);
+#endif
+	}
+}
+
+/*
+ * rec_segment_begin - Make a segment current, starting its delta state
+ *
+ * Writes the header with the first event's clock as the base. Runs on the
+ * hook thread.
+ */
+static void rec_segment_begin(RecSegment* seg, unsigned long long clock_ns) {
+	memset(&g_rec_enc, 0, sizeof(g_rec_enc));
+	g_rec_enc.last_us = clock_ns / 1000ULL;
+	unsigned char* h = seg->base;
+	unsigned version = REC_VERSION;
+	unsigned long long base = g_rec_enc.last_us;
+	memcpy(h, REC_MAGIC, 8);
+	for(int i = 0; i < 4; ++i) h[8 + i] = (unsigned char)(version >> (8 * i));
+	for(int i = 0; i < 4; ++i) h[12 + i] = (unsigned char)(seg->index >> (8 * i));
+	for(int i = 0; i < 8; ++i) h[16 + i] = (unsigned char)(base >> (8 * i));
+	seg->used = REC_HEADER_SIZE;
+	g_rec_cur = seg;
+	__atomic_fetch_add(&g_rec_segments, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&g_rec_bytes, REC_HEADER_SIZE, __ATOMIC_RELAXED);
+}
+
+/*
+ * rec_thread_proc - Segment writer thread
+ *
+ * Finishes segments the hook has filled and keeps one spare segment
+ * mapped, so rotation on the hook thread is a pointer swap.
+ */
+static DWORD WINAPI rec_thread_proc(void* param) {
+	(void)param;
+	EnterCriticalSection(&g_rec_cs);
+	for(;;) {
+		RecSegment* full = __atomic_exchange_n(&g_rec_full, NULL, __ATOMIC_ACQUIRE);
+		int need_spare = !g_rec_stop && !__atomic_load_n(&g_rec_spare, __ATOMIC_ACQUIRE);
+		if(full || need_spare) {
+			unsigned index = g_rec_next_index;
+			if(need_spare) g_rec_next_index++;
+			LeaveCriticalSection(&g_rec_cs);
+
+			/* Oldest first, the list was pushed newest first */
+			RecSegment* order = NULL;
+			while(full) {
+				RecSegment* next = full->next;
+				full->next = order;
+				order = full;
+				full = next;
+			}
+			while(order) {
+				RecSegment* next = order->next;
+				rec_segment_retire(order);
+				order = next;
+			}
+			RecSegment* spare = need_spare ? rec_segment_open(g_rec_path, index, g_rec_size) : NULL;
+
+			EnterCriticalSection(&g_rec_cs);
+			if(spare) {
+				__atomic_store_n(&g_rec_spare, spare, __ATOMIC_RELEASE);
+			} else if(need_spare) {
+				g_rec_next_index--;  /* Retry the same name */
+			}
+			if(need_spare && !spare && !g_rec_stop) SleepConditionVariableCS(&g_rec_cv, &g_rec_cs, 100);
+			continue;
+		}
+		if(g_rec_stop) break;
+		SleepConditionVariableCS(&g_rec_cv, &g_rec_cs, INFINITE);
+	}
+	LeaveCriticalSection(&g_rec_cs);
+	return 0;
+}
+
+/*
+ * rec_write - Encode and copy one event into the current segment
+ */
+static void rec_write(const EventEx* ev) {
+	unsigned char buf[REC_MAX_RECORD];
+	RecSegment* seg = g_rec_cur;
+	size_t n = rec_encode(&g_rec_enc, ev, buf);
+	if(seg->used + n > seg->size) {
+		RecSegment* next = __atomic_exchange_n(&g_rec_spare, NULL, __ATOMIC_ACQUIRE);
+		if(!next) {
+			__atomic_fetch_add(&g_rec_dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+		/* Hand the full segment to the writer, it only wakes once per segment */
+		RecSegment* head = __atomic_load_n(&g_rec_full, __ATOMIC_RELAXED);
+		do {
+			seg->next = head;
+		} while(!__atomic_compare_exchange_n(&g_rec_full, &head, seg, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+		EnterCriticalSection(&g_rec_cs);
+		WakeConditionVariable(&g_rec_cv);
+		LeaveCriticalSection(&g_rec_cs);
+
+		seg = next;
+		rec_segment_begin(seg, ev->clock_ns);
+		n = rec_encode(&g_rec_enc, ev, buf);
+	}
+	memcpy(seg->base + seg->used, buf, n);
+	seg->used += n;
+	rec_commit(&g_rec_enc, ev);
+	__atomic_fetch_add(&g_rec_events, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&g_rec_bytes, n, __ATOMIC_RELAXED);
+}
+
+/*
+ * recorder_append - Record one listener event
+ *
+ * @ev: Event as delivered to consumers
+ *
+ * Called on the hook thread for every event that passes the block rules.
+ * A no-op unless recording.
+ */
+void recorder_append(const EventEx* ev) {
+	if(!__atomic_load_n(&g_rec_on, __ATOMIC_RELAXED)) return;
+	/* Announce before re-checking, so listener_recordstop can wait us out */
+	__atomic_fetch_add(&g_rec_busy, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&g_rec_on, __ATOMIC_SEQ_CST)) rec_write(ev);
+	__atomic_fetch_sub(&g_rec_busy, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * recorder_init - Set up the recorder locks
+ */
+void recorder_init(void) {
+	InitializeCriticalSection(&g_rec_ctl_cs);
+	InitializeCriticalSection(&g_rec_cs);
+	InitializeConditionVariable(&g_rec_cv);
+}
+
+/*
+ * listener_record - Start recording listener events
+ *
+ * @path: File name prefix, segments are <path>.000000, <path>.000001, ...
+ * @segment_bytes: Size of each segment, at least REC_MIN_SEGMENT (4096)
+ * @max_segments: Number of finished segments to keep, the oldest are
+ *                deleted beyond it; 0 keeps all
+ *
+ * Every event that passes the block rules is appended to the current
+ * segment in a compact delta/varint encoding (typically 4-6 bytes per key
+ * event), so memory use is bounded by two mapped segments however long
+ * the session. Finished segments are trimmed to their used length.
+ *
+ * Returns: 0 if successful, 1 on invalid parameters, if already recording
+ * or if the first segment could not be created
+ */
+int INPUTLIB_CALL listener_record(const char* path, size_t segment_bytes, int max_segments) {
+	if(!path || !path[0] || segment_bytes < REC_MIN_SEGMENT || max_segments < 0) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return 1;
+	}
+	EnterCriticalSection(&g_rec_ctl_cs);
+	if(g_rec_thread) {
+		LeaveCriticalSection(&g_rec_ctl_cs);
+		SetLastError(ERROR_ALREADY_EXISTS);
+		return 1;
+	}
+	size_t len = strlen(path);
+	g_rec_path = (char*)malloc(len + 1);
+	if(!g_rec_path) {
+		LeaveCriticalSection(&g_rec_ctl_cs);
+		SetLastError(ERROR_OUTOFMEMORY);
+		return 1;
+	}
+	memcpy(g_rec_path, path, len + 1);
+	g_rec_size = segment_bytes;
+	g_rec_max = max_segments;
+	g_rec_stop = 0;
+
+	/* Map the first spare too, the hook may fill the first segment before 
+	   the writer thread has run at all */
+	RecSegment* first = rec_segment_open(g_rec_path, 0, g_rec_size);
+	RecSegment* spare = first ? rec_segment_open(g_rec_path, 1, g_rec_size) : NULL;
+	if(!spare) {
+		if(first) rec_segment_close(first, 0);
+		free(g_rec_path);
+		g_rec_path = NULL;
+		LeaveCriticalSection(&g_rec_ctl_cs);
+		SetLastError(ERROR_INVALID_FUNCTION);
+		return 1;
+	}
+	g_rec_next_index = 2;
+	g_rec_events = g_rec_bytes = g_rec_dropped = g_rec_segments = 0;
+	rec_segment_begin(first, g_backend->now_ns());
+	__atomic_store_n(&g_rec_spare, spare, __ATOMIC_RELEASE);
+
+	g_rec_thread = CreateThread(NULL, 0, rec_thread_proc, NULL, 0, NULL);
+	if(!g_rec_thread) {
+		rec_segment_close(first, 0);
+		rec_segment_close(__atomic_exchange_n(&g_rec_spare, NULL, __ATOMIC_ACQUIRE), 0);
+		g_rec_cur = NULL;
+		free(g_rec_path);
+		g_rec_path = NULL;
+		LeaveCriticalSection(&g_rec_ctl_cs);
+		SetLastError(ERROR_OUTOFMEMORY);
+		return 1;
+	}
+	__atomic_store_n(&g_rec_on, 1, __ATOMIC_RELEASE);
+	LeaveCriticalSection(&g_rec_ctl_cs);
+	return 0;
+}
+
+/*
+ * listener_recordstop - Stop recording
+ *
+ * Waits for an in-progress append, then finishes the current segment and
+ * deletes the unused spare.
+ *
+ * Returns: 0 if successful, 1 if not recording
+ */
+int INPUTLIB_CALL listener_recordstop(void) {
+	EnterCriticalSection(&g_rec_ctl_cs);
+	if(!g_rec_thread) {
+		LeaveCriticalSection(&g_rec_ctl_cs);
+		SetLastError(ERROR_INVALID_OPERATION);
+		return 1;
+	}
+	__atomic_store_n(&g_rec_on, 0, __ATOMIC_SEQ_CST);
+	while(__atomic_load_n(&g_rec_busy, __ATOMIC_ACQUIRE) != 0) SwitchToThread();
+
+	EnterCriticalSection(&g_rec_cs);
+	g_rec_stop = 1;
+	WakeConditionVariable(&g_rec_cv);
+	LeaveCriticalSection(&g_rec_cs);
+	WaitForSingleObject(g_rec_thread, INFINITE);
+	CloseHandle(g_rec_thread);
+	g_rec_thread = NULL;
+
+	RecSegment* full = __atomic_exchange_n(&g_rec_full, NULL, __ATOMIC_ACQUIRE);
+	RecSegment* order = NULL;
+	while(full) {
+		RecSegment* next = full->next;
+		full->next = order;
+		order = full;
+		full = next;
+	}
+	while(order) {
+		RecSegment* next = order->next;
+		rec_segment_retire(order);
+		order = next;
+	}
+	if(g_rec_cur) rec_segment_retire(g_rec_cur);
+	g_rec_cur = NULL;
+	RecSegment* spare = __atomic_exchange_n(&g_rec_spare, NULL, __ATOMIC_ACQUIRE);
+	if(spare) rec_segment_close(spare, 0);
+	free(g_rec_path);
+	g_rec_path = NULL;
+	LeaveCriticalSection(&g_rec_ctl_cs);
+	return 0;
+}
+
+/*
+ * listener_recordstats - Get event recorder statistics
+ *
+ * @out: Pointer to ListenerRecordStats struct to populate
+ *
+ * Counters cover the current or most recent recording.
+ *
+ * Returns: 0 if successful, 1 if out is NULL
+ */
+int INPUTLIB_CALL listener_recordstats(ListenerRecordStats* out) {
+	if(!out) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+	out->events = __atomic_load_n(&g_rec_events, __ATOMIC_RELAXED);
+	out->bytes = __atomic_load_n(&g_rec_bytes, __ATOMIC_RELAXED);
+	out->dropped = __atomic_load_n(&g_rec_dropped, __ATOMIC_RELAXED);
+	out->segments = __atomic_load_n(&g_rec_segments, __ATOMIC_RELAXED);
+	return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * recorder.h - Internal binary event recorder and its file format
+ *
+ * A recording is a series of segment files named <path>.000000,
+ * <path>.000001 and so on. Each segment starts with a REC_HEADER_SIZE byte
+ * header and is followed by variable-length records until the first zero
+ * byte or the end of the file. Segments decode independently: the delta
+ * state below restarts at every segment.
+ *
+ * Header, little-endian:
+ *   0  char[8]  REC_MAGIC
+ *   8  u32      REC_VERSION
+ *   12 u32      Segment index
+ *   16 u64      Base clock in microseconds, the first record's delta is from it
+ *   24 u64      Reserved, zero
+ *
+ * Record:
+ *   u8          Head, REC_* bits below
+ *   u8          Virtual key code, EVENT_KEY and EVENT_MOUSE_BUTTON only
+ *   varint      Microseconds since the previous record
+ *   varint      Modifier bitmask, if REC_MODS
+ *   EVENT_KEY:
+ *     varint    Repeat count, if REC_OPT
+ *     varint    Scan code, if REC_SCAN, otherwise the last one seen for vk
+ *   Mouse events:
+ *     zigzag x2 Cursor position delta, if REC_OPT
+ *     zigzag    Wheel delta, wheel events only
+ *
+ * Varints are LEB128, seven bits per byte with the high bit set on all but
+ * the last. Zigzag maps signed n to (n << 1) ^ (n >> 31) before LEB128.
+ */
+
+#pragma once
+
+#include "platform.h"
+
+#define REC_MAGIC "INPUTREC"
+#define REC_VERSION 1
+#define REC_HEADER_SIZE 32
+
+/* Smallest segment accepted by listener_record */
+#define REC_MIN_SEGMENT 4096
+
+/* Largest encoded record */
+#define REC_MAX_RECORD 48
+
+/* Record head bits */
+#define REC_TYPE_MASK 0x07    /* EVENT_* + 1, so a zero byte ends the segment */
+#define REC_PRESSED 0x08
+#define REC_INJECTED 0x10
+#define REC_MODS 0x20         /* Modifiers changed */
+#define REC_OPT 0x40          /* Key: repeat count follows. Mouse: position delta follows */
+#define REC_SCAN 0x80         /* Key: scan code changed */
+
+/*
+ * RecState - Delta state shared by the encoder and decoder
+ */
+typedef struct RecState {
+	unsigned long long last_us;   /* Clock of the previous record */
+	int mods;                     /* Modifiers of the previous record */
+	int x, y;                     /* Last mouse position */
+	unsigned short scan[256];     /* Last scan code per vk */
+} RecState;
+
+/* Set up the recorder lock, called once from listener_init */
+void recorder_init(void);
+
+/* Append an event to the active recording; called on the hook thread */
+void recorder_append(const EventEx* ev);
+
+/* Build the file name of segment index of a recording */
+void recorder_segname(char* out, size_t len, const char* path, unsigned index);
+
+/* Check a segment header and start the delta state from it, returns 0 if valid */
+int recorder_header(RecState* st, const unsigned char* p, size_t len);
+
+/* Decode one record, returns bytes consumed or 0 at the end of the segment */
+size_t recorder_decode(RecState* st, const unsigned char* p, size_t len, EventEx* out);
@@ -0,0 +1,398 @@
+/*
+ * replay.c - Timing-accurate replay of recorded input sessions
+ *
+ * Reads the segment files written by listener_record and feeds the events
+ * back through the platform backend's injection primitives. Every event is
+ * scheduled against an absolute deadline derived from its recorded clock,
+ * so waiting and injection overhead never accumulate into drift. Key events
+ * whose deadlines fall within REPLAY_BATCH_US of each other go out in one
+ * send_keys submission.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "backend.h"
+#include "timing.h"
+#include "async.h"
+#include "recorder.h"
+
+#ifdef _WIN32
+	#define REPLAY_SEP(c) ((c) == '/' || (c) == '\\')
+#else
+	#include <dirent.h>
+	#define REPLAY_SEP(c) ((c) == '/')
+#endif
+
+/* Key events closer than this to the first of a batch share its deadline */
+#define REPLAY_BATCH_US 250
+
+/* Most key events in one submission */
+#define REPLAY_BATCH_MAX 64
+
+/*
+ * Replay - State of one replay run
+ */
+typedef struct Replay {
+	double speed;               /* Playback speed multiplier */
+	unsigned long long max_gap_us;  /* Longest recorded gap kept, 0 for all */
+	int flags;                  /* INPUT_REPLAY_* */
+	const int* cancel;          /* Cancellation flag, or NULL */
+
+	Pacer pacer;                /* Deadline clock, started at the first event */
+	unsigned long long start_ns;
+	unsigned long long virt_us; /* Recorded time since the first event, after gap compression */
+	unsigned long long prev_us; /* Recorded clock of the previous event */
+	int started;
+
+	KeyInput batch[REPLAY_BATCH_MAX];
+	int batch_n;
+	unsigned long long batch_ns;  /* Deadline of the first batched key */
+
+	int x, y;                   /* Where replay last put the cursor */
+	BYTE keys_down[256];        /* Keys and buttons replay pressed and has not released */
+} Replay;
+
+/*
+ * replay_first_segment - Find the lowest segment index of a recording
+ *
+ * @path: Recording path as given to listener_record
+ * @out: Receives the index
+ *
+ * Older segments may have been deleted by the segment limit, so the
+ * directory is scanned rather than assuming index 0.
+ *
+ * Returns: 0 if a segment was found, 1 otherwise
+ */
+static int replay_first_segment(const char* path, unsigned* out) {
+	const char* base = path;
+	for(const char* c = path; *c; ++c) if(REPLAY_SEP(*c)) base = c + 1;
+	size_t base_len = strlen(base);
+	int found = 0;
+
+#ifdef _WIN32
+	char pattern[1024];
+	_snprintf(pattern, sizeof(pattern), "%s.*", path);
+	WIN32_FIND_DATAA fd;
+	HANDLE h = FindFirstFileA(pattern, &fd);
+	if(h == INVALID_HANDLE_VALUE) return 1;
+	do {
+		const char* name = fd.cFileName;
+#else
+	char dir[1024];
+	size_t dir_len = (size_t)(base - path);
+	if(dir_len == 0) {
+		strcpy(dir, ".");
+	} else {
+		if(dir_len >= sizeof(dir)) return 1;
+		memcpy(dir, path, dir_len);
+		dir[dir_len] = '\0';
+	}
+	DIR* d = opendir(dir);
+	if(!d) return 1;
+	struct dirent* de;
+	while((de = readdir(d)) != NULL) {
+		const char* name = de->d_name;
+#endif
+		if(strncmp(name, base, base_len) != 0 || name[base_len] != '.') continue;
+		const char* digits = name + base_len + 1;
+		size_t n = 0;
+		unsigned long long index = 0;
+		while(digits[n] >= '0' && digits[n] <= '9' && n < 10) index = index * 10 + (unsigned)(digits[n++] - '0');
+		if(n < 6 || digits[n] != '\0' || index > 0xFFFFFFFFULL) continue;
+		if(!found || index < *out) *out = (unsigned)index;
+		found = 1;
+#ifdef _WIN32
+	} while(FindNextFileA(h, &fd));
+	FindClose(h);
+#else
+	}
+	closedir(d);
+#endif
+	return found ? 0 : 1;
+}
+
+/*
+ * replay_load - Read a whole segment file
+ *
+ * @buf: Buffer, grown as needed
+ * @cap: Capacity of buf
+ *
+ * Returns: Bytes read, or 0 if the segment does not exist
+ */
+static size_t replay_load(const char* name, unsigned char** buf, size_t* cap) {
+	FILE* f = fopen(name, "rb");
+	if(!f) return 0;
+	size_t len = 0;
+	if(fseek(f, 0, SEEK_END) == 0) {
+		long end = ftell(f);
+		if(end > 0) len = (size_t)end;
+		fseek(f, 0, SEEK_SET);
+	}
+	if(len > *cap) {
+		unsigned char* grown = (unsigned char*)realloc(*buf, len);
+		if(!grown) { fclose(f); return 0; }
+		*buf = grown;
+		*cap = len;
+	}
+	len = fread(*buf, 1, len, f);
+	fclose(f);
+	return len;
+}
+
+/*
+ * replay_flush - Submit the batched key events
+ *
+ * Returns: 0 if successful, 1 if the backend injected fewer events
+ */
+static int replay_flush(Replay* r) {
+	int n = r->batch_n;
+	r->batch_n = 0;
+	if(n == 0) return 0;
+	return g_backend->send_keys(r->batch, n) == n ? 0 : 1;
+}
+
+/*
+ * replay_wait - Wait for the deadline of a recorded clock value
+ *
+ * Returns: 1 if cancelled, 0 otherwise
+ */
+static int replay_wait(Replay* r, unsigned long long deadline) {
+	if(deadline <= r->pacer.next_ns) return 0;
+	/* Whole microseconds only, the remainder carries to the next wait */
+	long long us = (long long)((deadline - r->pacer.next_ns) / 1000ULL);
+	return pacer_waitc(&r->pacer, us, r->cancel);
+}
+
+/*
+ * replay_mouse - Inject one recorded mouse event
+ */
+static void replay_mouse(Replay* r, const EventEx* ev) {
+	if((ev->x != r->x || ev->y != r->y) && ev->type != EVENT_MOUSE_WHEEL && ev->type != EVENT_MOUSE_HWHEEL) {
+		g_backend->cursor_set(ev->x, ev->y);
+		r->x = ev->x;
+		r->y = ev->y;
+	}
+	switch(ev->type) {
+		case EVENT_MOUSE_BUTTON: {
+			DWORD flags = 0;
+			int data = 0;
+			switch(ev->vk) {
+				case VK_LBUTTON: flags = ev->pressed ? MOUSEEVENTF_LEFTDOWN : MOUSEEVENTF_LEFTUP; break;
+				case VK_RBUTTON: flags = ev->pressed ? MOUSEEVENTF_RIGHTDOWN : MOUSEEVENTF_RIGHTUP; break;
+				case VK_MBUTTON: flags = ev->pressed ? MOUSEEVENTF_MIDDLEDOWN : MOUSEEVENTF_MIDDLEUP; break;
+				case VK_XBUTTON1: flags = ev->pressed ? MOUSEEVENTF_XDOWN : MOUSEEVENTF_XUP; data = XBUTTON1; break;
+				case VK_XBUTTON2: flags = ev->pressed ? MOUSEEVENTF_XDOWN : MOUSEEVENTF_XUP; data = XBUTTON2; break;
+				default: return;
+			}
+			g_backend->mouse_event(flags, 0, 0, data);
+			r->keys_down[(BYTE)ev->vk] = ev->pressed ? 1 : 0;
+			break;
+		}
+		case EVENT_MOUSE_WHEEL:
+			g_backend->mouse_event(MOUSEEVENTF_WHEEL, 0, 0, ev->wheel);
+			break;
+		case EVENT_MOUSE_HWHEEL:
+			g_backend->mouse_event(MOUSEEVENTF_HWHEEL, 0, 0, ev->wheel);
+			break;
+	}
+}
+
+/*
+ * replay_event - Schedule and inject one recorded event
+ *
+ * Returns: ASYNC_RUN_DONE to continue, or the outcome to stop with
+ */
+static int replay_event(Replay* r, const EventEx* ev) {
+	if((r->flags & INPUT_REPLAY_PHYSICAL) && ev->injected) return ASYNC_RUN_DONE;
+	if((r->flags & INPUT_REPLAY_KEYS) && ev->type != EVENT_KEY) return ASYNC_RUN_DONE;
+
+	/* Recorded gaps are compressed first, then scaled */
+	unsigned long long us = ev->clock_ns / 1000ULL;
+	if(!r->started) {
+		pacer_start(&r->pacer);
+		r->start_ns = r->pacer.next_ns;
+		r->started = 1;
+	} else {
+		unsigned long long gap = us > r->prev_us ? us - r->prev_us : 0;
+		if(r->max_gap_us && gap > r->max_gap_us) gap = r->max_gap_us;
+		r->virt_us += gap;
+	}
+	r->prev_us = us;
+	unsigned long long deadline = r->start_ns + (unsigned long long)((double)r->virt_us * 1000.0 / r->speed);
+
+	if(r->batch_n && (ev->type != EVENT_KEY || r->batch_n == REPLAY_BATCH_MAX ||
+	   deadline > r->batch_ns + REPLAY_BATCH_US * 1000ULL)) {
+		if(replay_flush(r)) return ASYNC_RUN_FAILED;
+	}
+
+	if(ev->type == EVENT_KEY) {
+		if(r->batch_n == 0) {
+			if(replay_wait(r, deadline)) return ASYNC_RUN_CANCELLED;
+			r->batch_ns = deadline;
+		}
+		KeyInput* k = &r->batch[r->batch_n++];
+		k->vk = (WORD)ev->vk;
+		k->scan = (WORD)ev->scan;
+		k->flags = ev->pressed ? 0 : KEYEVENTF_KEYUP;
+		r->keys_down[(BYTE)ev->vk] = ev->pressed ? 1 : 0;
+		return ASYNC_RUN_DONE;
+	}
+	if(replay_wait(r, deadline)) return ASYNC_RUN_CANCELLED;
+	replay_mouse(r, ev);
+	return ASYNC_RUN_DONE;
+}
+
+/*
+ * replay_release - Release every key and button the replay left down
+ *
+ * A recording can end, or be cancelled, between a press and its release.
+ */
+static void replay_release(Replay* r) {
+	r->batch_n = 0;
+	for(int vk = 1; vk < 256; ++vk) {
+		if(!r->keys_down[vk]) continue;
+		r->keys_down[vk] = 0;
+		switch(vk) {
+			case VK_LBUTTON: g_backend->mouse_event(MOUSEEVENTF_LEFTUP, 0, 0, 0); break;
+			case VK_RBUTTON: g_backend->mouse_event(MOUSEEVENTF_RIGHTUP, 0, 0, 0); break;
+			case VK_MBUTTON: g_backend->mouse_event(MOUSEEVENTF_MIDDLEUP, 0, 0, 0); break;
+			case VK_XBUTTON1: g_backend->mouse_event(MOUSEEVENTF_XUP, 0, 0, XBUTTON1); break;
+			case VK_XBUTTON2: g_backend->mouse_event(MOUSEEVENTF_XUP, 0, 0, XBUTTON2); break;
+			default: {
+				KeyInput* k = &r->batch[r->batch_n++];
+				k->vk = (WORD)vk;
+				k->scan = 0;
+				k->flags = KEYEVENTF_KEYUP;
+				if(r->batch_n == REPLAY_BATCH_MAX) replay_flush(r);
+				break;
+			}
+		}
+	}
+	replay_flush(r);
+}
+
+/*
+ * replay_run - Replay a recording
+ *
+ * @path: Recording path as given to listener_record
+ * @speed: Playback speed multiplier
+ * @max_gap_ms: Longest pause kept from the recording, 0 keeps all
+ * @flags: INPUT_REPLAY_* flags
+ * @cancel: Cancellation flag, or NULL
+ *
+ * Returns: ASYNC_RUN_* outcome
+ */
+static int replay_run(const char* path, double speed, int max_gap_ms, int flags, const int* cancel) {
+	unsigned index = 0;
+	if(replay_first_segment(path, &index)) {
+		SetLastError(ERROR_FILE_NOT_FOUND);
+		return ASYNC_RUN_FAILED;
+	}
+	Replay* r = (Replay*)calloc(1, sizeof(Replay));
+	if(!r) {
+		SetLastError(ERROR_OUTOFMEMORY);
+		return ASYNC_RUN_FAILED;
+	}
+	r->speed = speed;
+	r->max_gap_us = (unsigned long long)max_gap_ms * 1000ULL;
+	r->flags = flags;
+	r->cancel = cancel;
+	if(g_backend->cursor_get(&r->x, &r->y)) r->x = r->y = -1;
+
+	unsigned char* buf = NULL;
+	size_t cap = 0;
+	int rc = ASYNC_RUN_DONE;
+	char name[1024];
+	for(;; ++index) {
+		recorder_segname(name, sizeof(name), path, index);
+		size_t len = replay_load(name, &buf, &cap);
+		if(len == 0) break;
+		RecState st;
+		if(recorder_header(&st, buf, len)) {
+			SetLastError(ERROR_INVALID_DATA);
+			rc = ASYNC_RUN_FAILED;
+			break;
+		}
+		size_t off = REC_HEADER_SIZE;
+		size_t n;
+		EventEx ev;
+		while(rc == ASYNC_RUN_DONE && (n = recorder_decode(&st, buf + off, len - off, &ev)) != 0) {
+			off += n;
+			rc = replay_event(r, &ev);
+		}
+		if(rc != ASYNC_RUN_DONE) break;
+	}
+	if(rc == ASYNC_RUN_DONE && replay_flush(r)) rc = ASYNC_RUN_FAILED;
+	replay_release(r);
+	free(buf);
+	free(r);
+	return rc;
+}
+
+/*
+ * input_replay - Replay a recorded input session
+ *
+ * @path: Recording path as given to listener_record
+ * @speed: Playback speed multiplier, 1.0 for real time, 10.0 for ten times
+ *         faster
+ * @max_gap_ms: Pauses longer than this are shortened to it before scaling,
+ *              0 keeps all pauses
+ * @flags: INPUT_REPLAY_PHYSICAL to skip events that were injected when
+ *         recorded, INPUT_REPLAY_KEYS to skip mouse events
+ *
+ * Plays every segment from the oldest one left on disk. Each event waits
+ * for an absolute deadline from the start of the replay, so timing does
+ * not drift however long the recording. Keys and buttons still down at
+ * the end are released.
+ *
+ * Returns: 0 if successful, 1 on invalid parameters, if no recording was
+ * found or if injection failed
+ */
+int INPUTLIB_CALL input_replay(const char* path, double speed, int max_gap_ms, int flags) {
+	if(!path || !(speed > 0.0) || max_gap_ms < 0) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return 1;
+	}
+	return replay_run(path, speed, max_gap_ms, flags, NULL) == ASYNC_RUN_DONE ? 0 : 1;
+}
+
+/* Arguments of an input_replay_async job */
+typedef struct ReplayJob {
+	double speed;
+	int max_gap_ms;
+	int flags;
+	char path[1];
+} ReplayJob;
+
+static int replay_job_run(void* arg, const int* cancel) {
+	ReplayJob* job = (ReplayJob*)arg;
+	return replay_run(job->path, job->speed, job->max_gap_ms, job->flags, cancel);
+}
+
+/*
+ * input_replay_async - Replay a recorded input session on the injector thread
+ *
+ * @path: Recording path, copied before returning
+ * @speed: Playback speed multiplier
+ * @max_gap_ms: Longest pause kept, 0 keeps all
+ * @flags: INPUT_REPLAY_* flags
+ *
+ * Queues the same replay as input_replay and returns immediately.
+ * Cancelling stops at the next wait and releases anything held down.
+ *
+ * Returns: Job handle to wait on, poll, cancel and close, or NULL on failure
+ */
+input_job_t* INPUTLIB_CALL input_replay_async(const char* path, double speed, int max_gap_ms, int flags) {
+	if(!path || !(speed > 0.0) || max_gap_ms < 0) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return NULL;
+	}
+	size_t len = strlen(path);
+	ReplayJob* job = (ReplayJob*)malloc(sizeof(ReplayJob) + len);
+	if(!job) { SetLastError(ERROR_OUTOFMEMORY); return NULL; }
+	job->speed = speed;
+	job->max_gap_ms = max_gap_ms;
+	job->flags = flags;
+	memcpy(job->path, path, len + 1);
+	return async_submit(replay_job_run, job);
+}
@@ -0,0 +1,222 @@
+/*
+ * seqauto.c - Key sequence automaton construction and stepping
+ *
+ * Builds the trie of all sequences, links every state to its longest
+ * proper suffix that is also a trie state (the Aho-Corasick failure link)
+ * and then folds the failure links into explicit transitions, turning the
+ * trie into a DFA. A state's transitions are its trie children plus the
+ * folded transitions of its failure state, which is shallower and so
+ * already complete when visited in breadth-first order.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "seqauto.h"
+
+#define SEQ_EDGE_KEY(state, symbol) (((unsigned long long)(state) + 1) << 16 | (symbol))
+
+static unsigned seq_hash(unsigned long long key) {
+	return (unsigned)((key * 0x9E3779B97F4A7C15ULL) >> 40);
+}
+
+/*
+ * seq_lookup - Find an edge in an open-addressed table
+ *
+ * Returns: Target state, or -1 if there is no such edge
+ */
+static int seq_lookup(const SeqEdge* edges, unsigned mask, unsigned long long key) {
+	unsigned at = seq_hash(key) & mask;
+	while(edges[at].key) {
+		if(edges[at].key == key) return edges[at].to;
+		at = (at + 1) & mask;
+	}
+	return -1;
+}
+
+static void seq_insert(SeqEdge* edges, unsigned mask, unsigned long long key, int to) {
+	unsigned at = seq_hash(key) & mask;
+	while(edges[at].key) at = (at + 1) & mask;
+	edges[at].key = key;
+	edges[at].to = to;
+}
+
+static size_t seq_table_size(size_t entries) {
+	size_t n = 8;
+	while(n < entries * 2) n <<= 1;
+	return n;
+}
+
+/*
+ * seq_compile - Build the automaton using caller-provided scratch space
+ *
+ * @trie: Zeroed edge table of trie_mask + 1 slots
+ * @scratch: Room for 9 * max_nodes ints
+ * @max_nodes: 1 + total number of steps
+ *
+ * Returns: Automaton, or NULL if out of memory
+ */
+static SeqAutomaton* seq_compile(const SeqDef* defs, int count, SeqEdge* trie, unsigned trie_mask,
+                                 int* scratch, int max_nodes) {
+	int* sym = scratch;                       /* Symbol on the edge into a state */
+	int* child = sym + max_nodes;             /* First trie child, -1 if none */
+	int* sibling = child + max_nodes;         /* Next trie child of the same parent */
+	int* fail = sibling + max_nodes;
+	int* order = fail + max_nodes;            /* States in breadth-first order */
+	int* edge_first = order + max_nodes;      /* Transitions of a state are list[first .. first + count) */
+	int* edge_count = edge_first + max_nodes;
+	int* out_count = edge_count + max_nodes;
+	int* out_next = out_count + max_nodes;    /* Fill position while placing outputs */
+
+	/* Trie */
+	int nodes = 1;
+	child[0] = -1;
+	for(int i = 0; i < count; ++i) {
+		int s = 0;
+		for(int k = 0; k < defs[i].out.count; ++k) {
+			unsigned key = defs[i].steps[k];
+			int t = seq_lookup(trie, trie_mask, SEQ_EDGE_KEY(s, key));
+			if(t < 0) {
+				t = nodes++;
+				sym[t] = (int)key;
+				child[t] = -1;
+				sibling[t] = child[s];
+				child[s] = t;
+				seq_insert(trie, trie_mask, SEQ_EDGE_KEY(s, key), t);
+			}
+			s = t;
+		}
+	}
+
+	/* Failure links, breadth first */
+	int head = 0, tail = 0;
+	order[tail++] = 0;
+	fail[0] = 0;
+	while(head < tail) {
+		int u = order[head++];
+		for(int c = child[u]; c >= 0; c = sibling[c]) {
+			order[tail++] = c;
+			if(u == 0) {
+				fail[c] = 0;
+				continue;
+			}
+			int f = fail[u];
+			int g;
+			while((g = seq_lookup(trie, trie_mask, SEQ_EDGE_KEY(f, (unsigned)sym[c]))) < 0 && f) f = fail[f];
+			fail[c] = g >= 0 ? g : 0;
+		}
+	}
+
+	/* Fold failure links into transitions. Those equal to state 0's are
+	   left out, seqauto_next falls back to state 0 */
+	SeqEdge* list = NULL;
+	size_t n_edges = 0, cap_edges = 0;
+	for(int i = 0; i < nodes; ++i) {
+		int s = order[i];
+		edge_first[s] = (int)n_edges;
+		int f = fail[s];
+		size_t need = n_edges + (size_t)max_nodes + (f ? (size_t)edge_count[f] : 0);
+		if(need > cap_edges) {
+			size_t cap = cap_edges ? cap_edges : 64;
+			while(cap < need) cap *= 2;
+			SeqEdge* grown = (SeqEdge*)realloc(list, cap * sizeof(SeqEdge));
+			if(!grown) {
+				free(list);
+				return NULL;
+			}
+			list = grown;
+			cap_edges = cap;
+		}
+		for(int c = child[s]; c >= 0; c = sibling[c]) {
+			list[n_edges].key = SEQ_EDGE_KEY(s, (unsigned)sym[c]);
+			list[n_edges++].to = c;
+		}
+		if(s && f) {
+			for(int e = edge_first[f]; e < edge_first[f] + edge_count[f]; ++e) {
+				unsigned key = (unsigned)(list[e].key & 0xFFFF);
+				if(seq_lookup(trie, trie_mask, SEQ_EDGE_KEY(s, key)) >= 0) continue;
+				list[n_edges].key = SEQ_EDGE_KEY(s, key);
+				list[n_edges++].to = list[e].to;
+			}
+		}
+		edge_count[s] = (int)(n_edges - (size_t)edge_first[s]);
+	}
+
+	size_t edge_size = seq_table_size(n_edges);
+	SeqAutomaton* a = (SeqAutomaton*)calloc(1, sizeof(SeqAutomaton) + edge_size * sizeof(SeqEdge) +
+	                          (size_t)count * sizeof(SeqOutput) + (size_t)nodes * sizeof(SeqNode));
+	if(!a) {
+		free(list);
+		return NULL;
+	}
+	a->edges = (SeqEdge*)(a + 1);
+	a->mask = (unsigned)edge_size - 1;
+	a->out = (SeqOutput*)(a->edges + edge_size);
+	a->nodes = (SeqNode*)(a->out + count);
+	a->node_count = nodes;
+	for(size_t e = 0; e < n_edges; ++e) seq_insert(a->edges, a->mask, list[e].key, list[e].to);
+	free(list);
+
+	/* Outputs, grouped by the state each sequence ends in */
+	memset(out_count, 0, (size_t)nodes * sizeof(int));
+	for(int i = 0; i < count; ++i) {
+		int s = 0;
+		for(int k = 0; k < defs[i].out.count; ++k) s = seq_lookup(trie, trie_mask, SEQ_EDGE_KEY(s, defs[i].steps[k]));
+		out_count[s]++;
+	}
+	int pos = 0;
+	for(int s = 0; s < nodes; ++s) {
+		a->nodes[s].out_first = pos;
+		a->nodes[s].out_count = out_count[s];
+		out_next[s] = pos;
+		pos += out_count[s];
+	}
+	for(int i = 0; i < count; ++i) {
+		int s = 0;
+		for(int k = 0; k < defs[i].out.count; ++k) s = seq_lookup(trie, trie_mask, SEQ_EDGE_KEY(s, defs[i].steps[k]));
+		a->out[out_next[s]++] = defs[i].out;
+	}
+	a->nodes[0].dict = -1;
+	for(int i = 1; i < nodes; ++i) {
+		int s = order[i];
+		int f = fail[s];
+		a->nodes[s].dict = out_count[f] ? f : a->nodes[f].dict;
+	}
+	return a;
+}
+
+/*
+ * seqauto_build - Compile a set of sequences
+ *
+ * @defs: Sequences, each with at least one step
+ * @count: Number of sequences, at least 1
+ *
+ * Returns: Automaton to release with free, or NULL if out of memory
+ */
+SeqAutomaton* seqauto_build(const SeqDef* defs, int count) {
+	int max_nodes = 1;
+	for(int i = 0; i < count; ++i) max_nodes += defs[i].out.count;
+
+	size_t trie_size = seq_table_size((size_t)max_nodes);
+	SeqEdge* trie = (SeqEdge*)calloc(trie_size, sizeof(SeqEdge));
+	int* scratch = (int*)malloc((size_t)max_nodes * 9 * sizeof(int));
+	SeqAutomaton* a = NULL;
+	if(trie && scratch) a = seq_compile(defs, count, trie, (unsigned)trie_size - 1, scratch, max_nodes);
+	free(scratch);
+	free(trie);
+	return a;
+}
+
+/*
+ * seqauto_next - Take one transition
+ *
+ * @a: Automaton
+ * @state: Current state
+ * @symbol: SEQ_SYMBOL of the key press
+ *
+ * Returns: Next state
+ */
+int seqauto_next(const SeqAutomaton* a, int state, unsigned symbol) {
+	int t = seq_lookup(a->edges, a->mask, SEQ_EDGE_KEY(state, symbol));
+	if(t < 0 && state) t = seq_lookup(a->edges, a->mask, SEQ_EDGE_KEY(0, symbol));
+	return t < 0 ? 0 : t;
+}
@@ -0,0 +1,67 @@
+/*
+ * seqauto.h - Internal key sequence automaton
+ *
+ * Compiles a set of key sequences into one Aho-Corasick automaton whose
+ * failure transitions are resolved ahead of time, so matching takes a
+ * single transition per step however many sequences are registered.
+ * Symbols are (vk, modifier mask) pairs. Automata are immutable once
+ * built and are published with the listener's rule snapshots.
+ */
+
+#pragma once
+
+#include "platform.h"
+
+/* Symbol of a key press, vk in the low byte and L_MOD_* bits above */
+#define SEQ_SYMBOL(vk, mods) ((unsigned)(vk) | ((unsigned)(mods) << 8))
+
+/*
+ * SeqOutput - A sequence as reported on a match
+ */
+typedef struct SeqOutput {
+	int id;
+	int flags;                          /* HOTKEY_* */
+	int count;                          /* Number of steps */
+	int timeout_ms;                     /* Longest gap between steps, 0 for none */
+	void (*cb)(int id, EventEx* ev);
+} SeqOutput;
+
+/*
+ * SeqDef - A sequence as given to seqauto_build
+ */
+typedef struct SeqDef {
+	SeqOutput out;
+	unsigned steps[SEQUENCE_MAX_STEPS];  /* SEQ_SYMBOL per step */
+} SeqDef;
+
+typedef struct SeqNode {
+	int out_first;                      /* Sequences ending here are out[first .. first + count) */
+	int out_count;
+	int dict;                           /* Nearest proper suffix state with outputs, -1 if none */
+} SeqNode;
+
+typedef struct SeqEdge {
+	unsigned long long key;             /* (state + 1) << 16 | symbol, 0 if empty */
+	int to;
+} SeqEdge;
+
+/*
+ * SeqAutomaton - Compiled sequence set
+ *
+ * State 0 is the start. Only the transitions of state 0 and those of other
+ * states that differ from state 0's are stored, in one open-addressed
+ * table. Everything lives in a single allocation.
+ */
+typedef struct SeqAutomaton {
+	SeqEdge* edges;
+	unsigned mask;                      /* Edge slot count - 1 */
+	SeqNode* nodes;
+	SeqOutput* out;                     /* Grouped by end state, in definition order */
+	int node_count;
+} SeqAutomaton;
+
+/* Build an automaton from count sequences; returns NULL if out of memory */
+SeqAutomaton* seqauto_build(const SeqDef* defs, int count);
+
+/* State after seeing symbol in state */
+int seqauto_next(const SeqAutomaton* a, int state, unsigned symbol);
@@ -0,0 +1,226 @@
+/*
+ * timing.c - Precise timing and pacing engine
+ *
+ * Replaces coarse Sleep-based delays with microsecond-resolution absolute
+ * deadlines. On Windows the bulk of a wait is slept on a high-resolution
+ * waitable timer and the last stretch is spun on QueryPerformanceCounter;
+ * elsewhere clock_nanosleep(TIMER_ABSTIME) does the same job. Every wait
+ * records how late it woke up, exposed through input_timingstats.
+ */
+
+#include <string.h>
+#include "backend.h"
+#include "timing.h"
+
+#ifdef _WIN32
+	#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+		#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+	#endif
+	/* Remaining time that is spun instead of slept on the timer */
+	#define TIMING_SPIN_NS 1000000ULL
+#else
+	#include <time.h>
+	#include <errno.h>
+	/* Remaining time that is spun instead of slept */
+	#define TIMING_SPIN_NS 50000ULL
+#endif
+
+/* Longest single wait in pacer_waitc before the cancel flag is re-checked */
+#define PACER_SLICE_US 50000LL
+
+/* Wake-up lateness statistics, updated atomically */
+static unsigned long long g_timing_waits = 0;
+static unsigned long long g_timing_total_late = 0;
+static unsigned long long g_timing_max_late = 0;
+static unsigned long long g_timing_missed = 0;
+
+#ifdef _WIN32
+
+/* Per-thread waitable timer, created on first use */
+static __thread HANDLE t_timer = NULL;
+
+/*
+ * timing_timer - Get this thread's waitable timer
+ *
+ * Prefers a high-resolution timer (Windows 10 1803+) and falls back to a
+ * regular manual-reset timer on older systems.
+ */
+static HANDLE timing_timer(void) {
+	if(t_timer) return t_timer;
+	t_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if(!t_timer) t_timer = CreateWaitableTimerW(NULL, TRUE, NULL);
+	return t_timer;
+}
+
+unsigned long long timing_now_ns(void) {
+	static LARGE_INTEGER freq = {0};
+	if(!freq.QuadPart) QueryPerformanceFrequency(&freq);
+	LARGE_INTEGER c;
+	QueryPerformanceCounter(&c);
+	unsigned long long f = (unsigned long long)freq.QuadPart;
+	unsigned long long v = (unsigned long long)c.QuadPart;
+	/* Split to avoid overflowing 64 bits */
+	return (v / f) * 1000000000ULL + (v % f) * 1000000000ULL / f;
+}
+
+void timing_sleep_until_ns(unsigned long long deadline) {
+	unsigned long long now = timing_now_ns();
+	if(now + TIMING_SPIN_NS < deadline) {
+		HANDLE timer = timing_timer();
+		unsigned long long sleep_ns = deadline - now - TIMING_SPIN_NS;
+		if(timer) {
+			LARGE_INTEGER due;
+			due.QuadPart = -(LONGLONG)(sleep_ns / 100);  /* Relative, 100ns units */
+			if(SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) WaitForSingleObject(timer, INFINITE);
+		} else {
+			Sleep((DWORD)(sleep_ns / 1000000ULL));
+		}
+	}
+	/* Spin for the final stretch */
+	while(timing_now_ns() < deadline) YieldProcessor();
+}
+
+#else
+
+unsigned long long timing_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+void timing_sleep_until_ns(unsigned long long deadline) {
+	if(deadline > TIMING_SPIN_NS && timing_now_ns() + TIMING_SPIN_NS < deadline) {
+		unsigned long long wake = deadline - TIMING_SPIN_NS;
+		struct timespec ts;
+		ts.tv_sec = (time_t)(wake / 1000000000ULL);
+		ts.tv_nsec = (long)(wake % 1000000000ULL);
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+	}
+	/* Spin for the final stretch */
+	while(timing_now_ns() < deadline) {}
+}
+
+#endif
+
+/*
+ * timing_record - Record the lateness of one wait
+ *
+ * @late: Nanoseconds past the deadline at wake-up
+ * @missed: 1 if the deadline had already passed before waiting
+ */
+static void timing_record(unsigned long long late, int missed) {
+	__atomic_fetch_add(&g_timing_waits, 1, __ATOMIC_RELAXED);
+	if(missed) {
+		__atomic_fetch_add(&g_timing_missed, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	__atomic_fetch_add(&g_timing_total_late, late, __ATOMIC_RELAXED);
+	unsigned long long max = __atomic_load_n(&g_timing_max_late, __ATOMIC_RELAXED);
+	while(late > max && !__atomic_compare_exchange_n(&g_timing_max_late, &max, late, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+/*
+ * timing_wait_until - Wait until an absolute backend deadline
+ *
+ * @deadline: Backend time in nanoseconds
+ *
+ * Deadlines that have already passed return immediately and count as
+ * missed rather than late.
+ */
+void timing_wait_until(unsigned long long deadline) {
+	unsigned long long now = g_backend->now_ns();
+	if(now >= deadline) {
+		timing_record(0, 1);
+		return;
+	}
+	g_backend->sleep_until_ns(deadline);
+	now = g_backend->now_ns();
+	timing_record(now > deadline ? now - deadline : 0, 0);
+}
+
+/*
+ * pacer_start - Start a pacer
+ *
+ * @p: Pacer to start
+ */
+void pacer_start(Pacer* p) {
+	p->next_ns = g_backend->now_ns();
+}
+
+/*
+ * pacer_wait - Wait for the next step of a pacer
+ *
+ * @p: Pacer started with pacer_start
+ * @us: Step length in microseconds
+ */
+void pacer_wait(Pacer* p, long long us) {
+	if(us <= 0) return;
+	p->next_ns += (unsigned long long)us * 1000ULL;
+	timing_wait_until(p->next_ns);
+}
+
+/*
+ * pacer_waitc - Wait for the next step of a pacer, unless cancelled
+ *
+ * @p: Pacer started with pacer_start
+ * @us: Step length in microseconds
+ * @cancel: Flag polled between wait slices, or NULL
+ *
+ * Long steps are split into slices so a cancellation is noticed within
+ * PACER_SLICE_US. The deadline only advances by the part actually waited.
+ *
+ * Returns: 1 if cancelled, 0 otherwise
+ */
+int pacer_waitc(Pacer* p, long long us, const int* cancel) {
+	if(!cancel) {
+		pacer_wait(p, us);
+		return 0;
+	}
+	while(us > 0) {
+		if(__atomic_load_n(cancel, __ATOMIC_ACQUIRE)) return 1;
+		long long step = us < PACER_SLICE_US ? us : PACER_SLICE_US;
+		pacer_wait(p, step);
+		us -= step;
+	}
+	return __atomic_load_n(cancel, __ATOMIC_ACQUIRE) ? 1 : 0;
+}
+
+/*
+ * input_sleep_us - Sleep for a specified duration in microseconds
+ *
+ * @us: Number of microseconds to sleep
+ *
+ * Waits on an absolute deadline with sub-millisecond precision. On the
+ * simulated backend this only advances the virtual clock.
+ */
+void INPUTLIB_CALL input_sleep_us(long long us) {
+	if(us <= 0) return;
+	timing_wait_until(g_backend->now_ns() + (unsigned long long)us * 1000ULL);
+}
+
+/*
+ * input_timingstats - Get pacing jitter statistics
+ *
+ * @out: Pointer to InputTimingStats struct to populate
+ * @reset: If nonzero, the counters are reset after being read
+ *
+ * Returns: 0 on success, 1 if out is NULL
+ */
+int INPUTLIB_CALL input_timingstats(InputTimingStats* out, int reset) {
+	if(!out) { SetLastError(ERROR_INVALID_PARAMETER); return 1; }
+	memset(out, 0, sizeof(*out));
+	if(reset) {
+		out->waits = __atomic_exchange_n(&g_timing_waits, 0, __ATOMIC_RELAXED);
+		out->missed = __atomic_exchange_n(&g_timing_missed, 0, __ATOMIC_RELAXED);
+		out->total_late_ns = __atomic_exchange_n(&g_timing_total_late, 0, __ATOMIC_RELAXED);
+		out->max_late_ns = __atomic_exchange_n(&g_timing_max_late, 0, __ATOMIC_RELAXED);
+	} else {
+		out->waits = __atomic_load_n(&g_timing_waits, __ATOMIC_RELAXED);
+		out->missed = __atomic_load_n(&g_timing_missed, __ATOMIC_RELAXED);
+		out->total_late_ns = __atomic_load_n(&g_timing_total_late, __ATOMIC_RELAXED);
+		out->max_late_ns = __atomic_load_n(&g_timing_max_late, __ATOMIC_RELAXED);
+	}
+	unsigned long long timed = out->waits - out->missed;
+	out->mean_late_ns = timed ? out->total_late_ns / timed : 0;
+	return 0;
+}
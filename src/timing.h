@@ -0,0 +1,35 @@
+/*
+ * timing.h - Internal precise timing and pacing
+ */
+
+#pragma once
+
+#include "platform.h"
+
+/* Monotonic clock in nanoseconds (QPC on Windows, CLOCK_MONOTONIC elsewhere) */
+unsigned long long timing_now_ns(void);
+
+/* Sleep on the real clock until an absolute timing_now_ns deadline */
+void timing_sleep_until_ns(unsigned long long deadline);
+
+/* Wait on the backend clock until an absolute deadline and record jitter */
+void timing_wait_until(unsigned long long deadline);
+
+/*
+ * Pacer - Schedules a series of waits against absolute deadlines
+ *
+ * Each wait is measured from the previous deadline rather than from when
+ * the caller woke up, so per-step error does not accumulate.
+ */
+typedef struct Pacer {
+	unsigned long long next_ns;   /* Next deadline on the backend clock */
+} Pacer;
+
+/* Start a pacer at the current backend time */
+void pacer_start(Pacer* p);
+
+/* Advance the deadline by us microseconds and wait for it */
+void pacer_wait(Pacer* p, long long us);
+
+/* Like pacer_wait, but returns 1 early once *cancel becomes nonzero */
+int pacer_waitc(Pacer* p, long long us, const int* cancel);
@@ -2,24 +2,30 @@
  * util.c - Utility functions for initialization, timing, and error handling
  * 
  * Provides core utility functions needed by other parts of the library,
- * including DPI awareness setup, sleep functionality, and Windows error
- * message formatting.
+ * including backend selection and setup, sleep functionality, and Windows
+ * error message formatting.
  */
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
 #include <stdio.h>
 #include <string.h>
-#include "inputlib.h"
+#include "backend.h"
+#include "layout.h"
 
 /* Thread-local storage for the last Windows error code */
 static __thread DWORD last_err_code = 0;
 
+/* Currently selected platform backend */
+#ifdef _WIN32
+const InputBackend* g_backend = &backend_win32;
+#else
+const InputBackend* g_backend = &backend_sim;
+#endif
+
 /*
  * input_init - Initialize the input library
  * 
- * Performs one-time initialization required by the library, primarily
- * setting up DPI awareness so that coordinate systems work correctly
+ * Performs one-time initialization required by the library. The native
+ * backend sets up DPI awareness so that coordinate systems work correctly
  * on high-DPI displays.
  * 
  * Should be called once before using any other library functions.
@@ -28,17 +34,54 @@ static __thread DWORD last_err_code = 0;
  */
 int INPUTLIB_CALL input_init(void) {
 	last_err_code = 0;
-	
-	/*
-	 * Set DPI awareness to per-monitor V2 mode
-	 * This ensures cursor coordinates and window rectangles are correct
-	 * on systems with multiple monitors at different DPI settings
-	 */
-	SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
+	g_backend->init();
+	layout_init();
     listener_init();
 	return 0;
 }
 
+/*
+ * input_setbackend - Select the platform backend
+ * 
+ * @backend: INPUT_BACKEND_NATIVE or INPUT_BACKEND_SIM
+ * 
+ * Routes every subsequent library call through the given backend. The
+ * backend cannot be changed while the listener is running, since its hook
+ * lives in the previous backend. Listener timestamps are re-based on the
+ * new backend's clock.
+ * 
+ * Returns: 0 on success, 1 on unknown/unavailable backend or running listener
+ */
+int INPUTLIB_CALL input_setbackend(int backend) {
+	const InputBackend* b = NULL;
+	switch(backend) {
+#ifdef _WIN32
+		case INPUT_BACKEND_NATIVE: b = &backend_win32; break;
+#endif
+		case INPUT_BACKEND_SIM: b = &backend_sim; break;
+		default: break;
+	}
+	if(!b) { SetLastError(ERROR_NOT_SUPPORTED); return 1; }
+	listener_init();
+	layout_init();
+	if(listener_isrunning()) { SetLastError(ERROR_INVALID_OPERATION); return 1; }
+	
+	b->init();
+	g_backend = b;
+	layout_invalidate();
+	listener_rebase();
+	return 0;
+}
+
+/*
+ * input_getbackend - Query the selected platform backend
+ * 
+ * Returns: INPUT_BACKEND_NATIVE or INPUT_BACKEND_SIM
+ */
+int INPUTLIB_CALL input_getbackend(void) {
+	return g_backend == &backend_sim ? INPUT_BACKEND_SIM : INPUT_BACKEND_NATIVE;
+}
+
 /*
  * input_sleep - Sleep for a specified duration
  * 
@@ -46,10 +89,11 @@ int INPUTLIB_CALL input_init(void) {
  * 
  * Pauses execution for the specified duration. Used to add delays between
  * input events to make automation appear more natural and to ensure the
- * system has time to process events.
+ * system has time to process events. Waits on an absolute deadline through
+ * the precise timing engine, see input_sleep_us.
  */
 void INPUTLIB_CALL input_sleep(int ms) {
-	Sleep(ms);
+	input_sleep_us((long long)ms * 1000);
 }
 
 /*
@@ -73,10 +117,11 @@ void INPUTLIB_CALL input_gle(char* buffer, size_t len) {
 	
 	/* Handle the "no error" case */
 	if(err == 0) {
-		strncpy_s(buffer, len, "No error", _TRUNCATE);
+		snprintf(buffer, len, "No error");
 		return;
 	}
 	
+#ifdef _WIN32
 	/* Format the error code into a human-readable message */
 	LPVOID msg_buf = NULL;
 	FormatMessageA(
@@ -95,8 +140,9 @@ void INPUTLIB_CALL input_gle(char* buffer, size_t len) {
 		/* Successfully formatted - copy to output buffer */
 		strncpy_s(buffer, len, (char*)msg_buf, _TRUNCATE);
 		LocalFree(msg_buf);  /* Free the allocated message buffer */
-	} else {
-		/* FormatMessage failed - just show the error code */
-		snprintf(buffer, len, "Unknown error %lu", err);
+		return;
 	}
+#endif
+	/* No system message available - just show the error code */
+	snprintf(buffer, len, "Unknown error %lu", (unsigned long)err);
 }
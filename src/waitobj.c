@@ -0,0 +1,107 @@
+/*
+ * waitobj.c - Waitable signal for joining external event loops
+ */
+
+#include "waitobj.h"
+
+#ifdef _WIN32
+
+int waitobj_create(WaitObj* w) {
+	w->event = CreateEventA(NULL, TRUE, FALSE, NULL);
+	return w->event ? 0 : 1;
+}
+
+void waitobj_signal(WaitObj* w) {
+	SetEvent(w->event);
+}
+
+void waitobj_reset(WaitObj* w) {
+	ResetEvent(w->event);
+}
+
+int waitobj_wait(WaitObj* w, DWORD ms) {
+	return WaitForSingleObject(w->event, ms) == WAIT_OBJECT_0;
+}
+
+intptr_t waitobj_export(WaitObj* w) {
+	return (intptr_t)w->event;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+	#include <sys/eventfd.h>
+#endif
+
+/*
+ * waitobj_create - Create a signal
+ *
+ * Returns: 0 on success, 1 if no descriptor could be created
+ */
+int waitobj_create(WaitObj* w) {
+#ifdef __linux__
+	int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(fd < 0) return 1;
+	w->rd = w->wr = fd;
+#else
+	int fds[2];
+	if(pipe(fds) != 0) return 1;
+	for(int i = 0; i < 2; ++i) {
+		fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+		fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+	}
+	w->rd = fds[0];
+	w->wr = fds[1];
+#endif
+	return 0;
+}
+
+/*
+ * waitobj_signal - Set a signal
+ *
+ * A full pipe or a saturated eventfd is already signalled, so a failed
+ * write is ignored.
+ */
+void waitobj_signal(WaitObj* w) {
+	uint64_t one = 1;
+	ssize_t n = write(w->wr, &one, w->rd == w->wr ? sizeof(one) : 1);
+	(void)n;
+}
+
+/*
+ * waitobj_reset - Clear a signal
+ */
+void waitobj_reset(WaitObj* w) {
+	uint64_t buf[8];
+	if(w->rd == w->wr) {
+		ssize_t n = read(w->rd, buf, sizeof(uint64_t));  /* An eventfd read zeroes the counter */
+		(void)n;
+		return;
+	}
+	while(read(w->rd, buf, sizeof(buf)) > 0) {}
+}
+
+/*
+ * waitobj_wait - Wait for a signal
+ *
+ * Returns: 1 if signalled, 0 on timeout
+ */
+int waitobj_wait(WaitObj* w, DWORD ms) {
+	struct pollfd p = { w->rd, POLLIN, 0 };
+	int timeout = ms == INFINITE ? -1 : (int)ms;
+	for(;;) {
+		int rc = poll(&p, 1, timeout);
+		if(rc > 0) return 1;
+		if(rc == 0 || errno != EINTR) return 0;
+	}
+}
+
+intptr_t waitobj_export(WaitObj* w) {
+	return (intptr_t)w->rd;
+}
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * waitobj.h - Internal waitable signal that event loops can join
+ *
+ * A manual-reset signal backed by a Win32 event on Windows, an eventfd on
+ * Linux and a non-blocking pipe elsewhere, so callers can add it to their
+ * own WaitForMultipleObjects, poll or epoll loop.
+ */
+
+#pragma once
+
+#include "platform.h"
+
+typedef struct WaitObj {
+#ifdef _WIN32
+	HANDLE event;
+#else
+	int rd;    /* Readable while signalled */
+	int wr;    /* Same descriptor as rd for an eventfd */
+#endif
+} WaitObj;
+
+/* Create the signal, initially reset; returns 0 on success */
+int waitobj_create(WaitObj* w);
+
+/* Set the signal */
+void waitobj_signal(WaitObj* w);
+
+/* Clear the signal */
+void waitobj_reset(WaitObj* w);
+
+/* Wait up to ms milliseconds (INFINITE to wait forever); returns 1 if signalled, 0 on timeout */
+int waitobj_wait(WaitObj* w, DWORD ms);
+
+/* Handle or file descriptor callers can wait on */
+intptr_t waitobj_export(WaitObj* w);
@@ -3,17 +3,43 @@
  * 
  * Provides functions for finding, manipulating, and querying information about
  * Windows desktop windows. Includes support for window activation, positioning,
- * state changes, and process information retrieval.
+ * state changes, and process information retrieval. All window system access
+ * goes through the platform backend.
  */
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#include <psapi.h>
-#pragma comment(lib, "Psapi.lib")
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include "inputlib.h"
+#include "backend.h"
+
+/*
+ * find_title_ctx - Search state for find_by_title
+ */
+typedef struct {
+	const char* title;  /* Title being searched for */
+	HWND found;         /* First match in Z-order */
+} find_title_ctx;
+
+/*
+ * find_by_title_proc - Window enumeration callback for find_by_title
+ * 
+ * @hwnd: Handle of the window being enumerated
+ * @ctx: User data (pointer to find_title_ctx)
+ * 
+ * Returns: 0 to stop enumeration once a match is found, 1 to continue
+ */
+static int find_by_title_proc(HWND hwnd, void* ctx) {
+	find_title_ctx* f = (find_title_ctx*)ctx;
+	char buf[512];
+	if(g_backend->window_title(hwnd, buf, sizeof(buf))) {
+		/* Case-insensitive title comparison */
+		if(_stricmp(buf, f->title) == 0) {
+			f->found = hwnd;
+			return 0;
+		}
+	}
+	return 1;
+}
 
 /*
  * find_by_title - Find a window by its exact title
@@ -28,23 +54,10 @@
 static HWND find_by_title(const char* title) {
 	if(!title) return NULL;
 	
-	/* Start with the first top-level window */
-	HWND hwnd = GetTopWindow(NULL);
-	char buf[512];
-	
-	/* Iterate through all top-level windows */
-	while(hwnd) {
-		/* Only check visible windows */
-		if(IsWindowVisible(hwnd)) {
-			if(GetWindowTextA(hwnd, buf, sizeof(buf))) {
-				/* Case-insensitive title comparison */
-				if(_stricmp(buf, title) == 0) return hwnd;
-			}
-		}
-		/* Move to next window in Z-order */
-		hwnd = GetNextWindow(hwnd, GW_HWNDNEXT);
-	}
-	return NULL;  /* Window not found */
+	/* Iterate through all visible top-level windows in Z-order */
+	find_title_ctx f = { title, NULL };
+	g_backend->window_enum(find_by_title_proc, &f);
+	return f.found;  /* NULL if window not found */
 }
 
 /*
@@ -59,9 +72,9 @@ static HWND find_by_title(const char* title) {
  */
 int INPUTLIB_CALL window_getactive(char* title_out, size_t title_len) {
 	if(!title_out || title_len == 0) return 1;
-	HWND hwnd = GetForegroundWindow();
+	HWND hwnd = g_backend->window_foreground();
 	if(!hwnd) return 1;
-	if(GetWindowTextA(hwnd, title_out, (int)title_len) == 0) return 1;
+	if(g_backend->window_title(hwnd, title_out, title_len) == 0) return 1;
 	return 0;
 }
 
@@ -78,7 +91,7 @@ int INPUTLIB_CALL window_getactive(char* title_out, size_t title_len) {
 int INPUTLIB_CALL window_setactive(const char* title) {
 	HWND hwnd = find_by_title(title);
 	if(!hwnd) return 1;
-	if(!SetForegroundWindow(hwnd)) return 1;
+	if(g_backend->window_activate(hwnd)) return 1;
 	return 0;
 }
 
@@ -100,14 +113,8 @@ int INPUTLIB_CALL window_getrect(const char* title, int* x, int* y, int* w, int*
 	HWND hwnd = find_by_title(title);
 	if(!hwnd) return 1;
 	
-	RECT r;
-	if(!GetWindowRect(hwnd, &r)) return 1;
-	
-	/* Extract position and dimensions from RECT */
-	*x = r.left;
-	*y = r.top;
-	*w = r.right - r.left;   /* Width */
-	*h = r.bottom - r.top;   /* Height */
+	/* Position and dimensions from the window rectangle */
+	if(g_backend->window_rect(hwnd, x, y, w, h)) return 1;
 	return 0;
 }
 
@@ -128,7 +135,7 @@ int INPUTLIB_CALL window_getrect(const char* title, int* x, int* y, int* w, int*
 int INPUTLIB_CALL window_move(const char* title, int x, int y, int w, int h) {
 	HWND hwnd = find_by_title(title);
 	if(!hwnd) return 1;
-	if(!MoveWindow(hwnd, x, y, w, h, TRUE)) return 1;
+	if(g_backend->window_move(hwnd, x, y, w, h)) return 1;
 	return 0;
 }
 
@@ -144,7 +151,7 @@ int INPUTLIB_CALL window_move(const char* title, int x, int y, int w, int h) {
 int INPUTLIB_CALL window_maximize(const char* title) {
 	HWND hwnd = find_by_title(title);
 	if(!hwnd) return 1;
-	if(!ShowWindow(hwnd, SW_MAXIMIZE)) return 1;
+	if(g_backend->window_show(hwnd, SW_MAXIMIZE)) return 1;
 	return 0;
 }
 
@@ -160,7 +167,7 @@ int INPUTLIB_CALL window_maximize(const char* title) {
 int INPUTLIB_CALL window_minimize(const char* title) {
 	HWND hwnd = find_by_title(title);
 	if(!hwnd) return 1;
-	if(!ShowWindow(hwnd, SW_MINIMIZE)) return 1;
+	if(g_backend->window_show(hwnd, SW_MINIMIZE)) return 1;
 	return 0;
 }
 
@@ -177,7 +184,7 @@ int INPUTLIB_CALL window_minimize(const char* title) {
 int INPUTLIB_CALL window_close(const char* title) {
 	HWND hwnd = find_by_title(title);
 	if(!hwnd) return 1;
-	if(!PostMessageA(hwnd, WM_CLOSE, 0, 0)) return 1;  /* Request close */
+	if(g_backend->window_close(hwnd)) return 1;  /* Request close */
 	return 0;
 }
 
@@ -200,45 +207,12 @@ int INPUTLIB_CALL window_info(HWND hwnd, window_info_t* out) {
 	memset(out, 0, sizeof(window_info_t));
 	out->hwnd = hwnd;
 	
-	/* Validate window handle */
-	if(!hwnd || !IsWindow(hwnd)) {
+	/* Query window and process details from the backend */
+	if(!hwnd || g_backend->window_query(hwnd, out)) {
 		out->valid = 0;
 		return 1;
 	}
 	
-	/* Get process and thread IDs */
-	DWORD pid = 0;
-	DWORD tid = GetWindowThreadProcessId(hwnd, &pid);
-	out->pid = pid;
-	out->tid = tid;
-	
-	/* Get window title and class name */
-	if(!GetWindowTextA(hwnd, out->title, sizeof(out->title))) out->title[0] = '\0';
-	if(!GetClassNameA(hwnd, out->classname, sizeof(out->classname))) out->classname[0] = '\0';
-	
-	/* Open process to get executable information */
-	HANDLE hProc = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pid);
-	if(hProc) {
-		/* Get full path to executable */
-		if(!GetModuleFileNameExA(hProc, NULL, out->procpath, sizeof(out->procpath))) out->procpath[0] = '\0';
-		
-		/* Extract just the filename from the full path */
-		if(out->procpath[0]) {
-			const char* p = strrchr(out->procpath, '\\');  /* Find last backslash */
-			if(p) {
-				strncpy(out->procname, p + 1, sizeof(out->procname));  /* Copy filename */
-			} else {
-				strncpy(out->procname, out->procpath, sizeof(out->procname));  /* No path separator */
-			}
-		} else out->procname[0] = '\0';
-		
-		CloseHandle(hProc);
-	} else {
-		/* Unable to open process - may lack permissions */
-		out->procpath[0] = '\0';
-		out->procname[0] = '\0';
-	}
-	
 	out->valid = 1;
 	return 0;
 }
@@ -255,32 +229,29 @@ typedef struct {
 } window_list_builder;
 
 /*
- * enum_windows_proc - Callback for EnumWindows to collect window titles
+ * enum_windows_proc - Callback for window enumeration to collect window titles
  * 
  * @hwnd: Handle of the window being enumerated
- * @lparam: User data (pointer to window_list_builder)
+ * @ctx: User data (pointer to window_list_builder)
  * 
- * Called once for each top-level window. Collects titles of visible windows
- * into a dynamically growing array. The array capacity doubles when full.
+ * Called once for each visible top-level window. Collects titles into a
+ * dynamically growing array. The array capacity doubles when full.
  * 
- * Returns: TRUE to continue enumeration, FALSE on error
+ * Returns: 1 to continue enumeration, 0 on error
  */
-static BOOL CALLBACK enum_windows_proc(HWND hwnd, LPARAM lparam) {
-	/* Skip invisible windows */
-	if(!IsWindowVisible(hwnd)) return TRUE;
-	
+static int enum_windows_proc(HWND hwnd, void* ctx) {
 	char title[512];
-	if(GetWindowTextA(hwnd, title, sizeof(title)) == 0) return TRUE;
-	if(title[0] == '\0') return TRUE;  /* Skip windows with no title */
+	if(g_backend->window_title(hwnd, title, sizeof(title)) == 0) return 1;
+	if(title[0] == '\0') return 1;  /* Skip windows with no title */
 	
-	window_list_builder* b = (window_list_builder*)lparam;
+	window_list_builder* b = (window_list_builder*)ctx;
 	
 	/* Grow array if needed (doubling strategy) */
 	if(b->count >= b->capacity) {
 		int newcap = b->capacity * 2;
 		if(newcap < 8) newcap = 8;  /* Initial capacity */
 		char** newarr = (char**)realloc(b->arr, newcap * sizeof(char*));
-		if(!newarr) return FALSE;  /* Allocation failed */
+		if(!newarr) return 0;  /* Allocation failed */
 		b->arr = newarr;
 		b->capacity = newcap;
 	}
@@ -288,11 +259,11 @@ static BOOL CALLBACK enum_windows_proc(HWND hwnd, LPARAM lparam) {
 	/* Allocate and copy the title string */
 	size_t len = strlen(title);
 	char* t = (char*)malloc(len + 1);
-	if(!t) return FALSE;  /* Allocation failed */
+	if(!t) return 0;  /* Allocation failed */
 	strcpy(t, title);
 	b->arr[b->count++] = t;
 	
-	return TRUE;  /* Continue enumeration */
+	return 1;  /* Continue enumeration */
 }
 
 /*
@@ -317,7 +288,7 @@ int INPUTLIB_CALL window_list(char*** titles_out, int* count_out) {
 	b.arr = NULL;
 	
 	/* Enumerate all windows, collecting titles */
-	if(!EnumWindows(enum_windows_proc, (LPARAM)&b)) {
+	if(g_backend->window_enum(enum_windows_proc, &b)) {
 		/* Enumeration failed - clean up partial results */
 		for(int i = 0; i < b.count; i++) free(b.arr[i]);
 		free(b.arr);
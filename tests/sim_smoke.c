@@ -0,0 +1,902 @@
+/*
+ * sim_smoke.c - Smoke test of the listener on the simulated backend
+ *
+ * Drives physical key events through sim_keyevent and checks that they
+ * are queued, blocked and counted as the listener promises. Injected 
+ * input goes through the same hook, so the poll queue doubles as a log 
+ * of what the library sent.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include "inputlib.h"
+#include "platform.h"
+
+static int g_failed = 0;
+
+/* Where the last hotkey callback ran */
+static int g_fired_id = 0;
+static pthread_t g_fired_thread;
+
+static void on_hotkey(int id, EventEx* ev) {
+	(void)ev;
+	g_fired_thread = pthread_self();
+	__atomic_store_n(&g_fired_id, id, __ATOMIC_RELEASE);
+}
+
+/* Wait up to a second for a hotkey callback */
+static int wait_fired(void) {
+	struct pollfd none = { -1, 0, 0 };
+	for(int i = 0; i < 1000 && !__atomic_load_n(&g_fired_id, __ATOMIC_ACQUIRE); ++i) poll(&none, 1, 1);
+	return __atomic_load_n(&g_fired_id, __ATOMIC_ACQUIRE);
+}
+
+#define CHECK(cond) do { \
+	if(!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); g_failed = 1; } \
+} while(0)
+
+/* Key presses as +vk, releases as -vk, for comparing injected sequences */
+#define KEYS(...) ((const int[]){ __VA_ARGS__ }), (int)(sizeof((const int[]){ __VA_ARGS__ }) / sizeof(int))
+
+/*
+ * keys_match - Drain the poll queue and compare it with a key sequence
+ * 
+ * VK_PACKET events compare by their UTF-16 code unit instead, which the 
+ * sequence gives with 0x10000 added.
+ */
+static int keys_match(const int* want, int count) {
+	Event ev[64];
+	int n = listener_cbpolln(ev, 64);
+	int ok = n == count;
+	for(int i = 0; ok && i < n; ++i) {
+		int code = ev[i].vk == 0xE7 ? 0x10000 + ev[i].scan : ev[i].vk;
+		ok = (ev[i].pressed ? code : -code) == want[i];
+	}
+	if(!ok) {
+		fprintf(stderr, "got");
+		for(int i = 0; i < n; ++i) fprintf(stderr, " %c0x%X", ev[i].pressed ? '+' : '-', ev[i].vk == 0xE7 ? 0x10000 + ev[i].scan : ev[i].vk);
+		fprintf(stderr, "\n");
+	}
+	return ok;
+}
+
+/*
+ * poll_ex - Poll the next event as an EventEx
+ */
+static int poll_ex(EventEx* ex) {
+	ex->size = sizeof(*ex);
+	return listener_cbpollex(ex) == 1;
+}
+
+/*
+ * test_modifiers - Injected generic modifiers arrive sided, as on Windows
+ */
+static void test_modifiers(void) {
+	Event ev[8];
+	CHECK(listener_start() == 0);
+	CHECK(listener_blockc("CONTROL", "C") == 0);
+	CHECK(key_pressm("CONTROL", "C") == 0);
+	int n = listener_cbpolln(ev, 8);
+	CHECK(n == 2);
+	if(n == 2) CHECK(ev[0].vk == 0xA2 && ev[0].pressed == 1 && ev[1].vk == 0xA2 && ev[1].pressed == 0);
+	CHECK(listener_ublockc("CONTROL", "C") == 0);
+
+	/* The generic code reads as down while either side is */
+	CHECK(sim_keyevent(0xA1, 1) == 0);
+	CHECK(key_isdown("SHIFT") == 1);
+	CHECK(sim_keyevent(0xA1, 0) == 0);
+	CHECK(key_isdown("SHIFT") == 0);
+	while(listener_cbpolln(ev, 8) > 0) {}
+	CHECK(listener_stop() == 0);
+}
+
+/*
+ * test_typeb - Batched typing reuses Shift across a run
+ */
+static void test_typeb(void) {
+	CHECK(listener_start() == 0);
+
+	/* One Shift press covers a run of shifted characters */
+	CHECK(key_typeb("aBC d", 0, 0) == 0);
+	CHECK(keys_match(KEYS(0x41, -0x41, 0xA0, 0x42, -0x42, 0x43, -0x43, -0xA0, 0x20, -0x20, 0x44, -0x44)));
+
+	/* Every chunk releases what it pressed */
+	CHECK(key_typeb("AB", 1, 0) == 0);
+	CHECK(keys_match(KEYS(0xA0, 0x41, -0x41, -0xA0, 0xA0, 0x42, -0x42, -0xA0)));
+	CHECK(key_type("x!") == 0);
+	CHECK(keys_match(KEYS(0x58, -0x58, 0xA0, 0x31, -0x31, -0xA0)));
+	CHECK(listener_stop() == 0);
+}
+
+/*
+ * test_type_utf8 - Unicode typing sends code units, surrogate pairs as two
+ */
+static void test_type_utf8(void) {
+	CHECK(listener_start() == 0);
+	CHECK(key_type_utf8("\xC3\xA9\xF0\x9F\x98\x80\r\n") == 0);
+	CHECK(keys_match(KEYS(0x100E9, -0x100E9, 0x1D83D, -0x1D83D, 0x1DE00, -0x1DE00, 0x0D, -0x0D)));
+
+	/* Malformed input is rejected whole: a stray byte, an overlong form 
+	   and an encoded surrogate */
+	CHECK(key_type_utf8("a\xFF") == 1);
+	CHECK(key_type_utf8("\xC0\xAF") == 1);
+	CHECK(key_type_utf8("\xED\xA0\x80") == 1);
+	CHECK(keys_match(NULL, 0));
+	CHECK(listener_stop() == 0);
+}
+
+/*
+ * test_layout - Typed characters resolve on the current layout
+ */
+static void test_layout(void) {
+	CHECK(listener_start() == 0);
+
+	/* Malformed bytes are skipped, the rest still types */
+	CHECK(key_typeb("a\xFF" "b\xC3(c\xE2\x82" "d\xC0\xAF", 0, 0) == 0);
+	CHECK(keys_match(KEYS(0x41, -0x41, 0x42, -0x42, 0xA0, 0x39, -0x39, -0xA0, 0x43, -0x43, 0x44, -0x44)));
+	CHECK(key_typeb("\xF0\x9F", 0, 0) == 0);
+	CHECK(keys_match(NULL, 0));
+
+	/* AltGr is Ctrl+Alt, pressed once around its run. é is not on the 
+	   layout and is skipped */
+	CHECK(sim_layout(SIM_LAYOUT_DE) == 0);
+	CHECK(key_typeb("z\xC3\xA4@\xE2\x82\xAC\xC3\xA9y", 0, 0) == 0);
+	CHECK(keys_match(KEYS(0x5A, -0x5A, 0xDE, -0xDE, 0xA2, 0xA4, 0x51, -0x51, 0x45, -0x45, -0xA4, -0xA2, 0x59, -0x59)));
+	CHECK(key_typeb("\xC3\x9F?/#", 0, 0) == 0);
+	CHECK(keys_match(KEYS(0xDB, -0xDB, 0xA0, 0xDB, -0xDB, 0x37, -0x37, -0xA0, 0xBF, -0xBF)));
+
+	/* Listener names resolve on the same layout as the injection functions */
+	CHECK(listener_block("\xC3\x9F") == 0);
+	CHECK(sim_keyevent(0xDB, 1) == 1 && sim_keyevent(0xDB, 0) == 1);
+	CHECK(listener_ublock("\xC3\x9F") == 0);
+	CHECK(sim_keyevent(0xDB, 1) == 0);
+	CHECK(key_isdown("\xC3\x9F") == 1 && listener_keystate("?") == 1 && listener_keystate("/") == 0);
+	CHECK(sim_keyevent(0xDB, 0) == 0);
+	CHECK(keys_match(KEYS(0xDB, -0xDB)));
+
+	/* A layout switch drops the cached translations */
+	CHECK(sim_layout(SIM_LAYOUT_US) == 0);
+	CHECK(sim_keyevent(0xBF, 1) == 0);
+	CHECK(listener_keystate("/") == 1 && key_isdown("?") == 1);
+	CHECK(sim_keyevent(0xBF, 0) == 0);
+	CHECK(keys_match(KEYS(0xBF, -0xBF)));
+	CHECK(key_typeb("?@/", 0, 0) == 0);
+	CHECK(keys_match(KEYS(0xA0, 0xBF, -0xBF, 0x32, -0x32, -0xA0, 0xBF, -0xBF)));
+	CHECK(listener_stop() == 0);
+}
+
+/*
+ * overflow - Queue five press/release pairs, A to E, into a small queue
+ */
+static void overflow(int policy, int max_capacity) {
+	CHECK(listener_cbqueue(4, policy, max_capacity) == 0);
+	CHECK(listener_start() == 0);
+	for(int vk = 0x41; vk <= 0x45; ++vk) {
+		CHECK(sim_keyevent(vk, 1) == 0);
+		CHECK(sim_keyevent(vk, 0) == 0);
+	}
+	CHECK(listener_stop() == 0);
+}
+
+/*
+ * test_queue_policies - Which events survive an overflow, and the counts
+ */
+static void test_queue_policies(void) {
+	ListenerQueueStats st;
+
+	/* The newest events overwrite the oldest */
+	overflow(LISTENER_QUEUE_DROP_OLDEST, 0);
+	CHECK(listener_cbqueuestats(&st, 0) == 0);
+	CHECK(st.capacity == 4 && st.length == 4 && st.dropped == 6 && st.grown == 0);
+	CHECK(keys_match(KEYS(0x44, -0x44, 0x45, -0x45)));
+
+	/* Incoming events are discarded */
+	overflow(LISTENER_QUEUE_DROP_NEWEST, 0);
+	CHECK(listener_cbqueuestats(&st, 0) == 0);
+	CHECK(st.length == 4 && st.high_water == 4 && st.dropped == 6);
+	CHECK(keys_match(KEYS(0x41, -0x41, 0x42, -0x42)));
+
+	/* The queue doubles up to its cap, then discards incoming events */
+	overflow(LISTENER_QUEUE_GROW, 8);
+	CHECK(listener_cbqueuestats(&st, 0) == 0);
+	CHECK(st.capacity == 8 && st.max_capacity == 8 && st.grown == 1 && st.dropped == 2);
+	CHECK(keys_match(KEYS(0x41, -0x41, 0x42, -0x42, 0x43, -0x43, 0x44, -0x44)));
+
+	/* Reset clears the counters and restarts the high-water mark */
+	CHECK(listener_cbqueuestats(&st, 1) == 0);
+	CHECK(st.dropped == 2);
+	CHECK(listener_cbqueuestats(&st, 0) == 0);
+	CHECK(st.dropped == 0 && st.grown == 0 && st.high_water == 0 && st.length == 0);
+	CHECK(listener_cbqueue(4096, LISTENER_QUEUE_DROP_NEWEST, 0) == 0);
+}
+
+/*
+ * test_pollex - listener_cbpollex honours the caller's struct size
+ */
+static void test_pollex(void) {
+	const size_t v1 = offsetof(EventEx, type);
+	union {
+		EventEx ex;
+		unsigned char bytes[sizeof(EventEx)];
+	} buf;
+
+	CHECK(listener_start() == 0);
+	CHECK(sim_keyevent(0x41, 1) == 0);
+	CHECK(sim_keyevent(0x41, 0) == 0);
+	CHECK(sim_keyevent(0x42, 1) == 0);
+	CHECK(listener_stop() == 0);
+	CHECK(sim_keyevent(0x42, 0) == 0);
+
+	/* Too small for the first version, rejected without consuming */
+	memset(&buf, 0, sizeof(buf));
+	buf.ex.size = (unsigned int)v1 - 1;
+	SetLastError(0);
+	CHECK(listener_cbpollex(&buf.ex) == -1 && GetLastError() == ERROR_INVALID_PARAMETER);
+	CHECK(listener_cbpollex(NULL) == -1 && GetLastError() == ERROR_INVALID_PARAMETER);
+
+	/* A version 1 caller gets the version 1 fields and nothing past them */
+	memset(&buf, 0xA5, sizeof(buf));
+	buf.ex.size = (unsigned int)v1;
+	CHECK(listener_cbpollex(&buf.ex) == 1);
+	CHECK(buf.ex.size == v1 && buf.ex.version == 1);
+	CHECK(buf.ex.vk == 0x41 && buf.ex.pressed == 1);
+	int untouched = 1;
+	for(size_t i = v1; i < sizeof(buf); ++i) untouched &= buf.bytes[i] == 0xA5;
+	CHECK(untouched);
+
+	/* A version 3 caller stops short of self */
+	memset(&buf, 0xA5, sizeof(buf));
+	buf.ex.size = (unsigned int)offsetof(EventEx, self);
+	CHECK(listener_cbpollex(&buf.ex) == 1);
+	CHECK(buf.ex.version == 3 && buf.ex.vk == 0x41 && buf.ex.pressed == 0 && buf.ex.repeat == 0);
+	CHECK(buf.bytes[offsetof(EventEx, self)] == 0xA5);
+
+	/* The full struct gets every field */
+	memset(&buf, 0xA5, sizeof(buf));
+	buf.ex.size = sizeof(EventEx);
+	CHECK(listener_cbpollex(&buf.ex) == 1);
+	CHECK(buf.ex.size == sizeof(EventEx) && buf.ex.version == EVENTEX_VERSION);
+	CHECK(buf.ex.vk == 0x42 && buf.ex.pressed == 1);
+	CHECK(buf.ex.type == EVENT_KEY && buf.ex.repeat == 0 && buf.ex.self == 0);
+	CHECK(listener_cbpollex(&buf.ex) == 0);
+}
+
+/*
+ * poll_key - Poll the next event and check its key, direction and repeat
+ */
+static int poll_key(int vk, int pressed, int repeat) {
+	EventEx ex;
+	ex.size = sizeof(ex);
+	if(listener_cbpollex(&ex) != 1) return 0;
+	return ex.vk == vk && ex.pressed == pressed && ex.repeat == repeat;
+}
+
+/*
+ * test_repeat_debounce - Auto-repeat folding and chatter suppression
+ */
+static void test_repeat_debounce(void) {
+	CHECK(listener_start() == 0);
+
+	/* Unfolded, each repeat is its own press */
+	CHECK(sim_keyevent(0x41, 1) == 0);
+	CHECK(sim_keyevent(0x41, 1) == 0);
+	CHECK(sim_keyevent(0x41, 0) == 0);
+	CHECK(poll_key(0x41, 1, 0) && poll_key(0x41, 1, 1) && poll_key(0x41, 0, 0));
+
+	/* Folded, repeats still pass but only the release reports them */
+	CHECK(listener_repeatfold(1) == 0);
+	CHECK(sim_keyevent(0x41, 1) == 0);
+	for(int i = 0; i < 3; ++i) CHECK(sim_keyevent(0x41, 1) == 0);
+	CHECK(sim_keyevent(0x41, 0) == 0);
+	CHECK(poll_key(0x41, 1, 0) && poll_key(0x41, 0, 3));
+	CHECK(listener_repeatfold(0) == 0);
+
+	/* A press within the window of the last release is swallowed with its release */
+	CHECK(listener_debounce(0x42, 20) == 0);
+	CHECK(sim_advance(100) == 0);
+	CHECK(sim_keyevent(0x42, 1) == 0);
+	CHECK(sim_advance(30) == 0);
+	CHECK(sim_keyevent(0x42, 0) == 0);
+	CHECK(sim_advance(5) == 0);
+	CHECK(sim_keyevent(0x42, 1) == 1);
+	CHECK(sim_keyevent(0x42, 0) == 1);
+	CHECK(sim_advance(30) == 0);
+	CHECK(sim_keyevent(0x42, 1) == 0);
+	CHECK(sim_keyevent(0x42, 0) == 0);
+	CHECK(poll_key(0x42, 1, 0) && poll_key(0x42, 0, 0));
+	CHECK(poll_key(0x42, 1, 0) && poll_key(0x42, 0, 0));
+	EventEx ex;
+	ex.size = sizeof(ex);
+	CHECK(listener_cbpollex(&ex) == 0);
+
+	/* Other keys and injected input are not debounced */
+	CHECK(key_press("b") == 0);
+	CHECK(key_press("b") == 0);
+	CHECK(poll_key(0x42, 1, 0) && poll_key(0x42, 0, 0));
+	CHECK(poll_key(0x42, 1, 0) && poll_key(0x42, 0, 0));
+	CHECK(sim_keyevent(0x43, 1) == 0 && sim_keyevent(0x43, 0) == 0);
+	CHECK(sim_keyevent(0x43, 1) == 0 && sim_keyevent(0x43, 0) == 0);
+	CHECK(listener_debounce(0x42, 0) == 0);
+	CHECK(listener_stop() == 0);
+	CHECK(listener_cbqueue(4096, LISTENER_QUEUE_DROP_NEWEST, 0) == 0);
+}
+
+/*
+ * test_record_replay - A recording replays the events it captured
+ */
+static void test_record_replay(void) {
+	enum { PAIRS = 750 };
+	static int vks[PAIRS * 2];
+	static unsigned long long deltas[PAIRS * 2];
+	EventEx ex;
+
+	CHECK(listener_start() == 0);
+	CHECK(listener_record("sim_smoke_rec", 4096, 0) == 0);
+	for(int i = 0; i < PAIRS * 2; ++i) {
+		int vk = 0x41 + (i / 2) % 26;
+		CHECK(sim_advance(1 + i % 3) == 0);
+		CHECK(sim_keyevent(vk, !(i & 1)) == 0);
+		vks[i] = i & 1 ? -vk : vk;
+		ex.size = sizeof(ex);
+		CHECK(listener_cbpollex(&ex) == 1);
+		deltas[i] = ex.delta_ns;
+	}
+	CHECK(listener_recordstop() == 0);
+	ListenerRecordStats rst;
+	CHECK(listener_recordstats(&rst) == 0);
+	CHECK(rst.events == PAIRS * 2 && rst.dropped == 0 && rst.segments == 2);
+
+	/* Replayed through the same hook, injected but otherwise unchanged */
+	CHECK(input_replay("sim_smoke_rec", 1.0, 0, 0) == 0);
+	int same = 1;
+	for(int i = 0; i < PAIRS * 2; ++i) {
+		ex.size = sizeof(ex);
+		if(listener_cbpollex(&ex) != 1) { same = 0; break; }
+		int vk = ex.pressed ? ex.vk : -ex.vk;
+		if(vk != vks[i] || !ex.injected || (i > 0 && ex.delta_ns != deltas[i])) same = 0;
+	}
+	CHECK(same);
+	ex.size = sizeof(ex);
+	CHECK(listener_cbpollex(&ex) == 0);
+	CHECK(remove("sim_smoke_rec.000000") == 0 && remove("sim_smoke_rec.000001") == 0);
+
+	/* A record head with no type bits ends the segment. Decoded as type -1 
+	   it would misread the rest of the segment as further events */
+	CHECK(listener_record("sim_smoke_rec", 4096, 0) == 0);
+	CHECK(sim_keyevent(0x41, 1) == 0 && sim_keyevent(0x41, 0) == 0);
+	CHECK(sim_keyevent(0x42, 1) == 0 && sim_keyevent(0x42, 0) == 0);
+	CHECK(listener_recordstop() == 0);
+	while(poll_ex(&ex)) {}
+	FILE* f = fopen("sim_smoke_rec.000000", "r+b");
+	CHECK(f != NULL);
+	if(f) {
+		unsigned char head = 0;
+		CHECK(fseek(f, 32, SEEK_SET) == 0 && fread(&head, 1, 1, f) == 1);  /* First record, after the header */
+		head = (unsigned char)((head & ~0x07) | 0x40);  /* Clear the type, keep REC_PRESSED, set REC_OPT */
+		CHECK(fseek(f, 32, SEEK_SET) == 0 && fwrite(&head, 1, 1, f) == 1);
+		fclose(f);
+	}
+	CHECK(listener_stop() == 0);
+	CHECK(listener_mouse(1) == 0);
+	CHECK(listener_start() == 0);
+	CHECK(input_replay("sim_smoke_rec", 1.0, 0, 0) == 0);
+	CHECK(!poll_ex(&ex));
+	CHECK(listener_stop() == 0);
+	CHECK(listener_mouse(0) == 0);
+	CHECK(remove("sim_smoke_rec.000000") == 0);
+}
+
+/*
+ * hist_total - Sum of a latency histogram
+ */
+static unsigned long long hist_total(const unsigned long long* hist) {
+	unsigned long long total = 0;
+	for(int i = 0; i < LISTENER_HIST_BUCKETS; ++i) total += hist[i];
+	return total;
+}
+
+/*
+ * test_stats - Hook counters, block reasons and reset
+ */
+static void test_stats(void) {
+	static ListenerStats st;
+
+	CHECK(listener_stats(&st, 1) == 0);
+	CHECK(listener_start() == 0);
+	CHECK(listener_blocka(0x42) == 0);
+	CHECK(sim_keyevent(0x42, 1) == 1 && sim_keyevent(0x42, 0) == 1);
+	CHECK(sim_keyevent(0x42, 1) == 1 && sim_keyevent(0x42, 0) == 1);
+	CHECK(listener_ublocka(0x42) == 0);
+	CHECK(listener_blockphys(1) == 0);
+	CHECK(sim_keyevent(0x43, 1) == 1 && sim_keyevent(0x43, 0) == 1);
+	CHECK(listener_blockphys(0) == 0);
+	CHECK(sim_keyevent(0x41, 1) == 0 && sim_keyevent(0x41, 0) == 0);
+	CHECK(listener_stop() == 0);
+
+	CHECK(listener_stats(&st, 0) == 0);
+	CHECK(st.events == 8 && hist_total(st.hook_hist) == 8);
+	CHECK(st.blocked_key == 4 && st.blocked_phys == 2 && st.blocked_all == 0);
+	CHECK(st.hook_mean_ns == st.hook_total_ns / 8 && st.hook_max_ns >= st.hook_mean_ns);
+	CHECK(st.hook_p50_ns <= st.hook_p99_ns && st.hook_p99_ns <= st.hook_max_ns);
+	CHECK(st.queue_length == 2);
+
+	/* Reset hands back the counts once, then starts over */
+	CHECK(listener_stats(&st, 1) == 0);
+	CHECK(st.events == 8 && st.blocked_key == 4);
+	CHECK(listener_stats(&st, 0) == 0);
+	CHECK(st.events == 0 && st.hook_total_ns == 0 && st.hook_max_ns == 0 && hist_total(st.hook_hist) == 0);
+	CHECK(st.blocked_key == 0 && st.blocked_phys == 0 && st.dropped == 0);
+	CHECK(keys_match(KEYS(0x41, -0x41)));
+}
+
+/*
+ * test_remap - Remapped keys are replaced in the hook and released on stop
+ */
+static void test_remap(void) {
+	const char* to_b[] = { "B" };
+	const char* to_xy[] = { "X", "Y" };
+	CHECK(listener_remap("A", to_b, 1) == 0);
+	CHECK(listener_remap("C", to_xy, 2) == 0);
+	CHECK(listener_start() == 0);
+
+	/* The source key is swallowed, the target held in its place */
+	CHECK(sim_keyevent(0x41, 1) == 1);
+	CHECK(key_isdown("B") == 1 && key_isdown("A") == 0);
+	CHECK(sim_keyevent(0x41, 0) == 1);
+	CHECK(key_isdown("B") == 0);
+	CHECK(keys_match(KEYS(0x42, -0x42)));
+
+	/* Several steps are typed on the press */
+	CHECK(sim_keyevent(0x43, 1) == 1 && sim_keyevent(0x43, 0) == 1);
+	CHECK(keys_match(KEYS(0x58, -0x58, 0x59, -0x59)));
+
+	/* A target still held is let go when the listener stops */
+	CHECK(sim_keyevent(0x41, 1) == 1);
+	CHECK(key_isdown("B") == 1);
+	CHECK(listener_stop() == 0);
+	CHECK(key_isdown("B") == 0);
+	CHECK(sim_keyevent(0x41, 0) == 0);
+	CHECK(keys_match(KEYS(0x42)));
+
+	/* Replacements reach the system whatever happens to other own input */
+	CHECK(listener_start() == 0);
+	for(int mode = LISTENER_SELF_DELIVER; mode <= LISTENER_SELF_BLOCK; ++mode) {
+		CHECK(listener_selfinput(mode) == 0);
+		CHECK(sim_keyevent(0x41, 1) == 1);
+		CHECK(key_isdown("B") == 1);
+		CHECK(sim_keyevent(0x41, 0) == 1);
+		CHECK(key_isdown("B") == 0);
+		CHECK(sim_keyevent(0x43, 1) == 1 && sim_keyevent(0x43, 0) == 1);
+		CHECK(keys_match(KEYS(0x42, -0x42, 0x58, -0x58, 0x59, -0x59)));
+	}
+	Event none[4];
+	CHECK(key_press("d") == 0);
+	CHECK(listener_cbpolln(none, 4) == 0);
+	CHECK(listener_selfinput(LISTENER_SELF_DELIVER) == 0);
+	CHECK(listener_stop() == 0);
+
+	/* Unremapped keys pass through again */
+	CHECK(listener_unremap("A") == 0 && listener_unremap("C") == 0);
+	CHECK(listener_unremap("A") == 1);
+	CHECK(listener_start() == 0);
+	CHECK(sim_keyevent(0x41, 1) == 0 && sim_keyevent(0x41, 0) == 0);
+	CHECK(keys_match(KEYS(0x41, -0x41)));
+	CHECK(listener_stop() == 0);
+}
+
+/*
+ * test_scoped_blocks - Scoped blocks follow the foreground window
+ */
+static void test_scoped_blocks(void) {
+	CHECK(listener_blockscope("A", LISTENER_SCOPE_PROCESS, "Notepad.exe") == 0);
+	CHECK(listener_blockscope("B", LISTENER_SCOPE_CLASS, "consolewindowclass") == 0);
+	CHECK(listener_blockscope("C", LISTENER_SCOPE_TITLE, "Secret") == 0);
+
+	/* Resolved on start */
+	CHECK(sim_addwindow("Untitled - Notepad", "Notepad", "notepad.exe", 0, 0, 640, 480) != NULL);
+	CHECK(listener_start() == 0);
+	CHECK(sim_keyevent(0x41, 1) == 1 && sim_keyevent(0x41, 0) == 1);
+	CHECK(sim_keyevent(0x42, 1) == 0 && sim_keyevent(0x42, 0) == 0);
+
+	/* And on every foreground change while running */
+	CHECK(sim_addwindow("cmd", "ConsoleWindowClass", "cmd.exe", 0, 0, 640, 480) != NULL);
+	CHECK(sim_keyevent(0x41, 1) == 0 && sim_keyevent(0x41, 0) == 0);
+	CHECK(sim_keyevent(0x42, 1) == 1 && sim_keyevent(0x42, 0) == 1);
+	CHECK(window_setactive("Untitled - Notepad") == 0);
+	CHECK(sim_keyevent(0x41, 1) == 1 && sim_keyevent(0x41, 0) == 1);
+	CHECK(sim_keyevent(0x43, 1) == 0 && sim_keyevent(0x43, 0) == 0);
+	CHECK(sim_addwindow("Secret - Notes", "Notes", "notes.exe", 0, 0, 640, 480) != NULL);
+	CHECK(sim_keyevent(0x43, 1) == 1 && sim_keyevent(0x43, 0) == 1);
+	CHECK(sim_keyevent(0x41, 1) == 0 && sim_keyevent(0x41, 0) == 0);
+	CHECK(window_setactive("cmd") == 0);
+	CHECK(sim_keyevent(0x42, 1) == 1 && sim_keyevent(0x42, 0) == 1);
+	CHECK(keys_match(KEYS(0x42, -0x42, 0x41, -0x41, 0x43, -0x43, 0x41, -0x41)));
+
+	/* Removing the block lets the key through in the same window */
+	CHECK(listener_ublockscope("A", LISTENER_SCOPE_PROCESS, "notepad.exe") == 0);
+	CHECK(window_setactive("Untitled - Notepad") == 0);
+	CHECK(sim_keyevent(0x41, 1) == 0 && sim_keyevent(0x41, 0) == 0);
+	CHECK(listener_stop() == 0);
+	CHECK(keys_match(KEYS(0x41, -0x41)));
+	CHECK(listener_ublockscope("B", LISTENER_SCOPE_CLASS, "ConsoleWindowClass") == 0);
+	CHECK(listener_ublockscope("C", LISTENER_SCOPE_TITLE, "secret") == 0);
+	CHECK(window_close("cmd") == 0 && window_close("Secret - Notes") == 0 && window_close("Untitled - Notepad") == 0);
+}
+
+static void* block_c(void* arg) {
+	(void)arg;
+	CHECK(listener_block("C") == 0);
+	return NULL;
+}
+
+/*
+ * test_block_batch - The hook keeps the old rules until the batch commits
+ */
+static void test_block_batch(void) {
+	pthread_t thread;
+	CHECK(listener_start() == 0);
+	CHECK(listener_blockbegin() == 0);
+	CHECK(listener_blockbegin() == 0);
+	CHECK(listener_block("A") == 0);
+	CHECK(listener_blockcommit() == 0);
+	CHECK(sim_keyevent(0x41, 1) == 0 && sim_keyevent(0x41, 0) == 0);
+
+	/* Another thread's change joins the open batch instead of waiting */
+	CHECK(pthread_create(&thread, NULL, block_c, NULL) == 0);
+	pthread_join(thread, NULL);
+	CHECK(sim_keyevent(0x43, 1) == 0 && sim_keyevent(0x43, 0) == 0);
+	CHECK(listener_isblocked("C") == 0);
+
+	/* The outermost commit publishes everything at once */
+	CHECK(listener_blockcommit() == 0);
+	CHECK(listener_isblocked("A") == 1 && listener_isblocked("C") == 1);
+	CHECK(sim_keyevent(0x41, 1) == 1 && sim_keyevent(0x41, 0) == 1);
+	CHECK(sim_keyevent(0x43, 1) == 1 && sim_keyevent(0x43, 0) == 1);
+	CHECK(listener_blockcommit() == 1);
+	CHECK(listener_ublock("A") == 0 && listener_ublock("C") == 0);
+	CHECK(listener_stop() == 0);
+	CHECK(keys_match(KEYS(0x41, -0x41, 0x43, -0x43)));
+}
+
+/*
+ * test_selfinput - The library's own input is tagged, skipped or blocked
+ */
+static void test_selfinput(void) {
+	ListenerStats st;
+	EventEx ex;
+	CHECK(listener_start() == 0);
+
+	/* Own injections are tagged, physical input is not */
+	CHECK(key_press("c") == 0);
+	CHECK(sim_keyevent(0x43, 1) == 0 && sim_keyevent(0x43, 0) == 0);
+	CHECK(poll_ex(&ex) && ex.vk == 0x43 && ex.injected == 1 && ex.self == 1);
+	CHECK(poll_ex(&ex) && ex.vk == 0x43 && ex.self == 1);
+	CHECK(poll_ex(&ex) && ex.vk == 0x43 && ex.injected == 0 && ex.self == 0);
+	CHECK(poll_ex(&ex) && ex.vk == 0x43 && ex.self == 0);
+
+	/* Skipped input reaches the system without being delivered, but still 
+	   counts as held: a physical Shift press during the hold is a repeat, 
+	   and other keys see Shift among the modifiers */
+	CHECK(listener_selfinput(LISTENER_SELF_SKIP) == 0);
+	CHECK(sim_realtime(1) == 0);
+	input_job_t* job = key_hold_async("SHIFT", 300);
+	CHECK(job != NULL);
+	for(int i = 0; i < 1000 && !key_isdown("SHIFT"); ++i) input_sleep(1);
+	CHECK(key_isdown("SHIFT") == 1);
+	CHECK(sim_keyevent(0xA0, 1) == 0);
+	CHECK(sim_keyevent(0x42, 1) == 0 && sim_keyevent(0x42, 0) == 0);
+	CHECK(input_jobwait(job, 5000) == 0 && input_jobpoll(job) == INPUT_JOB_DONE);
+	CHECK(input_jobclose(job) == 0);
+	CHECK(sim_realtime(0) == 0);
+	CHECK(key_isdown("SHIFT") == 0);
+	CHECK(poll_ex(&ex) && ex.vk == 0xA0 && ex.pressed == 1 && ex.repeat == 1);
+	CHECK(poll_ex(&ex) && ex.vk == 0x42 && ex.pressed == 1 && (ex.modifiers & 1));
+	CHECK(poll_ex(&ex) && ex.vk == 0x42 && ex.pressed == 0);
+	CHECK(!poll_ex(&ex));
+
+	/* Blocked input never reaches the system, and is counted */
+	CHECK(listener_selfinput(LISTENER_SELF_BLOCK) == 0);
+	CHECK(listener_stats(&st, 1) == 0);
+	CHECK(key_press("c") == 0);
+	CHECK(listener_stats(&st, 0) == 0);
+	CHECK(st.blocked_self == 2 && st.events == 0);
+	CHECK(!poll_ex(&ex));
+	CHECK(sim_keyevent(0x43, 1) == 0 && sim_keyevent(0x43, 0) == 0);
+	CHECK(poll_ex(&ex) && ex.vk == 0x43 && ex.self == 0);
+	CHECK(poll_ex(&ex) && ex.vk == 0x43 && ex.self == 0);
+	CHECK(listener_selfinput(LISTENER_SELF_DELIVER) == 0);
+	CHECK(listener_stop() == 0);
+}
+
+/*
+ * tap - Feed a physical press and release of a key
+ */
+static void tap(int vk) {
+	CHECK(sim_keyevent(vk, 1) == 0);
+	CHECK(sim_keyevent(vk, 0) == 0);
+}
+
+/*
+ * test_sequences - Step gaps, modifier steps and restarts
+ */
+static void test_sequences(void) {
+	Event ev[8];
+	CHECK(listener_start() == 0);
+
+	/* A gap over the timeout rejects the match, a shorter one does not */
+	const char* gh[] = { "G", "H" };
+	int seq = sequence_register(gh, 2, on_hotkey, 100, 0);
+	CHECK(seq > 0);
+	g_fired_id = 0;
+	tap(0x47);
+	CHECK(sim_advance(150) == 0);
+	tap(0x48);
+	CHECK(g_fired_id == 0);
+	tap(0x47);
+	CHECK(sim_advance(50) == 0);
+	tap(0x48);
+	CHECK(g_fired_id == seq);
+	g_fired_id = 0;
+
+	/* An unrelated key in between restarts matching from its next press */
+	tap(0x47);
+	tap(0x4A);
+	tap(0x48);
+	CHECK(g_fired_id == 0);
+	tap(0x47);
+	tap(0x4A);
+	tap(0x47);
+	tap(0x48);
+	CHECK(g_fired_id == seq);
+	g_fired_id = 0;
+	CHECK(sequence_unregister(seq) == 0);
+
+	/* Each step needs exactly its modifiers held */
+	const char* kc[] = { "CONTROL+K", "CONTROL+C" };
+	seq = sequence_register(kc, 2, on_hotkey, 0, 0);
+	CHECK(seq > 0);
+	CHECK(sim_keyevent(0xA2, 1) == 0);
+	tap(0x4B);
+	CHECK(sim_keyevent(0xA2, 0) == 0);
+	tap(0x43);
+	CHECK(g_fired_id == 0);
+	CHECK(sim_keyevent(0xA2, 1) == 0);
+	tap(0x4B);
+	tap(0x43);
+	CHECK(sim_keyevent(0xA2, 0) == 0);
+	CHECK(g_fired_id == seq);
+	g_fired_id = 0;
+	CHECK(sequence_unregister(seq) == 0);
+
+	while(listener_cbpolln(ev, 8) > 0) {}
+	CHECK(listener_stop() == 0);
+}
+
+/*
+ * test_timing - Paced waits land on their deadlines and are counted
+ */
+static void test_timing(void) {
+	InputTimingStats st;
+	CHECK(input_timingstats(&st, 1) == 0);
+
+	/* Each sleep lands exactly on its deadline, so they add up without
+	   drift; an empty sleep is not a wait */
+	unsigned long long t0 = sim_clock();
+	for(int i = 0; i < 10; ++i) input_sleep_us(1500);
+	input_sleep_us(0);
+	CHECK(sim_clock() - t0 == 15);
+
+	/* A paced move steps on absolute deadlines: 10 steps of 10ms */
+	CHECK(cursor_moveto(0, 0) == 0);
+	t0 = sim_clock();
+	CHECK(cursor_movetos(100, 0, 100) == 0);
+	CHECK(sim_clock() - t0 == 100);
+	CHECK(input_timingstats(&st, 0) == 0);
+	CHECK(st.waits == 20 && st.missed == 0 && st.max_late_ns == 0 && st.mean_late_ns == 0);
+
+	/* Reading with reset returns the counts, then starts over */
+	CHECK(input_timingstats(&st, 1) == 0);
+	CHECK(st.waits == 20);
+	CHECK(input_timingstats(&st, 0) == 0);
+	CHECK(st.waits == 0 && st.missed == 0 && st.total_late_ns == 0 && st.max_late_ns == 0);
+
+	/* On the real clock a sleep never wakes early */
+	CHECK(sim_realtime(1) == 0);
+	t0 = sim_clock();
+	for(int i = 0; i < 20; ++i) input_sleep_us(1000);
+	CHECK(sim_clock() - t0 >= 20);
+	CHECK(sim_realtime(0) == 0);
+	CHECK(input_timingstats(&st, 1) == 0);
+	CHECK(st.waits == 20 && st.missed == 0 && st.mean_late_ns <= st.max_late_ns);
+	CHECK(input_timingstats(NULL, 0) == 1);
+}
+
+/*
+ * cursor_at - Check the simulated cursor position
+ * 
+ * SetCursorPos moves are invisible to the hook, so a wheel turn is fed 
+ * through it to report where the cursor is. Needs listener_mouse.
+ */
+static int cursor_at(int x, int y) {
+	EventEx ex;
+	if(sim_mousewheel(0, 0) != 0 || !poll_ex(&ex)) return 0;
+	return ex.type == EVENT_MOUSE_WHEEL && ex.x == x && ex.y == y;
+}
+
+/*
+ * test_async_jobs - Running and queued jobs can be cancelled and polled
+ */
+static void test_async_jobs(void) {
+	EventEx ex;
+	CHECK(listener_mouse(1) == 0);
+	CHECK(listener_start() == 0);
+	CHECK(cursor_moveto(100, 100) == 0);
+
+	/* A cancelled hold releases its key early, and a job queued behind it
+	   is dropped without ever running */
+	CHECK(sim_realtime(1) == 0);
+	input_job_t* hold = key_hold_async("D", 5000);
+	input_job_t* move = cursor_movetos_async(200, 200, 50);
+	CHECK(hold != NULL && move != NULL);
+	for(int i = 0; i < 1000 && !key_isdown("D"); ++i) input_sleep(1);
+	CHECK(key_isdown("D") == 1);
+	CHECK(input_jobpoll(hold) == INPUT_JOB_RUNNING);
+	CHECK(input_jobpoll(move) == INPUT_JOB_PENDING);
+	CHECK(input_jobcancel(move) == 0);
+	CHECK(input_jobpoll(move) == INPUT_JOB_CANCELLED);
+	CHECK(input_jobwait(move, 0) == 0);
+	CHECK(input_jobcancel(hold) == 0);
+	CHECK(input_jobwait(hold, 5000) == 0 && input_jobpoll(hold) == INPUT_JOB_CANCELLED);
+	CHECK(input_jobcancel(hold) == 1);
+	CHECK(sim_realtime(0) == 0);
+	CHECK(key_isdown("D") == 0);
+	CHECK(poll_ex(&ex) && ex.vk == 0x44 && ex.pressed == 1);
+	CHECK(poll_ex(&ex) && ex.vk == 0x44 && ex.pressed == 0);
+	CHECK(!poll_ex(&ex));
+	CHECK(cursor_at(100, 100));
+	CHECK(input_jobclose(hold) == 0);
+	CHECK(input_jobclose(move) == 0);
+
+	/* An uncancelled move runs to completion over its duration */
+	unsigned long long t0 = sim_clock();
+	move = cursor_movetos_async(200, 200, 50);
+	CHECK(move != NULL);
+	CHECK(input_jobwait(move, 5000) == 0 && input_jobpoll(move) == INPUT_JOB_DONE);
+	CHECK(sim_clock() - t0 == 50);
+	CHECK(cursor_at(200, 200));
+	CHECK(input_jobclose(move) == 0);
+	CHECK(listener_stop() == 0);
+	CHECK(listener_mouse(0) == 0);
+}
+
+int main(void) {
+	CHECK(input_setbackend(INPUT_BACKEND_SIM) == 0);
+	CHECK(input_init() == 0);
+	CHECK(sim_reset() == 0);
+	CHECK(listener_cbpollmode(1) == 0);
+	CHECK(listener_cbqueue(4096, LISTENER_QUEUE_DROP_NEWEST, 0) == 0);
+	CHECK(listener_start() == 0);
+
+	/* A physical press and release reach the poll queue in order */
+	CHECK(sim_advance(10) == 0);
+	CHECK(sim_keyevent(0x41, 1) == 0);
+	CHECK(sim_advance(40) == 0);
+	CHECK(sim_keyevent(0x41, 0) == 0);
+	Event ev[8];
+	int n = listener_cbpolln(ev, 8);
+	CHECK(n == 2);
+	if(n == 2) {
+		CHECK(ev[0].vk == 0x41 && ev[0].pressed == 1 && ev[0].injected == 0);
+		CHECK(ev[1].vk == 0x41 && ev[1].pressed == 0 && ev[1].held == 40);
+	}
+
+	/* Blocked keys are swallowed and never queued */
+	CHECK(listener_blocka(0x42) == 0);
+	CHECK(sim_keyevent(0x42, 1) == 1);
+	CHECK(sim_keyevent(0x42, 0) == 1);
+	CHECK(listener_cbpolln(ev, 8) == 0);
+	CHECK(listener_ublocka(0x42) == 0);
+
+	/* Injected input goes through the same hook, flagged as injected */
+	CHECK(key_press("c") == 0);
+	n = listener_cbpolln(ev, 8);
+	CHECK(n == 2);
+	if(n == 2) CHECK(ev[0].vk == 0x43 && ev[0].injected == 1);
+	unsigned long long keys = 0, mouse = 0;
+	CHECK(sim_counts(&keys, &mouse) == 0);
+	CHECK(keys == 2 && mouse == 0);
+
+	/* Injector thread and physical input share the hook one event at a time */
+	input_job_t* job = key_type_async("abcdefghijklmnopqrstuvwxyz");
+	CHECK(job != NULL);
+	for(int i = 0; i < 2000; ++i) {
+		sim_keyevent(0x31, 1);
+		sim_keyevent(0x31, 0);
+	}
+	if(job) {
+		CHECK(input_jobwait(job, -1) == 0);
+		input_jobclose(job);
+	}
+	int total = 0;
+	while((n = listener_cbpolln(ev, 8)) > 0) total += n;
+	CHECK(total == 4000 + 52);
+
+	/* Hotkeys fire inline, or on the dispatcher once it is enabled, and 
+	   a swallowing hotkey blocks its trigger either way */
+	const char* chord[] = { "CONTROL", "H" };
+	int hk = hotkey_register(chord, 2, on_hotkey, HOTKEY_SWALLOW);
+	CHECK(hk > 0);
+	CHECK(sim_keyevent(0xA2, 1) == 0);
+	CHECK(sim_keyevent(0x48, 1) == 1);
+	CHECK(sim_keyevent(0x48, 0) == 1);
+	CHECK(g_fired_id == hk && pthread_equal(g_fired_thread, pthread_self()));
+	g_fired_id = 0;
+	CHECK(listener_cbdispatch(1, 64) == 0);
+	CHECK(sim_keyevent(0x48, 1) == 1);
+	CHECK(sim_keyevent(0x48, 0) == 1);
+	CHECK(wait_fired() == hk && !pthread_equal(g_fired_thread, pthread_self()));
+	g_fired_id = 0;
+	CHECK(sim_keyevent(0xA2, 0) == 0);
+	CHECK(hotkey_unregister(hk) == 0);
+
+	/* Sequences take the same route */
+	const char* steps[] = { "G", "G" };
+	int seq = sequence_register(steps, 2, on_hotkey, 0, 0);
+	CHECK(seq > 0);
+	for(int i = 0; i < 2; ++i) {
+		CHECK(sim_keyevent(0x47, 1) == 0);
+		CHECK(sim_keyevent(0x47, 0) == 0);
+	}
+	CHECK(wait_fired() == seq && !pthread_equal(g_fired_thread, pthread_self()));
+	g_fired_id = 0;
+	CHECK(listener_cbdispatch(0, 0) == 0);
+	CHECK(sequence_unregister(seq) == 0);
+	while(listener_cbpolln(ev, 8) > 0) {}
+
+	CHECK(listener_stop() == 0);
+
+	/* A move held back by a rate limit still wakes a waiting poll consumer */
+	CHECK(listener_mouse(1) == 0);
+	CHECK(listener_mousemoves(10) == 0);
+	CHECK(listener_start() == 0);
+	struct pollfd pfd = { (int)listener_cbwaitobj(), POLLIN, 0 };
+	CHECK(pfd.fd >= 0);
+	CHECK(poll(&pfd, 1, 20) == 0);  /* Let the wait timer park */
+	CHECK(sim_mousemove(10, 10) == 0);
+	CHECK(sim_mousemove(20, 20) == 0);
+	EventEx ex;
+	ex.size = sizeof(ex);
+	CHECK(listener_cbpollex(&ex) == 1 && ex.x == 10);
+	CHECK(listener_cbpollex(&ex) == 0);
+	CHECK(poll(&pfd, 1, 0) == 0);
+	CHECK(sim_advance(100) == 0);
+	CHECK(poll(&pfd, 1, 1000) == 1);
+	CHECK(listener_cbwait(ev, 8, 0) == 0);  /* Key-only, leaves the move */
+	CHECK(listener_cbpollex(&ex) == 1 && ex.type == EVENT_MOUSE_MOVE && ex.x == 20 && ex.y == 20);
+	CHECK(listener_stop() == 0);
+	CHECK(listener_mouse(0) == 0);
+	CHECK(listener_mousemoves(LISTENER_MOVES_ALL) == 0);
+
+	test_modifiers();
+	test_typeb();
+	test_type_utf8();
+	test_layout();
+	test_queue_policies();
+	test_pollex();
+	test_repeat_debounce();
+	test_record_replay();
+	test_stats();
+	test_remap();
+	test_scoped_blocks();
+	test_block_batch();
+	test_selfinput();
+	test_async_jobs();
+	test_timing();
+	test_sequences();
+
+	if(!g_failed) printf("sim_smoke: ok\n");
+	return g_failed;
+}
@@ -0,0 +1,114 @@
+/*
+ * bench_keymap.c - Key name lookup microbenchmark
+ *
+ * Compares keymap_find against the linear _stricmp scan it replaced (the
+ * original listener find_vk, reproduced below with its table) on a mix of
+ * single-character and multi-character names, and checks that both agree.
+ *
+ * Built by CMake as the bench_keymap target, best in a Release build:
+ *     cmake -S . -B build -DCMAKE_BUILD_TYPE=Release
+ *     cmake --build build --target bench_keymap && build/bench_keymap
+ *
+ * Usage: bench_keymap [lookups], 20000000 by default
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "keymap.h"
+#include "timing.h"
+
+typedef struct {
+	const char* name;
+	BYTE code;
+} vKey;
+
+/* The table find_vk scanned before keymap_find, in its original order */
+static const vKey old_keymap[] = {
+	{"A", 0x41}, {"B", 0x42}, {"C", 0x43}, {"D", 0x44}, {"E", 0x45}, {"F", 0x46}, {"G", 0x47},
+	{"H", 0x48}, {"I", 0x49}, {"J", 0x4A}, {"K", 0x4B}, {"L", 0x4C}, {"M", 0x4D}, {"N", 0x4E},
+	{"O", 0x4F}, {"P", 0x50}, {"Q", 0x51}, {"R", 0x52}, {"S", 0x53}, {"T", 0x54}, {"U", 0x55},
+	{"V", 0x56}, {"W", 0x57}, {"X", 0x58}, {"Y", 0x59}, {"Z", 0x5A},
+	{"0", 0x30}, {"1", 0x31}, {"2", 0x32}, {"3", 0x33}, {"4", 0x34}, {"5", 0x35}, {"6", 0x36},
+	{"7", 0x37}, {"8", 0x38}, {"9", 0x39}, {"!", 0x31}, {"@", 0x32}, {"#", 0x33}, {"$", 0x34},
+	{"%", 0x35}, {"^", 0x36}, {"&", 0x37}, {"*", 0x38}, {"(", 0x39}, {")", 0x30},
+	{"`", 0xC0}, {"~", 0xC0}, {"-", 0xBD}, {"_", 0xBD}, {"=", 0xBB}, {"+", 0xBB}, {"[", 0xDB},
+	{"{", 0xDB}, {"]", 0xDD}, {"}", 0xDD}, {"\\", 0xDC}, {"|", 0xDC}, {";", 0xBA}, {":", 0xBA},
+	{"'", 0xDE}, {"\"", 0xDE}, {",", 0xBC}, {"<", 0xBC}, {".", 0xBE}, {">", 0xBE}, {"/", 0xBF},
+	{"?", 0xBF},
+	{" ", 0x20}, {"SPACE", 0x20}, {"BACKSPACE", 0x08}, {"DELETE", 0x2E}, {"TAB", 0x09},
+	{"ENTER", 0x0D}, {"ESCAPE", 0x1B}, {"HOME", 0x24}, {"END", 0x23}, {"INSERT", 0x2D},
+	{"PAGEUP", 0x21}, {"PAGEDOWN", 0x22}, {"LEFT", 0x25}, {"UP", 0x26}, {"RIGHT", 0x27},
+	{"DOWN", 0x28}, {"SHIFT", 0x10}, {"CONTROL", 0x11}, {"ALT", 0x12}, {"WIN", 0x5B},
+	{"F1", 0x70}, {"F2", 0x71}, {"F3", 0x72}, {"F4", 0x73}, {"F5", 0x74}, {"F6", 0x75},
+	{"F7", 0x76}, {"F8", 0x77}, {"F9", 0x78}, {"F10", 0x79}, {"F11", 0x7A}, {"F12", 0x7B}
+};
+
+static const size_t old_keymap_count = sizeof(old_keymap) / sizeof(old_keymap[0]);
+
+/*
+ * old_find_vk - The original linear lookup
+ */
+static BYTE old_find_vk(const char* key) {
+	if(!key) return 0;
+	for(size_t i = 0; i < old_keymap_count; ++i) {
+		if(_stricmp(old_keymap[i].name, key) == 0) return old_keymap[i].code;
+	}
+	if(strlen(key) == 1) {
+		char s[2] = { (char)toupper((unsigned char)key[0]), 0 };
+		for(size_t i = 0; i < old_keymap_count; ++i) {
+			if(_stricmp(old_keymap[i].name, s) == 0) return old_keymap[i].code;
+		}
+	}
+	return 0;
+}
+
+/* Mixed workload: letters, digits, symbols and named keys in both cases */
+static const char* names[] = {
+	"A", "z", "7", "?", "ENTER", "space", "CONTROL", "shift", "F5", "f12", "PageDown", "ESCAPE"
+};
+#define NAME_COUNT (sizeof(names) / sizeof(names[0]))
+
+/* Keeps the lookups from being optimized away */
+static volatile unsigned g_sink;
+
+static double run(BYTE (*find)(const char*), long long lookups) {
+	unsigned sum = 0;
+	unsigned long long t0 = timing_now_ns();
+	for(long long i = 0; i < lookups; ++i) sum += find(names[i % NAME_COUNT]);
+	unsigned long long ns = timing_now_ns() - t0;
+	g_sink = sum;
+	return ns ? (double)lookups * 1000.0 / (double)ns : 0.0;  /* Millions per second */
+}
+
+int main(int argc, char** argv) {
+	long long lookups = argc > 1 ? atoll(argv[1]) : 20000000LL;
+	if(lookups <= 0) {
+		fprintf(stderr, "usage: %s [lookups]\n", argv[0]);
+		return 1;
+	}
+
+	/* Every old name, its lower-case form and every single byte must agree */
+	int mismatches = 0;
+	for(size_t i = 0; i < old_keymap_count; ++i) {
+		char lower[16];
+		size_t n = strlen(old_keymap[i].name);
+		for(size_t j = 0; j <= n; ++j) lower[j] = (char)tolower((unsigned char)old_keymap[i].name[j]);
+		mismatches += keymap_find(old_keymap[i].name) != old_find_vk(old_keymap[i].name);
+		mismatches += keymap_find(lower) != old_find_vk(lower);
+	}
+	for(int c = 1; c < 256; ++c) {
+		char s[2] = { (char)c, 0 };
+		mismatches += keymap_find(s) != old_find_vk(s);
+	}
+	if(mismatches) {
+		fprintf(stderr, "%d lookups disagree with the old table\n", mismatches);
+		return 1;
+	}
+
+	printf("%zu mixed names, %lld lookups\n", NAME_COUNT, lookups);
+	printf("  linear _stricmp scan (old listener find_vk): %6.1f M lookups/s\n", run(old_find_vk, lookups));
+	printf("  keymap_find:                                 %6.1f M lookups/s\n", run(keymap_find, lookups));
+	return 0;
+}
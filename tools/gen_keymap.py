@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""
+gen_keymap.py - Generate src/keymap_table.h
+
+Builds the compile-time key name tables used by keymap.c:
+  - a 256-entry table indexed by the case-folded character for
+    single-character names,
+  - a perfect hash table for multi-character names (FNV-1a over the
+    case-folded name with a searched seed, no collisions),
+  - a 256-entry vk -> canonical name table.
+
+Run from the repository root after editing KEYMAP:
+    python3 tools/gen_keymap.py > src/keymap_table.h
+"""
+
+import sys
+
+# Key name -> virtual key code, in canonical order. For the vk -> name
+# table the first multi-character name wins, otherwise the first name.
+KEYMAP = [
+    # Alphabetic keys A-Z (0x41-0x5A)
+    *[(chr(c), c) for c in range(0x41, 0x5B)],
+
+    # Number keys 0-9 (0x30-0x39) and their shifted symbols
+    *[(chr(c), c) for c in range(0x30, 0x3A)],
+    ("!", 0x31), ("@", 0x32), ("#", 0x33), ("$", 0x34), ("%", 0x35),
+    ("^", 0x36), ("&", 0x37), ("*", 0x38), ("(", 0x39), (")", 0x30),
+
+    # Punctuation and symbol keys
+    ("`", 0xC0), ("~", 0xC0), ("-", 0xBD), ("_", 0xBD), ("=", 0xBB), ("+", 0xBB),
+    ("[", 0xDB), ("{", 0xDB), ("]", 0xDD), ("}", 0xDD), ("\\", 0xDC), ("|", 0xDC),
+    (";", 0xBA), (":", 0xBA), ("'", 0xDE), ("\"", 0xDE), (",", 0xBC), ("<", 0xBC),
+    (".", 0xBE), (">", 0xBE), ("/", 0xBF), ("?", 0xBF),
+
+    # Special and navigation keys
+    (" ", 0x20), ("SPACE", 0x20), ("BACKSPACE", 0x08), ("DELETE", 0x2E), ("TAB", 0x09),
+    ("ENTER", 0x0D), ("ESCAPE", 0x1B), ("HOME", 0x24), ("END", 0x23), ("INSERT", 0x2D),
+    ("PAGEUP", 0x21), ("PAGEDOWN", 0x22), ("LEFT", 0x25), ("UP", 0x26), ("RIGHT", 0x27),
+    ("DOWN", 0x28), ("SHIFT", 0x10), ("CONTROL", 0x11), ("ALT", 0x12), ("WIN", 0x5B),
+
+    # Function keys F1-F12 (0x70-0x7B)
+    *[("F%d" % (i + 1), 0x70 + i) for i in range(12)],
+]
+
+FNV_PRIME = 0x01000193
+HASH_BITS = 7
+
+
+def fold(c):
+    return c - 32 if 0x61 <= c <= 0x7A else c
+
+
+def fnv(name, seed):
+    h = seed
+    for ch in name.encode():
+        h ^= fold(ch)
+        h = (h * FNV_PRIME) & 0xFFFFFFFF
+    return h
+
+
+def c_str(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def main():
+    single = {}
+    multi = []
+    for name, vk in KEYMAP:
+        if len(name) == 1:
+            single.setdefault(fold(ord(name)), (name, vk))
+        else:
+            multi.append((name, vk))
+
+    size = 1 << HASH_BITS
+    seed = 0x811C9DC5
+    while True:
+        slots = {}
+        for name, vk in multi:
+            i = fnv(name, seed) & (size - 1)
+            if i in slots:
+                break
+            slots[i] = (name, vk)
+        else:
+            break
+        seed = (seed + 1) & 0xFFFFFFFF
+
+    canon = {}
+    for name, vk in KEYMAP:
+        if vk not in canon or (len(canon[vk]) == 1 and len(name) > 1):
+            canon[vk] = name
+
+    out = sys.stdout
+    out.write("/*\n * keymap_table.h - Generated key name tables\n *\n")
+    out.write(" * Generated by tools/gen_keymap.py - do not edit by hand.\n */\n\n")
+    out.write("#pragma once\n\n")
+    out.write("/* Perfect hash parameters for multi-character names */\n")
+    out.write("#define KEYMAP_HASH_SEED 0x%08XU\n" % seed)
+    out.write("#define KEYMAP_HASH_BITS %d\n\n" % HASH_BITS)
+
+    out.write("/* Single-character names, indexed by case-folded character */\n")
+    out.write("static const BYTE keymap_chars[256] = {\n")
+    for c in sorted(single):
+        name, vk = single[c]
+        out.write("\t[0x%02X] = 0x%02X,  /* %s */\n" % (c, vk, c_str(name)))
+    out.write("};\n\n")
+
+    out.write("/* Multi-character names, indexed by perfect hash */\n")
+    out.write("static const KeymapSlot keymap_slots[1 << KEYMAP_HASH_BITS] = {\n")
+    for i in sorted(slots):
+        name, vk = slots[i]
+        out.write("\t[%d] = { %s, 0x%02X },\n" % (i, c_str(name), vk))
+    out.write("};\n\n")
+
+    out.write("/* Canonical name for each virtual key code */\n")
+    out.write("static const char* const keymap_names[256] = {\n")
+    for vk in sorted(canon):
+        out.write("\t[0x%02X] = %s,\n" % (vk, c_str(canon[vk])))
+    out.write("};\n")
+
+
+if __name__ == "__main__":
+    main()